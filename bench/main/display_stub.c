@@ -0,0 +1,61 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "ssd1306.h"
+
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define FONT_6x8_LEN 581 // as long as the original ssd1306xled_font6x8, which the lcd module copies
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+// characters printed since the screen was last cleared, so that the text is read like the display would
+static size_t printed_len = 0;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+const uint8_t ssd1306xled_font6x8[FONT_6x8_LEN] = {0};
+
+void ssd1306_setFixedFont(const uint8_t *progmemFont)
+{
+    (void)progmemFont;
+}
+
+void pcd8544_84x48_spi_init(int8_t rstPin, int8_t cesPin, int8_t dcPin)
+{
+    (void)rstPin;
+    (void)cesPin;
+    (void)dcPin;
+}
+
+void ssd1306_clearScreen(void)
+{
+    printed_len = 0;
+}
+
+uint8_t ssd1306_printFixed(uint8_t xpos, uint8_t y, const char *ch, EFontStyle style)
+{
+    (void)xpos;
+    (void)y;
+    (void)style;
+    size_t len = strlen(ch);
+    printed_len += len;
+    return len;
+}
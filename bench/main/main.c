@@ -0,0 +1,340 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "derived_metrics.h"
+#include "float_batch.h"
+#include "lcd.h"
+#include "sample_store.h"
+#include "sensor_channel.h"
+#include "stats.h"
+#include "store_float_into_uint8_arr.h"
+
+#include "soc/cpu.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define HISTORY_LEN CONFIG_HISTORY_MAX_LEN
+#define SAMPLES 1000         // readings appended, converted or reduced by each benchmark
+#define STATS_WINDOW_LEN 120 // one hour of readings taken every 30 seconds
+#define STATS_BINS_LEN 500
+#define RENDERS 40 // lcd views rendered, cycling through all of them
+#define ROUNDS 3   // each benchmark is run ROUNDS times, and the fastest round is reported
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+typedef struct
+{
+    const char *name;
+    const char *unit;      // what the cycles are counted per
+    uint32_t (*run)(void); // returns the CPU cycles taken per unit
+} benchmark_t;
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static uint32_t bench_sample_store_append(void);
+
+static uint32_t bench_sample_store_query(void);
+
+static uint32_t bench_sample_store_scan(void);
+
+static uint32_t bench_store_float_into_uint8_arr(void);
+
+static uint32_t bench_float_batch_quantize_i16(void);
+
+static uint32_t bench_float_batch_reduce(void);
+
+static uint32_t bench_float_batch_reduce_i16(void);
+
+static uint32_t bench_derived_metrics_compute(void);
+
+static uint32_t bench_stats_window_push(void);
+
+static uint32_t bench_stats_window_get(void);
+
+static uint32_t bench_lcd_render(void);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+static const benchmark_t benchmarks[] = {
+    {"sample_store_append", "record", bench_sample_store_append},
+    {"sample_store_query", "item", bench_sample_store_query},
+    {"sample_store_scan", "item", bench_sample_store_scan},
+    {"store_float_into_uint8_arr", "item", bench_store_float_into_uint8_arr},
+    {"float_batch_quantize_i16", "item", bench_float_batch_quantize_i16},
+    {"float_batch_reduce", "item", bench_float_batch_reduce},
+    {"float_batch_reduce_i16", "item", bench_float_batch_reduce_i16},
+    {"derived_metrics_compute", "reading", bench_derived_metrics_compute},
+    {"stats_window_push", "item", bench_stats_window_push},
+    {"stats_window_get", "call", bench_stats_window_get},
+    {"lcd_render", "view", bench_lcd_render},
+};
+
+// synthetic readings, the same on every target
+static float temperatures[SAMPLES];
+static float humidities[SAMPLES];
+
+static float bench_store_values_[HISTORY_LEN * SAMPLE_FIELD_COUNT];
+static uint32_t bench_store_timestamps_ms_[HISTORY_LEN];
+static sample_store_t bench_store;
+
+// history shown by the lcd, filled through the stubbed sensor channels
+static float lcd_store_values_[HISTORY_LEN * SAMPLE_FIELD_COUNT];
+static uint32_t lcd_store_timestamps_ms_[HISTORY_LEN];
+static sample_store_t lcd_store;
+
+static uint16_t stats_bins_[STATS_BINS_LEN];
+
+static float scratch[SAMPLES];
+static int16_t scratch_i16[SAMPLES];
+
+// results are written here, so that the compiler can't drop the work being measured
+static volatile float sink;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void app_main(void)
+{
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        temperatures[i] = 20 + (float)(i * 37 % 101) / 100;
+        humidities[i] = 40 + (float)(i * 53 % 211) / 10;
+    }
+    bench_store = sample_store_init(bench_store_values_, bench_store_timestamps_ms_, SAMPLE_FIELD_COUNT, HISTORY_LEN,
+                                    HISTORY_LEN);
+    lcd_store = sample_store_init(lcd_store_values_, lcd_store_timestamps_ms_, SAMPLE_FIELD_COUNT, HISTORY_LEN,
+                                  HISTORY_LEN);
+    sensor_channel_init(&lcd_store, CONFIG_READ_SENSOR_FREQUENCY_MS);
+    lcd_init(&lcd_store);
+
+#if CONFIG_STATS_FIXED_POINT
+    const char *arithmetic = "fixed point";
+#else
+    const char *arithmetic = "floating point";
+#endif
+    printf("bench: target %s, statistics in %s\n", CONFIG_IDF_TARGET, arithmetic);
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+    {
+        uint32_t fastest = UINT32_MAX;
+        for (size_t round = 0; round < ROUNDS; round++)
+        {
+            uint32_t cycles = benchmarks[i].run();
+            fastest = cycles < fastest ? cycles : fastest;
+        }
+        printf("bench: %s %u cycles/%s\n", benchmarks[i].name, (unsigned)fastest, benchmarks[i].unit);
+    }
+    printf("bench: done\n");
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static uint32_t bench_sample_store_append(void)
+{
+    float record[SAMPLE_FIELD_COUNT];
+    for (size_t field = 0; field < SAMPLE_FIELD_COUNT; field++)
+    {
+        record[field] = NAN;
+    }
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        record[SENSOR_CHANNEL_TEMPERATURE] = temperatures[i];
+        record[SENSOR_CHANNEL_HUMIDITY] = humidities[i];
+        sample_store_append(&bench_store, i * CONFIG_READ_SENSOR_FREQUENCY_MS, record);
+    }
+    return (esp_cpu_get_ccount() - start_cycles) / SAMPLES;
+}
+
+static uint32_t bench_sample_store_query(void)
+{
+    for (size_t i = 0; i < HISTORY_LEN; i++)
+    {
+        float record[SAMPLE_FIELD_COUNT];
+        for (size_t field = 0; field < SAMPLE_FIELD_COUNT; field++)
+        {
+            record[field] = temperatures[i];
+        }
+        sample_store_append(&bench_store, i * CONFIG_READ_SENSOR_FREQUENCY_MS, record);
+    }
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    size_t len = sample_store_query(&bench_store, SENSOR_CHANNEL_TEMPERATURE, HISTORY_LEN, scratch, NULL);
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = scratch[len - 1];
+    return cycles / len;
+}
+
+static uint32_t bench_sample_store_scan(void)
+{
+    for (size_t i = 0; i < HISTORY_LEN; i++)
+    {
+        float record[SAMPLE_FIELD_COUNT];
+        for (size_t field = 0; field < SAMPLE_FIELD_COUNT; field++)
+        {
+            record[field] = temperatures[i];
+        }
+        sample_store_append(&bench_store, i * CONFIG_READ_SENSOR_FREQUENCY_MS, record);
+    }
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    sample_store_span_t spans[2];
+    size_t len = sample_store_lock_spans(&bench_store, spans);
+    float sum = 0;
+    for (size_t s = 0; s < 2; s++)
+    {
+        const float *values = sample_store_span_values(&bench_store, &spans[s], SENSOR_CHANNEL_TEMPERATURE);
+        for (size_t i = 0; i < spans[s].len; i++)
+        {
+            if (!isnan(values[i]))
+            {
+                sum += values[i];
+            }
+        }
+    }
+    sample_store_unlock_spans(&bench_store);
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = sum;
+    return cycles / len;
+}
+
+static uint32_t bench_store_float_into_uint8_arr(void)
+{
+    uint8_t arr[2];
+    uint32_t checksum = 0;
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        store_float_into_uint8_arr(&temperatures[i], arr);
+        checksum += arr[0];
+    }
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = checksum;
+    return cycles / SAMPLES;
+}
+
+static uint32_t bench_float_batch_quantize_i16(void)
+{
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    float_batch_quantize_i16(temperatures, SAMPLES, 100, scratch_i16);
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = scratch_i16[SAMPLES - 1];
+    return cycles / SAMPLES;
+}
+
+static uint32_t bench_float_batch_reduce(void)
+{
+    float_batch_reduction_t reduction;
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    float_batch_reduce(temperatures, SAMPLES, &reduction);
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = reduction.sum;
+    return cycles / SAMPLES;
+}
+
+static uint32_t bench_float_batch_reduce_i16(void)
+{
+    float_batch_quantize_i16(temperatures, SAMPLES, 100, scratch_i16);
+    float_batch_reduction_i16_t reduction;
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    float_batch_reduce_i16(scratch_i16, SAMPLES, &reduction);
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = reduction.sum;
+    return cycles / SAMPLES;
+}
+
+static uint32_t bench_derived_metrics_compute(void)
+{
+    derived_metrics_t metrics;
+    float sum = 0;
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        derived_metrics_compute(temperatures[i], humidities[i], &metrics);
+        sum += metrics.dew_point;
+    }
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = sum;
+    return cycles / SAMPLES;
+}
+
+static uint32_t bench_stats_window_push(void)
+{
+    stats_window_t win = stats_window_init(stats_bins_, STATS_BINS_LEN, -40, 0.25, STATS_WINDOW_LEN, 30000);
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        stats_window_push(&win, temperatures[i], i >= STATS_WINDOW_LEN ? temperatures[i - STATS_WINDOW_LEN] : NAN);
+    }
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = win.count;
+    return cycles / SAMPLES;
+}
+
+static uint32_t bench_stats_window_get(void)
+{
+    stats_window_t win = stats_window_init(stats_bins_, STATS_BINS_LEN, -40, 0.25, STATS_WINDOW_LEN, 30000);
+    for (size_t i = 0; i < STATS_WINDOW_LEN; i++)
+    {
+        stats_window_push(&win, temperatures[i], NAN);
+    }
+    stats_t stats;
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    stats_window_get(&win, &stats);
+    uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+    sink = stats.p90;
+    return cycles;
+}
+
+/*
+ * bench_lcd_render fills the lcd's history with HISTORY_LEN readings, then renders every view in turn, on the
+ *   stubbed display.
+ */
+static uint32_t bench_lcd_render(void)
+{
+    for (size_t i = 0; i < HISTORY_LEN; i++)
+    {
+        float record[SAMPLE_FIELD_COUNT];
+        for (size_t field = 0; field < SAMPLE_FIELD_COUNT; field++)
+        {
+            record[field] = NAN;
+        }
+        derived_metrics_t metrics;
+        derived_metrics_compute(temperatures[i], humidities[i], &metrics);
+        record[SENSOR_CHANNEL_TEMPERATURE] = temperatures[i];
+        record[SENSOR_CHANNEL_HUMIDITY] = humidities[i];
+        record[SAMPLE_FIELD_DEW_POINT] = metrics.dew_point;
+        record[SAMPLE_FIELD_ABSOLUTE_HUMIDITY] = metrics.absolute_humidity;
+        record[SAMPLE_FIELD_HEAT_INDEX] = metrics.heat_index;
+        sensor_channel_store(i * CONFIG_READ_SENSOR_FREQUENCY_MS, record);
+    }
+
+    uint32_t start_cycles = esp_cpu_get_ccount();
+    for (size_t i = 0; i < RENDERS; i++)
+    {
+        lcd_render();
+        lcd_select_next_view();
+    }
+    return (esp_cpu_get_ccount() - start_cycles) / RENDERS;
+}
@@ -0,0 +1,118 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "sensor_channel.h"
+
+#include <assert.h>
+#include <math.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define STATS_BINS_LEN 500 // histogram bins per statistics window, as in sensor_channel.c
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+_Static_assert(SENSOR_CHANNEL_COUNT == 2, "the stubbed sensor channels are the temperature and humidity of one SHT21");
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static size_t window_len(uint32_t minutes);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+/*
+ * Only the statistics windows are kept, as the lcd reads them: the channels are never acquired, and the benchmarks
+ *   store synthetic readings instead, without any I2C transaction or lock.
+ */
+static sample_store_t *store = NULL;
+static uint32_t read_period_ms = 0;
+
+static stats_window_t channel_stats[SENSOR_CHANNEL_COUNT][SENSOR_CHANNEL_STATS_WINDOW_COUNT];
+static uint16_t channel_stats_bins_[SENSOR_CHANNEL_COUNT][SENSOR_CHANNEL_STATS_WINDOW_COUNT][STATS_BINS_LEN];
+
+static const float channel_bins_min[SENSOR_CHANNEL_COUNT] = {[SENSOR_CHANNEL_TEMPERATURE] = -40,
+                                                             [SENSOR_CHANNEL_HUMIDITY] = 0};
+
+static const uint32_t stats_window_configured_minutes[SENSOR_CHANNEL_STATS_WINDOW_COUNT] = {
+    [SENSOR_CHANNEL_STATS_WINDOW_SHORT] = CONFIG_STATS_WINDOW_SHORT_MINUTES,
+    [SENSOR_CHANNEL_STATS_WINDOW_MEDIUM] = CONFIG_STATS_WINDOW_MEDIUM_MINUTES,
+    [SENSOR_CHANNEL_STATS_WINDOW_LONG] = CONFIG_STATS_WINDOW_LONG_MINUTES,
+};
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+esp_err_t sensor_channel_init(sample_store_t *store_, uint32_t read_period_ms_)
+{
+    store = store_;
+    read_period_ms = read_period_ms_;
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        for (size_t i = 0; i < SENSOR_CHANNEL_STATS_WINDOW_COUNT; i++)
+        {
+            channel_stats[id][i] = stats_window_init(channel_stats_bins_[id][i], STATS_BINS_LEN, channel_bins_min[id],
+                                                     0.25, window_len(stats_window_configured_minutes[i]),
+                                                     read_period_ms);
+        }
+    }
+    return ESP_OK;
+}
+
+void sensor_channel_store(uint32_t timestamp_ms, const float record[])
+{
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        for (size_t i = 0; i < SENSOR_CHANNEL_STATS_WINDOW_COUNT; i++)
+        {
+            stats_window_t *win = &channel_stats[id][i];
+            float oldest = NAN;
+            // synthetic readings hold every field, so the item leaving the window is capacity - 1 appends ago
+            if (win->count == win->capacity)
+            {
+                sample_store_get_value(store, id, win->capacity - 1, &oldest);
+            }
+            stats_window_push(win, record[id], oldest);
+        }
+    }
+    sample_store_append(store, timestamp_ms, record);
+}
+
+uint32_t sensor_channel_get_stats_window_minutes(sensor_channel_id_t id, sensor_channel_stats_window_t window)
+{
+    assert(id < SENSOR_CHANNEL_COUNT && window < SENSOR_CHANNEL_STATS_WINDOW_COUNT);
+    return (uint64_t)channel_stats[id][window].capacity * read_period_ms / 60000;
+}
+
+size_t sensor_channel_get_stats(sensor_channel_id_t id, sensor_channel_stats_window_t window, stats_t *dst)
+{
+    assert(id < SENSOR_CHANNEL_COUNT && window < SENSOR_CHANNEL_STATS_WINDOW_COUNT);
+    return stats_window_get(&channel_stats[id][window], dst);
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * window_len converts the window length from minutes to number of readings, limited by the sample store's capacity.
+ */
+static size_t window_len(uint32_t minutes)
+{
+    size_t len = (uint64_t)minutes * 60000 / read_period_ms;
+    size_t max_len = sample_store_capacity(store);
+    if (len == 0)
+    {
+        return 1;
+    }
+    return len > max_len ? max_len : len;
+}
@@ -0,0 +1,25 @@
+/*
+ * Stand-in for the ssd1306 library, declaring only what the lcd module calls: the benchmarks measure how long the
+ *   views take to be rendered, not how long the SPI transfers to the display take.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum
+{
+    STYLE_NORMAL,
+    STYLE_BOLD,
+    STYLE_ITALIC
+} EFontStyle;
+
+extern const uint8_t ssd1306xled_font6x8[];
+
+void ssd1306_setFixedFont(const uint8_t *progmemFont);
+
+void pcd8544_84x48_spi_init(int8_t rstPin, int8_t cesPin, int8_t dcPin);
+
+void ssd1306_clearScreen(void);
+
+uint8_t ssd1306_printFixed(uint8_t xpos, uint8_t y, const char *ch, EFontStyle style);
@@ -4,7 +4,10 @@
 
 #include "ble.h"
 
-#include "store_float_into_uint8_arr.h"
+#include "ble_adv_payload.h"
+#include "ble_ext_adv.h"
+#include "ble_service.h"
+#include "boot_profile.h"
 
 #include "esp_bt.h"
 #include "esp_bt_defs.h"
@@ -12,11 +15,9 @@
 #include "esp_gap_ble_api.h"
 #include "esp_gatt_common_api.h"
 #include "esp_gatts_api.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "nvs_flash.h"
-#include <assert.h>
+#include "esp_timer.h"
 #include <stdbool.h>
 #include <string.h>
 
@@ -31,6 +32,20 @@
 #define PROFILE_APP_IDX 0
 #define SERVICE_INSTANCE_ID 0
 
+#define CCCD_NOTIFICATIONS_ENABLED 0x0001
+
+/* The Settings characteristic changes what is stored in NVS, so writes may require the client to pair first */
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+#define SETTINGS_PERM_WRITE ESP_GATT_PERM_WRITE_ENCRYPTED
+#else
+#define SETTINGS_PERM_WRITE ESP_GATT_PERM_WRITE
+#endif
+
+_Static_assert(CONFIG_BLE_MAX_CONNECTIONS <= CONFIG_BT_ACL_CONNECTIONS, "Bluedroid can't hold that many connections");
+#ifdef CONFIG_BTDM_CTRL_BLE_MAX_CONN
+_Static_assert(CONFIG_BLE_MAX_CONNECTIONS <= CONFIG_BTDM_CTRL_BLE_MAX_CONN, "controller can't hold that many connections");
+#endif
+
 //==================================================================================================
 // ENUMS - STRUCTS - TYPEDEFS
 //==================================================================================================
@@ -40,7 +55,6 @@ struct gatts_profile_inst
     esp_gatts_cb_t gatts_cb;
     uint16_t gatts_if;
     uint16_t app_id;
-    uint16_t conn_id;
     uint16_t service_handle;
     esp_gatt_srvc_id_t service_id;
     uint16_t char_handle;
@@ -51,6 +65,20 @@ struct gatts_profile_inst
     esp_bt_uuid_t descr_uuid;
 };
 
+/* Maps a value of ble_service, served on ESP_GATTS_READ_EVT, to its attribute index */
+typedef struct
+{
+    size_t attr_idx;
+    ble_service_value_t value;
+} attr_value_t;
+
+/* Maps a characteristic supporting notifications to the attribute indexes of its value and CCCD */
+typedef struct
+{
+    size_t value_attr_idx;
+    size_t cccd_attr_idx;
+} notify_attrs_t;
+
 /* Attributes Indexes */
 enum
 {
@@ -58,9 +86,40 @@ enum
 
     IDX_TEMPERATURE_CHARACT,
     IDX_TEMPERATURE_CHARACT_VALUE,
+    IDX_TEMPERATURE_CHARACT_CCCD,
+    IDX_TEMPERATURE_ES_MEASUREMENT,
+    IDX_TEMPERATURE_ES_TRIGGER_SETTING_1,
+    IDX_TEMPERATURE_ES_TRIGGER_SETTING_2,
+    IDX_TEMPERATURE_ES_TRIGGER_SETTING_3,
+    IDX_TEMPERATURE_ES_CONFIGURATION,
 
     IDX_HUMIDITY_CHARACT,
     IDX_HUMIDITY_CHARACT_VALUE,
+    IDX_HUMIDITY_CHARACT_CCCD,
+    IDX_HUMIDITY_ES_MEASUREMENT,
+    IDX_HUMIDITY_ES_TRIGGER_SETTING_1,
+    IDX_HUMIDITY_ES_TRIGGER_SETTING_2,
+    IDX_HUMIDITY_ES_TRIGGER_SETTING_3,
+    IDX_HUMIDITY_ES_CONFIGURATION,
+
+    IDX_STATS_CHARACT,
+    IDX_STATS_CHARACT_VALUE,
+
+    IDX_DEW_POINT_CHARACT,
+    IDX_DEW_POINT_CHARACT_VALUE,
+
+    IDX_HEAT_INDEX_CHARACT,
+    IDX_HEAT_INDEX_CHARACT_VALUE,
+
+    IDX_ABSOLUTE_HUMIDITY_CHARACT,
+    IDX_ABSOLUTE_HUMIDITY_CHARACT_VALUE,
+
+    IDX_READINGS_CHARACT,
+    IDX_READINGS_CHARACT_VALUE,
+    IDX_READINGS_CHARACT_CCCD,
+
+    IDX_SETTINGS_CHARACT,
+    IDX_SETTINGS_CHARACT_VALUE,
 
     IDX_COUNT,
 };
@@ -71,6 +130,18 @@ enum
 
 static esp_err_t gatts_read_event_handler(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
 
+static esp_err_t gatts_write_event_handler(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+
+static bool read_cccd(uint16_t conn_id, uint16_t handle, uint8_t value[2]);
+
+static bool write_cccd(const esp_ble_gatts_cb_param_t *param, esp_gatt_status_t *status);
+
+static bool find_ess_descriptor(uint16_t handle, ble_service_ess_t *charact, size_t *descriptor);
+
+static bool write_ess_descriptor(const esp_ble_gatts_cb_param_t *param, esp_gatt_status_t *status);
+
+static bool write_settings(const esp_ble_gatts_cb_param_t *param, esp_gatt_status_t *status);
+
 static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
 
 static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
@@ -78,6 +149,12 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
 
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
 
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+static esp_err_t set_security_params(void);
+#endif
+
+static void restart_advertising(void);
+
 //==================================================================================================
 // STATIC VARIABLES
 //==================================================================================================
@@ -86,6 +163,10 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
  * Advertising
  */
 
+// with CONFIG_BLE_PERIODIC_ADVERTISING, advertising is handled by ble_ext_adv instead
+#if !CONFIG_BLE_PERIODIC_ADVERTISING
+
+#if !CONFIG_BLE_BROADCAST_MODE
 // clang-format off
 static uint8_t adv_service_uuid[16] = {
     /* LSB <--------------------------------------------------------------------------------> MSB */
@@ -110,18 +191,42 @@ static esp_ble_adv_data_t adv_data = {
     .p_service_uuid = adv_service_uuid,
     .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
 };
+#endif
 
 /* For the iOS system, please refer to Apple official documents about the BLE advertising parameters
  * restrictions: https://developer.apple.com/library/archive/qa/qa1931/_index.html */
 static esp_ble_adv_params_t adv_params = {
     .adv_int_min = 0x0808, // advertising happens every 0x0808 * 0.625ms = 1285ms
     .adv_int_max = 0x0808, // advertising happens every 0x0808 * 0.625ms = 1285ms
+#if CONFIG_BLE_BROADCAST_MODE
+    .adv_type = ADV_TYPE_NONCONN_IND,
+#else
     .adv_type = ADV_TYPE_IND,
+#endif
     .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
     .channel_map = ADV_CHNL_ALL,
     .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
 };
 
+#endif // !CONFIG_BLE_PERIODIC_ADVERTISING
+
+#if CONFIG_BLE_PERIODIC_ADVERTISING
+// packet id of the history payload, incremented with every new reading
+static uint8_t history_packet_id = 0;
+#endif
+
+#if CONFIG_BLE_BROADCAST_MODE
+// packet id of the BTHome payload, incremented with every new reading
+static uint8_t broadcast_packet_id = 0;
+
+// advertising starts once the first payload is set, later payloads just replace the advertised data
+static bool broadcast_started = false;
+#endif
+
+/* Cost of bringing up the host, from ble_init to the start of the service, to compare with the NimBLE backend */
+static int64_t init_start_us = 0;
+static size_t init_start_free_heap = 0;
+
 /*
  * Profile
  */
@@ -141,20 +246,70 @@ static struct gatts_profile_inst environmental_sensing_profile_tab[PROFILE_NUM]
 static const uint16_t GATTS_ENVIRONMENTAL_SENSING_SERVICE_UUID = 0x181A;
 static const uint16_t GATTS_TEMPERATURE_CHARACT_UUID = 0x2A6E;
 static const uint16_t GATTS_HUMIDITY_CHARACT_UUID = 0x2A6F;
+static const uint16_t GATTS_HEAT_INDEX_CHARACT_UUID = 0x2A7A;
+static const uint16_t GATTS_DEW_POINT_CHARACT_UUID = 0x2A7B;
+// clang-format off
+static const uint8_t GATTS_STATS_CHARACT_UUID[16] = {
+    /* LSB <--------------------------------------------------------------------------------> MSB */
+    // vendor-specific uuid f71e0001-36a0-49d6-8d68-7ba76f904774
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x01, 0x00, 0x1e, 0xf7,
+};
+static const uint8_t GATTS_ABSOLUTE_HUMIDITY_CHARACT_UUID[16] = {
+    /* LSB <--------------------------------------------------------------------------------> MSB */
+    // vendor-specific uuid f71e0002-36a0-49d6-8d68-7ba76f904774
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x02, 0x00, 0x1e, 0xf7,
+};
+static const uint8_t GATTS_READINGS_CHARACT_UUID[16] = {
+    /* LSB <--------------------------------------------------------------------------------> MSB */
+    // vendor-specific uuid f71e0004-36a0-49d6-8d68-7ba76f904774
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x04, 0x00, 0x1e, 0xf7,
+};
+static const uint8_t GATTS_SETTINGS_CHARACT_UUID[16] = {
+    /* LSB <--------------------------------------------------------------------------------> MSB */
+    // vendor-specific uuid f71e0005-36a0-49d6-8d68-7ba76f904774
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x05, 0x00, 0x1e, 0xf7,
+};
+// clang-format on
 
 static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t charact_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
+static const uint16_t charact_client_config_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
+static const uint16_t es_configuration_uuid = ESP_GATT_UUID_ENV_SENSING_CONFIG_DESCR;
+static const uint16_t es_measurement_uuid = ESP_GATT_UUID_ENV_SENSING_MEASUREMENT_DESCR;
+static const uint16_t es_trigger_setting_uuid = ESP_GATT_UUID_ENV_SENSING_TRIGGER_DESCR;
 static const uint8_t charact_property_read = ESP_GATT_CHAR_PROP_BIT_READ;
+static const uint8_t charact_property_read_notify = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint8_t charact_property_read_write = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE;
+
+static const attr_value_t attr_values[] = {
+    {IDX_TEMPERATURE_CHARACT_VALUE, BLE_SERVICE_VALUE_TEMPERATURE},
+    {IDX_TEMPERATURE_ES_MEASUREMENT, BLE_SERVICE_VALUE_TEMPERATURE_ES_MEASUREMENT},
+    {IDX_HUMIDITY_CHARACT_VALUE, BLE_SERVICE_VALUE_HUMIDITY},
+    {IDX_HUMIDITY_ES_MEASUREMENT, BLE_SERVICE_VALUE_HUMIDITY_ES_MEASUREMENT},
+    {IDX_STATS_CHARACT_VALUE, BLE_SERVICE_VALUE_STATS},
+    {IDX_DEW_POINT_CHARACT_VALUE, BLE_SERVICE_VALUE_DEW_POINT},
+    {IDX_HEAT_INDEX_CHARACT_VALUE, BLE_SERVICE_VALUE_HEAT_INDEX},
+    {IDX_ABSOLUTE_HUMIDITY_CHARACT_VALUE, BLE_SERVICE_VALUE_ABSOLUTE_HUMIDITY},
+    {IDX_READINGS_CHARACT_VALUE, BLE_SERVICE_VALUE_READINGS},
+    {IDX_SETTINGS_CHARACT_VALUE, BLE_SERVICE_VALUE_SETTINGS},
+};
+
+static const notify_attrs_t notify_attrs[BLE_SERVICE_NOTIFY_COUNT] = {
+    [BLE_SERVICE_NOTIFY_TEMPERATURE] = {IDX_TEMPERATURE_CHARACT_VALUE, IDX_TEMPERATURE_CHARACT_CCCD},
+    [BLE_SERVICE_NOTIFY_HUMIDITY] = {IDX_HUMIDITY_CHARACT_VALUE, IDX_HUMIDITY_CHARACT_CCCD},
+    [BLE_SERVICE_NOTIFY_READINGS] = {IDX_READINGS_CHARACT_VALUE, IDX_READINGS_CHARACT_CCCD},
+};
 
-/* temperature_charact_value and humidity_charact_value hold the last temperature and
- *   humidity reading, respectively */
-static uint8_t temperature_charact_value[2];
-static uint8_t humidity_charact_value[2];
+/* Attribute indexes of the ES Trigger Setting and ES Configuration descriptors, see ble_service */
+static const size_t ess_descriptor_attr_idx[BLE_SERVICE_ESS_COUNT][BLE_SERVICE_ESS_DESCRIPTOR_COUNT] = {
+    [BLE_SERVICE_ESS_TEMPERATURE] = {IDX_TEMPERATURE_ES_TRIGGER_SETTING_1, IDX_TEMPERATURE_ES_TRIGGER_SETTING_2,
+                                     IDX_TEMPERATURE_ES_TRIGGER_SETTING_3, IDX_TEMPERATURE_ES_CONFIGURATION},
+    [BLE_SERVICE_ESS_HUMIDITY] = {IDX_HUMIDITY_ES_TRIGGER_SETTING_1, IDX_HUMIDITY_ES_TRIGGER_SETTING_2,
+                                  IDX_HUMIDITY_ES_TRIGGER_SETTING_3, IDX_HUMIDITY_ES_CONFIGURATION},
+};
 
-/* temperature_charact_sentinel_value and humidity_charact_sentinel_value are used to detect
- *   if the ESP_GATTS_READ_EVT has been triggered by a temperature or a humidity reading */
-static const uint8_t temperature_charact_sentinel_value[2] = {0x80, 0x00};
-static const uint8_t humidity_charact_sentinel_value[2] = {0xFF, 0xFF};
+/* Handles assigned to the attributes, used to detect which characteristic the ESP_GATTS_READ_EVT refers to */
+static uint16_t environmental_sensing_handle_table[IDX_COUNT];
 
 /* Full Database Description - Used to add attributes into the database */
 // clang-format off
@@ -168,22 +323,143 @@ static const esp_gatts_attr_db_t gatt_db[IDX_COUNT] =
     /* Characteristic Declaration */
     [IDX_TEMPERATURE_CHARACT] =
     {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_declaration_uuid, ESP_GATT_PERM_READ,
-      sizeof(charact_property_read), sizeof(charact_property_read), (uint8_t*)&charact_property_read}},
+      sizeof(charact_property_read_notify), sizeof(charact_property_read_notify), (uint8_t*)&charact_property_read_notify}},
 
     /* Characteristic Value */
     [IDX_TEMPERATURE_CHARACT_VALUE] =
     {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&GATTS_TEMPERATURE_CHARACT_UUID, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-      sizeof(temperature_charact_sentinel_value), sizeof(temperature_charact_sentinel_value), (uint8_t*)temperature_charact_sentinel_value}},
+      sizeof(uint16_t), 0, NULL}},
+
+    /* Client Characteristic Configuration Descriptor, one value per connection */
+    [IDX_TEMPERATURE_CHARACT_CCCD] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      sizeof(uint16_t), 0, NULL}},
+
+    /* ES Measurement Descriptor */
+    [IDX_TEMPERATURE_ES_MEASUREMENT] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_measurement_uuid, ESP_GATT_PERM_READ,
+      BLE_SERVICE_ES_MEASUREMENT_LEN, 0, NULL}},
+
+    /* ES Trigger Setting Descriptors, shared by all the connections */
+    [IDX_TEMPERATURE_ES_TRIGGER_SETTING_1] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_trigger_setting_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      ESS_TRIGGER_MAX_LEN, 0, NULL}},
+
+    [IDX_TEMPERATURE_ES_TRIGGER_SETTING_2] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_trigger_setting_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      ESS_TRIGGER_MAX_LEN, 0, NULL}},
+
+    [IDX_TEMPERATURE_ES_TRIGGER_SETTING_3] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_trigger_setting_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      ESS_TRIGGER_MAX_LEN, 0, NULL}},
+
+    /* ES Configuration Descriptor, combining the trigger settings */
+    [IDX_TEMPERATURE_ES_CONFIGURATION] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_configuration_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      sizeof(uint8_t), 0, NULL}},
 
     /* Characteristic Declaration */
     [IDX_HUMIDITY_CHARACT] =
     {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_declaration_uuid, ESP_GATT_PERM_READ,
-      sizeof(charact_property_read), sizeof(charact_property_read), (uint8_t*)&charact_property_read}},
+      sizeof(charact_property_read_notify), sizeof(charact_property_read_notify), (uint8_t*)&charact_property_read_notify}},
 
     /* Characteristic Value */
     [IDX_HUMIDITY_CHARACT_VALUE] =
     {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&GATTS_HUMIDITY_CHARACT_UUID, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-      sizeof(humidity_charact_sentinel_value), sizeof(humidity_charact_sentinel_value), (uint8_t*)humidity_charact_sentinel_value}},
+      sizeof(uint16_t), 0, NULL}},
+
+    /* Client Characteristic Configuration Descriptor, one value per connection */
+    [IDX_HUMIDITY_CHARACT_CCCD] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      sizeof(uint16_t), 0, NULL}},
+
+    /* ES Measurement Descriptor */
+    [IDX_HUMIDITY_ES_MEASUREMENT] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_measurement_uuid, ESP_GATT_PERM_READ,
+      BLE_SERVICE_ES_MEASUREMENT_LEN, 0, NULL}},
+
+    /* ES Trigger Setting Descriptors, shared by all the connections */
+    [IDX_HUMIDITY_ES_TRIGGER_SETTING_1] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_trigger_setting_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      ESS_TRIGGER_MAX_LEN, 0, NULL}},
+
+    [IDX_HUMIDITY_ES_TRIGGER_SETTING_2] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_trigger_setting_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      ESS_TRIGGER_MAX_LEN, 0, NULL}},
+
+    [IDX_HUMIDITY_ES_TRIGGER_SETTING_3] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_trigger_setting_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      ESS_TRIGGER_MAX_LEN, 0, NULL}},
+
+    /* ES Configuration Descriptor, combining the trigger settings */
+    [IDX_HUMIDITY_ES_CONFIGURATION] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&es_configuration_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      sizeof(uint8_t), 0, NULL}},
+
+    /* Characteristic Declaration */
+    [IDX_STATS_CHARACT] =
+    {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_declaration_uuid, ESP_GATT_PERM_READ,
+      sizeof(charact_property_read), sizeof(charact_property_read), (uint8_t*)&charact_property_read}},
+
+    /* Characteristic Value */
+    [IDX_STATS_CHARACT_VALUE] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_128, (uint8_t *)GATTS_STATS_CHARACT_UUID, ESP_GATT_PERM_READ,
+      BLE_SERVICE_STATS_LEN, 0, NULL}},
+
+    /* Characteristic Declaration */
+    [IDX_DEW_POINT_CHARACT] =
+    {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_declaration_uuid, ESP_GATT_PERM_READ,
+      sizeof(charact_property_read), sizeof(charact_property_read), (uint8_t*)&charact_property_read}},
+
+    /* Characteristic Value */
+    [IDX_DEW_POINT_CHARACT_VALUE] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&GATTS_DEW_POINT_CHARACT_UUID, ESP_GATT_PERM_READ,
+      sizeof(uint8_t), 0, NULL}},
+
+    /* Characteristic Declaration */
+    [IDX_HEAT_INDEX_CHARACT] =
+    {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_declaration_uuid, ESP_GATT_PERM_READ,
+      sizeof(charact_property_read), sizeof(charact_property_read), (uint8_t*)&charact_property_read}},
+
+    /* Characteristic Value */
+    [IDX_HEAT_INDEX_CHARACT_VALUE] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&GATTS_HEAT_INDEX_CHARACT_UUID, ESP_GATT_PERM_READ,
+      sizeof(uint8_t), 0, NULL}},
+
+    /* Characteristic Declaration */
+    [IDX_ABSOLUTE_HUMIDITY_CHARACT] =
+    {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_declaration_uuid, ESP_GATT_PERM_READ,
+      sizeof(charact_property_read), sizeof(charact_property_read), (uint8_t*)&charact_property_read}},
+
+    /* Characteristic Value */
+    [IDX_ABSOLUTE_HUMIDITY_CHARACT_VALUE] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_128, (uint8_t *)GATTS_ABSOLUTE_HUMIDITY_CHARACT_UUID, ESP_GATT_PERM_READ,
+      sizeof(uint16_t), 0, NULL}},
+
+    /* Characteristic Declaration */
+    [IDX_READINGS_CHARACT] =
+    {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_declaration_uuid, ESP_GATT_PERM_READ,
+      sizeof(charact_property_read_notify), sizeof(charact_property_read_notify), (uint8_t*)&charact_property_read_notify}},
+
+    /* Characteristic Value */
+    [IDX_READINGS_CHARACT_VALUE] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_128, (uint8_t *)GATTS_READINGS_CHARACT_UUID, ESP_GATT_PERM_READ,
+      STORE_READINGS_LEN, 0, NULL}},
+
+    /* Client Characteristic Configuration Descriptor, one value per connection */
+    [IDX_READINGS_CHARACT_CCCD] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_client_config_uuid, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+      sizeof(uint16_t), 0, NULL}},
+
+    /* Characteristic Declaration */
+    [IDX_SETTINGS_CHARACT] =
+    {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&charact_declaration_uuid, ESP_GATT_PERM_READ,
+      sizeof(charact_property_read_write), sizeof(charact_property_read_write), (uint8_t*)&charact_property_read_write}},
+
+    /* Characteristic Value */
+    [IDX_SETTINGS_CHARACT_VALUE] =
+    {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_128, (uint8_t *)GATTS_SETTINGS_CHARACT_UUID, ESP_GATT_PERM_READ | SETTINGS_PERM_WRITE,
+      BLE_SERVICE_SETTINGS_LEN, 0, NULL}},
 };
 // clang-format on
 
@@ -191,15 +467,11 @@ static const esp_gatts_attr_db_t gatt_db[IDX_COUNT] =
 // GLOBAL FUNCTIONS
 //==================================================================================================
 
-esp_err_t ble_init(void)
+esp_err_t ble_init(ble_settings_handler_t settings_handler)
 {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
-    {
-        IFERR_RETE(nvs_flash_erase(), "erase flash failed");
-        ret = nvs_flash_init();
-    }
-    IFERR_RETE(ret, "init flash failed");
+    init_start_us = esp_timer_get_time();
+    init_start_free_heap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    ble_service_init(settings_handler);
 
     IFERR_RETE(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT), "release controller memory failed");
     esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
@@ -211,33 +483,80 @@ esp_err_t ble_init(void)
 
     IFERR_RETE(esp_ble_gatts_register_callback(gatts_event_handler), "gatts register error");
     IFERR_RETE(esp_ble_gap_register_callback(gap_event_handler), "gap register error");
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+    IFERR_RETE(set_security_params(), "set security params failed");
+#endif
     IFERR_RETE(esp_ble_gatts_app_register(PROFILE_APP_IDX), "gatts app register error");
     IFERR_RETE(esp_ble_gatt_set_local_mtu(500), "set local MTU failed");
+#if CONFIG_BLE_PERIODIC_ADVERTISING
+    IFERR_RETE(ble_ext_adv_start(), "start extended advertising failed");
+#endif
     return ESP_OK;
 }
 
-esp_err_t ble_write_temperature(float temperature)
+esp_err_t ble_stop(void)
 {
-    ESP_LOGD(ESP_LOG_TAG, "%s - write %f", __func__, temperature);
-    // See: GATT Specification Supplement Datasheet Page 223 Section 3.204
-    if (temperature < -273.15 || temperature > 327.67)
+    ble_service_stop();
+    IFERR_RETE(esp_bluedroid_disable(), "disable bluetooth failed");
+    IFERR_RETE(esp_bluedroid_deinit(), "deinit bluetooth failed");
+    IFERR_RETE(esp_bt_controller_disable(), "disable controller failed");
+    return ESP_OK;
+}
+
+esp_err_t ble_broadcast_readings(float temperature, float humidity)
+{
+#if CONFIG_BLE_BROADCAST_MODE
+    ESP_LOGD(ESP_LOG_TAG, "%s - broadcast temperature %f, humidity %f", __func__, temperature, humidity);
+    static uint8_t payload[BLE_ADV_PAYLOAD_MAX_LEN];
+    size_t len = ble_adv_payload_bthome(temperature, humidity, broadcast_packet_id, BLE_DEVICE_NAME, payload);
+    if (len == 0)
     {
         return ESP_ERR_INVALID_ARG;
     }
-    store_float_into_uint8_arr(&temperature, temperature_charact_value);
+    broadcast_packet_id++;
+    IFERR_RETE(esp_ble_gap_config_adv_data_raw(payload, len), "config raw adv data failed");
     return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-esp_err_t ble_write_humidity(float humidity)
+esp_err_t ble_broadcast_history(ble_adv_payload_history_t *history)
 {
-    ESP_LOGD(ESP_LOG_TAG, "%s - write %f", __func__, humidity);
-    // See: GATT Specification Supplement Datasheet Page 146 Section 3.114
-    if (humidity < 0.00 || humidity > 100.00)
+#if CONFIG_BLE_PERIODIC_ADVERTISING
+    ESP_LOGD(ESP_LOG_TAG, "%s - broadcast %u readings", __func__, (unsigned)history->count);
+    static uint8_t payload[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN];
+    history->packet_id = history_packet_id;
+    size_t len = ble_adv_payload_history(history, payload);
+    if (len == 0)
     {
         return ESP_ERR_INVALID_ARG;
     }
-    store_float_into_uint8_arr(&humidity, humidity_charact_value);
+    history_packet_id++;
+    IFERR_RETE(ble_ext_adv_set_periodic_data(payload, len), "config periodic adv data failed");
     return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t ble_service_backend_notify(uint16_t conn_id, ble_service_notify_t charact, const uint8_t *value,
+                                     size_t len)
+{
+    esp_gatt_if_t gatts_if = environmental_sensing_profile_tab[PROFILE_APP_IDX].gatts_if;
+    uint16_t handle = environmental_sensing_handle_table[notify_attrs[charact].value_attr_idx];
+    return esp_ble_gatts_send_indicate(gatts_if, conn_id, handle, len, (uint8_t *)value, false);
+}
+
+esp_err_t ble_service_backend_update_conn_params(const ble_conn_t *conn, const ble_conn_params_t *params)
+{
+    esp_ble_conn_update_params_t conn_params = {0};
+    memcpy(conn_params.bda, conn->remote_bda, sizeof(esp_bd_addr_t));
+    conn_params.min_int = params->min_int;
+    conn_params.max_int = params->max_int;
+    conn_params.latency = params->latency;
+    conn_params.timeout = params->timeout;
+    return esp_ble_gap_update_conn_params(&conn_params);
 }
 
 //==================================================================================================
@@ -246,34 +565,188 @@ esp_err_t ble_write_humidity(float humidity)
 
 static esp_err_t gatts_read_event_handler(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
 {
-    uint16_t sentinel_value_length;
-    const uint8_t *sentinel_value;
-    IFERR_RETE(esp_ble_gatts_get_attr_value(param->read.handle, &sentinel_value_length, &sentinel_value),
-               "illegal handle %d", param->read.handle);
-    assert(sentinel_value_length == 2);
+    uint8_t value[BLE_SERVICE_VALUE_MAX_LEN];
+    uint16_t value_len = 0;
+    bool found = false;
+    ble_service_ess_t charact;
+    size_t descriptor;
+    if (read_cccd(param->read.conn_id, param->read.handle, value))
+    {
+        value_len = 2;
+        found = true;
+    }
+    else if (find_ess_descriptor(param->read.handle, &charact, &descriptor))
+    {
+        value_len = ble_service_read_ess_descriptor(charact, descriptor, value);
+        found = true;
+    }
+    for (size_t i = 0; !found && i < sizeof(attr_values) / sizeof(attr_values[0]); i++)
+    {
+        if (param->read.handle == environmental_sensing_handle_table[attr_values[i].attr_idx])
+        {
+            value_len = ble_service_read_value(attr_values[i].value, value);
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        ESP_LOGE(ESP_LOG_TAG, "illegal handle %d", param->read.handle);
+        return ESP_ERR_INVALID_ARG;
+    }
 
+    /* Values longer than MTU - 1 bytes are read by the client in multiple requests, starting at different offsets */
     esp_gatt_rsp_t rsp = {0};
     rsp.attr_value.handle = param->read.handle;
-    if (memcmp(temperature_charact_sentinel_value, sentinel_value, sizeof(temperature_charact_sentinel_value)) == 0)
-    {
-        rsp.attr_value.len = sizeof(temperature_charact_value);
-        memcpy(rsp.attr_value.value, temperature_charact_value, sizeof(temperature_charact_value));
-    }
-    else if (memcmp(humidity_charact_sentinel_value, sentinel_value, sizeof(humidity_charact_sentinel_value)) == 0)
+    rsp.attr_value.offset = param->read.offset;
+    esp_gatt_status_t status = ESP_GATT_OK;
+    if (param->read.offset > value_len)
     {
-        rsp.attr_value.len = sizeof(humidity_charact_value);
-        memcpy(rsp.attr_value.value, humidity_charact_value, sizeof(humidity_charact_value));
+        status = ESP_GATT_INVALID_OFFSET;
     }
     else
     {
-        assert(0);
+        uint16_t mtu = ble_service_get_mtu(param->read.conn_id);
+        rsp.attr_value.len = value_len - param->read.offset;
+        if (rsp.attr_value.len > mtu - 1)
+        {
+            rsp.attr_value.len = mtu - 1;
+        }
+        memcpy(rsp.attr_value.value, &value[param->read.offset], rsp.attr_value.len);
+        ble_service_on_traffic(param->read.conn_id, rsp.attr_value.len);
     }
 
-    IFERR_RETE(esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, ESP_GATT_OK, &rsp),
+    IFERR_RETE(esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, status, &rsp),
                "failed to send response");
     return ESP_OK;
 }
 
+/*
+ * gatts_write_event_handler only accepts writes to the CCCDs, to the ES Trigger Setting and ES Configuration
+ *   descriptors, and to the Settings characteristic.
+ */
+static esp_err_t gatts_write_event_handler(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    esp_gatt_status_t status = ESP_GATT_WRITE_NOT_PERMIT;
+    if (write_cccd(param, &status) || write_ess_descriptor(param, &status) || write_settings(param, &status))
+    {
+        ble_service_on_traffic(param->write.conn_id, param->write.len);
+    }
+
+    if (param->write.need_rsp)
+    {
+        IFERR_RETE(esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, NULL),
+                   "failed to send response");
+    }
+    return status == ESP_GATT_OK ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+/*
+ * read_cccd writes into value the CCCD of the connection, if handle refers to one.
+ * It returns false otherwise.
+ */
+static bool read_cccd(uint16_t conn_id, uint16_t handle, uint8_t value[2])
+{
+    for (ble_service_notify_t charact = 0; charact < BLE_SERVICE_NOTIFY_COUNT; charact++)
+    {
+        if (handle == environmental_sensing_handle_table[notify_attrs[charact].cccd_attr_idx])
+        {
+            value[0] = ble_service_is_subscribed(conn_id, charact) ? CCCD_NOTIFICATIONS_ENABLED : 0;
+            value[1] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * write_cccd stores the subscription of the connection, if the write refers to a CCCD.
+ * It returns false otherwise, leaving status untouched.
+ */
+static bool write_cccd(const esp_ble_gatts_cb_param_t *param, esp_gatt_status_t *status)
+{
+    for (ble_service_notify_t charact = 0; charact < BLE_SERVICE_NOTIFY_COUNT; charact++)
+    {
+        if (param->write.handle != environmental_sensing_handle_table[notify_attrs[charact].cccd_attr_idx])
+        {
+            continue;
+        }
+        if (param->write.is_prep || param->write.offset != 0 || param->write.len != 2)
+        {
+            *status = ESP_GATT_INVALID_ATTR_LEN;
+            return true;
+        }
+        bool enabled = (param->write.value[0] | param->write.value[1] << 8) & CCCD_NOTIFICATIONS_ENABLED;
+        esp_err_t err = ble_service_set_subscription(param->write.conn_id, charact, enabled);
+        *status = err == ESP_OK ? ESP_GATT_OK : ESP_GATT_INVALID_HANDLE;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * find_ess_descriptor looks up the characteristic and the index of the ES Trigger Setting or ES Configuration
+ *   descriptor handle refers to, if any.
+ * It returns false otherwise.
+ */
+static bool find_ess_descriptor(uint16_t handle, ble_service_ess_t *charact, size_t *descriptor)
+{
+    for (ble_service_ess_t c = 0; c < BLE_SERVICE_ESS_COUNT; c++)
+    {
+        for (size_t d = 0; d < BLE_SERVICE_ESS_DESCRIPTOR_COUNT; d++)
+        {
+            if (handle == environmental_sensing_handle_table[ess_descriptor_attr_idx[c][d]])
+            {
+                *charact = c;
+                *descriptor = d;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+ * write_ess_descriptor passes the write to ble_service, if it refers to an ES Trigger Setting or ES Configuration
+ *   descriptor; prepared writes are rejected, as the values fit into any MTU.
+ * It returns false otherwise, leaving status untouched.
+ */
+static bool write_ess_descriptor(const esp_ble_gatts_cb_param_t *param, esp_gatt_status_t *status)
+{
+    ble_service_ess_t charact;
+    size_t descriptor;
+    if (!find_ess_descriptor(param->write.handle, &charact, &descriptor))
+    {
+        return false;
+    }
+    if (param->write.is_prep || param->write.offset != 0)
+    {
+        *status = BLE_SERVICE_ATT_ERR_ESS_WRITE_REQUEST_REJECTED;
+        return true;
+    }
+    *status = ble_service_write_ess_descriptor(param->write.conn_id, charact, descriptor, param->write.value,
+                                               param->write.len);
+    return true;
+}
+
+/*
+ * write_settings passes the write to ble_service, if it refers to the Settings characteristic.
+ * It returns false otherwise, leaving status untouched.
+ */
+static bool write_settings(const esp_ble_gatts_cb_param_t *param, esp_gatt_status_t *status)
+{
+    if (param->write.handle != environmental_sensing_handle_table[IDX_SETTINGS_CHARACT_VALUE])
+    {
+        return false;
+    }
+    if (param->write.is_prep || param->write.offset != 0)
+    {
+        *status = ESP_GATT_INVALID_ATTR_LEN;
+        return true;
+    }
+    *status = ble_service_write_settings(param->write.conn_id, param->write.value, param->write.len);
+    return true;
+}
+
 static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
 {
     /* If event is register event, store the gatts_if for each profile */
@@ -308,7 +781,10 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
     case ESP_GATTS_REG_EVT: {
         ESP_LOGD(ESP_LOG_TAG, "ESP_GATTS_REG_EVT");
         IFERR_LOG(esp_ble_gap_set_device_name(BLE_DEVICE_NAME), "set device name failed");
+#if !CONFIG_BLE_BROADCAST_MODE && !CONFIG_BLE_PERIODIC_ADVERTISING
+        // in broadcast mode, advertising starts with the first reading, see ble_broadcast_readings
         IFERR_LOG(esp_ble_gap_config_adv_data(&adv_data), "config adv data failed");
+#endif
         IFERR_LOG(esp_ble_gatts_create_attr_tab(gatt_db, gatts_if, IDX_COUNT, SERVICE_INSTANCE_ID),
                   "create attr table failed");
     }
@@ -318,27 +794,54 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
                  param->read.trans_id, param->read.handle);
         IFERR_RETV(gatts_read_event_handler(gatts_if, param), "failed to handle ESP_GATTS_READ_EVT");
         break;
+    case ESP_GATTS_WRITE_EVT:
+        ESP_LOGI(ESP_LOG_TAG, "ESP_GATTS_WRITE_EVT, conn_id %d, trans_id %d, handle %d", param->write.conn_id,
+                 param->write.trans_id, param->write.handle);
+        IFERR_RETV(gatts_write_event_handler(gatts_if, param), "failed to handle ESP_GATTS_WRITE_EVT");
+        break;
     case ESP_GATTS_MTU_EVT:
-        ESP_LOGD(ESP_LOG_TAG, "ESP_GATTS_MTU_EVT, MTU %d", param->mtu.mtu);
+        ESP_LOGD(ESP_LOG_TAG, "ESP_GATTS_MTU_EVT, conn_id %d, MTU %d", param->mtu.conn_id, param->mtu.mtu);
+        ble_service_on_mtu(param->mtu.conn_id, param->mtu.mtu);
+        break;
+    case ESP_GATTS_CONGEST_EVT:
+        ESP_LOGD(ESP_LOG_TAG, "ESP_GATTS_CONGEST_EVT, conn_id %d, congested %d", param->congest.conn_id,
+                 param->congest.congested);
+        ble_service_on_congestion(param->congest.conn_id, param->congest.congested);
         break;
     case ESP_GATTS_START_EVT:
         ESP_LOGD(ESP_LOG_TAG, "SERVICE_START_EVT, status %d, service_handle %d", param->start.status,
                  param->start.service_handle);
+        ESP_LOGI(ESP_LOG_TAG, "Bluedroid host ready in %u ms, using %u bytes of heap",
+                 (unsigned)((esp_timer_get_time() - init_start_us) / 1000),
+                 (unsigned)(init_start_free_heap - heap_caps_get_free_size(MALLOC_CAP_DEFAULT)));
         break;
-    case ESP_GATTS_CONNECT_EVT:
+    case ESP_GATTS_CONNECT_EVT: {
         ESP_LOGI(ESP_LOG_TAG, "ESP_GATTS_CONNECT_EVT, conn_id = %d", param->connect.conn_id);
-        esp_ble_conn_update_params_t conn_params = {0};
-        memcpy(conn_params.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
-        conn_params.latency = 0;
-        conn_params.max_int = ESP_BLE_CONN_INT_MAX;
-        conn_params.min_int = ESP_BLE_CONN_INT_MAX;
-        conn_params.timeout = ESP_BLE_CONN_SUP_TOUT_MAX;
-        esp_ble_gap_update_conn_params(&conn_params);
+        size_t conns_count;
+        if (ble_service_on_connect(param->connect.conn_id, param->connect.remote_bda, &conns_count) != ESP_OK)
+        {
+            ESP_LOGW(ESP_LOG_TAG, "no room for conn_id %d, disconnecting", param->connect.conn_id);
+            IFERR_LOG(esp_ble_gatts_close(gatts_if, param->connect.conn_id), "close connection failed");
+            break;
+        }
+        // the controller stops advertising as soon as a client connects
+        if (conns_count < CONFIG_BLE_MAX_CONNECTIONS)
+        {
+            restart_advertising();
+        }
         break;
-    case ESP_GATTS_DISCONNECT_EVT:
-        ESP_LOGI(ESP_LOG_TAG, "ESP_GATTS_DISCONNECT_EVT, reason = 0x%x", param->disconnect.reason);
-        esp_ble_gap_start_advertising(&adv_params);
+    }
+    case ESP_GATTS_DISCONNECT_EVT: {
+        ESP_LOGI(ESP_LOG_TAG, "ESP_GATTS_DISCONNECT_EVT, conn_id = %d, reason = 0x%x", param->disconnect.conn_id,
+                 param->disconnect.reason);
+        bool was_full;
+        // a refused client isn't among the connections; otherwise, advertising is still running unless it was full
+        if (ble_service_on_disconnect(param->disconnect.conn_id, &was_full) == ESP_OK && was_full)
+        {
+            restart_advertising();
+        }
         break;
+    }
     case ESP_GATTS_CREAT_ATTR_TAB_EVT: {
         ESP_LOGD(ESP_LOG_TAG, "ESP_GATTS_CREAT_ATTR_TAB_EVT");
         if (param->add_attr_tab.status != ESP_GATT_OK)
@@ -355,7 +858,6 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
         }
         ESP_LOGD(ESP_LOG_TAG, "create attribute table successfully, the number handle = %d\n",
                  param->add_attr_tab.num_handle);
-        uint16_t environmental_sensing_handle_table[IDX_COUNT];
         memcpy(environmental_sensing_handle_table, param->add_attr_tab.handles,
                sizeof(environmental_sensing_handle_table));
         esp_ble_gatts_start_service(environmental_sensing_handle_table[IDX_SERVICE]);
@@ -368,28 +870,102 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
 
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
 {
+#if CONFIG_BLE_PERIODIC_ADVERTISING
+    ble_ext_adv_gap_event_handler(event, param);
+#endif
     switch (event)
     {
+#if !CONFIG_BLE_PERIODIC_ADVERTISING
     case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
         ESP_LOGD(ESP_LOG_TAG, "ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT");
         esp_ble_gap_start_advertising(&adv_params);
         break;
+#if CONFIG_BLE_BROADCAST_MODE
+    case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
+        ESP_LOGD(ESP_LOG_TAG, "ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT");
+        if (!broadcast_started)
+        {
+            broadcast_started = true;
+            esp_ble_gap_start_advertising(&adv_params);
+        }
+        break;
+#endif
     case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
         ESP_LOGD(ESP_LOG_TAG, "ESP_GAP_BLE_ADV_START_COMPLETE_EVT");
         if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS)
         {
             ESP_LOGE(ESP_LOG_TAG, "advertising start failed");
+            break;
         }
+        boot_profile_mark(BOOT_PHASE_ADVERTISING);
         break;
-    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+#endif
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT: {
         ESP_LOGD(ESP_LOG_TAG,
                  "ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT, status = %d, min_int = %d, max_int = %d,conn_int = %d,latency = "
                  "%d, timeout = %d",
                  param->update_conn_params.status, param->update_conn_params.min_int, param->update_conn_params.max_int,
                  param->update_conn_params.conn_int, param->update_conn_params.latency,
                  param->update_conn_params.timeout);
+        uint16_t conn_id;
+        if (param->update_conn_params.status == ESP_BT_STATUS_SUCCESS &&
+            ble_service_find_conn_id(param->update_conn_params.bda, &conn_id) == ESP_OK)
+        {
+            ble_service_on_params_updated(conn_id, param->update_conn_params.conn_int,
+                                          param->update_conn_params.latency);
+        }
+        break;
+    }
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+    case ESP_GAP_BLE_SEC_REQ_EVT:
+        // the client asks to pair, e.g. after its write to the Settings characteristic was rejected
+        esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+        break;
+    case ESP_GAP_BLE_AUTH_CMPL_EVT:
+        if (param->ble_security.auth_cmpl.success)
+        {
+            ESP_LOGI(ESP_LOG_TAG, "ESP_GAP_BLE_AUTH_CMPL_EVT, link encrypted");
+        }
+        else
+        {
+            ESP_LOGW(ESP_LOG_TAG, "ESP_GAP_BLE_AUTH_CMPL_EVT, pairing failed, reason 0x%x",
+                     param->ble_security.auth_cmpl.fail_reason);
+        }
         break;
+#endif
     default:
         break;
     }
 }
+
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+/*
+ * set_security_params lets clients pair without a passkey (Just Works), as the Envi Sensor has no keypad, and bond,
+ *   so that later connections are encrypted right away.
+ */
+static esp_err_t set_security_params(void)
+{
+    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_BOND;
+    esp_ble_io_cap_t io_cap = ESP_IO_CAP_NONE;
+    uint8_t max_key_size = 16;
+    uint8_t keys = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+    IFERR_RETE(esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(auth_req)),
+               "set auth_req failed");
+    IFERR_RETE(esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &io_cap, sizeof(io_cap)), "set io_cap failed");
+    IFERR_RETE(esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &max_key_size, sizeof(max_key_size)),
+               "set max_key_size failed");
+    IFERR_RETE(esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &keys, sizeof(keys)), "set init_key failed");
+    IFERR_RETE(esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &keys, sizeof(keys)), "set rsp_key failed");
+    return ESP_OK;
+}
+#endif
+
+static void restart_advertising(void)
+{
+#if CONFIG_BLE_PERIODIC_ADVERTISING
+    IFERR_LOG(ble_ext_adv_restart_connectable(), "restart advertising failed");
+#else
+    IFERR_LOG(esp_ble_gap_start_advertising(&adv_params), "restart advertising failed");
+#endif
+}
+
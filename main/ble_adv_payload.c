@@ -0,0 +1,202 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "ble_adv_payload.h"
+
+#include "float_batch.h"
+#include "store_float_into_uint8_arr.h"
+#include "store_stats_into_uint8_arr.h"
+
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+/* AD types, see: Bluetooth Assigned Numbers Section 2.3 */
+#define AD_TYPE_FLAGS 0x01
+#define AD_TYPE_SHORTENED_LOCAL_NAME 0x08
+#define AD_TYPE_COMPLETE_LOCAL_NAME 0x09
+#define AD_TYPE_SERVICE_DATA_16BIT_UUID 0x16
+#define AD_TYPE_SERVICE_DATA_128BIT_UUID 0x21
+
+#define AD_FLAGS_GEN_DISC_BREDR_NOT_SPT 0x06
+
+/* BTHome v2 */
+#define BTHOME_SERVICE_UUID 0xFCD2
+#define BTHOME_DEVICE_INFO 0x40 // version 2, not encrypted, sent at regular intervals
+#define BTHOME_OBJECT_PACKET_ID 0x00
+#define BTHOME_OBJECT_TEMPERATURE 0x02 // sint16, 0.01 °C
+#define BTHOME_OBJECT_HUMIDITY 0x03    // uint16, 0.01 %
+
+/* History */
+#define HISTORY_VERSION 2
+#define HISTORY_RANGE_LEN 4 // minimum and maximum of the readings of a channel, in the same format as the readings
+#define HISTORY_HEADER_LEN (2 + 16 + 1 + 1 + 2 + 2 + 2 * STORE_STATS_LEN + 2 * HISTORY_RANGE_LEN + 1)
+#define HISTORY_READING_LEN 4 // sint16 temperature, uint16 humidity
+#define HISTORY_UNKNOWN_TEMPERATURE 0x8000
+#define HISTORY_UNKNOWN_HUMIDITY 0xFFFF
+
+_Static_assert(HISTORY_HEADER_LEN + BLE_ADV_PAYLOAD_HISTORY_MAX_COUNT * HISTORY_READING_LEN <=
+                   BLE_ADV_PAYLOAD_HISTORY_MAX_LEN,
+               "history doesn't fit into the periodic advertising data");
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static void quantize_readings(const float src[], size_t len, float min, float max, int16_t dst[]);
+
+static void store_centi(int16_t centi, uint16_t unknown, uint8_t arr[2]);
+
+static void store_range(const int16_t centis[], size_t len, uint16_t unknown, uint8_t arr[HISTORY_RANGE_LEN]);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+// clang-format off
+static const uint8_t history_uuid[16] = {
+    /* LSB <--------------------------------------------------------------------------------> MSB */
+    // vendor-specific uuid f71e0003-36a0-49d6-8d68-7ba76f904774
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x03, 0x00, 0x1e, 0xf7,
+};
+// clang-format on
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+size_t ble_adv_payload_bthome(float temperature, float humidity, uint8_t packet_id, const char *device_name,
+                              uint8_t dst[BLE_ADV_PAYLOAD_MAX_LEN])
+{
+    if (temperature < -327.68 || temperature > 327.67 || humidity < 0 || humidity > 100)
+    {
+        return 0;
+    }
+    size_t len = 0;
+
+    dst[len++] = 2;
+    dst[len++] = AD_TYPE_FLAGS;
+    dst[len++] = AD_FLAGS_GEN_DISC_BREDR_NOT_SPT;
+
+    size_t service_data_len_idx = len++;
+    dst[len++] = AD_TYPE_SERVICE_DATA_16BIT_UUID;
+    dst[len++] = BTHOME_SERVICE_UUID & 0xFF;
+    dst[len++] = BTHOME_SERVICE_UUID >> 8;
+    dst[len++] = BTHOME_DEVICE_INFO;
+    // objects must be sorted by id
+    dst[len++] = BTHOME_OBJECT_PACKET_ID;
+    dst[len++] = packet_id;
+    dst[len++] = BTHOME_OBJECT_TEMPERATURE;
+    store_float_into_uint8_arr(&temperature, &dst[len]);
+    len += 2;
+    dst[len++] = BTHOME_OBJECT_HUMIDITY;
+    store_float_into_uint8_arr(&humidity, &dst[len]);
+    len += 2;
+    dst[service_data_len_idx] = len - service_data_len_idx - 1;
+
+    size_t name_len = strlen(device_name);
+    size_t name_room = BLE_ADV_PAYLOAD_MAX_LEN - len - 2;
+    if (name_room > 0 && name_len > 0)
+    {
+        uint8_t name_type = AD_TYPE_COMPLETE_LOCAL_NAME;
+        if (name_len > name_room)
+        {
+            name_len = name_room;
+            name_type = AD_TYPE_SHORTENED_LOCAL_NAME;
+        }
+        dst[len++] = name_len + 1;
+        dst[len++] = name_type;
+        memcpy(&dst[len], device_name, name_len);
+        len += name_len;
+    }
+    return len;
+}
+
+size_t ble_adv_payload_history(const ble_adv_payload_history_t *history,
+                               uint8_t dst[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN])
+{
+    if (history->count > BLE_ADV_PAYLOAD_HISTORY_MAX_COUNT)
+    {
+        return 0;
+    }
+    size_t len = 0;
+    dst[len++] = HISTORY_HEADER_LEN - 1 + history->count * HISTORY_READING_LEN;
+    dst[len++] = AD_TYPE_SERVICE_DATA_128BIT_UUID;
+    memcpy(&dst[len], history_uuid, sizeof(history_uuid));
+    len += sizeof(history_uuid);
+    dst[len++] = HISTORY_VERSION;
+    dst[len++] = history->packet_id;
+    dst[len++] = history->sample_period_s & 0xFF;
+    dst[len++] = history->sample_period_s >> 8;
+    dst[len++] = history->window_minutes & 0xFF;
+    dst[len++] = history->window_minutes >> 8;
+    store_stats_into_uint8_arr(history->temperature_stats, &dst[len]);
+    len += STORE_STATS_LEN;
+    store_stats_into_uint8_arr(history->humidity_stats, &dst[len]);
+    len += STORE_STATS_LEN;
+    int16_t centi_temperatures[BLE_ADV_PAYLOAD_HISTORY_MAX_COUNT];
+    int16_t centi_humidities[BLE_ADV_PAYLOAD_HISTORY_MAX_COUNT];
+    quantize_readings(history->temperatures, history->count, -273.15, 327.67, centi_temperatures);
+    quantize_readings(history->humidities, history->count, 0, 100, centi_humidities);
+    store_range(centi_temperatures, history->count, HISTORY_UNKNOWN_TEMPERATURE, &dst[len]);
+    len += HISTORY_RANGE_LEN;
+    store_range(centi_humidities, history->count, HISTORY_UNKNOWN_HUMIDITY, &dst[len]);
+    len += HISTORY_RANGE_LEN;
+    dst[len++] = history->count;
+    for (size_t i = 0; i < history->count; i++)
+    {
+        store_centi(centi_temperatures[i], HISTORY_UNKNOWN_TEMPERATURE, &dst[len]);
+        store_centi(centi_humidities[i], HISTORY_UNKNOWN_HUMIDITY, &dst[len + 2]);
+        len += HISTORY_READING_LEN;
+    }
+    return len;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * quantize_readings follows the representation of the temperature and humidity GATT characteristics: readings in
+ *   [min, max] are quantized in hundredths, the others, NAN included, become INT16_MIN, i.e. 'value is not known'.
+ */
+static void quantize_readings(const float src[], size_t len, float min, float max, int16_t dst[])
+{
+    float_batch_quantize_i16(src, len, 100, dst);
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!(src[i] >= min && src[i] <= max))
+        {
+            dst[i] = INT16_MIN;
+        }
+    }
+}
+
+/*
+ * store_centi stores a reading quantized by quantize_readings, little-endian, or unknown if it's INT16_MIN.
+ */
+static void store_centi(int16_t centi, uint16_t unknown, uint8_t arr[2])
+{
+    uint16_t value = centi == INT16_MIN ? unknown : (uint16_t)centi;
+    arr[0] = value & 0xFF;
+    arr[1] = value >> 8;
+}
+
+/*
+ * store_range stores minimum and maximum of the known readings, quantized by quantize_readings, or unknown twice if
+ *   none is.
+ */
+static void store_range(const int16_t centis[], size_t len, uint16_t unknown, uint8_t arr[HISTORY_RANGE_LEN])
+{
+    float_batch_reduction_i16_t range = {.min = INT16_MIN, .max = INT16_MIN};
+    float_batch_reduce_i16(centis, len, &range);
+    store_centi(range.min, unknown, &arr[0]);
+    store_centi(range.max, unknown, &arr[2]);
+}
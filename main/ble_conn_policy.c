@@ -0,0 +1,166 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "ble_conn_policy.h"
+
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+/* Limits of the Link Layer, see: Bluetooth Core Specification Vol 6 Part B Section 4.5.1 */
+#define CONN_INT_MIN 0x0006      // 7.5ms
+#define CONN_INT_MAX 0x0C80      // 4s
+#define SUP_TIMEOUT_MIN_MS 2000  // not required by the specification, tolerates short radio interferences
+#define SUP_TIMEOUT_MAX_MS 32000 // 0x0C80 * 10ms
+
+#define MS_TO_CONN_INT(ms) ((ms)*4 / 5) // unit of 1.25ms
+#define CONN_INT_TO_MS(units) ((units)*1.25f)
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static void accumulate(ble_conn_policy_t *policy, uint32_t now_ms);
+
+static void enter_phase(ble_conn_policy_t *policy, ble_conn_policy_phase_t phase);
+
+static uint16_t clamp_conn_int(uint32_t interval_ms);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void ble_conn_policy_init(ble_conn_policy_t *policy, const ble_conn_policy_config_t *config, uint32_t now_ms)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->config = *config;
+    policy->last_traffic_ms = now_ms;
+    policy->last_accumulated_ms = now_ms;
+    enter_phase(policy, BLE_CONN_POLICY_FAST);
+}
+
+bool ble_conn_policy_on_traffic(ble_conn_policy_t *policy, uint32_t now_ms, size_t bytes)
+{
+    accumulate(policy, now_ms);
+    policy->last_traffic_ms = now_ms;
+    policy->metrics[policy->phase].bytes += bytes;
+    if (policy->phase == BLE_CONN_POLICY_FAST)
+    {
+        return false;
+    }
+    enter_phase(policy, BLE_CONN_POLICY_FAST);
+    return true;
+}
+
+bool ble_conn_policy_on_tick(ble_conn_policy_t *policy, uint32_t now_ms)
+{
+    accumulate(policy, now_ms);
+    if (policy->phase == BLE_CONN_POLICY_RELAXED || now_ms - policy->last_traffic_ms < policy->config.idle_timeout_ms)
+    {
+        return false;
+    }
+    enter_phase(policy, BLE_CONN_POLICY_RELAXED);
+    return true;
+}
+
+void ble_conn_policy_on_params_updated(ble_conn_policy_t *policy, uint32_t now_ms, uint16_t interval,
+                                       uint16_t latency)
+{
+    // connection events until now happened with the previous parameters
+    accumulate(policy, now_ms);
+    policy->interval_ms = CONN_INT_TO_MS(interval);
+    policy->latency = latency;
+}
+
+void ble_conn_policy_get_params(const ble_conn_policy_t *policy, ble_conn_params_t *dst)
+{
+    uint32_t interval_ms = policy->config.fast_interval_ms;
+    uint32_t latency = 0;
+    if (policy->phase == BLE_CONN_POLICY_RELAXED)
+    {
+        interval_ms = policy->config.relaxed_interval_ms;
+        latency = policy->config.relaxed_latency;
+    }
+    // a range lets the central align the interval with its other connections
+    dst->min_int = clamp_conn_int(interval_ms);
+    dst->max_int = clamp_conn_int(interval_ms * 2);
+
+    // the supervision timeout must be longer than twice the longest gap between two attended connection events
+    float max_int_ms = CONN_INT_TO_MS(dst->max_int);
+    while (latency > 0 && (1 + latency) * max_int_ms * 2 >= SUP_TIMEOUT_MAX_MS)
+    {
+        latency--;
+    }
+    uint32_t timeout_ms = (1 + latency) * max_int_ms * 4;
+    if (timeout_ms < SUP_TIMEOUT_MIN_MS)
+    {
+        timeout_ms = SUP_TIMEOUT_MIN_MS;
+    }
+    if (timeout_ms > SUP_TIMEOUT_MAX_MS)
+    {
+        timeout_ms = SUP_TIMEOUT_MAX_MS;
+    }
+    dst->latency = latency;
+    dst->timeout = timeout_ms / 10;
+}
+
+void ble_conn_policy_get_metrics(ble_conn_policy_t *policy, uint32_t now_ms, ble_conn_policy_phase_t phase,
+                                 ble_conn_policy_metrics_t *dst)
+{
+    accumulate(policy, now_ms);
+    *dst = policy->metrics[phase];
+    dst->throughput_bps = dst->duration_ms > 0 ? dst->bytes * 1000.0f / dst->duration_ms : 0;
+    dst->bytes_per_event = dst->conn_events > 0 ? dst->bytes / dst->conn_events : 0;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * accumulate adds the time elapsed since the last call to the current phase.
+ * With slave latency the peripheral attends one connection event every (1 + latency), unless it has data to send:
+ *   the estimate is a lower bound when the client is exchanging data on a relaxed link.
+ */
+static void accumulate(ble_conn_policy_t *policy, uint32_t now_ms)
+{
+    uint32_t elapsed_ms = now_ms - policy->last_accumulated_ms;
+    policy->last_accumulated_ms = now_ms;
+    ble_conn_policy_metrics_t *metrics = &policy->metrics[policy->phase];
+    metrics->duration_ms += elapsed_ms;
+    if (policy->interval_ms > 0)
+    {
+        metrics->conn_events += elapsed_ms / (policy->interval_ms * (1 + policy->latency));
+    }
+}
+
+static void enter_phase(ble_conn_policy_t *policy, ble_conn_policy_phase_t phase)
+{
+    policy->phase = phase;
+    policy->metrics[phase].entered_count++;
+}
+
+static uint16_t clamp_conn_int(uint32_t interval_ms)
+{
+    uint32_t interval = MS_TO_CONN_INT(interval_ms);
+    if (interval < CONN_INT_MIN)
+    {
+        return CONN_INT_MIN;
+    }
+    if (interval > CONN_INT_MAX)
+    {
+        return CONN_INT_MAX;
+    }
+    return interval;
+}
@@ -0,0 +1,160 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "ble_conn_table.h"
+
+#include <assert.h>
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+ble_conn_table_t ble_conn_table_init(ble_conn_t conns[], size_t capacity)
+{
+    memset(conns, 0, capacity * sizeof(conns[0]));
+    ble_conn_table_t table = {.conns = conns, .capacity = capacity};
+    return table;
+}
+
+ble_conn_t *ble_conn_table_add(ble_conn_table_t *table, uint16_t conn_id, const uint8_t remote_bda[6])
+{
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        ble_conn_t *conn = &table->conns[i];
+        if (!conn->in_use)
+        {
+            memset(conn, 0, sizeof(*conn));
+            conn->in_use = true;
+            conn->conn_id = conn_id;
+            memcpy(conn->remote_bda, remote_bda, sizeof(conn->remote_bda));
+            conn->mtu = BLE_CONN_TABLE_DEFAULT_MTU;
+            return conn;
+        }
+    }
+    return NULL;
+}
+
+ble_conn_t *ble_conn_table_find(ble_conn_table_t *table, uint16_t conn_id)
+{
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        if (table->conns[i].in_use && table->conns[i].conn_id == conn_id)
+        {
+            return &table->conns[i];
+        }
+    }
+    return NULL;
+}
+
+ble_conn_t *ble_conn_table_find_by_bda(ble_conn_table_t *table, const uint8_t remote_bda[6])
+{
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        if (table->conns[i].in_use && memcmp(table->conns[i].remote_bda, remote_bda, 6) == 0)
+        {
+            return &table->conns[i];
+        }
+    }
+    return NULL;
+}
+
+bool ble_conn_table_remove(ble_conn_table_t *table, uint16_t conn_id)
+{
+    ble_conn_t *conn = ble_conn_table_find(table, conn_id);
+    if (conn == NULL)
+    {
+        return false;
+    }
+    conn->in_use = false;
+    return true;
+}
+
+size_t ble_conn_table_count(const ble_conn_table_t *table)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        if (table->conns[i].in_use)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t ble_conn_table_select_targets(ble_conn_table_t *table, size_t charact_idx, size_t payload_len,
+                                     ble_conn_target_t dst[])
+{
+    assert(charact_idx < 32);
+    size_t len = 0;
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        ble_conn_t *conn = &table->conns[i];
+        if (!conn->in_use || !(conn->subscriptions & (1UL << charact_idx)))
+        {
+            continue;
+        }
+        if (conn->congested)
+        {
+            conn->notify_counters.skipped++;
+            continue;
+        }
+        size_t max_len = conn->mtu - BLE_CONN_TABLE_NOTIFY_OVERHEAD;
+        dst[len].conn_id = conn->conn_id;
+        dst[len].len = payload_len < max_len ? payload_len : max_len;
+        len++;
+    }
+    if (len < 2)
+    {
+        return len;
+    }
+
+    // rotate the targets in place, so that a different one comes first at every call
+    size_t first = table->rotation++ % len;
+    for (size_t rotated = 0; rotated < first; rotated++)
+    {
+        ble_conn_target_t head = dst[0];
+        memmove(&dst[0], &dst[1], (len - 1) * sizeof(dst[0]));
+        dst[len - 1] = head;
+    }
+    return len;
+}
+
+void ble_conn_table_on_notify_result(ble_conn_table_t *table, uint16_t conn_id, bool sent)
+{
+    ble_conn_t *conn = ble_conn_table_find(table, conn_id);
+    if (conn == NULL)
+    {
+        return;
+    }
+    if (sent)
+    {
+        conn->notify_counters.sent++;
+    }
+    else
+    {
+        conn->notify_counters.failed++;
+    }
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
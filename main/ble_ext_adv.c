@@ -0,0 +1,248 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "ble_ext_adv.h"
+
+#include "ble.h"
+#include "ble_adv_payload.h"
+#include "boot_profile.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define ESP_LOG_TAG "ENVI_SENSOR_BLE_EXT_ADV"
+#include "iferr.h"
+
+#define CONNECTABLE_INSTANCE 0
+#define PERIODIC_INSTANCE 1
+
+#define GAP_EVENT_TIMEOUT_MS 1000
+
+#define MS_TO_ADV_INTERVAL(ms) ((ms)*8 / 5)      // unit of 0.625ms
+#define MS_TO_PERIODIC_INTERVAL(ms) ((ms)*4 / 5) // unit of 1.25ms
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static size_t take_pending_periodic_data(uint8_t dst[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN]);
+
+static esp_err_t wait_for_gap_event(void);
+
+static size_t store_connectable_adv_data(uint8_t dst[BLE_ADV_PAYLOAD_MAX_LEN]);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+static esp_ble_gap_ext_adv_params_t connectable_params = {
+    .type = ESP_BLE_GAP_SET_EXT_ADV_PROP_LEGACY_IND,
+    .interval_min = MS_TO_ADV_INTERVAL(1285),
+    .interval_max = MS_TO_ADV_INTERVAL(1285),
+    .channel_map = ADV_CHNL_ALL,
+    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+    .filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+    .tx_power = EXT_ADV_TX_PWR_NO_PREFERENCE,
+    .primary_phy = ESP_BLE_GAP_PHY_1M,
+    .max_skip = 0,
+    .secondary_phy = ESP_BLE_GAP_PHY_1M,
+    .sid = CONNECTABLE_INSTANCE,
+    .scan_req_notif = false,
+};
+
+static esp_ble_gap_ext_adv_params_t periodic_params = {
+    .type = ESP_BLE_GAP_SET_EXT_ADV_PROP_NONCONN_NONSCANNABLE_UNDIRECTED,
+    .interval_min = MS_TO_ADV_INTERVAL(CONFIG_BLE_PERIODIC_ADV_INTERVAL_MS),
+    .interval_max = MS_TO_ADV_INTERVAL(CONFIG_BLE_PERIODIC_ADV_INTERVAL_MS),
+    .channel_map = ADV_CHNL_ALL,
+    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+    .filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+    .tx_power = EXT_ADV_TX_PWR_NO_PREFERENCE,
+    .primary_phy = ESP_BLE_GAP_PHY_1M,
+    .max_skip = 0,
+    .secondary_phy = ESP_BLE_GAP_PHY_1M,
+    .sid = PERIODIC_INSTANCE,
+    .scan_req_notif = false,
+};
+
+static esp_ble_gap_periodic_adv_params_t periodic_train_params = {
+    .interval_min = MS_TO_PERIODIC_INTERVAL(CONFIG_BLE_PERIODIC_ADV_INTERVAL_MS),
+    .interval_max = MS_TO_PERIODIC_INTERVAL(CONFIG_BLE_PERIODIC_ADV_INTERVAL_MS),
+    .properties = 0, // don't include tx power
+};
+
+static esp_ble_gap_ext_adv_t ext_adv[] = {
+    {.instance = CONNECTABLE_INSTANCE, .duration = 0, .max_events = 0},
+    {.instance = PERIODIC_INSTANCE, .duration = 0, .max_events = 0},
+};
+
+// binsemaphore_gap_event is given for every event completing an advertising command
+static SemaphoreHandle_t binsemaphore_gap_event = NULL;
+
+// periodic data can only be replaced once the periodic set has been configured
+static bool periodic_started = false;
+
+// periodic data set before the train started, the readings may come first as the sensor starts before BLE
+static uint8_t pending_periodic_data[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN];
+static size_t pending_periodic_data_len = 0;
+static portMUX_TYPE periodic_data_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+esp_err_t ble_ext_adv_start(void)
+{
+    binsemaphore_gap_event = xSemaphoreCreateBinary();
+    assert(binsemaphore_gap_event);
+
+    uint8_t adv_data[BLE_ADV_PAYLOAD_MAX_LEN];
+    size_t adv_data_len = store_connectable_adv_data(adv_data);
+    IFERR_RETE(esp_ble_gap_ext_adv_set_params(CONNECTABLE_INSTANCE, &connectable_params), "set params failed");
+    IFERR_RETE(wait_for_gap_event(), "set params not completed");
+    IFERR_RETE(esp_ble_gap_config_ext_adv_data_raw(CONNECTABLE_INSTANCE, adv_data_len, adv_data),
+               "config adv data failed");
+    IFERR_RETE(wait_for_gap_event(), "config adv data not completed");
+
+    // the periodic set itself carries the device name only, the readings go into the periodic train
+    uint8_t name_data[2 + sizeof(BLE_DEVICE_NAME) - 1] = {sizeof(BLE_DEVICE_NAME), 0x09};
+    memcpy(&name_data[2], BLE_DEVICE_NAME, sizeof(BLE_DEVICE_NAME) - 1);
+    IFERR_RETE(esp_ble_gap_ext_adv_set_params(PERIODIC_INSTANCE, &periodic_params), "set params failed");
+    IFERR_RETE(wait_for_gap_event(), "set params not completed");
+    IFERR_RETE(esp_ble_gap_config_ext_adv_data_raw(PERIODIC_INSTANCE, sizeof(name_data), name_data),
+               "config adv data failed");
+    IFERR_RETE(wait_for_gap_event(), "config adv data not completed");
+
+    uint8_t periodic_data[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN];
+    size_t periodic_data_len = take_pending_periodic_data(periodic_data);
+    if (periodic_data_len == 0)
+    {
+        stats_t no_stats = {0};
+        ble_adv_payload_history_t no_history = {.temperature_stats = &no_stats, .humidity_stats = &no_stats};
+        periodic_data_len = ble_adv_payload_history(&no_history, periodic_data);
+    }
+    IFERR_RETE(esp_ble_gap_periodic_adv_set_params(PERIODIC_INSTANCE, &periodic_train_params),
+               "set periodic params failed");
+    IFERR_RETE(wait_for_gap_event(), "set periodic params not completed");
+    IFERR_RETE(esp_ble_gap_config_periodic_adv_data_raw(PERIODIC_INSTANCE, periodic_data_len, periodic_data),
+               "config periodic data failed");
+    IFERR_RETE(wait_for_gap_event(), "config periodic data not completed");
+    IFERR_RETE(esp_ble_gap_periodic_adv_start(PERIODIC_INSTANCE), "start periodic advertising failed");
+    IFERR_RETE(wait_for_gap_event(), "start periodic advertising not completed");
+
+    IFERR_RETE(esp_ble_gap_ext_adv_start(sizeof(ext_adv) / sizeof(ext_adv[0]), ext_adv), "start advertising failed");
+    IFERR_RETE(wait_for_gap_event(), "start advertising not completed");
+    boot_profile_mark(BOOT_PHASE_ADVERTISING);
+    portENTER_CRITICAL(&periodic_data_lock);
+    periodic_started = true;
+    portEXIT_CRITICAL(&periodic_data_lock);
+
+    // data set while the sets were being configured
+    periodic_data_len = take_pending_periodic_data(periodic_data);
+    if (periodic_data_len > 0)
+    {
+        IFERR_RETE(esp_ble_gap_config_periodic_adv_data_raw(PERIODIC_INSTANCE, periodic_data_len, periodic_data),
+                   "config periodic data failed");
+    }
+    return ESP_OK;
+}
+
+esp_err_t ble_ext_adv_restart_connectable(void)
+{
+    return esp_ble_gap_ext_adv_start(1, &ext_adv[CONNECTABLE_INSTANCE]);
+}
+
+esp_err_t ble_ext_adv_set_periodic_data(const uint8_t *data, size_t len)
+{
+    if (len > sizeof(pending_periodic_data))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    portENTER_CRITICAL(&periodic_data_lock);
+    const bool started = periodic_started;
+    if (!started)
+    {
+        memcpy(pending_periodic_data, data, len);
+        pending_periodic_data_len = len;
+    }
+    portEXIT_CRITICAL(&periodic_data_lock);
+    if (!started)
+    {
+        return ESP_OK;
+    }
+    return esp_ble_gap_config_periodic_adv_data_raw(PERIODIC_INSTANCE, len, data);
+}
+
+void ble_ext_adv_gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event)
+    {
+    case ESP_GAP_BLE_EXT_ADV_SET_PARAMS_COMPLETE_EVT:
+    case ESP_GAP_BLE_EXT_ADV_DATA_SET_COMPLETE_EVT:
+    case ESP_GAP_BLE_PERIODIC_ADV_SET_PARAMS_COMPLETE_EVT:
+    case ESP_GAP_BLE_PERIODIC_ADV_DATA_SET_COMPLETE_EVT:
+    case ESP_GAP_BLE_PERIODIC_ADV_START_COMPLETE_EVT:
+    case ESP_GAP_BLE_EXT_ADV_START_COMPLETE_EVT:
+        ESP_LOGD(ESP_LOG_TAG, "extended advertising event %d", event);
+        if (!periodic_started)
+        {
+            xSemaphoreGive(binsemaphore_gap_event);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * take_pending_periodic_data copies the pending periodic data into dst, and returns its length, or 0 if there's none.
+ */
+static size_t take_pending_periodic_data(uint8_t dst[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN])
+{
+    portENTER_CRITICAL(&periodic_data_lock);
+    const size_t len = pending_periodic_data_len;
+    memcpy(dst, pending_periodic_data, len);
+    pending_periodic_data_len = 0;
+    portEXIT_CRITICAL(&periodic_data_lock);
+    return len;
+}
+
+static esp_err_t wait_for_gap_event(void)
+{
+    if (xSemaphoreTake(binsemaphore_gap_event, GAP_EVENT_TIMEOUT_MS / portTICK_PERIOD_MS) != pdTRUE)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+/*
+ * store_connectable_adv_data writes the same data advertised without BLE 5 features:
+ *   flags, Environmental Sensing Service uuid and device name.
+ */
+static size_t store_connectable_adv_data(uint8_t dst[BLE_ADV_PAYLOAD_MAX_LEN])
+{
+    size_t name_len = sizeof(BLE_DEVICE_NAME) - 1;
+    uint8_t header[] = {0x02, 0x01, 0x06, 0x03, 0x03, 0x1A, 0x18, name_len + 1, 0x09};
+    _Static_assert(sizeof(header) + sizeof(BLE_DEVICE_NAME) - 1 <= BLE_ADV_PAYLOAD_MAX_LEN, "device name too long");
+    memcpy(dst, header, sizeof(header));
+    memcpy(&dst[sizeof(header)], BLE_DEVICE_NAME, name_len);
+    return sizeof(header) + name_len;
+}
@@ -0,0 +1,656 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "ble.h"
+
+#include "ble_adv_payload.h"
+#include "ble_service.h"
+#include "boot_profile.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_nimble_hci.h"
+#include "esp_timer.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+#include "host/ble_store.h"
+#include "store/config/ble_store_config.h"
+#endif
+#include <stdbool.h>
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define ESP_LOG_TAG "ENVI_SENSOR_BLE"
+#include "iferr.h"
+
+/* The Settings characteristic changes what is stored in NVS, so writes may require the client to pair first */
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+#define SETTINGS_FLAGS_WRITE (BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC)
+#else
+#define SETTINGS_FLAGS_WRITE BLE_GATT_CHR_F_WRITE
+#endif
+
+#define PREFERRED_MTU 500
+
+_Static_assert(CONFIG_BLE_MAX_CONNECTIONS <= CONFIG_BT_NIMBLE_MAX_CONNECTIONS,
+               "NimBLE can't hold that many connections");
+#ifdef CONFIG_BTDM_CTRL_BLE_MAX_CONN
+_Static_assert(CONFIG_BLE_MAX_CONNECTIONS <= CONFIG_BTDM_CTRL_BLE_MAX_CONN, "controller can't hold that many connections");
+#endif
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+/* Attributes served by the application, passed to gatt_access_callback as its argument; unlike Bluedroid, NimBLE
+ *   doesn't report the handles of the descriptors, so attributes are told apart by this id */
+typedef enum
+{
+    ATTR_TEMPERATURE,
+    ATTR_TEMPERATURE_ES_MEASUREMENT,
+    ATTR_TEMPERATURE_ES_TRIGGER_SETTING_1,
+    ATTR_TEMPERATURE_ES_TRIGGER_SETTING_2,
+    ATTR_TEMPERATURE_ES_TRIGGER_SETTING_3,
+    ATTR_TEMPERATURE_ES_CONFIGURATION,
+
+    ATTR_HUMIDITY,
+    ATTR_HUMIDITY_ES_MEASUREMENT,
+    ATTR_HUMIDITY_ES_TRIGGER_SETTING_1,
+    ATTR_HUMIDITY_ES_TRIGGER_SETTING_2,
+    ATTR_HUMIDITY_ES_TRIGGER_SETTING_3,
+    ATTR_HUMIDITY_ES_CONFIGURATION,
+
+    ATTR_STATS,
+    ATTR_DEW_POINT,
+    ATTR_HEAT_INDEX,
+    ATTR_ABSOLUTE_HUMIDITY,
+    ATTR_READINGS,
+    ATTR_SETTINGS,
+
+    ATTR_COUNT,
+} attr_t;
+
+/* Maps a value of ble_service, served on reads, to its id */
+typedef struct
+{
+    attr_t attr;
+    ble_service_value_t value;
+} attr_value_t;
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static int gatt_access_callback(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt,
+                                void *arg);
+
+static int read_attr(attr_t attr, struct os_mbuf *om);
+
+static int write_attr(uint16_t conn_handle, attr_t attr, struct os_mbuf *om);
+
+static bool find_ess_descriptor(attr_t attr, ble_service_ess_t *charact, size_t *descriptor);
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg);
+
+static void on_connect(uint16_t conn_handle);
+
+static void on_disconnect(uint16_t conn_handle);
+
+static void on_sync(void);
+
+static void on_reset(int reason);
+
+static void host_task(void *param);
+
+static void start_advertising(void);
+
+static esp_err_t err_from_rc(int rc);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+/*
+ * Advertising
+ */
+
+static uint8_t own_addr_type;
+
+/* Set by on_sync, once the host and the controller are in sync: only then the GAP API can be used */
+static volatile bool synced = false;
+
+#if CONFIG_BLE_BROADCAST_MODE
+// packet id of the BTHome payload, incremented with every new reading
+static uint8_t broadcast_packet_id = 0;
+#endif
+
+/* Cost of bringing up the host, from ble_init to on_sync, to compare with the Bluedroid backend */
+static int64_t init_start_us = 0;
+static size_t init_start_free_heap = 0;
+
+/*
+ * Service and Characteristics
+ */
+
+static const ble_uuid16_t GATTS_ENVIRONMENTAL_SENSING_SERVICE_UUID = BLE_UUID16_INIT(0x181A);
+static const ble_uuid16_t GATTS_TEMPERATURE_CHARACT_UUID = BLE_UUID16_INIT(0x2A6E);
+static const ble_uuid16_t GATTS_HUMIDITY_CHARACT_UUID = BLE_UUID16_INIT(0x2A6F);
+static const ble_uuid16_t GATTS_HEAT_INDEX_CHARACT_UUID = BLE_UUID16_INIT(0x2A7A);
+static const ble_uuid16_t GATTS_DEW_POINT_CHARACT_UUID = BLE_UUID16_INIT(0x2A7B);
+// clang-format off
+// vendor-specific uuid f71e0001-36a0-49d6-8d68-7ba76f904774
+static const ble_uuid128_t GATTS_STATS_CHARACT_UUID = BLE_UUID128_INIT(
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x01, 0x00, 0x1e, 0xf7);
+// vendor-specific uuid f71e0002-36a0-49d6-8d68-7ba76f904774
+static const ble_uuid128_t GATTS_ABSOLUTE_HUMIDITY_CHARACT_UUID = BLE_UUID128_INIT(
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x02, 0x00, 0x1e, 0xf7);
+// vendor-specific uuid f71e0004-36a0-49d6-8d68-7ba76f904774
+static const ble_uuid128_t GATTS_READINGS_CHARACT_UUID = BLE_UUID128_INIT(
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x04, 0x00, 0x1e, 0xf7);
+// vendor-specific uuid f71e0005-36a0-49d6-8d68-7ba76f904774
+static const ble_uuid128_t GATTS_SETTINGS_CHARACT_UUID = BLE_UUID128_INIT(
+    0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49, 0xa0, 0x36, 0x05, 0x00, 0x1e, 0xf7);
+// clang-format on
+
+static const ble_uuid16_t es_configuration_uuid = BLE_UUID16_INIT(0x290B);
+static const ble_uuid16_t es_measurement_uuid = BLE_UUID16_INIT(0x290C);
+static const ble_uuid16_t es_trigger_setting_uuid = BLE_UUID16_INIT(0x290D);
+
+static const attr_value_t attr_values[] = {
+    {ATTR_TEMPERATURE, BLE_SERVICE_VALUE_TEMPERATURE},
+    {ATTR_TEMPERATURE_ES_MEASUREMENT, BLE_SERVICE_VALUE_TEMPERATURE_ES_MEASUREMENT},
+    {ATTR_HUMIDITY, BLE_SERVICE_VALUE_HUMIDITY},
+    {ATTR_HUMIDITY_ES_MEASUREMENT, BLE_SERVICE_VALUE_HUMIDITY_ES_MEASUREMENT},
+    {ATTR_STATS, BLE_SERVICE_VALUE_STATS},
+    {ATTR_DEW_POINT, BLE_SERVICE_VALUE_DEW_POINT},
+    {ATTR_HEAT_INDEX, BLE_SERVICE_VALUE_HEAT_INDEX},
+    {ATTR_ABSOLUTE_HUMIDITY, BLE_SERVICE_VALUE_ABSOLUTE_HUMIDITY},
+    {ATTR_READINGS, BLE_SERVICE_VALUE_READINGS},
+    {ATTR_SETTINGS, BLE_SERVICE_VALUE_SETTINGS},
+};
+
+/* Handles of the characteristics supporting notifications, assigned by ble_gatts_add_svcs */
+static uint16_t notify_handles[BLE_SERVICE_NOTIFY_COUNT];
+
+/* Ids of the ES Trigger Setting and ES Configuration descriptors, see ble_service */
+static const attr_t ess_descriptor_attrs[BLE_SERVICE_ESS_COUNT][BLE_SERVICE_ESS_DESCRIPTOR_COUNT] = {
+    [BLE_SERVICE_ESS_TEMPERATURE] = {ATTR_TEMPERATURE_ES_TRIGGER_SETTING_1, ATTR_TEMPERATURE_ES_TRIGGER_SETTING_2,
+                                     ATTR_TEMPERATURE_ES_TRIGGER_SETTING_3, ATTR_TEMPERATURE_ES_CONFIGURATION},
+    [BLE_SERVICE_ESS_HUMIDITY] = {ATTR_HUMIDITY_ES_TRIGGER_SETTING_1, ATTR_HUMIDITY_ES_TRIGGER_SETTING_2,
+                                  ATTR_HUMIDITY_ES_TRIGGER_SETTING_3, ATTR_HUMIDITY_ES_CONFIGURATION},
+};
+
+/* Full Database Description, the same as the Bluedroid backend: NimBLE adds the CCCDs by itself */
+#define ATTR_ARG(attr) ((void *)(uintptr_t)(attr))
+#define DSC(dsc_uuid, flags, attr)                                                                                     \
+    {                                                                                                                  \
+        .uuid = &(dsc_uuid).u, .att_flags = (flags), .access_cb = gatt_access_callback, .arg = ATTR_ARG(attr)          \
+    }
+#define ESS_DESCRIPTORS(prefix)                                                                                        \
+    (struct ble_gatt_dsc_def[])                                                                                        \
+    {                                                                                                                  \
+        DSC(es_measurement_uuid, BLE_ATT_F_READ, prefix##_ES_MEASUREMENT),                                             \
+            DSC(es_trigger_setting_uuid, BLE_ATT_F_READ | BLE_ATT_F_WRITE, prefix##_ES_TRIGGER_SETTING_1),             \
+            DSC(es_trigger_setting_uuid, BLE_ATT_F_READ | BLE_ATT_F_WRITE, prefix##_ES_TRIGGER_SETTING_2),             \
+            DSC(es_trigger_setting_uuid, BLE_ATT_F_READ | BLE_ATT_F_WRITE, prefix##_ES_TRIGGER_SETTING_3),             \
+            DSC(es_configuration_uuid, BLE_ATT_F_READ | BLE_ATT_F_WRITE, prefix##_ES_CONFIGURATION), {0},              \
+    }
+
+// clang-format off
+static const struct ble_gatt_svc_def gatt_svcs[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = &GATTS_ENVIRONMENTAL_SENSING_SERVICE_UUID.u,
+        .characteristics = (struct ble_gatt_chr_def[]){
+            {.uuid = &GATTS_TEMPERATURE_CHARACT_UUID.u, .access_cb = gatt_access_callback, .arg = ATTR_ARG(ATTR_TEMPERATURE),
+             .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+             .val_handle = &notify_handles[BLE_SERVICE_NOTIFY_TEMPERATURE],
+             .descriptors = ESS_DESCRIPTORS(ATTR_TEMPERATURE)},
+            {.uuid = &GATTS_HUMIDITY_CHARACT_UUID.u, .access_cb = gatt_access_callback, .arg = ATTR_ARG(ATTR_HUMIDITY),
+             .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+             .val_handle = &notify_handles[BLE_SERVICE_NOTIFY_HUMIDITY],
+             .descriptors = ESS_DESCRIPTORS(ATTR_HUMIDITY)},
+            {.uuid = &GATTS_STATS_CHARACT_UUID.u, .access_cb = gatt_access_callback, .arg = ATTR_ARG(ATTR_STATS),
+             .flags = BLE_GATT_CHR_F_READ},
+            {.uuid = &GATTS_DEW_POINT_CHARACT_UUID.u, .access_cb = gatt_access_callback, .arg = ATTR_ARG(ATTR_DEW_POINT),
+             .flags = BLE_GATT_CHR_F_READ},
+            {.uuid = &GATTS_HEAT_INDEX_CHARACT_UUID.u, .access_cb = gatt_access_callback, .arg = ATTR_ARG(ATTR_HEAT_INDEX),
+             .flags = BLE_GATT_CHR_F_READ},
+            {.uuid = &GATTS_ABSOLUTE_HUMIDITY_CHARACT_UUID.u, .access_cb = gatt_access_callback,
+             .arg = ATTR_ARG(ATTR_ABSOLUTE_HUMIDITY), .flags = BLE_GATT_CHR_F_READ},
+            {.uuid = &GATTS_READINGS_CHARACT_UUID.u, .access_cb = gatt_access_callback, .arg = ATTR_ARG(ATTR_READINGS),
+             .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+             .val_handle = &notify_handles[BLE_SERVICE_NOTIFY_READINGS]},
+            {.uuid = &GATTS_SETTINGS_CHARACT_UUID.u, .access_cb = gatt_access_callback, .arg = ATTR_ARG(ATTR_SETTINGS),
+             .flags = BLE_GATT_CHR_F_READ | SETTINGS_FLAGS_WRITE},
+            {0},
+        },
+    },
+    {0},
+};
+// clang-format on
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+esp_err_t ble_init(ble_settings_handler_t settings_handler)
+{
+    init_start_us = esp_timer_get_time();
+    init_start_free_heap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    ble_service_init(settings_handler);
+
+    IFERR_RETE(esp_nimble_hci_and_controller_init(), "init controller failed");
+    nimble_port_init();
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+    // clients pair without a passkey (Just Works), as the Envi Sensor has no keypad, and bond, so that later
+    //   connections are encrypted right away
+    ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_NO_IO;
+    ble_hs_cfg.sm_bonding = 1;
+    ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+    ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+    ble_store_config_init();
+#endif
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+    int rc = ble_gatts_count_cfg(gatt_svcs);
+    IFERR_RETE(err_from_rc(rc), "count gatt services failed, rc %d", rc);
+    rc = ble_gatts_add_svcs(gatt_svcs);
+    IFERR_RETE(err_from_rc(rc), "add gatt services failed, rc %d", rc);
+    rc = ble_svc_gap_device_name_set(BLE_DEVICE_NAME);
+    IFERR_RETE(err_from_rc(rc), "set device name failed, rc %d", rc);
+    rc = ble_att_set_preferred_mtu(PREFERRED_MTU);
+    IFERR_RETE(err_from_rc(rc), "set local MTU failed, rc %d", rc);
+
+    nimble_port_freertos_init(host_task);
+    return ESP_OK;
+}
+
+esp_err_t ble_stop(void)
+{
+    ble_service_stop();
+    int rc = nimble_port_stop();
+    IFERR_RETE(err_from_rc(rc), "stop host failed, rc %d", rc);
+    nimble_port_deinit();
+    IFERR_RETE(esp_nimble_hci_and_controller_deinit(), "deinit controller failed");
+    return ESP_OK;
+}
+
+esp_err_t ble_broadcast_readings(float temperature, float humidity)
+{
+#if CONFIG_BLE_BROADCAST_MODE
+    ESP_LOGD(ESP_LOG_TAG, "%s - broadcast temperature %f, humidity %f", __func__, temperature, humidity);
+    if (!synced)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    static uint8_t payload[BLE_ADV_PAYLOAD_MAX_LEN];
+    size_t len = ble_adv_payload_bthome(temperature, humidity, broadcast_packet_id, BLE_DEVICE_NAME, payload);
+    if (len == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    broadcast_packet_id++;
+    // the controller advertises the new payload from the next advertising event
+    int rc = ble_gap_adv_set_data(payload, len);
+    IFERR_RETE(err_from_rc(rc), "config raw adv data failed, rc %d", rc);
+    if (!ble_gap_adv_active())
+    {
+        start_advertising();
+    }
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t ble_broadcast_history(ble_adv_payload_history_t *history)
+{
+    // periodic advertising is only implemented on top of Bluedroid, see ble_ext_adv
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+/*
+ * ble_service_backend_notify sends the value to the client; each copy is freed by NimBLE once sent.
+ * NimBLE has no congestion event: notifications refused while its buffers are full are counted as failed.
+ */
+esp_err_t ble_service_backend_notify(uint16_t conn_id, ble_service_notify_t charact, const uint8_t *value,
+                                     size_t len)
+{
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(value, len);
+    int rc = om ? ble_gattc_notify_custom(conn_id, notify_handles[charact], om) : BLE_HS_ENOMEM;
+    return err_from_rc(rc);
+}
+
+esp_err_t ble_service_backend_update_conn_params(const ble_conn_t *conn, const ble_conn_params_t *params)
+{
+    struct ble_gap_upd_params upd_params = {0};
+    upd_params.itvl_min = params->min_int;
+    upd_params.itvl_max = params->max_int;
+    upd_params.latency = params->latency;
+    upd_params.supervision_timeout = params->timeout;
+    int rc = ble_gap_update_params(conn->conn_id, &upd_params);
+    return err_from_rc(rc);
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * gatt_access_callback serves the reads of every attribute of the service, and only accepts writes to the ES
+ *   Trigger Setting and ES Configuration descriptors, and to the Settings characteristic.
+ * Long reads and writes are reassembled by NimBLE, so each call carries the whole value.
+ */
+static int gatt_access_callback(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt,
+                                void *arg)
+{
+    attr_t attr = (attr_t)(uintptr_t)arg;
+    int att_err = BLE_ATT_ERR_UNLIKELY;
+    switch (ctxt->op)
+    {
+    case BLE_GATT_ACCESS_OP_READ_CHR:
+    case BLE_GATT_ACCESS_OP_READ_DSC:
+        ESP_LOGI(ESP_LOG_TAG, "read, conn_id %d, handle %d", conn_handle, attr_handle);
+        att_err = read_attr(attr, ctxt->om);
+        break;
+    case BLE_GATT_ACCESS_OP_WRITE_CHR:
+    case BLE_GATT_ACCESS_OP_WRITE_DSC:
+        ESP_LOGI(ESP_LOG_TAG, "write, conn_id %d, handle %d", conn_handle, attr_handle);
+        att_err = write_attr(conn_handle, attr, ctxt->om);
+        break;
+    default:
+        break;
+    }
+    ble_service_on_traffic(conn_handle, OS_MBUF_PKTLEN(ctxt->om));
+    return att_err;
+}
+
+/*
+ * read_attr appends to om the value of the attribute.
+ */
+static int read_attr(attr_t attr, struct os_mbuf *om)
+{
+    uint8_t value[BLE_SERVICE_VALUE_MAX_LEN];
+    uint16_t len = 0;
+    bool found = false;
+    ble_service_ess_t charact;
+    size_t descriptor;
+    if (find_ess_descriptor(attr, &charact, &descriptor))
+    {
+        len = ble_service_read_ess_descriptor(charact, descriptor, value);
+        found = true;
+    }
+    for (size_t i = 0; !found && i < sizeof(attr_values) / sizeof(attr_values[0]); i++)
+    {
+        if (attr_values[i].attr == attr)
+        {
+            len = ble_service_read_value(attr_values[i].value, value);
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        ESP_LOGE(ESP_LOG_TAG, "illegal attribute %d", attr);
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    return os_mbuf_append(om, value, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+/*
+ * write_attr passes the value written by the client to ble_service, if attr refers to an ES Trigger Setting or
+ *   ES Configuration descriptor, or to the Settings characteristic.
+ */
+static int write_attr(uint16_t conn_handle, attr_t attr, struct os_mbuf *om)
+{
+    uint8_t value[ESS_TRIGGER_MAX_LEN > BLE_SERVICE_SETTINGS_LEN ? ESS_TRIGGER_MAX_LEN : BLE_SERVICE_SETTINGS_LEN];
+    uint16_t len = 0;
+    if (ble_hs_mbuf_to_flat(om, value, sizeof(value), &len) != 0)
+    {
+        // longer than any value accepted
+        return attr == ATTR_SETTINGS ? BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN
+                                     : BLE_SERVICE_ATT_ERR_ESS_WRITE_REQUEST_REJECTED;
+    }
+    ble_service_ess_t charact;
+    size_t descriptor;
+    if (find_ess_descriptor(attr, &charact, &descriptor))
+    {
+        return ble_service_write_ess_descriptor(conn_handle, charact, descriptor, value, len);
+    }
+    if (attr == ATTR_SETTINGS)
+    {
+        return ble_service_write_settings(conn_handle, value, len);
+    }
+    return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
+}
+
+/*
+ * find_ess_descriptor looks up the characteristic and the index of the ES Trigger Setting or ES Configuration
+ *   descriptor attr refers to, if any.
+ * It returns false otherwise.
+ */
+static bool find_ess_descriptor(attr_t attr, ble_service_ess_t *charact, size_t *descriptor)
+{
+    for (ble_service_ess_t c = 0; c < BLE_SERVICE_ESS_COUNT; c++)
+    {
+        for (size_t d = 0; d < BLE_SERVICE_ESS_DESCRIPTOR_COUNT; d++)
+        {
+            if (attr == ess_descriptor_attrs[c][d])
+            {
+                *charact = c;
+                *descriptor = d;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg)
+{
+    switch (event->type)
+    {
+    case BLE_GAP_EVENT_CONNECT:
+        ESP_LOGI(ESP_LOG_TAG, "BLE_GAP_EVENT_CONNECT, conn_id = %d, status = %d", event->connect.conn_handle,
+                 event->connect.status);
+        if (event->connect.status == 0)
+        {
+            on_connect(event->connect.conn_handle);
+        }
+        else
+        {
+            start_advertising();
+        }
+        break;
+    case BLE_GAP_EVENT_DISCONNECT:
+        ESP_LOGI(ESP_LOG_TAG, "BLE_GAP_EVENT_DISCONNECT, conn_id = %d, reason = 0x%x",
+                 event->disconnect.conn.conn_handle, event->disconnect.reason);
+        on_disconnect(event->disconnect.conn.conn_handle);
+        break;
+    case BLE_GAP_EVENT_CONN_UPDATE: {
+        ESP_LOGD(ESP_LOG_TAG, "BLE_GAP_EVENT_CONN_UPDATE, conn_id = %d, status = %d", event->conn_update.conn_handle,
+                 event->conn_update.status);
+        struct ble_gap_conn_desc desc;
+        if (event->conn_update.status != 0 || ble_gap_conn_find(event->conn_update.conn_handle, &desc) != 0)
+        {
+            break;
+        }
+        ESP_LOGD(ESP_LOG_TAG, "conn_int = %d, latency = %d, timeout = %d", desc.conn_itvl, desc.conn_latency,
+                 desc.supervision_timeout);
+        ble_service_on_params_updated(event->conn_update.conn_handle, desc.conn_itvl, desc.conn_latency);
+        break;
+    }
+    case BLE_GAP_EVENT_MTU:
+        ESP_LOGD(ESP_LOG_TAG, "BLE_GAP_EVENT_MTU, conn_id %d, MTU %d", event->mtu.conn_handle, event->mtu.value);
+        ble_service_on_mtu(event->mtu.conn_handle, event->mtu.value);
+        break;
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        for (ble_service_notify_t charact = 0; charact < BLE_SERVICE_NOTIFY_COUNT; charact++)
+        {
+            if (event->subscribe.attr_handle == notify_handles[charact])
+            {
+                ble_service_set_subscription(event->subscribe.conn_handle, charact, event->subscribe.cur_notify);
+            }
+        }
+        ble_service_on_traffic(event->subscribe.conn_handle, 2);
+        break;
+    case BLE_GAP_EVENT_ADV_COMPLETE:
+        ESP_LOGD(ESP_LOG_TAG, "BLE_GAP_EVENT_ADV_COMPLETE, reason = %d", event->adv_complete.reason);
+        break;
+#if CONFIG_BLE_SETTINGS_WRITE_ENCRYPTED
+    case BLE_GAP_EVENT_ENC_CHANGE:
+        ESP_LOGI(ESP_LOG_TAG, "BLE_GAP_EVENT_ENC_CHANGE, conn_id = %d, status = %d", event->enc_change.conn_handle,
+                 event->enc_change.status);
+        break;
+    case BLE_GAP_EVENT_REPEAT_PAIRING: {
+        // the client lost its bond: forget ours too, and let it pair again
+        struct ble_gap_conn_desc desc;
+        if (ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc) == 0)
+        {
+            ble_store_util_delete_peer(&desc.peer_id_addr);
+        }
+        return BLE_GAP_REPEAT_PAIRING_RETRY;
+    }
+#endif
+    default:
+        break;
+    }
+    return 0;
+}
+
+static void on_connect(uint16_t conn_handle)
+{
+    struct ble_gap_conn_desc desc;
+    uint8_t remote_bda[6] = {0};
+    if (ble_gap_conn_find(conn_handle, &desc) == 0)
+    {
+        memcpy(remote_bda, desc.peer_id_addr.val, sizeof(remote_bda));
+    }
+    size_t conns_count;
+    if (ble_service_on_connect(conn_handle, remote_bda, &conns_count) != ESP_OK)
+    {
+        ESP_LOGW(ESP_LOG_TAG, "no room for conn_id %d, disconnecting", conn_handle);
+        int rc = ble_gap_terminate(conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+        IFERR_LOG(err_from_rc(rc), "close connection failed, rc %d", rc);
+        return;
+    }
+    // the controller stops advertising as soon as a client connects
+    if (conns_count < CONFIG_BLE_MAX_CONNECTIONS)
+    {
+        start_advertising();
+    }
+}
+
+static void on_disconnect(uint16_t conn_handle)
+{
+    bool was_full;
+    // a refused client isn't among the connections; otherwise, advertising is still running unless it was full
+    if (ble_service_on_disconnect(conn_handle, &was_full) == ESP_OK && was_full)
+    {
+        start_advertising();
+    }
+}
+
+/*
+ * on_sync runs in the host task once the host and the controller are in sync, i.e. when the peripheral is ready.
+ */
+static void on_sync(void)
+{
+    int rc = ble_hs_util_ensure_addr(0);
+    IFERR_RETV(err_from_rc(rc), "no usable address, rc %d", rc);
+    rc = ble_hs_id_infer_auto(0, &own_addr_type);
+    IFERR_RETV(err_from_rc(rc), "failed to infer the address type, rc %d", rc);
+    synced = true;
+    ESP_LOGI(ESP_LOG_TAG, "NimBLE host ready in %u ms, using %u bytes of heap",
+             (unsigned)((esp_timer_get_time() - init_start_us) / 1000),
+             (unsigned)(init_start_free_heap - heap_caps_get_free_size(MALLOC_CAP_DEFAULT)));
+#if !CONFIG_BLE_BROADCAST_MODE
+    // in broadcast mode, advertising starts with the first reading, see ble_broadcast_readings
+    struct ble_hs_adv_fields fields = {0};
+    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    fields.name = (const uint8_t *)BLE_DEVICE_NAME;
+    fields.name_len = strlen(BLE_DEVICE_NAME);
+    fields.name_is_complete = 1;
+    fields.tx_pwr_lvl_is_present = 1;
+    fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
+    fields.uuids16 = &GATTS_ENVIRONMENTAL_SENSING_SERVICE_UUID;
+    fields.num_uuids16 = 1;
+    fields.uuids16_is_complete = 1;
+    rc = ble_gap_adv_set_fields(&fields);
+    IFERR_RETV(err_from_rc(rc), "config adv data failed, rc %d", rc);
+    start_advertising();
+#endif
+}
+
+static void on_reset(int reason)
+{
+    synced = false;
+    ESP_LOGE(ESP_LOG_TAG, "NimBLE host reset, reason %d", reason);
+}
+
+static void host_task(void *param)
+{
+    // returns only once nimble_port_stop is called
+    nimble_port_run();
+    nimble_port_freertos_deinit();
+}
+
+static void start_advertising(void)
+{
+    struct ble_gap_adv_params adv_params = {0};
+    adv_params.itvl_min = 0x0808; // advertising happens every 0x0808 * 0.625ms = 1285ms
+    adv_params.itvl_max = 0x0808; // advertising happens every 0x0808 * 0.625ms = 1285ms
+#if CONFIG_BLE_BROADCAST_MODE
+    adv_params.conn_mode = BLE_GAP_CONN_MODE_NON;
+    adv_params.disc_mode = BLE_GAP_DISC_MODE_NON;
+#else
+    adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+    adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+#endif
+    int rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &adv_params, gap_event_handler, NULL);
+    if (rc == 0)
+    {
+        boot_profile_mark(BOOT_PHASE_ADVERTISING);
+    }
+    else if (rc != BLE_HS_EALREADY)
+    {
+        IFERR_LOG(err_from_rc(rc), "start advertising failed, rc %d", rc);
+    }
+}
+
+/*
+ * err_from_rc maps the return codes of NimBLE to esp_err_t, for IFERR_* to report them.
+ */
+static esp_err_t err_from_rc(int rc)
+{
+    switch (rc)
+    {
+    case 0:
+        return ESP_OK;
+    case BLE_HS_EINVAL:
+        return ESP_ERR_INVALID_ARG;
+    case BLE_HS_ENOMEM:
+        return ESP_ERR_NO_MEM;
+    case BLE_HS_ENOTCONN:
+        return ESP_ERR_NOT_FOUND;
+    case BLE_HS_EALREADY:
+    case BLE_HS_EBUSY:
+        return ESP_ERR_INVALID_STATE;
+    case BLE_HS_ETIMEOUT:
+        return ESP_ERR_TIMEOUT;
+    default:
+        return ESP_FAIL;
+    }
+}
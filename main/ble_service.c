@@ -0,0 +1,717 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "ble_service.h"
+
+#include "store_float_into_uint8_arr.h"
+#include "store_stats_into_uint8_arr.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define ESP_LOG_TAG "ENVI_SENSOR_BLE"
+#include "iferr.h"
+
+#define CONN_POLICY_TICK_MS 1000 // how often idle connections are checked
+
+/* ES Measurement descriptor: flags, sampling function (instantaneous), measurement period (not in use),
+ *   update interval in seconds, application (air) and measurement uncertainty (in steps of 0.5 %) */
+#define ES_MEASUREMENT_UPDATE_INTERVAL_S (CONFIG_READ_SENSOR_FREQUENCY_MS / 1000)
+#define ES_MEASUREMENT(uncertainty)                                                                                    \
+    {                                                                                                                  \
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, ES_MEASUREMENT_UPDATE_INTERVAL_S & 0xFF,                                   \
+            (ES_MEASUREMENT_UPDATE_INTERVAL_S >> 8) & 0xFF, (ES_MEASUREMENT_UPDATE_INTERVAL_S >> 16) & 0xFF, 0x01,     \
+            uncertainty                                                                                                \
+    }
+#define ES_MEASUREMENT_UNCERTAINTY_UNKNOWN 0xFF
+#define ES_MEASUREMENT_UPDATE_INTERVAL_OFFSET 6
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+/* A value served on reads */
+typedef struct
+{
+    uint8_t *value;
+    uint16_t len;
+} charact_value_t;
+
+/* Last readings written with ble_write_readings */
+typedef struct
+{
+    float temperature;
+    float humidity;
+    uint16_t seq;
+    uint32_t timestamp_ms;
+    bool valid; // false until the first reading
+} readings_t;
+
+/* Maps a characteristic with trigger settings to its notifications */
+typedef struct
+{
+    ble_service_notify_t notify_charact;
+    bool is_signed;
+} ess_attrs_t;
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static void write_charact_value(uint8_t *charact_value, const uint8_t *value, size_t len);
+
+static void notify_subscribers(ble_service_notify_t charact, const uint8_t *value, size_t len);
+
+static void notify_on_trigger(ble_service_ess_t charact, const uint8_t value[2]);
+
+static void update_readings_charact_value(void);
+
+static void update_es_measurement_interval(uint8_t es_measurement[BLE_SERVICE_ES_MEASUREMENT_LEN],
+                                           uint32_t read_period_ms);
+
+static uint32_t get_now_ms(void);
+
+static void conn_policy_timer_callback(TimerHandle_t timer);
+
+static void conn_policy_request_params(uint16_t conn_id);
+
+static void log_conn_metrics(const ble_conn_t *conn);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+/*
+ * Connection
+ */
+
+static const ble_conn_policy_config_t conn_policy_config = {
+    .fast_interval_ms = CONFIG_BLE_CONN_FAST_INTERVAL_MS,
+    .relaxed_interval_ms = CONFIG_BLE_CONN_RELAXED_INTERVAL_MS,
+    .relaxed_latency = CONFIG_BLE_CONN_RELAXED_LATENCY,
+    .idle_timeout_ms = CONFIG_BLE_CONN_IDLE_TIMEOUT_MS,
+};
+
+/* conns_lock guards conns, updated by the BT host task, the timer task and the application when notifying */
+static ble_conn_t conns_[CONFIG_BLE_MAX_CONNECTIONS];
+static ble_conn_table_t conns;
+static portMUX_TYPE conns_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* conn_policy_timer relaxes the connection parameters once the client stops exchanging data */
+static TimerHandle_t conn_policy_timer = NULL;
+
+/*
+ * Service and Characteristics
+ */
+
+/* temperature_charact_value and humidity_charact_value hold the last temperature and
+ *   humidity reading, respectively */
+static uint8_t temperature_charact_value[2];
+static uint8_t humidity_charact_value[2];
+
+/* stats_charact_value holds the statistics for every window */
+static uint8_t stats_charact_value[BLE_SERVICE_STATS_LEN];
+
+/* Metrics derived from the last temperature and humidity reading */
+static uint8_t dew_point_charact_value[1];
+static uint8_t heat_index_charact_value[1];
+static uint8_t absolute_humidity_charact_value[2];
+
+/* readings_charact_value holds temperature and humidity of the same sample, its sequence number and age;
+ *   the age is updated from last_readings on every read */
+static uint8_t readings_charact_value[STORE_READINGS_LEN];
+
+static readings_t last_readings = {.temperature = NAN, .humidity = NAN};
+
+/* settings_charact_value holds the settings in use, written with ble_write_settings */
+static uint8_t settings_charact_value[BLE_SERVICE_SETTINGS_LEN];
+
+/* settings_handler applies the settings written by the clients */
+static ble_settings_handler_t settings_handler = NULL;
+
+/* The initial value of each characteristic is 'value is not known' */
+static const uint8_t temperature_charact_unknown_value[2] = {0x00, 0x80};
+static const uint8_t humidity_charact_unknown_value[2] = {0xFF, 0xFF};
+static const uint8_t absolute_humidity_charact_unknown_value[2] = {0xFF, 0xFF};
+
+/* The sensor is the SHT21: humidity accuracy is ±2 %RH, temperature accuracy isn't relative to the value;
+ *   the update interval follows the read period, see ble_write_settings */
+static uint8_t temperature_es_measurement[BLE_SERVICE_ES_MEASUREMENT_LEN] =
+    ES_MEASUREMENT(ES_MEASUREMENT_UNCERTAINTY_UNKNOWN);
+static uint8_t humidity_es_measurement[BLE_SERVICE_ES_MEASUREMENT_LEN] = ES_MEASUREMENT(4);
+
+/* charact_values_lock guards the values, written by the application and read by the BT host task */
+static portMUX_TYPE charact_values_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const charact_value_t charact_values[BLE_SERVICE_VALUE_COUNT] = {
+    [BLE_SERVICE_VALUE_TEMPERATURE] = {temperature_charact_value, sizeof(temperature_charact_value)},
+    [BLE_SERVICE_VALUE_TEMPERATURE_ES_MEASUREMENT] = {temperature_es_measurement, sizeof(temperature_es_measurement)},
+    [BLE_SERVICE_VALUE_HUMIDITY] = {humidity_charact_value, sizeof(humidity_charact_value)},
+    [BLE_SERVICE_VALUE_HUMIDITY_ES_MEASUREMENT] = {humidity_es_measurement, sizeof(humidity_es_measurement)},
+    [BLE_SERVICE_VALUE_STATS] = {stats_charact_value, sizeof(stats_charact_value)},
+    [BLE_SERVICE_VALUE_DEW_POINT] = {dew_point_charact_value, sizeof(dew_point_charact_value)},
+    [BLE_SERVICE_VALUE_HEAT_INDEX] = {heat_index_charact_value, sizeof(heat_index_charact_value)},
+    [BLE_SERVICE_VALUE_ABSOLUTE_HUMIDITY] = {absolute_humidity_charact_value, sizeof(absolute_humidity_charact_value)},
+    [BLE_SERVICE_VALUE_READINGS] = {readings_charact_value, sizeof(readings_charact_value)},
+    [BLE_SERVICE_VALUE_SETTINGS] = {settings_charact_value, sizeof(settings_charact_value)},
+};
+
+static const ess_attrs_t ess_attrs[BLE_SERVICE_ESS_COUNT] = {
+    [BLE_SERVICE_ESS_TEMPERATURE] = {BLE_SERVICE_NOTIFY_TEMPERATURE, true},
+    [BLE_SERVICE_ESS_HUMIDITY] = {BLE_SERVICE_NOTIFY_HUMIDITY, false},
+};
+
+/* Trigger settings written by the clients, and the last notified value of each characteristic */
+static ess_trigger_set_t ess_trigger_sets[BLE_SERVICE_ESS_COUNT];
+static portMUX_TYPE ess_trigger_sets_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void ble_service_init(ble_settings_handler_t settings_handler_)
+{
+    settings_handler = settings_handler_;
+    memcpy(temperature_charact_value, temperature_charact_unknown_value, sizeof(temperature_charact_value));
+    memcpy(humidity_charact_value, humidity_charact_unknown_value, sizeof(humidity_charact_value));
+    memcpy(absolute_humidity_charact_value, absolute_humidity_charact_unknown_value,
+           sizeof(absolute_humidity_charact_value));
+    update_readings_charact_value();
+    stats_t no_stats = {0};
+    for (size_t i = 0; i < BLE_STATS_WINDOW_COUNT; i++)
+    {
+        ble_write_stats(i, 0, &no_stats, &no_stats);
+    }
+
+    conns = ble_conn_table_init(conns_, CONFIG_BLE_MAX_CONNECTIONS);
+    for (ble_service_ess_t charact = 0; charact < BLE_SERVICE_ESS_COUNT; charact++)
+    {
+        ess_trigger_set_init(&ess_trigger_sets[charact]);
+    }
+    conn_policy_timer =
+        xTimerCreate("conn_policy", CONN_POLICY_TICK_MS / portTICK_PERIOD_MS, pdTRUE, NULL, conn_policy_timer_callback);
+    assert(conn_policy_timer);
+}
+
+void ble_service_stop(void)
+{
+    xTimerStop(conn_policy_timer, portMAX_DELAY);
+}
+
+uint16_t ble_service_read_value(ble_service_value_t value, uint8_t dst[BLE_SERVICE_VALUE_MAX_LEN])
+{
+    if (value == BLE_SERVICE_VALUE_READINGS)
+    {
+        update_readings_charact_value();
+    }
+    uint16_t len = charact_values[value].len;
+    portENTER_CRITICAL(&charact_values_lock);
+    memcpy(dst, charact_values[value].value, len);
+    portEXIT_CRITICAL(&charact_values_lock);
+    return len;
+}
+
+uint16_t ble_service_read_ess_descriptor(ble_service_ess_t charact, size_t descriptor,
+                                         uint8_t dst[ESS_TRIGGER_MAX_LEN])
+{
+    if (descriptor == BLE_SERVICE_ESS_CONFIGURATION)
+    {
+        portENTER_CRITICAL(&ess_trigger_sets_lock);
+        dst[0] = ess_trigger_sets[charact].logic;
+        portEXIT_CRITICAL(&ess_trigger_sets_lock);
+        return 1;
+    }
+    portENTER_CRITICAL(&ess_trigger_sets_lock);
+    ess_trigger_t trigger = ess_trigger_sets[charact].triggers[descriptor];
+    portEXIT_CRITICAL(&ess_trigger_sets_lock);
+    return ess_trigger_encode(&trigger, dst);
+}
+
+uint8_t ble_service_write_ess_descriptor(uint16_t conn_id, ble_service_ess_t charact, size_t descriptor,
+                                         const uint8_t *value, uint16_t len)
+{
+    const ess_attrs_t *attrs = &ess_attrs[charact];
+    if (descriptor == BLE_SERVICE_ESS_CONFIGURATION)
+    {
+        uint8_t logic = len == 1 ? value[0] : 0xFF;
+        if (logic != ESS_TRIGGER_LOGIC_AND && logic != ESS_TRIGGER_LOGIC_OR)
+        {
+            return BLE_SERVICE_ATT_ERR_ESS_WRITE_REQUEST_REJECTED;
+        }
+        ESP_LOGI(ESP_LOG_TAG, "conn_id %d set logic %d of characteristic %d", conn_id, logic, attrs->notify_charact);
+        portENTER_CRITICAL(&ess_trigger_sets_lock);
+        ess_trigger_sets[charact].logic = logic;
+        portEXIT_CRITICAL(&ess_trigger_sets_lock);
+        return 0;
+    }
+    ess_trigger_t trigger;
+    esp_err_t err = ess_trigger_parse(value, len, attrs->is_signed, &trigger);
+    if (err != ESP_OK)
+    {
+        return err == ESP_ERR_NOT_SUPPORTED ? BLE_SERVICE_ATT_ERR_ESS_CONDITION_NOT_SUPPORTED
+                                            : BLE_SERVICE_ATT_ERR_ESS_WRITE_REQUEST_REJECTED;
+    }
+    ESP_LOGI(ESP_LOG_TAG, "conn_id %d set trigger %d of characteristic %d to condition %d", conn_id, (int)descriptor,
+             attrs->notify_charact, trigger.condition);
+    portENTER_CRITICAL(&ess_trigger_sets_lock);
+    ess_trigger_sets[charact].triggers[descriptor] = trigger;
+    portEXIT_CRITICAL(&ess_trigger_sets_lock);
+    return 0;
+}
+
+uint8_t ble_service_write_settings(uint16_t conn_id, const uint8_t *value, uint16_t len)
+{
+    if (len != BLE_SERVICE_SETTINGS_LEN)
+    {
+        return BLE_SERVICE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    uint32_t read_period_ms = value[0] | value[1] << 8 | value[2] << 16 | (uint32_t)value[3] << 24;
+    uint32_t history_len = value[4] | value[5] << 8;
+    ESP_LOGI(ESP_LOG_TAG, "conn_id %d set period %u ms, history %u", conn_id, (unsigned)read_period_ms,
+             (unsigned)history_len);
+    esp_err_t err = settings_handler ? settings_handler(read_period_ms, history_len) : ESP_ERR_NOT_SUPPORTED;
+    if (err == ESP_OK)
+    {
+        return 0;
+    }
+    return err == ESP_ERR_INVALID_ARG ? BLE_SERVICE_ATT_ERR_OUT_OF_RANGE : BLE_SERVICE_ATT_ERR_UNLIKELY;
+}
+
+esp_err_t ble_service_on_connect(uint16_t conn_id, const uint8_t remote_bda[6], size_t *conns_count)
+{
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_add(&conns, conn_id, remote_bda);
+    if (conn)
+    {
+        ble_conn_policy_init(&conn->policy, &conn_policy_config, get_now_ms());
+    }
+    *conns_count = ble_conn_table_count(&conns);
+    portEXIT_CRITICAL(&conns_lock);
+    if (conn == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    // service discovery is about to start: fast parameters first, relaxed once the client is idle
+    conn_policy_request_params(conn_id);
+    xTimerStart(conn_policy_timer, 0);
+    return ESP_OK;
+}
+
+esp_err_t ble_service_on_disconnect(uint16_t conn_id, bool *was_full)
+{
+    ble_conn_t conn_copy;
+    portENTER_CRITICAL(&conns_lock);
+    *was_full = ble_conn_table_count(&conns) == CONFIG_BLE_MAX_CONNECTIONS;
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    if (conn)
+    {
+        conn_copy = *conn;
+        ble_conn_table_remove(&conns, conn_id);
+    }
+    size_t conns_count = ble_conn_table_count(&conns);
+    portEXIT_CRITICAL(&conns_lock);
+    if (conn == NULL)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    log_conn_metrics(&conn_copy);
+    if (conns_count == 0)
+    {
+        xTimerStop(conn_policy_timer, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t ble_service_find_conn_id(const uint8_t remote_bda[6], uint16_t *conn_id)
+{
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find_by_bda(&conns, remote_bda);
+    if (conn)
+    {
+        *conn_id = conn->conn_id;
+    }
+    portEXIT_CRITICAL(&conns_lock);
+    return conn ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void ble_service_on_traffic(uint16_t conn_id, size_t bytes)
+{
+    bool speed_up = false;
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    if (conn)
+    {
+        speed_up = ble_conn_policy_on_traffic(&conn->policy, get_now_ms(), bytes);
+    }
+    portEXIT_CRITICAL(&conns_lock);
+    if (speed_up)
+    {
+        ESP_LOGI(ESP_LOG_TAG, "conn_id %d is active, request fast connection parameters", conn_id);
+        conn_policy_request_params(conn_id);
+    }
+}
+
+void ble_service_on_params_updated(uint16_t conn_id, uint16_t interval, uint16_t latency)
+{
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    if (conn)
+    {
+        ble_conn_policy_on_params_updated(&conn->policy, get_now_ms(), interval, latency);
+    }
+    portEXIT_CRITICAL(&conns_lock);
+}
+
+void ble_service_on_mtu(uint16_t conn_id, uint16_t mtu)
+{
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    if (conn)
+    {
+        conn->mtu = mtu;
+    }
+    portEXIT_CRITICAL(&conns_lock);
+    ble_service_on_traffic(conn_id, 0);
+}
+
+uint16_t ble_service_get_mtu(uint16_t conn_id)
+{
+    uint16_t mtu = BLE_CONN_TABLE_DEFAULT_MTU;
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    if (conn)
+    {
+        mtu = conn->mtu;
+    }
+    portEXIT_CRITICAL(&conns_lock);
+    return mtu;
+}
+
+void ble_service_on_congestion(uint16_t conn_id, bool congested)
+{
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    if (conn)
+    {
+        conn->congested = congested;
+    }
+    portEXIT_CRITICAL(&conns_lock);
+}
+
+esp_err_t ble_service_set_subscription(uint16_t conn_id, ble_service_notify_t charact, bool enabled)
+{
+    ESP_LOGI(ESP_LOG_TAG, "conn_id %d %s notifications of characteristic %d", conn_id,
+             enabled ? "enabled" : "disabled", charact);
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    if (conn)
+    {
+        conn->subscriptions &= ~(1UL << charact);
+        conn->subscriptions |= (uint32_t)enabled << charact;
+    }
+    portEXIT_CRITICAL(&conns_lock);
+    return conn ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+bool ble_service_is_subscribed(uint16_t conn_id, ble_service_notify_t charact)
+{
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    bool enabled = conn && (conn->subscriptions & (1UL << charact));
+    portEXIT_CRITICAL(&conns_lock);
+    return enabled;
+}
+
+esp_err_t ble_write_temperature(float temperature)
+{
+    ESP_LOGD(ESP_LOG_TAG, "%s - write %f", __func__, temperature);
+    // See: GATT Specification Supplement Datasheet Page 223 Section 3.204
+    if (temperature < -273.15 || temperature > 327.67)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t value[2];
+    store_float_into_uint8_arr(&temperature, value);
+    write_charact_value(temperature_charact_value, value, sizeof(value));
+    notify_on_trigger(BLE_SERVICE_ESS_TEMPERATURE, value);
+    return ESP_OK;
+}
+
+esp_err_t ble_write_humidity(float humidity)
+{
+    ESP_LOGD(ESP_LOG_TAG, "%s - write %f", __func__, humidity);
+    // See: GATT Specification Supplement Datasheet Page 146 Section 3.114
+    if (humidity < 0.00 || humidity > 100.00)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t value[2];
+    store_float_into_uint8_arr(&humidity, value);
+    write_charact_value(humidity_charact_value, value, sizeof(value));
+    notify_on_trigger(BLE_SERVICE_ESS_HUMIDITY, value);
+    return ESP_OK;
+}
+
+esp_err_t ble_write_readings(float temperature, float humidity, uint32_t seq, uint32_t timestamp_ms)
+{
+    ESP_LOGD(ESP_LOG_TAG, "%s - write %f, %f, seq %u", __func__, temperature, humidity, (unsigned)seq);
+    portENTER_CRITICAL(&charact_values_lock);
+    last_readings.temperature = temperature;
+    last_readings.humidity = humidity;
+    last_readings.seq = seq;
+    last_readings.timestamp_ms = timestamp_ms;
+    last_readings.valid = true;
+    portEXIT_CRITICAL(&charact_values_lock);
+
+    update_readings_charact_value();
+    uint8_t value[STORE_READINGS_LEN];
+    portENTER_CRITICAL(&charact_values_lock);
+    memcpy(value, readings_charact_value, sizeof(value));
+    portEXIT_CRITICAL(&charact_values_lock);
+    notify_subscribers(BLE_SERVICE_NOTIFY_READINGS, value, sizeof(value));
+    return ESP_OK;
+}
+
+esp_err_t ble_write_stats(size_t window, uint32_t window_minutes, const stats_t *temperature, const stats_t *humidity)
+{
+    if (window >= BLE_STATS_WINDOW_COUNT || window_minutes > UINT16_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t window_value[BLE_SERVICE_STATS_WINDOW_LEN];
+    window_value[0] = window_minutes & 0xFF;
+    window_value[1] = window_minutes >> 8;
+    store_stats_into_uint8_arr(temperature, &window_value[2]);
+    store_stats_into_uint8_arr(humidity, &window_value[12]);
+
+    write_charact_value(&stats_charact_value[window * BLE_SERVICE_STATS_WINDOW_LEN], window_value,
+                        sizeof(window_value));
+    return ESP_OK;
+}
+
+esp_err_t ble_write_derived_metrics(const derived_metrics_t *metrics)
+{
+    ESP_LOGD(ESP_LOG_TAG, "%s - write dew point %f, heat index %f, absolute humidity %f", __func__,
+             metrics->dew_point, metrics->heat_index, metrics->absolute_humidity);
+    esp_err_t err = ESP_OK;
+    // See: GATT Specification Supplement Datasheet Section 3.67 (Dew Point) and 3.111 (Heat Index)
+    if (metrics->dew_point >= INT8_MIN && metrics->dew_point <= INT8_MAX)
+    {
+        uint8_t value = (uint8_t)(int8_t)lroundf(metrics->dew_point);
+        write_charact_value(dew_point_charact_value, &value, sizeof(value));
+    }
+    else
+    {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    if (metrics->heat_index >= INT8_MIN && metrics->heat_index <= INT8_MAX)
+    {
+        uint8_t value = (uint8_t)(int8_t)lroundf(metrics->heat_index);
+        write_charact_value(heat_index_charact_value, &value, sizeof(value));
+    }
+    else
+    {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    // Unsigned, with resolution of 0.01 g/m³, 0xFFFF represents 'value is not known'
+    if (metrics->absolute_humidity >= 0 && metrics->absolute_humidity < 655.35)
+    {
+        uint16_t centi = (uint16_t)lroundf(metrics->absolute_humidity * 100);
+        uint8_t value[2] = {centi & 0xFF, centi >> 8};
+        write_charact_value(absolute_humidity_charact_value, value, sizeof(value));
+    }
+    else
+    {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    return err;
+}
+
+esp_err_t ble_write_settings(uint32_t read_period_ms, uint32_t history_len)
+{
+    ESP_LOGD(ESP_LOG_TAG, "%s - write period %u ms, history %u", __func__, (unsigned)read_period_ms,
+             (unsigned)history_len);
+    if (history_len > UINT16_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t value[BLE_SERVICE_SETTINGS_LEN] = {
+        read_period_ms & 0xFF,         (read_period_ms >> 8) & 0xFF, (read_period_ms >> 16) & 0xFF,
+        (read_period_ms >> 24) & 0xFF, history_len & 0xFF,           history_len >> 8,
+    };
+    write_charact_value(settings_charact_value, value, sizeof(value));
+    update_es_measurement_interval(temperature_es_measurement, read_period_ms);
+    update_es_measurement_interval(humidity_es_measurement, read_period_ms);
+    return ESP_OK;
+}
+
+size_t ble_get_connections(ble_conn_t dst[], size_t capacity)
+{
+    size_t count = 0;
+    portENTER_CRITICAL(&conns_lock);
+    for (size_t i = 0; i < conns.capacity && count < capacity; i++)
+    {
+        if (conns.conns[i].in_use)
+        {
+            dst[count++] = conns.conns[i];
+        }
+    }
+    portEXIT_CRITICAL(&conns_lock);
+    return count;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static void write_charact_value(uint8_t *charact_value, const uint8_t *value, size_t len)
+{
+    portENTER_CRITICAL(&charact_values_lock);
+    memcpy(charact_value, value, len);
+    portEXIT_CRITICAL(&charact_values_lock);
+}
+
+/*
+ * notify_subscribers sends the value to every subscribed client, through the backend.
+ */
+static void notify_subscribers(ble_service_notify_t charact, const uint8_t *value, size_t len)
+{
+    ble_conn_target_t targets[CONFIG_BLE_MAX_CONNECTIONS];
+    portENTER_CRITICAL(&conns_lock);
+    size_t targets_len = ble_conn_table_select_targets(&conns, charact, len, targets);
+    portEXIT_CRITICAL(&conns_lock);
+
+    // the same encoded value is sent to every subscriber
+    for (size_t i = 0; i < targets_len; i++)
+    {
+        esp_err_t err = ble_service_backend_notify(targets[i].conn_id, charact, value, targets[i].len);
+        IFERR_LOG(err, "notify conn_id %d failed", targets[i].conn_id);
+        portENTER_CRITICAL(&conns_lock);
+        ble_conn_table_on_notify_result(&conns, targets[i].conn_id, err == ESP_OK);
+        portEXIT_CRITICAL(&conns_lock);
+    }
+}
+
+/*
+ * notify_on_trigger notifies the new value of the characteristic only if its trigger settings fire, so that
+ *   clients are notified as often as they asked for.
+ */
+static void notify_on_trigger(ble_service_ess_t charact, const uint8_t value[2])
+{
+    const ess_attrs_t *attrs = &ess_attrs[charact];
+    uint16_t raw = value[0] | value[1] << 8;
+    int32_t trigger_value = attrs->is_signed ? (int16_t)raw : raw;
+    uint32_t now_ms = get_now_ms();
+    portENTER_CRITICAL(&ess_trigger_sets_lock);
+    bool fired = ess_trigger_evaluate(&ess_trigger_sets[charact], trigger_value, now_ms);
+    portEXIT_CRITICAL(&ess_trigger_sets_lock);
+    if (fired)
+    {
+        notify_subscribers(attrs->notify_charact, value, 2);
+    }
+}
+
+/*
+ * update_readings_charact_value encodes last_readings with its current age into readings_charact_value.
+ */
+static void update_readings_charact_value(void)
+{
+    portENTER_CRITICAL(&charact_values_lock);
+    readings_t readings = last_readings;
+    portEXIT_CRITICAL(&charact_values_lock);
+
+    uint32_t age_s = readings.valid ? (get_now_ms() - readings.timestamp_ms) / 1000 : UINT32_MAX;
+    uint8_t value[STORE_READINGS_LEN];
+    store_readings_into_uint8_arr(readings.temperature, readings.humidity, readings.seq, age_s, value);
+    write_charact_value(readings_charact_value, value, sizeof(value));
+}
+
+/*
+ * update_es_measurement_interval sets the update interval of the ES Measurement descriptor to the read period.
+ */
+static void update_es_measurement_interval(uint8_t es_measurement[BLE_SERVICE_ES_MEASUREMENT_LEN],
+                                           uint32_t read_period_ms)
+{
+    uint32_t interval_s = read_period_ms / 1000;
+    uint8_t interval[3] = {interval_s & 0xFF, (interval_s >> 8) & 0xFF, (interval_s >> 16) & 0xFF};
+    write_charact_value(&es_measurement[ES_MEASUREMENT_UPDATE_INTERVAL_OFFSET], interval, sizeof(interval));
+}
+
+static uint32_t get_now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void conn_policy_timer_callback(TimerHandle_t timer)
+{
+    uint16_t relax_conn_ids[CONFIG_BLE_MAX_CONNECTIONS];
+    size_t relax_len = 0;
+    portENTER_CRITICAL(&conns_lock);
+    uint32_t now_ms = get_now_ms();
+    for (size_t i = 0; i < conns.capacity; i++)
+    {
+        if (conns.conns[i].in_use && ble_conn_policy_on_tick(&conns.conns[i].policy, now_ms))
+        {
+            relax_conn_ids[relax_len++] = conns.conns[i].conn_id;
+        }
+    }
+    portEXIT_CRITICAL(&conns_lock);
+    for (size_t i = 0; i < relax_len; i++)
+    {
+        ESP_LOGI(ESP_LOG_TAG, "conn_id %d is idle, request relaxed connection parameters", relax_conn_ids[i]);
+        conn_policy_request_params(relax_conn_ids[i]);
+    }
+}
+
+static void conn_policy_request_params(uint16_t conn_id)
+{
+    ble_conn_t conn_copy;
+    ble_conn_params_t params;
+    portENTER_CRITICAL(&conns_lock);
+    ble_conn_t *conn = ble_conn_table_find(&conns, conn_id);
+    if (conn)
+    {
+        conn_copy = *conn;
+        ble_conn_policy_get_params(&conn->policy, &params);
+    }
+    portEXIT_CRITICAL(&conns_lock);
+    if (conn == NULL)
+    {
+        return;
+    }
+    IFERR_LOG(ble_service_backend_update_conn_params(&conn_copy, &params), "update connection parameters failed");
+}
+
+/*
+ * log_conn_metrics logs, for each phase of the connection, the data needed to tune the connection policy,
+ *   followed by the notification counters.
+ */
+static void log_conn_metrics(const ble_conn_t *conn)
+{
+    static const char *phase_names[BLE_CONN_POLICY_PHASE_COUNT] = {"fast", "relaxed"};
+    ble_conn_policy_t policy = conn->policy;
+    uint32_t now_ms = get_now_ms();
+    for (ble_conn_policy_phase_t phase = 0; phase < BLE_CONN_POLICY_PHASE_COUNT; phase++)
+    {
+        ble_conn_policy_metrics_t metrics;
+        ble_conn_policy_get_metrics(&policy, now_ms, phase, &metrics);
+        ESP_LOGI(ESP_LOG_TAG,
+                 "conn_id %d, %s phase: entered %u times, %u ms, %u bytes, %.1f B/s, ~%.0f connection events, "
+                 "%.2f B/event",
+                 conn->conn_id, phase_names[phase], (unsigned)metrics.entered_count, (unsigned)metrics.duration_ms,
+                 (unsigned)metrics.bytes, metrics.throughput_bps, metrics.conn_events, metrics.bytes_per_event);
+    }
+    ESP_LOGI(ESP_LOG_TAG, "conn_id %d, notifications: %u sent, %u failed, %u skipped while congested", conn->conn_id,
+             (unsigned)conn->notify_counters.sent, (unsigned)conn->notify_counters.failed,
+             (unsigned)conn->notify_counters.skipped);
+}
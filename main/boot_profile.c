@@ -0,0 +1,106 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "boot_profile.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define ESP_LOG_TAG "ENVI_SENSOR_BOOT"
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static void log_profile(void);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+static const char *const phase_names[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_APP_MAIN] = "app_main",
+    [BOOT_PHASE_SETTINGS] = "settings",
+    [BOOT_PHASE_GPIO] = "gpio",
+    [BOOT_PHASE_LCD] = "lcd",
+    [BOOT_PHASE_SENSOR] = "sensor",
+    [BOOT_PHASE_TASKS] = "tasks",
+    [BOOT_PHASE_BLE] = "ble",
+    [BOOT_PHASE_FIRST_SAMPLE] = "first sample",
+    [BOOT_PHASE_ADVERTISING] = "advertising",
+};
+
+// zero until the phase is marked, esp_timer never reads zero by the time app_main runs
+static int64_t marks_us[BOOT_PHASE_COUNT];
+static size_t marks_count = 0;
+static portMUX_TYPE marks_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void boot_profile_mark(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_COUNT)
+    {
+        return;
+    }
+    const int64_t now_us = esp_timer_get_time();
+    bool complete = false;
+    portENTER_CRITICAL(&marks_lock);
+    if (marks_us[phase] == 0)
+    {
+        marks_us[phase] = now_us;
+        complete = ++marks_count == BOOT_PHASE_COUNT;
+    }
+    portEXIT_CRITICAL(&marks_lock);
+    if (complete)
+    {
+        log_profile();
+    }
+}
+
+int64_t boot_profile_get_us(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_COUNT)
+    {
+        return -1;
+    }
+    portENTER_CRITICAL(&marks_lock);
+    int64_t mark_us = marks_us[phase];
+    portEXIT_CRITICAL(&marks_lock);
+    return mark_us == 0 ? -1 : mark_us;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * log_profile logs when each phase ended, and how long it took after the phase before it.
+ * Phases run in parallel after BOOT_PHASE_TASKS, so their durations may be negative, meaning the phase ended
+ *   before the one listed above it.
+ */
+static void log_profile(void)
+{
+    int64_t previous_us = 0;
+    for (boot_phase_t phase = 0; phase < BOOT_PHASE_COUNT; phase++)
+    {
+        ESP_LOGI(ESP_LOG_TAG, "%-12s at %6u ms, took %+6d ms", phase_names[phase], (unsigned)(marks_us[phase] / 1000),
+                 (int)((marks_us[phase] - previous_us) / 1000));
+        previous_us = marks_us[phase];
+    }
+    ESP_LOGI(ESP_LOG_TAG, "time-to-first-sample %u ms, time-to-advertising %u ms",
+             (unsigned)(marks_us[BOOT_PHASE_FIRST_SAMPLE] / 1000), (unsigned)(marks_us[BOOT_PHASE_ADVERTISING] / 1000));
+}
@@ -4,13 +4,13 @@
 
 #include "button.h"
 
+#include "debug_trace.h"
 #include "envi_config.h"
 
+#include "driver/gpio.h"
 #include "esp_log.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
-#include "freertos/task.h"
-#include <assert.h>
+#include "esp_timer.h"
+#include <stdbool.h>
 
 //==================================================================================================
 // DEFINES - MACROS
@@ -19,7 +19,9 @@
 #define ESP_LOG_TAG "ENVI_SENSOR_BUTTON"
 #include "iferr.h"
 
-#define DEBOUNCE_DELAY_MS 500
+#define DEBOUNCE_MS 20      // longer than the bounces of the button, shorter than the fastest press
+#define LONG_PRESS_MS 800   // held at least this long, it's a long press
+#define DOUBLE_PRESS_MS 250 // pressed again within this long from the release, it's a double press
 
 //==================================================================================================
 // ENUMS - STRUCTS - TYPEDEFS
@@ -29,65 +31,129 @@
 // STATIC PROTOTYPES
 //==================================================================================================
 
-static void create_task_debounce_button(void);
+static void button_isr_handler(void *param);
 
-static void task_debounce_button(void *param);
+static void debounce_timer_callback(void *param);
+
+static void gesture_timer_callback(void *param);
+
+static void dispatch(button_event_t event);
+
+static bool is_pressed(void);
+
+static uint32_t now_ms(void);
 
 //==================================================================================================
 // STATIC VARIABLES
 //==================================================================================================
 
-// binsemaphore_button_debounce wakes the task responsible for re-enabling interrupts on button
-static SemaphoreHandle_t binsemaphore_button_debounce = NULL;
+static button_event_handler_t event_handler = NULL;
+
+// debounce_timer fires once the button settled, gesture_timer once the gesture in progress times out
+static esp_timer_handle_t debounce_timer = NULL;
+static esp_timer_handle_t gesture_timer = NULL;
+
+// only accessed from the timers' callbacks, which the esp_timer task runs one at a time
+static button_gesture_t gesture;
+static bool pressed = false;
 
 //==================================================================================================
 // GLOBAL FUNCTIONS
 //==================================================================================================
 
-esp_err_t button_init(gpio_isr_t isr_handler)
+esp_err_t button_init(button_event_handler_t event_handler_)
 {
+    event_handler = event_handler_;
+    button_gesture_init(&gesture, LONG_PRESS_MS, DOUBLE_PRESS_MS);
+
+    esp_timer_create_args_t debounce_timer_args = {.callback = debounce_timer_callback,
+                                                   .name = "button_debounce"};
+    IFERR_RETE(esp_timer_create(&debounce_timer_args, &debounce_timer), "failed to create debounce_timer");
+    esp_timer_create_args_t gesture_timer_args = {.callback = gesture_timer_callback, .name = "button_gesture"};
+    IFERR_RETE(esp_timer_create(&gesture_timer_args, &gesture_timer), "failed to create gesture_timer");
+
     gpio_config_t gpio_conf = {0};
-    gpio_conf.intr_type = GPIO_INTR_NEGEDGE;
+    gpio_conf.intr_type = GPIO_INTR_ANYEDGE;
     gpio_conf.pin_bit_mask = (1ULL << BUTTON_PIN);
     gpio_conf.mode = GPIO_MODE_INPUT;
     gpio_conf.pull_up_en = 1;
     IFERR_RETE(gpio_config(&gpio_conf), "failed button setup");
+    // a button held through boot only counts once released and pressed again
+    pressed = is_pressed();
 
     IFERR_RETE(gpio_install_isr_service(0), "failed to install isr_service");
-    IFERR_RETE(gpio_isr_handler_add(BUTTON_PIN, isr_handler, NULL), "failed to register isr_handler");
-
-    binsemaphore_button_debounce = xSemaphoreCreateBinary();
-    create_task_debounce_button();
+    IFERR_RETE(gpio_isr_handler_add(BUTTON_PIN, button_isr_handler, NULL), "failed to register isr_handler");
 
     return ESP_OK;
 }
 
-void button_debounce(void)
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * button_isr_handler ignores the following edges, the bounces, until debounce_timer fires.
+ */
+static void button_isr_handler(void *param)
 {
+    DEBUG_TRACE_ENTER(ISR);
     gpio_intr_disable(BUTTON_PIN);
-    xSemaphoreGiveFromISR(binsemaphore_button_debounce, NULL);
+    esp_timer_start_once(debounce_timer, DEBOUNCE_MS * 1000);
+    DEBUG_TRACE_EXIT(ISR);
 }
 
-//==================================================================================================
-// STATIC FUNCTIONS
-//==================================================================================================
+static void debounce_timer_callback(void *param)
+{
+    bool was_pressed = pressed;
+    pressed = is_pressed();
+    gpio_intr_enable(BUTTON_PIN);
+    // an edge between reading the level and enabling the interrupt would go unnoticed: look for it once more
+    if (is_pressed() != pressed)
+    {
+        gpio_intr_disable(BUTTON_PIN);
+        esp_timer_start_once(debounce_timer, DEBOUNCE_MS * 1000);
+    }
+    if (pressed == was_pressed)
+    {
+        return; // a glitch, shorter than DEBOUNCE_MS
+    }
+    uint32_t edge_ms = now_ms();
+    dispatch(pressed ? button_gesture_press(&gesture, edge_ms) : button_gesture_release(&gesture, edge_ms));
+}
 
-static void create_task_debounce_button(void)
+static void gesture_timer_callback(void *param)
 {
-    TaskHandle_t task_handle = NULL;
-    xTaskCreate(task_debounce_button, "task_debounce_button", TASK_STACK_DEPTH, NULL, TASK_PRIORITY_DEBOUNCE_BUTTON,
-                &task_handle);
-    assert(task_handle);
+    dispatch(button_gesture_timeout(&gesture, now_ms()));
 }
 
-static void task_debounce_button(void *param)
+/*
+ * dispatch reports event, if any, to the handler, and restarts gesture_timer for the timeout the gesture now
+ *   waits for.
+ */
+static void dispatch(button_event_t event)
 {
-    while (1)
+    if (event != BUTTON_EVENT_NONE)
     {
-        while (!xSemaphoreTake(binsemaphore_button_debounce, portMAX_DELAY))
-        {
-        }
-        vTaskDelay(DEBOUNCE_DELAY_MS / portTICK_PERIOD_MS);
-        gpio_intr_enable(BUTTON_PIN);
+        ESP_LOGD(ESP_LOG_TAG, "event %d", event);
+        event_handler(event);
     }
+    esp_timer_stop(gesture_timer);
+    uint32_t timeout_ms = button_gesture_timeout_ms(&gesture, now_ms());
+    if (timeout_ms != BUTTON_GESTURE_NO_TIMEOUT)
+    {
+        IFERR_LOG(esp_timer_start_once(gesture_timer, (uint64_t)timeout_ms * 1000), "failed to start gesture_timer");
+    }
+}
+
+/*
+ * is_pressed reads the button, wired in negative logic.
+ */
+static bool is_pressed(void)
+{
+    return gpio_get_level(BUTTON_PIN) == 0;
+}
+
+static uint32_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
 }
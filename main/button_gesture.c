@@ -0,0 +1,136 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "button_gesture.h"
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static void enter(button_gesture_t *gesture, button_gesture_state_t state, uint32_t now_ms);
+
+static uint32_t state_timeout_ms(const button_gesture_t *gesture);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void button_gesture_init(button_gesture_t *gesture, uint32_t long_press_ms, uint32_t double_press_ms)
+{
+    gesture->long_press_ms = long_press_ms;
+    gesture->double_press_ms = double_press_ms;
+    gesture->state = BUTTON_GESTURE_IDLE;
+    gesture->since_ms = 0;
+}
+
+button_event_t button_gesture_press(button_gesture_t *gesture, uint32_t now_ms)
+{
+    switch (gesture->state)
+    {
+    case BUTTON_GESTURE_IDLE:
+        enter(gesture, BUTTON_GESTURE_PRESSED, now_ms);
+        return BUTTON_EVENT_NONE;
+    case BUTTON_GESTURE_RELEASED:
+        if (now_ms - gesture->since_ms < gesture->double_press_ms)
+        {
+            enter(gesture, BUTTON_GESTURE_HELD, now_ms);
+            return BUTTON_EVENT_DOUBLE_PRESS;
+        }
+        // the timeout came late: the previous press was a short one, and this one starts a new gesture
+        enter(gesture, BUTTON_GESTURE_PRESSED, now_ms);
+        return BUTTON_EVENT_SHORT_PRESS;
+    default:
+        return BUTTON_EVENT_NONE;
+    }
+}
+
+button_event_t button_gesture_release(button_gesture_t *gesture, uint32_t now_ms)
+{
+    switch (gesture->state)
+    {
+    case BUTTON_GESTURE_PRESSED:
+        if (now_ms - gesture->since_ms >= gesture->long_press_ms)
+        {
+            enter(gesture, BUTTON_GESTURE_IDLE, now_ms);
+            return BUTTON_EVENT_LONG_PRESS;
+        }
+        if (gesture->double_press_ms == 0)
+        {
+            enter(gesture, BUTTON_GESTURE_IDLE, now_ms);
+            return BUTTON_EVENT_SHORT_PRESS;
+        }
+        enter(gesture, BUTTON_GESTURE_RELEASED, now_ms);
+        return BUTTON_EVENT_NONE;
+    case BUTTON_GESTURE_HELD:
+        enter(gesture, BUTTON_GESTURE_IDLE, now_ms);
+        return BUTTON_EVENT_NONE;
+    default:
+        return BUTTON_EVENT_NONE;
+    }
+}
+
+button_event_t button_gesture_timeout(button_gesture_t *gesture, uint32_t now_ms)
+{
+    if (button_gesture_timeout_ms(gesture, now_ms) != 0)
+    {
+        return BUTTON_EVENT_NONE;
+    }
+    if (gesture->state == BUTTON_GESTURE_PRESSED)
+    {
+        enter(gesture, BUTTON_GESTURE_HELD, now_ms);
+        return BUTTON_EVENT_LONG_PRESS;
+    }
+    enter(gesture, BUTTON_GESTURE_IDLE, now_ms);
+    return BUTTON_EVENT_SHORT_PRESS;
+}
+
+uint32_t button_gesture_timeout_ms(const button_gesture_t *gesture, uint32_t now_ms)
+{
+    uint32_t timeout_ms = state_timeout_ms(gesture);
+    if (timeout_ms == BUTTON_GESTURE_NO_TIMEOUT)
+    {
+        return BUTTON_GESTURE_NO_TIMEOUT;
+    }
+    // differences of times are right even if the clock wrapped around in between
+    uint32_t elapsed_ms = now_ms - gesture->since_ms;
+    return elapsed_ms < timeout_ms ? timeout_ms - elapsed_ms : 0;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static void enter(button_gesture_t *gesture, button_gesture_state_t state, uint32_t now_ms)
+{
+    gesture->state = state;
+    gesture->since_ms = now_ms;
+}
+
+/*
+ * state_timeout_ms returns how long the current state lasts without any edge, or BUTTON_GESTURE_NO_TIMEOUT.
+ */
+static uint32_t state_timeout_ms(const button_gesture_t *gesture)
+{
+    switch (gesture->state)
+    {
+    case BUTTON_GESTURE_PRESSED:
+        return gesture->long_press_ms;
+    case BUTTON_GESTURE_RELEASED:
+        return gesture->double_press_ms;
+    default:
+        return BUTTON_GESTURE_NO_TIMEOUT;
+    }
+}
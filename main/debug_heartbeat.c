@@ -50,7 +50,7 @@ esp_err_t debug_heartbeat_set(void)
 
 esp_err_t debug_heartbeat_reset(void)
 {
-    gpio_pin_level = 1;
+    gpio_pin_level = 0;
     return gpio_set_level(gpio_pin, gpio_pin_level);
 }
 
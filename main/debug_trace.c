@@ -0,0 +1,49 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "debug_trace.h"
+
+#include "driver/gpio.h"
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+esp_err_t debug_trace_init(void)
+{
+#if CONFIG_DEBUG_TRACE
+    gpio_config_t io_conf = {0};
+    io_conf.intr_type = GPIO_INTR_DISABLE;
+    io_conf.mode = GPIO_MODE_OUTPUT;
+    io_conf.pin_bit_mask = DEBUG_TRACE_MASK_I2C_READ | DEBUG_TRACE_MASK_QUEUE_SEND | DEBUG_TRACE_MASK_BLE_WRITE |
+                           DEBUG_TRACE_MASK_LCD_RENDER | DEBUG_TRACE_MASK_ISR;
+    io_conf.pull_down_en = 0;
+    io_conf.pull_up_en = 0;
+    esp_err_t err = gpio_config(&io_conf);
+    REG_WRITE(GPIO_OUT_W1TC_REG, io_conf.pin_bit_mask);
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
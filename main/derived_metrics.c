@@ -0,0 +1,168 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "derived_metrics.h"
+
+#include <math.h>
+#include <stddef.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define TABLE_MIN_TEMPERATURE -45
+#define TABLE_MAX_TEMPERATURE 85
+#define TABLE_LEN (TABLE_MAX_TEMPERATURE - TABLE_MIN_TEMPERATURE + 1)
+
+#define ZERO_CELSIUS_IN_KELVIN 273.15f
+#define WATER_VAPOR_GAS_CONSTANT_INV 216.7f // 1 / R_w in g K / (m³ hPa), with unit conversions
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static float celsius_to_fahrenheit(float celsius);
+
+static float fahrenheit_to_celsius(float fahrenheit);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+/* Saturation vapor pressure in hPa, for each °C from TABLE_MIN_TEMPERATURE to TABLE_MAX_TEMPERATURE */
+// clang-format off
+static const float saturation_vapor_pressure_table[TABLE_LEN] = {
+    0.11171f, 0.12452f, 0.13865f, 0.15423f, 0.17137f, 0.19021f, 0.21092f, 0.23364f,
+    0.25855f, 0.28584f, 0.31571f, 0.34836f, 0.38403f, 0.42297f, 0.46543f, 0.51169f,
+    0.56205f, 0.61683f, 0.67636f, 0.74102f, 0.81117f, 0.88723f, 0.96964f, 1.05885f,
+    1.15534f, 1.25965f, 1.37232f, 1.49392f, 1.62508f, 1.76645f, 1.91871f, 2.08259f,
+    2.25886f, 2.44833f, 2.65184f, 2.87031f, 3.10468f, 3.35593f, 3.62514f, 3.91339f,
+    4.22185f, 4.55173f, 4.90431f, 5.28093f, 5.68301f, 6.11200f, 6.56946f, 7.05700f,
+    7.57632f, 8.12918f, 8.71743f, 9.34300f, 10.00793f, 10.71430f, 11.46433f, 12.26030f,
+    13.10462f, 13.99976f, 14.94834f, 15.95306f, 17.01672f, 18.14226f, 19.33273f, 20.59129f,
+    21.92122f, 23.32596f, 24.80904f, 26.37415f, 28.02511f, 29.76588f, 31.60057f, 33.53343f,
+    35.56889f, 37.71149f, 39.96598f, 42.33724f, 44.83033f, 47.45050f, 50.20314f, 53.09386f,
+    56.12842f, 59.31279f, 62.65314f, 66.15581f, 69.82737f, 73.67458f, 77.70442f, 81.92406f,
+    86.34094f, 90.96266f, 95.79710f, 100.85234f, 106.13672f, 111.65880f, 117.42740f, 123.45158f,
+    129.74067f, 136.30424f, 143.15214f, 150.29448f, 157.74163f, 165.50428f, 173.59335f, 182.02007f,
+    190.79598f, 199.93287f, 209.44289f, 219.33843f, 229.63224f, 240.33735f, 251.46714f, 263.03529f,
+    275.05581f, 287.54305f, 300.51169f, 313.97675f, 327.95361f, 342.45797f, 357.50593f, 373.11389f,
+    389.29867f, 406.07743f, 423.46769f, 441.48737f, 460.15477f, 479.48855f, 499.50778f, 520.23192f,
+    541.68084f, 563.87477f, 586.83439f,
+};
+// clang-format on
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void derived_metrics_compute(float temperature, float humidity, derived_metrics_t *dst)
+{
+    dst->dew_point = derived_metrics_dew_point(temperature, humidity);
+    dst->absolute_humidity = derived_metrics_absolute_humidity(temperature, humidity);
+    dst->heat_index = derived_metrics_heat_index(temperature, humidity);
+}
+
+float derived_metrics_saturation_vapor_pressure(float temperature)
+{
+    if (!(temperature > TABLE_MIN_TEMPERATURE))
+    {
+        return saturation_vapor_pressure_table[0];
+    }
+    if (temperature >= TABLE_MAX_TEMPERATURE)
+    {
+        return saturation_vapor_pressure_table[TABLE_LEN - 1];
+    }
+    float position = temperature - TABLE_MIN_TEMPERATURE;
+    size_t idx = (size_t)position;
+    float fraction = position - idx;
+    float lower = saturation_vapor_pressure_table[idx];
+    float upper = saturation_vapor_pressure_table[idx + 1];
+    return lower + fraction * (upper - lower);
+}
+
+/*
+ * The dew point is the temperature whose saturation vapor pressure equals the actual vapor pressure,
+ *   found by binary search in the (strictly increasing) table, then linearly interpolated.
+ */
+float derived_metrics_dew_point(float temperature, float humidity)
+{
+    float vapor_pressure = humidity / 100 * derived_metrics_saturation_vapor_pressure(temperature);
+    if (!(vapor_pressure > saturation_vapor_pressure_table[0]))
+    {
+        return TABLE_MIN_TEMPERATURE;
+    }
+    if (vapor_pressure >= saturation_vapor_pressure_table[TABLE_LEN - 1])
+    {
+        return TABLE_MAX_TEMPERATURE;
+    }
+    size_t lo = 0;
+    size_t hi = TABLE_LEN - 1;
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (saturation_vapor_pressure_table[mid] <= vapor_pressure)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    float lower = saturation_vapor_pressure_table[lo];
+    float upper = saturation_vapor_pressure_table[hi];
+    return TABLE_MIN_TEMPERATURE + (float)lo + (vapor_pressure - lower) / (upper - lower);
+}
+
+float derived_metrics_absolute_humidity(float temperature, float humidity)
+{
+    float vapor_pressure = humidity / 100 * derived_metrics_saturation_vapor_pressure(temperature);
+    return WATER_VAPOR_GAS_CONSTANT_INV * vapor_pressure / (ZERO_CELSIUS_IN_KELVIN + temperature);
+}
+
+/*
+ * See: https://www.wpc.ncep.noaa.gov/html/heatindex_equation.shtml
+ */
+float derived_metrics_heat_index(float temperature, float humidity)
+{
+    float t = celsius_to_fahrenheit(temperature);
+    float rh = humidity;
+    float simple = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + rh * 0.094f);
+    if ((simple + t) / 2 < 80.0f)
+    {
+        return fahrenheit_to_celsius(simple);
+    }
+
+    float hi = -42.379f + 2.04901523f * t + 10.14333127f * rh - 0.22475541f * t * rh - 0.00683783f * t * t -
+               0.05481717f * rh * rh + 0.00122874f * t * t * rh + 0.00085282f * t * rh * rh -
+               0.00000199f * t * t * rh * rh;
+    if (rh < 13.0f && t >= 80.0f && t <= 112.0f)
+    {
+        hi -= (13.0f - rh) / 4 * sqrtf((17.0f - fabsf(t - 95.0f)) / 17);
+    }
+    else if (rh > 85.0f && t >= 80.0f && t <= 87.0f)
+    {
+        hi += (rh - 85.0f) / 10 * ((87.0f - t) / 5);
+    }
+    return fahrenheit_to_celsius(hi);
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static float celsius_to_fahrenheit(float celsius)
+{
+    return celsius * 9 / 5 + 32;
+}
+
+static float fahrenheit_to_celsius(float fahrenheit)
+{
+    return (fahrenheit - 32) * 5 / 9;
+}
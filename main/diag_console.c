@@ -0,0 +1,395 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "diag_console.h"
+
+#include "ble.h"
+#include "envi_config.h"
+#include "float_batch.h"
+#include "lcd.h"
+#include "runtime_stats.h"
+#include "sensor_channel.h"
+
+#include "esp_console.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/queue.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define ESP_LOG_TAG "ENVI_SENSOR_DIAG_CONSOLE"
+#include "iferr.h"
+
+#define PROMPT "envi>"
+#define MAX_CMDLINE_LEN 64
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static int cmd_heap(int argc, char **argv);
+
+static int cmd_tasks(int argc, char **argv);
+
+static int cmd_queues(int argc, char **argv);
+
+static int cmd_store(int argc, char **argv);
+
+static int cmd_ble(int argc, char **argv);
+
+static int cmd_render(int argc, char **argv);
+
+static int cmd_sensor(int argc, char **argv);
+
+#if CONFIG_TASK_RUNTIME_STATS
+static int cmd_cpu(int argc, char **argv);
+#endif
+
+static int cmd_log_level(int argc, char **argv);
+
+static int cmd_period(int argc, char **argv);
+
+static int cmd_history(int argc, char **argv);
+
+static bool parse_log_level(const char *str, esp_log_level_t *dst);
+
+static bool parse_uint32(const char *str, uint32_t *dst);
+
+static void reduce_span(const float values[], size_t len, float_batch_reduction_t *dst, size_t *dst_len);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+static const diag_console_sources_t *sources = NULL;
+
+static const esp_console_cmd_t commands[] = {
+    {.command = "heap", .help = "Print free heap, its low-water mark and the largest free block", .func = cmd_heap},
+    {.command = "tasks", .help = "Print priority and stack high-water mark of the application tasks", .func = cmd_tasks},
+    {.command = "queues", .help = "Print depth and counters of the sample bus queues", .func = cmd_queues},
+    {.command = "store", .help = "Print fill level, time span and range of each channel of the sample store", .func = cmd_store},
+    {.command = "ble", .help = "Print state and notification counters of the BLE connections", .func = cmd_ble},
+    {.command = "render", .help = "Print how long the lcd views took to render", .func = cmd_render},
+    {.command = "sensor", .help = "Print sensor errors, retries and sample timing", .func = cmd_sensor},
+#if CONFIG_TASK_RUNTIME_STATS
+    {.command = "cpu", .help = "Print CPU usage of each task since the previous call", .func = cmd_cpu},
+#endif
+    {.command = "log_level",
+     .help = "Set the log level of a tag, or of all tags with *",
+     .hint = "<tag|*> <none|error|warn|info|debug|verbose>",
+     .func = cmd_log_level},
+    {.command = "period", .help = "Print the sensor period, or set and store it", .hint = "[ms]", .func = cmd_period},
+    {.command = "history",
+     .help = "Print the history length, or set and store it",
+     .hint = "[readings]",
+     .func = cmd_history},
+};
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+esp_err_t diag_console_start(const diag_console_sources_t *sources_)
+{
+    sources = sources_;
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = PROMPT;
+    repl_config.max_cmdline_length = MAX_CMDLINE_LEN;
+    repl_config.task_stack_size = TASK_STACK_DEPTH_DIAG_CONSOLE;
+    repl_config.task_priority = TASK_PRIORITY_DIAG_CONSOLE;
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    IFERR_RETE(esp_console_new_repl_uart(&uart_config, &repl_config, &repl), "failed to create the console");
+
+    IFERR_RETE(esp_console_register_help_command(), "failed to register the help command");
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+    {
+        IFERR_RETE(esp_console_cmd_register(&commands[i]), "failed to register command %s", commands[i].command);
+    }
+    IFERR_RETE(esp_console_start_repl(repl), "failed to start the console");
+    return ESP_OK;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static int cmd_heap(int argc, char **argv)
+{
+    printf("free %u, min free %u, largest block %u bytes\n", (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT),
+           (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+           (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    return 0;
+}
+
+static int cmd_tasks(int argc, char **argv)
+{
+    printf("%-28s %4s %6s\n", "task", "prio", "stack");
+    for (size_t i = 0; i < sources->tasks_len; i++)
+    {
+        const diag_console_task_t *task = &sources->tasks[i];
+        printf("%-28s %4u %6u\n", task->name, (unsigned)uxTaskPriorityGet(task->handle),
+               (unsigned)uxTaskGetStackHighWaterMark(task->handle));
+    }
+    printf("%u tasks running, including the ones of ESP-IDF\n", (unsigned)uxTaskGetNumberOfTasks());
+    return 0;
+}
+
+static int cmd_queues(int argc, char **argv)
+{
+    printf("%-8s %7s %9s %7s %4s\n", "queue", "waiting", "delivered", "dropped", "late");
+    for (size_t i = 0; i < sources->sample_bus->consumers_len; i++)
+    {
+        const sample_bus_consumer_t *consumer = &sources->sample_bus->consumers[i];
+        sample_bus_counters_t counters;
+        sample_bus_get_counters(consumer, &counters);
+        printf("%-8s %3u/%-3u %9u %7u %4u\n", consumer->name, (unsigned)uxQueueMessagesWaiting(consumer->queue),
+               (unsigned)consumer->depth, (unsigned)counters.delivered, (unsigned)counters.dropped,
+               (unsigned)counters.late);
+    }
+    return 0;
+}
+
+static int cmd_store(int argc, char **argv)
+{
+    const sample_store_t *store = sources->sample_store;
+    size_t capacity = sample_store_capacity(store);
+
+    // the history is reduced in place, and printed once the store is unlocked
+    float_batch_reduction_t reductions[SENSOR_CHANNEL_COUNT];
+    size_t lens[SENSOR_CHANNEL_COUNT] = {0};
+    uint32_t oldest_ms = 0;
+    uint32_t newest_ms = 0;
+    sample_store_span_t spans[2];
+    size_t count = sample_store_lock_spans(store, spans);
+    if (count > 0)
+    {
+        const sample_store_span_t *newest_span = spans[1].len > 0 ? &spans[1] : &spans[0];
+        oldest_ms = sample_store_span_timestamps(store, &spans[0])[0];
+        newest_ms = sample_store_span_timestamps(store, newest_span)[newest_span->len - 1];
+    }
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        for (size_t s = 0; s < 2; s++)
+        {
+            reduce_span(sample_store_span_values(store, &spans[s], id), spans[s].len, &reductions[id], &lens[id]);
+        }
+    }
+    sample_store_unlock_spans(store);
+
+    printf("%-8s %4u/%-4u\n", "records", (unsigned)count, (unsigned)capacity);
+    if (count > 0)
+    {
+        printf("%-8s %10u ms\n", "oldest", (unsigned)oldest_ms);
+        printf("%-8s %10u ms\n", "newest", (unsigned)newest_ms);
+    }
+    printf("%-8s %8s %8s %8s\n", "channel", "min", "mean", "max");
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        if (lens[id] > 0)
+        {
+            printf("%-8.8s %8.2f %8.2f %8.2f\n", sensor_channel_get_desc(id)->name, reductions[id].min,
+                   reductions[id].sum / lens[id], reductions[id].max);
+        }
+    }
+    return 0;
+}
+
+static int cmd_ble(int argc, char **argv)
+{
+    ble_conn_t conns[CONFIG_BLE_MAX_CONNECTIONS];
+    size_t count = ble_get_connections(conns, CONFIG_BLE_MAX_CONNECTIONS);
+    printf("%u of %u clients connected\n", (unsigned)count, (unsigned)CONFIG_BLE_MAX_CONNECTIONS);
+    for (size_t i = 0; i < count; i++)
+    {
+        const ble_conn_t *conn = &conns[i];
+        printf("conn %u: mtu %u, subscriptions 0x%08x, %s, %s, notify sent %u failed %u skipped %u\n",
+               (unsigned)conn->conn_id, (unsigned)conn->mtu, (unsigned)conn->subscriptions,
+               conn->congested ? "congested" : "not congested",
+               conn->policy.phase == BLE_CONN_POLICY_FAST ? "fast" : "relaxed", (unsigned)conn->notify_counters.sent,
+               (unsigned)conn->notify_counters.failed, (unsigned)conn->notify_counters.skipped);
+    }
+    return 0;
+}
+
+static int cmd_render(int argc, char **argv)
+{
+    lcd_render_timing_t timing;
+    lcd_get_render_timing(&timing);
+    printf("%u views rendered, last %u us, mean %u us, max %u us\n", (unsigned)timing.count,
+           (unsigned)timing.last_us, timing.count == 0 ? 0U : (unsigned)(timing.total_us / timing.count),
+           (unsigned)timing.max_us);
+    return 0;
+}
+
+static int cmd_sensor(int argc, char **argv)
+{
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        printf("%-16s %u errors\n", sensor_channel_get_desc(id)->name,
+               (unsigned)sensor_channel_get_error_count(id));
+    }
+
+    // static, as the console task is the only caller and the copy takes about 350 bytes
+    static sample_timing_t timing;
+    sources->get_sample_timing(&timing);
+    printf("%u readings, %u retries, %u given up\n", (unsigned)timing.samples, (unsigned)timing.retries,
+           (unsigned)timing.gave_up);
+    printf("lateness min %lld, mean %lld, max %lld us, %u later than %u us\n", (long long)timing.min_lateness_us,
+           (long long)sample_timing_mean_lateness_us(&timing), (long long)timing.max_lateness_us,
+           (unsigned)timing.missed_deadlines, (unsigned)timing.deadline_us);
+    for (size_t bin = 0, upper_bound_us = SAMPLE_TIMING_BIN0_US; bin < SAMPLE_TIMING_BINS; bin++, upper_bound_us *= 2)
+    {
+        if (bin < SAMPLE_TIMING_BINS - 1)
+        {
+            printf("  < %6u us: %u\n", (unsigned)upper_bound_us, (unsigned)timing.histogram[bin]);
+        }
+        else
+        {
+            printf(" >= %6u us: %u\n", (unsigned)(upper_bound_us / 2), (unsigned)timing.histogram[bin]);
+        }
+    }
+    return 0;
+}
+
+#if CONFIG_TASK_RUNTIME_STATS
+static int cmd_cpu(int argc, char **argv)
+{
+    return runtime_stats_log_window() == ESP_OK ? 0 : 1;
+}
+#endif
+
+static int cmd_log_level(int argc, char **argv)
+{
+    esp_log_level_t level;
+    if (argc != 3 || !parse_log_level(argv[2], &level))
+    {
+        printf("usage: log_level <tag|*> <none|error|warn|info|debug|verbose>\n");
+        return 1;
+    }
+    // levels above CONFIG_LOG_DEFAULT_LEVEL are accepted, but their messages aren't compiled in
+    esp_log_level_set(argv[1], level);
+    return 0;
+}
+
+static int cmd_period(int argc, char **argv)
+{
+    settings_t settings;
+    sources->get_settings(&settings);
+    if (argc == 1)
+    {
+        printf("%u ms\n", (unsigned)settings.read_period_ms);
+        return 0;
+    }
+    if (argc != 2 || !parse_uint32(argv[1], &settings.read_period_ms))
+    {
+        printf("usage: period [ms]\n");
+        return 1;
+    }
+    if (sources->set_settings(&settings) != ESP_OK)
+    {
+        printf("period must be between %u and %u ms\n", (unsigned)SETTINGS_READ_PERIOD_MIN_MS,
+               (unsigned)SETTINGS_READ_PERIOD_MAX_MS);
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_history(int argc, char **argv)
+{
+    settings_t settings;
+    sources->get_settings(&settings);
+    if (argc == 1)
+    {
+        printf("%u readings\n", (unsigned)settings.history_len);
+        return 0;
+    }
+    if (argc != 2 || !parse_uint32(argv[1], &settings.history_len))
+    {
+        printf("usage: history [readings]\n");
+        return 1;
+    }
+    if (sources->set_settings(&settings) != ESP_OK)
+    {
+        printf("history must be between %u and %u readings\n", (unsigned)SETTINGS_HISTORY_MIN_LEN,
+               (unsigned)SETTINGS_HISTORY_MAX_LEN);
+        return 1;
+    }
+    return 0;
+}
+
+static bool parse_log_level(const char *str, esp_log_level_t *dst)
+{
+    static const char *const names[] = {
+        [ESP_LOG_NONE] = "none",   [ESP_LOG_ERROR] = "error", [ESP_LOG_WARN] = "warn",
+        [ESP_LOG_INFO] = "info",   [ESP_LOG_DEBUG] = "debug", [ESP_LOG_VERBOSE] = "verbose",
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (strcmp(str, names[i]) == 0)
+        {
+            *dst = (esp_log_level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_uint32(const char *str, uint32_t *dst)
+{
+    char *end = NULL;
+    unsigned long value = strtoul(str, &end, 10);
+    if (end == str || *end != '\0' || str[0] == '-' || value > UINT32_MAX)
+    {
+        return false;
+    }
+    *dst = value;
+    return true;
+}
+
+/*
+ * reduce_span adds the values of a span of the sample store, skipping the NAN ones, to the reduction in dst of
+ *   *dst_len values so far, reducing each run of values in between with float_batch_reduce.
+ */
+static void reduce_span(const float values[], size_t len, float_batch_reduction_t *dst, size_t *dst_len)
+{
+    size_t begin = 0;
+    while (begin < len)
+    {
+        if (isnan(values[begin]))
+        {
+            begin++;
+            continue;
+        }
+        size_t end = begin + 1;
+        while (end < len && !isnan(values[end]))
+        {
+            end++;
+        }
+        float_batch_reduction_t run;
+        float_batch_reduce(values + begin, end - begin, &run);
+        if (*dst_len == 0)
+        {
+            *dst = run;
+        }
+        else
+        {
+            dst->min = run.min < dst->min ? run.min : dst->min;
+            dst->max = run.max > dst->max ? run.max : dst->max;
+            dst->sum += run.sum;
+        }
+        *dst_len += end - begin;
+        begin = end;
+    }
+}
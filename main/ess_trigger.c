@@ -0,0 +1,184 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "ess_trigger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define INTERVAL_LEN 3 // uint24, seconds
+#define VALUE_LEN 2    // sint16 or uint16, as the characteristic
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static bool evaluate_trigger(const ess_trigger_set_t *set, const ess_trigger_t *trigger, int32_t value,
+                             uint32_t now_ms);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void ess_trigger_set_init(ess_trigger_set_t *set)
+{
+    memset(set, 0, sizeof(*set));
+    set->triggers[0].condition = ESS_TRIGGER_ON_CHANGE;
+    set->logic = ESS_TRIGGER_LOGIC_AND;
+}
+
+esp_err_t ess_trigger_parse(const uint8_t *data, size_t len, bool is_signed, ess_trigger_t *dst)
+{
+    if (len == 0)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ess_trigger_t trigger = {.condition = data[0]};
+    switch (trigger.condition)
+    {
+    case ESS_TRIGGER_INACTIVE:
+        if (len != 1)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        break;
+    case ESS_TRIGGER_FIXED_INTERVAL:
+    case ESS_TRIGGER_MIN_INTERVAL:
+        if (len != 1 + INTERVAL_LEN)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        trigger.interval_s = data[1] | data[2] << 8 | (uint32_t)data[3] << 16;
+        break;
+    case ESS_TRIGGER_ON_CHANGE:
+        // the operand is optional, and must not be negative
+        if (len == 1)
+        {
+            break;
+        }
+        if (len != 1 + VALUE_LEN)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        trigger.operand = (uint16_t)(data[1] | data[2] << 8);
+        if (is_signed && trigger.operand > INT16_MAX)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        break;
+    case ESS_TRIGGER_LESS_THAN:
+    case ESS_TRIGGER_LESS_OR_EQUAL:
+    case ESS_TRIGGER_GREATER_THAN:
+    case ESS_TRIGGER_GREATER_OR_EQUAL:
+    case ESS_TRIGGER_EQUAL:
+    case ESS_TRIGGER_NOT_EQUAL:
+        if (len != 1 + VALUE_LEN)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint16_t operand = data[1] | data[2] << 8;
+        trigger.operand = is_signed ? (int16_t)operand : operand;
+        break;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    *dst = trigger;
+    return ESP_OK;
+}
+
+size_t ess_trigger_encode(const ess_trigger_t *trigger, uint8_t dst[ESS_TRIGGER_MAX_LEN])
+{
+    dst[0] = trigger->condition;
+    switch (trigger->condition)
+    {
+    case ESS_TRIGGER_INACTIVE:
+        return 1;
+    case ESS_TRIGGER_FIXED_INTERVAL:
+    case ESS_TRIGGER_MIN_INTERVAL:
+        dst[1] = trigger->interval_s & 0xFF;
+        dst[2] = (trigger->interval_s >> 8) & 0xFF;
+        dst[3] = (trigger->interval_s >> 16) & 0xFF;
+        return 1 + INTERVAL_LEN;
+    case ESS_TRIGGER_ON_CHANGE:
+        if (trigger->operand == 0)
+        {
+            return 1;
+        }
+        // fall through
+    default:
+        dst[1] = trigger->operand & 0xFF;
+        dst[2] = (trigger->operand >> 8) & 0xFF;
+        return 1 + VALUE_LEN;
+    }
+}
+
+bool ess_trigger_evaluate(ess_trigger_set_t *set, int32_t value, uint32_t now_ms)
+{
+    bool any_active = false;
+    bool notify = set->logic == ESS_TRIGGER_LOGIC_AND;
+    for (size_t i = 0; i < ESS_TRIGGER_MAX; i++)
+    {
+        const ess_trigger_t *trigger = &set->triggers[i];
+        if (trigger->condition == ESS_TRIGGER_INACTIVE)
+        {
+            continue;
+        }
+        any_active = true;
+        bool fired = evaluate_trigger(set, trigger, value, now_ms);
+        notify = set->logic == ESS_TRIGGER_LOGIC_AND ? notify && fired : notify || fired;
+    }
+    if (!any_active || !notify)
+    {
+        return false;
+    }
+    set->notified = true;
+    set->last_value = value;
+    set->last_ms = now_ms;
+    return true;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static bool evaluate_trigger(const ess_trigger_set_t *set, const ess_trigger_t *trigger, int32_t value,
+                             uint32_t now_ms)
+{
+    uint32_t elapsed_s = (now_ms - set->last_ms) / 1000;
+    switch (trigger->condition)
+    {
+    case ESS_TRIGGER_FIXED_INTERVAL:
+        return !set->notified || elapsed_s >= trigger->interval_s;
+    case ESS_TRIGGER_MIN_INTERVAL:
+        return !set->notified || (elapsed_s >= trigger->interval_s && value != set->last_value);
+    case ESS_TRIGGER_ON_CHANGE:
+        return !set->notified || abs(value - set->last_value) > trigger->operand;
+    case ESS_TRIGGER_LESS_THAN:
+        return value < trigger->operand;
+    case ESS_TRIGGER_LESS_OR_EQUAL:
+        return value <= trigger->operand;
+    case ESS_TRIGGER_GREATER_THAN:
+        return value > trigger->operand;
+    case ESS_TRIGGER_GREATER_OR_EQUAL:
+        return value >= trigger->operand;
+    case ESS_TRIGGER_EQUAL:
+        return value == trigger->operand;
+    case ESS_TRIGGER_NOT_EQUAL:
+        return value != trigger->operand;
+    default:
+        return false;
+    }
+}
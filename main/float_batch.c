@@ -0,0 +1,267 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "float_batch.h"
+
+#include "sdkconfig.h"
+#include <math.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define LANES 4 // the lanes are combined in float_batch_reduce as (0 + 1) + (2 + 3)
+
+#define QUANTIZED_MIN (INT16_MIN + 1) // INT16_MIN is reserved for NAN
+#define QUANTIZED_MAX INT16_MAX
+#define QUANTIZED_UNKNOWN INT16_MIN
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#define PIE_LANES 8  // int16 items in a 128-bit PIE register
+#define PIE_ALIGN 16 // PIE loads ignore the 4 least significant bits of the address
+#endif
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+// running reduction of int16 items: min and max start from the opposite ends of the range of the known items
+typedef struct
+{
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+    size_t len;
+} reduction_i16_t;
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static int16_t quantize(float item, float scale);
+
+static void reduction_i16_init(reduction_i16_t *reduction);
+
+static void reduction_i16_add(reduction_i16_t *reduction, const int16_t src[], size_t len);
+
+static size_t reduction_i16_get(const reduction_i16_t *reduction, float_batch_reduction_i16_t *dst);
+
+#if CONFIG_IDF_TARGET_ESP32S3
+static void reduction_i16_add_pie(reduction_i16_t *reduction, const int16_t src[], size_t blocks);
+#endif
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+size_t float_batch_reduce(const float src[], size_t len, float_batch_reduction_t *dst)
+{
+    if (len == 0)
+    {
+        return 0;
+    }
+    float mins[LANES];
+    float maxs[LANES];
+    float sums[LANES];
+    for (size_t l = 0; l < LANES; l++)
+    {
+        mins[l] = src[0];
+        maxs[l] = src[0];
+        sums[l] = 0;
+    }
+
+    size_t i = 0;
+    for (; i + LANES <= len; i += LANES)
+    {
+        for (size_t l = 0; l < LANES; l++)
+        {
+            float item = src[i + l];
+            mins[l] = item < mins[l] ? item : mins[l];
+            maxs[l] = item > maxs[l] ? item : maxs[l];
+            sums[l] += item;
+        }
+    }
+    // the tail goes into the first lanes, whose sums then hold one more item
+    for (size_t l = 0; i + l < len; l++)
+    {
+        float item = src[i + l];
+        mins[l] = item < mins[l] ? item : mins[l];
+        maxs[l] = item > maxs[l] ? item : maxs[l];
+        sums[l] += item;
+    }
+
+    dst->min = fminf(fminf(mins[0], mins[1]), fminf(mins[2], mins[3]));
+    dst->max = fmaxf(fmaxf(maxs[0], maxs[1]), fmaxf(maxs[2], maxs[3]));
+    dst->sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    return len;
+}
+
+void float_batch_quantize_i16(const float src[], size_t len, float scale, int16_t dst[])
+{
+    size_t i = 0;
+    for (; i + LANES <= len; i += LANES)
+    {
+        for (size_t l = 0; l < LANES; l++)
+        {
+            dst[i + l] = quantize(src[i + l], scale);
+        }
+    }
+    for (; i < len; i++)
+    {
+        dst[i] = quantize(src[i], scale);
+    }
+}
+
+size_t float_batch_reduce_i16(const int16_t src[], size_t len, float_batch_reduction_i16_t *dst)
+{
+#if CONFIG_IDF_TARGET_ESP32S3
+    // the items before the first aligned one, and after the last whole block, are reduced one at a time
+    size_t head = (PIE_ALIGN - (uintptr_t)src % PIE_ALIGN) % PIE_ALIGN / sizeof(int16_t);
+    head = head < len ? head : len;
+    size_t blocks = (len - head) / PIE_LANES;
+    size_t tail = head + blocks * PIE_LANES;
+
+    reduction_i16_t reduction;
+    reduction_i16_init(&reduction);
+    reduction_i16_add(&reduction, src, head);
+    reduction_i16_add_pie(&reduction, src + head, blocks);
+    reduction_i16_add(&reduction, src + tail, len - tail);
+    return reduction_i16_get(&reduction, dst);
+#else
+    return float_batch_reduce_i16_scalar(src, len, dst);
+#endif
+}
+
+size_t float_batch_reduce_i16_scalar(const int16_t src[], size_t len, float_batch_reduction_i16_t *dst)
+{
+    reduction_i16_t reduction;
+    reduction_i16_init(&reduction);
+    reduction_i16_add(&reduction, src, len);
+    return reduction_i16_get(&reduction, dst);
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * quantize saturates before rounding, so that lroundf never sees a value out of the range of long.
+ */
+static int16_t quantize(float item, float scale)
+{
+    float scaled = item * scale;
+    if (isnan(scaled))
+    {
+        return INT16_MIN;
+    }
+    if (scaled <= QUANTIZED_MIN)
+    {
+        return QUANTIZED_MIN;
+    }
+    if (scaled >= QUANTIZED_MAX)
+    {
+        return QUANTIZED_MAX;
+    }
+    return (int16_t)lroundf(scaled);
+}
+
+static void reduction_i16_init(reduction_i16_t *reduction)
+{
+    reduction->min = QUANTIZED_MAX;
+    reduction->max = QUANTIZED_MIN;
+    reduction->sum = 0;
+    reduction->len = 0;
+}
+
+static void reduction_i16_add(reduction_i16_t *reduction, const int16_t src[], size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        int16_t item = src[i];
+        if (item == QUANTIZED_UNKNOWN)
+        {
+            continue;
+        }
+        reduction->min = item < reduction->min ? item : reduction->min;
+        reduction->max = item > reduction->max ? item : reduction->max;
+        reduction->sum += item;
+        reduction->len++;
+    }
+}
+
+static size_t reduction_i16_get(const reduction_i16_t *reduction, float_batch_reduction_i16_t *dst)
+{
+    if (reduction->len > 0)
+    {
+        dst->min = reduction->min;
+        dst->max = reduction->max;
+        dst->sum = reduction->sum;
+    }
+    return reduction->len;
+}
+
+#if CONFIG_IDF_TARGET_ESP32S3
+/*
+ * reduction_i16_add_pie adds blocks of PIE_LANES items, starting from src aligned to PIE_ALIGN, without branching on
+ *   the unknown items: they're masked to INT16_MAX for the minimum and to 0 for the sum, while as INT16_MIN they never
+ *   raise the maximum, and they're counted lane by lane.
+ * The sum of each block is the dot product of its items with a vector of ones, accumulated into the 40-bit ACCX.
+ */
+static void reduction_i16_add_pie(reduction_i16_t *reduction, const int16_t src[], size_t blocks)
+{
+    if (blocks == 0)
+    {
+        return;
+    }
+    static const int16_t max_item = QUANTIZED_MAX;
+    static const int16_t unknown_item = QUANTIZED_UNKNOWN;
+    static const int16_t one = 1;
+    int16_t mins[PIE_LANES] __attribute__((aligned(PIE_ALIGN)));
+    int16_t maxs[PIE_LANES] __attribute__((aligned(PIE_ALIGN)));
+    int16_t unknowns[PIE_LANES] __attribute__((aligned(PIE_ALIGN)));
+    int32_t sum;
+    size_t len = blocks * PIE_LANES;
+
+    // q0 minimums, q1 maximums, q2 unknown items, q3 INT16_MIN, q4 ones, q5 block, q6 unknown mask, q7 masked block
+    __asm__ volatile("ee.zero.accx\n"
+                     "ee.zero.q q2\n"
+                     "ee.vldbc.16 q0, %[max_item]\n"
+                     "ee.vldbc.16 q1, %[unknown_item]\n"
+                     "ee.vldbc.16 q3, %[unknown_item]\n"
+                     "ee.vldbc.16 q4, %[one]\n"
+                     "1:\n"
+                     "ee.vld.128.ip q5, %[src], 16\n"
+                     "ee.vcmp.eq.s16 q6, q5, q3\n"
+                     "ee.vmax.s16 q1, q1, q5\n"
+                     "ee.vsubs.s16 q2, q2, q6\n" // the mask is -1 in the unknown lanes
+                     "ee.xorq q7, q5, q6\n"      // 0x8000 ^ 0xFFFF is INT16_MAX
+                     "ee.vmin.s16 q0, q0, q7\n"
+                     "ee.notq q6, q6\n"
+                     "ee.andq q7, q5, q6\n"
+                     "ee.vmulas.s16.accx q7, q4\n"
+                     "addi %[blocks], %[blocks], -1\n"
+                     "bnez %[blocks], 1b\n"
+                     "ee.vst.128.ip q0, %[mins], 0\n"
+                     "ee.vst.128.ip q1, %[maxs], 0\n"
+                     "ee.vst.128.ip q2, %[unknowns], 0\n"
+                     "rur.accx_0 %[sum]\n"
+                     : [src] "+r"(src), [blocks] "+r"(blocks), [sum] "=r"(sum)
+                     : [mins] "r"(mins), [maxs] "r"(maxs), [unknowns] "r"(unknowns), [max_item] "r"(&max_item),
+                       [unknown_item] "r"(&unknown_item), [one] "r"(&one)
+                     : "memory");
+
+    for (size_t l = 0; l < PIE_LANES; l++)
+    {
+        reduction->min = mins[l] < reduction->min ? mins[l] : reduction->min;
+        reduction->max = maxs[l] > reduction->max ? maxs[l] : reduction->max;
+        len -= unknowns[l];
+    }
+    reduction->sum += sum;
+    reduction->len += len;
+}
+#endif
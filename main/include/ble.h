@@ -1,11 +1,76 @@
 #pragma once
 
+#include "ble_adv_payload.h"
+#include "ble_conn_table.h"
+#include "derived_metrics.h"
+#include "stats.h"
+
 #include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
 
 #define BLE_DEVICE_NAME "Envi Sensor" // device name shown when advertising
+#define BLE_STATS_WINDOW_COUNT 3      // number of statistics windows exposed by the statistics characteristic
+
+/*
+ * ble_settings_handler_t takes the settings written by a client to the Settings characteristic.
+ * It runs in the BT host task, before the write is answered, so it must not block: it's expected to check the
+ *   settings and leave applying them to another task.
+ * It returns ESP_ERR_INVALID_ARG if any setting is out of range, so that the write is rejected.
+ */
+typedef esp_err_t (*ble_settings_handler_t)(uint32_t read_period_ms, uint32_t history_len);
+
+esp_err_t ble_init(ble_settings_handler_t settings_handler);
 
-esp_err_t ble_init(void);
+/*
+ * ble_stop disconnects the clients and powers the BT controller down, as required before deep sleep.
+ */
+esp_err_t ble_stop(void);
 
 esp_err_t ble_write_temperature(float temperature);
 
 esp_err_t ble_write_humidity(float humidity);
+
+/*
+ * ble_write_readings updates the Readings characteristic, holding temperature and humidity of the same sample, with
+ *   its sequence number and the time it was taken, in milliseconds since boot; subscribed clients are notified.
+ * Values that can't be represented are exposed as 'value is not known'.
+ */
+esp_err_t ble_write_readings(float temperature, float humidity, uint32_t seq, uint32_t timestamp_ms);
+
+/*
+ * ble_broadcast_readings advertises the readings in BTHome format, with a packet id incremented at every call.
+ * It returns ESP_ERR_NOT_SUPPORTED unless CONFIG_BLE_BROADCAST_MODE is enabled.
+ */
+esp_err_t ble_broadcast_readings(float temperature, float humidity);
+
+/*
+ * ble_broadcast_history replaces the data of the periodic advertising train with the given history.
+ * The packet id is assigned by this function, incremented at every call.
+ * It returns ESP_ERR_NOT_SUPPORTED unless CONFIG_BLE_PERIODIC_ADVERTISING is enabled.
+ */
+esp_err_t ble_broadcast_history(ble_adv_payload_history_t *history);
+
+/*
+ * ble_write_stats updates the statistics characteristic for the given window.
+ * Statistics with count 0 are exposed as 'value is not known'.
+ */
+esp_err_t ble_write_stats(size_t window, uint32_t window_minutes, const stats_t *temperature, const stats_t *humidity);
+
+/*
+ * ble_write_derived_metrics updates the dew point, heat index and absolute humidity characteristics.
+ * Values that can't be represented are left untouched, and ESP_ERR_INVALID_ARG is returned.
+ */
+esp_err_t ble_write_derived_metrics(const derived_metrics_t *metrics);
+
+/*
+ * ble_write_settings updates the Settings characteristic, and the update interval of the ES Measurement descriptors.
+ * It's called with the settings in use, both at boot and whenever they change.
+ */
+esp_err_t ble_write_settings(uint32_t read_period_ms, uint32_t history_len);
+
+/*
+ * ble_get_connections copies into dst the state of the connected clients, up to capacity of them.
+ * It returns the number of connections copied.
+ */
+size_t ble_get_connections(ble_conn_t dst[], size_t capacity);
@@ -0,0 +1,71 @@
+/*
+ * Encoders for advertising data carrying the readings, so that gateways can collect them without connecting:
+ *   - ble_adv_payload_bthome encodes the latest readings in BTHome v2 format (https://bthome.io/format/), with
+ *     the flags and the device name, ready to be passed to esp_ble_gap_config_adv_data_raw,
+ *   - ble_adv_payload_history encodes the most recent readings, their statistics and their range as service data,
+ *     ready to be passed to esp_ble_gap_config_periodic_adv_data_raw.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "ble_adv_payload.h"
+ *
+ * int main(void)
+ * {
+ *     uint8_t payload[BLE_ADV_PAYLOAD_MAX_LEN];
+ *     size_t len = ble_adv_payload_bthome(21.5, 48.25, 7, "Envi Sensor", payload);
+ *
+ *     uint8_t history_payload[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN];
+ *     stats_t no_stats = {0};
+ *     ble_adv_payload_history_t history = {.packet_id = 7,
+ *                                          .sample_period_s = 30,
+ *                                          .window_minutes = 15,
+ *                                          .temperature_stats = &no_stats,
+ *                                          .humidity_stats = &no_stats,
+ *                                          .temperatures = (float[]){21.5, 21.25},
+ *                                          .humidities = (float[]){48.25, 48.5},
+ *                                          .count = 2};
+ *     size_t history_len = ble_adv_payload_history(&history, history_payload);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "stats.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLE_ADV_PAYLOAD_MAX_LEN 31          // legacy advertising data can't be longer than 31 bytes
+#define BLE_ADV_PAYLOAD_HISTORY_MAX_LEN 252 // periodic advertising data fitting into a single HCI command
+#define BLE_ADV_PAYLOAD_HISTORY_MAX_COUNT 49 // readings fitting into BLE_ADV_PAYLOAD_HISTORY_MAX_LEN
+
+typedef struct
+{
+    uint8_t packet_id;        // must change with every new reading
+    uint16_t sample_period_s; // time between two readings
+    uint16_t window_minutes;  // length of the statistics window
+    const stats_t *temperature_stats;
+    const stats_t *humidity_stats;
+    const float *temperatures; // most recent readings, newest first
+    const float *humidities;
+    size_t count; // number of readings in temperatures and humidities
+} ble_adv_payload_history_t;
+
+/*
+ * ble_adv_payload_bthome writes the advertising data into dst.
+ * packet_id must change with every new reading, so that receivers can tell it from a retransmission.
+ * The device name is shortened if it doesn't fit into the remaining bytes.
+ * It returns the length of the payload, or 0 if temperature or humidity can't be represented.
+ */
+size_t ble_adv_payload_bthome(float temperature, float humidity, uint8_t packet_id, const char *device_name,
+                              uint8_t dst[BLE_ADV_PAYLOAD_MAX_LEN]);
+
+/*
+ * ble_adv_payload_history writes the history into dst, as service data for the vendor-specific uuid
+ *   f71e0003-36a0-49d6-8d68-7ba76f904774.
+ * Readings that can't be represented are encoded as 'value is not known', and left out of the range of their channel.
+ * It returns the length of the payload, or 0 if history holds more than BLE_ADV_PAYLOAD_HISTORY_MAX_COUNT readings.
+ */
+size_t ble_adv_payload_history(const ble_adv_payload_history_t *history,
+                               uint8_t dst[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN]);
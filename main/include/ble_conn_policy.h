@@ -0,0 +1,125 @@
+/*
+ * A policy choosing the connection parameters requested by the peripheral, depending on the client's workload:
+ *   - BLE_CONN_POLICY_FAST: right after connecting, and whenever the client exchanges data, a short interval
+ *     without slave latency speeds up service discovery and bulk reads,
+ *   - BLE_CONN_POLICY_RELAXED: once the link has been idle for idle_timeout_ms, a long interval with slave
+ *     latency lets the radio sleep between the client's sporadic polls.
+ * For each phase, the policy also accumulates the time spent, the bytes exchanged and an estimate of the connection
+ *   events attended by the peripheral. Radio energy is roughly proportional to connection events, so the metrics
+ *   tell how many bytes each wake-up moved, and the parameters can be tuned from measured data.
+ * The policy doesn't call any BLE API: the caller feeds it events and time, and requests the parameters it returns.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "ble_conn_policy.h"
+ *
+ * int main(void)
+ * {
+ *     ble_conn_policy_config_t config = {
+ *         .fast_interval_ms = 30, .relaxed_interval_ms = 1000, .relaxed_latency = 4, .idle_timeout_ms = 5000};
+ *     ble_conn_policy_t policy;
+ *     ble_conn_policy_init(&policy, &config, 0);
+ *
+ *     ble_conn_params_t params;
+ *     ble_conn_policy_get_params(&policy, &params); // request params
+ *     ble_conn_policy_on_params_updated(&policy, 100, params.max_int, params.latency);
+ *     ble_conn_policy_on_traffic(&policy, 200, 22);
+ *     if (ble_conn_policy_on_tick(&policy, 6000))
+ *     {
+ *         ble_conn_policy_get_params(&policy, &params); // request relaxed params
+ *     }
+ *
+ *     ble_conn_policy_metrics_t metrics;
+ *     ble_conn_policy_get_metrics(&policy, 6000, BLE_CONN_POLICY_FAST, &metrics);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+    BLE_CONN_POLICY_FAST = 0,
+    BLE_CONN_POLICY_RELAXED,
+    BLE_CONN_POLICY_PHASE_COUNT,
+} ble_conn_policy_phase_t;
+
+typedef struct
+{
+    uint32_t fast_interval_ms;    // interval while the client is exchanging data
+    uint32_t relaxed_interval_ms; // interval while the link is idle
+    uint16_t relaxed_latency;     // connection events the peripheral may skip while the link is idle
+    uint32_t idle_timeout_ms;     // time without traffic before relaxing the parameters
+} ble_conn_policy_config_t;
+
+/* Connection parameters, in the units of the Link Layer */
+typedef struct
+{
+    uint16_t min_int; // unit of 1.25ms
+    uint16_t max_int; // unit of 1.25ms
+    uint16_t latency; // connection events
+    uint16_t timeout; // supervision timeout, unit of 10ms
+} ble_conn_params_t;
+
+typedef struct
+{
+    uint32_t duration_ms;
+    uint32_t bytes;         // bytes exchanged with the client
+    float conn_events;      // estimated connection events attended by the peripheral
+    float throughput_bps;   // bytes per second
+    float bytes_per_event;  // bytes per connection event, the higher the cheaper each byte
+    uint32_t entered_count; // number of times the phase was entered
+} ble_conn_policy_metrics_t;
+
+typedef struct
+{
+    ble_conn_policy_config_t config;
+    ble_conn_policy_phase_t phase;
+    uint32_t last_traffic_ms;
+    uint32_t last_accumulated_ms;
+    float interval_ms; // interval in use, as reported by the controller; 0 until known
+    uint16_t latency;  // latency in use, as reported by the controller
+    ble_conn_policy_metrics_t metrics[BLE_CONN_POLICY_PHASE_COUNT];
+} ble_conn_policy_t;
+
+/*
+ * ble_conn_policy_init starts a new connection in BLE_CONN_POLICY_FAST phase.
+ * Times are in milliseconds, from any monotonic clock; wrap-around is handled.
+ */
+void ble_conn_policy_init(ble_conn_policy_t *policy, const ble_conn_policy_config_t *config, uint32_t now_ms);
+
+/*
+ * ble_conn_policy_on_traffic records bytes exchanged with the client.
+ * It returns true if the phase changed to BLE_CONN_POLICY_FAST, and the new parameters should be requested.
+ */
+bool ble_conn_policy_on_traffic(ble_conn_policy_t *policy, uint32_t now_ms, size_t bytes);
+
+/*
+ * ble_conn_policy_on_tick must be called periodically, at least as often as idle_timeout_ms.
+ * It returns true if the phase changed to BLE_CONN_POLICY_RELAXED, and the new parameters should be requested.
+ */
+bool ble_conn_policy_on_tick(ble_conn_policy_t *policy, uint32_t now_ms);
+
+/*
+ * ble_conn_policy_on_params_updated records the parameters chosen by the central, which may differ from the
+ *   requested ones. interval is in units of 1.25ms.
+ */
+void ble_conn_policy_on_params_updated(ble_conn_policy_t *policy, uint32_t now_ms, uint16_t interval,
+                                       uint16_t latency);
+
+/*
+ * ble_conn_policy_get_params writes the parameters for the current phase into dst.
+ * The supervision timeout is long enough for the central to miss a few connection events in a row, even when the
+ *   peripheral is using all its latency.
+ */
+void ble_conn_policy_get_params(const ble_conn_policy_t *policy, ble_conn_params_t *dst);
+
+/*
+ * ble_conn_policy_get_metrics writes the metrics of the given phase, up to now_ms, into dst.
+ */
+void ble_conn_policy_get_metrics(ble_conn_policy_t *policy, uint32_t now_ms, ble_conn_policy_phase_t phase,
+                                 ble_conn_policy_metrics_t *dst);
@@ -0,0 +1,125 @@
+/*
+ * The state of every client connected to the GATT server: MTU, subscriptions to notifications, connection policy
+ *   and notification counters.
+ * Notifications are fanned out from a single encoded payload: ble_conn_table_select_targets lists the connections
+ *   subscribed to a characteristic, each with the number of bytes fitting into its MTU, and the caller sends the
+ *   same payload to each of them.
+ * Fan-out is fair: the order of the targets rotates at every call, so that no client is always served first.
+ *   Congested connections are skipped rather than delaying the others.
+ * The table doesn't call any BLE API, and isn't thread-safe: the caller guards it with a lock, and sends the
+ *   notifications outside of it.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "ble_conn_table.h"
+ *
+ * static ble_conn_t conns_[3];
+ *
+ * int main(void)
+ * {
+ *     ble_conn_table_t table = ble_conn_table_init(conns_, 3);
+ *     uint8_t bda[6] = {0};
+ *     ble_conn_t *conn = ble_conn_table_add(&table, 0, bda);
+ *     conn->subscriptions |= 1 << 0;
+ *
+ *     ble_conn_target_t targets[3];
+ *     size_t targets_len = ble_conn_table_select_targets(&table, 0, 2, targets);
+ *     for (size_t i = 0; i < targets_len; i++)
+ *     {
+ *         // send targets[i].len bytes to targets[i].conn_id
+ *         ble_conn_table_on_notify_result(&table, targets[i].conn_id, true);
+ *     }
+ *     ble_conn_table_remove(&table, 0);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "ble_conn_policy.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLE_CONN_TABLE_DEFAULT_MTU 23    // ATT MTU until the client negotiates a larger one
+#define BLE_CONN_TABLE_NOTIFY_OVERHEAD 3 // opcode and attribute handle of a notification
+
+typedef struct
+{
+    uint32_t sent;    // notifications handed over to the stack
+    uint32_t failed;  // notifications refused by the stack
+    uint32_t skipped; // notifications not sent because the connection was congested
+} ble_conn_notify_counters_t;
+
+typedef struct
+{
+    bool in_use;
+    uint16_t conn_id;
+    uint8_t remote_bda[6];
+    uint16_t mtu;
+    uint32_t subscriptions; // bit n is set if the client enabled notifications of characteristic n
+    bool congested;
+    ble_conn_policy_t policy;
+    ble_conn_notify_counters_t notify_counters;
+} ble_conn_t;
+
+typedef struct
+{
+    ble_conn_t *conns;
+    size_t capacity;
+    size_t rotation; // position of the first target at the next fan-out
+} ble_conn_table_t;
+
+typedef struct
+{
+    uint16_t conn_id;
+    uint16_t len; // bytes of the payload fitting into a notification
+} ble_conn_target_t;
+
+/*
+ * ble_conn_table_init creates a new table with room for capacity connections.
+ * It assumes conns is provided by the application writer and exists for the entire lifetime of the program.
+ */
+ble_conn_table_t ble_conn_table_init(ble_conn_t conns[], size_t capacity);
+
+/*
+ * ble_conn_table_add stores a new connection, with default MTU and no subscriptions.
+ * It returns the new connection, or NULL if the table is full.
+ */
+ble_conn_t *ble_conn_table_add(ble_conn_table_t *table, uint16_t conn_id, const uint8_t remote_bda[6]);
+
+/*
+ * ble_conn_table_find returns the connection with the given id, or NULL.
+ */
+ble_conn_t *ble_conn_table_find(ble_conn_table_t *table, uint16_t conn_id);
+
+/*
+ * ble_conn_table_find_by_bda returns the connection with the given remote address, or NULL.
+ */
+ble_conn_t *ble_conn_table_find_by_bda(ble_conn_table_t *table, const uint8_t remote_bda[6]);
+
+/*
+ * ble_conn_table_remove frees the slot of the connection with the given id.
+ * It returns false if there's no such connection.
+ */
+bool ble_conn_table_remove(ble_conn_table_t *table, uint16_t conn_id);
+
+/*
+ * ble_conn_table_count returns the number of connections in the table.
+ */
+size_t ble_conn_table_count(const ble_conn_table_t *table);
+
+/*
+ * ble_conn_table_select_targets writes into dst the connections subscribed to characteristic charact_idx, which
+ *   must be lower than 32, in fair order.
+ * dst must have room for capacity targets.
+ * It returns the number of targets.
+ */
+size_t ble_conn_table_select_targets(ble_conn_table_t *table, size_t charact_idx, size_t payload_len,
+                                     ble_conn_target_t dst[]);
+
+/*
+ * ble_conn_table_on_notify_result updates the notification counters of the connection, if still in the table.
+ */
+void ble_conn_table_on_notify_result(ble_conn_table_t *table, uint16_t conn_id, bool sent);
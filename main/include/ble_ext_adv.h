@@ -0,0 +1,37 @@
+/*
+ * BLE 5 extended advertising, used by the ble module when CONFIG_BLE_PERIODIC_ADVERTISING is enabled.
+ * Two advertising sets are started:
+ *   - a connectable set with legacy PDUs, so that every client can still discover the GATT server,
+ *   - a non-connectable set carrying a periodic advertising train, whose data holds the most recent readings;
+ *     scanners synchronize to the train and receive the updates without connecting.
+ * Legacy advertising APIs aren't used, as they are not available with BLE 5 features enabled.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_gap_ble_api.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * ble_ext_adv_start configures and starts both advertising sets, waiting for the controller to complete each step.
+ * It must not be called from the BLE callbacks.
+ */
+esp_err_t ble_ext_adv_start(void);
+
+/*
+ * ble_ext_adv_restart_connectable restarts the connectable set, which stops when a client connects.
+ */
+esp_err_t ble_ext_adv_restart_connectable(void);
+
+/*
+ * ble_ext_adv_set_periodic_data replaces the data of the periodic advertising train.
+ * Data set before the train started is kept, and the train starts with it.
+ */
+esp_err_t ble_ext_adv_set_periodic_data(const uint8_t *data, size_t len);
+
+/*
+ * ble_ext_adv_gap_event_handler must be called by the GAP callback for every event.
+ */
+void ble_ext_adv_gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
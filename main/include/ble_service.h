@@ -0,0 +1,216 @@
+/*
+ * The Environmental Sensing service, as seen by the ble module: the values of its characteristics and descriptors,
+ *   the trigger settings written by the clients, and the table of the connected clients with their connection
+ *   policy.
+ * It implements the ble_write_* functions and ble_get_connections of ble.h, once for both BLE backends: ble.c, on
+ *   top of Bluedroid, and ble_nimble.c, on top of NimBLE, only hold the glue to their host stack.
+ * The backend serves the reads and writes of the clients, and reports their connections, through the functions
+ *   below; in turn, it implements the ble_service_backend_* hooks, which this module calls to talk to the clients.
+ * Writes answer with an ATT error code, 0 on success, which both host stacks pass to the client as they are.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "ble_service.h"
+ *
+ * // in the backend, once a client wrote into the ES Configuration descriptor of the Temperature characteristic
+ * uint8_t att_err = ble_service_write_ess_descriptor(conn_id, BLE_SERVICE_ESS_TEMPERATURE,
+ *                                                    BLE_SERVICE_ESS_CONFIGURATION, value, len);
+ *
+ * // in the backend, once a client read the Readings characteristic
+ * uint8_t value[BLE_SERVICE_VALUE_MAX_LEN];
+ * uint16_t len = ble_service_read_value(BLE_SERVICE_VALUE_READINGS, value);
+ * ```
+ */
+
+#pragma once
+
+#include "ble.h"
+#include "ble_conn_policy.h"
+#include "ble_conn_table.h"
+#include "ess_trigger.h"
+#include "store_readings_into_uint8_arr.h"
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Statistics characteristic: for each window, its length in minutes followed by
+ *   mean, standard deviation, 10th percentile, 90th percentile and trend per hour for temperature and humidity */
+#define BLE_SERVICE_STATS_WINDOW_LEN (2 + 2 * 5 * 2)
+#define BLE_SERVICE_STATS_LEN (BLE_STATS_WINDOW_COUNT * BLE_SERVICE_STATS_WINDOW_LEN)
+
+/* Settings characteristic: read period in milliseconds (uint32) followed by history length in readings (uint16) */
+#define BLE_SERVICE_SETTINGS_LEN (4 + 2)
+
+/* ES Measurement descriptor: flags, sampling function, measurement period, update interval, application and
+ *   measurement uncertainty */
+#define BLE_SERVICE_ES_MEASUREMENT_LEN 11
+
+/* The longest value, see ble_service_read_value */
+#define BLE_SERVICE_VALUE_MAX_LEN BLE_SERVICE_STATS_LEN
+
+/* Descriptor index of the ES Configuration, following the ES Trigger Settings of the same characteristic */
+#define BLE_SERVICE_ESS_CONFIGURATION ESS_TRIGGER_MAX
+#define BLE_SERVICE_ESS_DESCRIPTOR_COUNT (ESS_TRIGGER_MAX + 1)
+
+/* ATT error codes answering the writes: the first ones are defined by the Core specification, the ESS ones by the
+ *   Environmental Sensing Service, and OUT_OF_RANGE by the Common Profile and Service Error Code specification */
+#define BLE_SERVICE_ATT_ERR_INVALID_ATTR_VALUE_LEN 0x0D
+#define BLE_SERVICE_ATT_ERR_UNLIKELY 0x0E
+#define BLE_SERVICE_ATT_ERR_ESS_WRITE_REQUEST_REJECTED 0x80
+#define BLE_SERVICE_ATT_ERR_ESS_CONDITION_NOT_SUPPORTED 0x81
+#define BLE_SERVICE_ATT_ERR_OUT_OF_RANGE 0xFF
+
+_Static_assert(BLE_SERVICE_VALUE_MAX_LEN >= STORE_READINGS_LEN && BLE_SERVICE_VALUE_MAX_LEN >= ESS_TRIGGER_MAX_LEN &&
+                   BLE_SERVICE_VALUE_MAX_LEN >= BLE_SERVICE_SETTINGS_LEN &&
+                   BLE_SERVICE_VALUE_MAX_LEN >= BLE_SERVICE_ES_MEASUREMENT_LEN,
+               "BLE_SERVICE_VALUE_MAX_LEN can't hold every value");
+
+/* Values served on reads */
+typedef enum
+{
+    BLE_SERVICE_VALUE_TEMPERATURE,
+    BLE_SERVICE_VALUE_TEMPERATURE_ES_MEASUREMENT,
+    BLE_SERVICE_VALUE_HUMIDITY,
+    BLE_SERVICE_VALUE_HUMIDITY_ES_MEASUREMENT,
+    BLE_SERVICE_VALUE_STATS,
+    BLE_SERVICE_VALUE_DEW_POINT,
+    BLE_SERVICE_VALUE_HEAT_INDEX,
+    BLE_SERVICE_VALUE_ABSOLUTE_HUMIDITY,
+    BLE_SERVICE_VALUE_READINGS,
+    BLE_SERVICE_VALUE_SETTINGS,
+    BLE_SERVICE_VALUE_COUNT,
+} ble_service_value_t;
+
+/* Characteristics clients can subscribe to, the index is the bit of the subscription in ble_conn_t */
+typedef enum
+{
+    BLE_SERVICE_NOTIFY_TEMPERATURE,
+    BLE_SERVICE_NOTIFY_HUMIDITY,
+    BLE_SERVICE_NOTIFY_READINGS,
+    BLE_SERVICE_NOTIFY_COUNT,
+} ble_service_notify_t;
+
+/* Characteristics with trigger settings, deciding when their value is notified */
+typedef enum
+{
+    BLE_SERVICE_ESS_TEMPERATURE,
+    BLE_SERVICE_ESS_HUMIDITY,
+    BLE_SERVICE_ESS_COUNT,
+} ble_service_ess_t;
+
+/*
+ * ble_service_init sets every value to 'value is not known', and keeps settings_handler for the writes to the
+ *   Settings characteristic.
+ * It's called by ble_init, before the host stack starts.
+ */
+void ble_service_init(ble_settings_handler_t settings_handler);
+
+/*
+ * ble_service_stop stops relaxing the connection parameters, before the host stack stops.
+ */
+void ble_service_stop(void);
+
+/*
+ * ble_service_read_value copies the value into dst and returns its length.
+ * The age held by the Readings characteristic is brought up to date first.
+ */
+uint16_t ble_service_read_value(ble_service_value_t value, uint8_t dst[BLE_SERVICE_VALUE_MAX_LEN]);
+
+/*
+ * ble_service_read_ess_descriptor copies the ES Trigger Setting, or with BLE_SERVICE_ESS_CONFIGURATION the
+ *   ES Configuration, of the characteristic into dst and returns its length.
+ */
+uint16_t ble_service_read_ess_descriptor(ble_service_ess_t charact, size_t descriptor,
+                                         uint8_t dst[ESS_TRIGGER_MAX_LEN]);
+
+/*
+ * ble_service_write_ess_descriptor stores the trigger setting, or with BLE_SERVICE_ESS_CONFIGURATION the logic
+ *   combining them, written by the client conn_id; the settings are shared by all the connections.
+ * It returns the ATT error code answering the write.
+ */
+uint8_t ble_service_write_ess_descriptor(uint16_t conn_id, ble_service_ess_t charact, size_t descriptor,
+                                         const uint8_t *value, uint16_t len);
+
+/*
+ * ble_service_write_settings passes the settings written by the client conn_id to the settings handler; the
+ *   characteristic is updated once they're applied, through ble_write_settings.
+ * It returns the ATT error code answering the write.
+ */
+uint8_t ble_service_write_settings(uint16_t conn_id, const uint8_t *value, uint16_t len);
+
+/*
+ * ble_service_on_connect adds the client to the connections, and requests the fast connection parameters, as
+ *   service discovery is about to start; conns_count is set to the number of connections, this one included.
+ * It returns ESP_ERR_NO_MEM if there's no room for the client, which the backend is then expected to disconnect.
+ */
+esp_err_t ble_service_on_connect(uint16_t conn_id, const uint8_t remote_bda[6], size_t *conns_count);
+
+/*
+ * ble_service_on_disconnect removes the client from the connections, and logs the metrics of its connection;
+ *   was_full is set if there was no room for any other client, i.e. if advertising stopped.
+ * It returns ESP_ERR_NOT_FOUND if the client wasn't among the connections, e.g. it was refused.
+ */
+esp_err_t ble_service_on_disconnect(uint16_t conn_id, bool *was_full);
+
+/*
+ * ble_service_find_conn_id looks up the connection of the client with the given address.
+ * It returns ESP_ERR_NOT_FOUND if the client isn't connected.
+ */
+esp_err_t ble_service_find_conn_id(const uint8_t remote_bda[6], uint16_t *conn_id);
+
+/*
+ * ble_service_on_traffic must be called for every request of the client, with the bytes it carried, so that the
+ *   link stays fast while the client is busy.
+ */
+void ble_service_on_traffic(uint16_t conn_id, size_t bytes);
+
+/*
+ * ble_service_on_params_updated records the connection parameters the client agreed to, interval in units of
+ *   1.25 ms.
+ */
+void ble_service_on_params_updated(uint16_t conn_id, uint16_t interval, uint16_t latency);
+
+/*
+ * ble_service_on_mtu records the MTU negotiated by the client, bounding the length of the notifications and
+ *   of the reads answered to it.
+ */
+void ble_service_on_mtu(uint16_t conn_id, uint16_t mtu);
+
+/*
+ * ble_service_get_mtu returns the MTU of the client, BLE_CONN_TABLE_DEFAULT_MTU if it isn't connected.
+ */
+uint16_t ble_service_get_mtu(uint16_t conn_id);
+
+/*
+ * ble_service_on_congestion records whether the stack can take more notifications for the client; congested
+ *   clients are skipped by notifications.
+ */
+void ble_service_on_congestion(uint16_t conn_id, bool congested);
+
+/*
+ * ble_service_set_subscription enables or disables the notifications of the characteristic to the client.
+ * It returns ESP_ERR_NOT_FOUND if the client isn't connected.
+ */
+esp_err_t ble_service_set_subscription(uint16_t conn_id, ble_service_notify_t charact, bool enabled);
+
+/*
+ * ble_service_is_subscribed returns true if the client enabled the notifications of the characteristic.
+ */
+bool ble_service_is_subscribed(uint16_t conn_id, ble_service_notify_t charact);
+
+/*
+ * ble_service_backend_notify, implemented by the backend, sends len bytes of the value of the characteristic to
+ *   the client.
+ * It's called outside of any lock of this module, from the task writing the value.
+ */
+esp_err_t ble_service_backend_notify(uint16_t conn_id, ble_service_notify_t charact, const uint8_t *value,
+                                     size_t len);
+
+/*
+ * ble_service_backend_update_conn_params, implemented by the backend, asks the client of conn to switch to the
+ *   given connection parameters.
+ * It's called outside of any lock of this module, with a copy of the connection.
+ */
+esp_err_t ble_service_backend_update_conn_params(const ble_conn_t *conn, const ble_conn_params_t *params);
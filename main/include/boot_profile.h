@@ -0,0 +1,51 @@
+/*
+ * This module timestamps the boot phases, from app_main to the first sensor reading and the first advertising
+ *   packet, so that reordering the initialization can be measured rather than guessed.
+ * Timestamps come from esp_timer, which starts before app_main, so the first phase also shows how long the
+ *   bootloader and the ESP-IDF startup code took.
+ * Each phase is marked once: later marks of the same phase are ignored, so that, for instance, restarting
+ *   advertising after a disconnection doesn't move BOOT_PHASE_ADVERTISING. Once every phase is marked, the module
+ *   logs the whole profile.
+ * boot_profile_mark can be called from any task, but not from ISRs.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "boot_profile.h"
+ *
+ * int main(void)
+ * {
+ *     boot_profile_mark(BOOT_PHASE_APP_MAIN);
+ *     lcd_init(history_len);
+ *     boot_profile_mark(BOOT_PHASE_LCD);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// phases are listed in the order app_main usually reaches them, the last two happen in other tasks
+typedef enum
+{
+    BOOT_PHASE_APP_MAIN,     // app_main entered
+    BOOT_PHASE_SETTINGS,     // NVS initialized and settings loaded
+    BOOT_PHASE_GPIO,         // button, heartbeat and trace pins configured
+    BOOT_PHASE_LCD,          // lcd initialized
+    BOOT_PHASE_SENSOR,       // sensor channels initialized
+    BOOT_PHASE_TASKS,        // sensor and lcd tasks created
+    BOOT_PHASE_BLE,          // ble_init returned, the BT host may still be starting
+    BOOT_PHASE_FIRST_SAMPLE, // first reading published on the sample bus
+    BOOT_PHASE_ADVERTISING,  // advertising started
+    BOOT_PHASE_COUNT,
+} boot_phase_t;
+
+/*
+ * boot_profile_mark records the current time as the end of phase, unless phase was already marked.
+ */
+void boot_profile_mark(boot_phase_t phase);
+
+/*
+ * boot_profile_get_us returns the time phase was marked at, in microseconds since startup, or -1 if it wasn't.
+ */
+int64_t boot_profile_get_us(boot_phase_t phase);
@@ -1,8 +1,33 @@
+/*
+ * This module reads the push button on BUTTON_PIN, debounces it, and reports the gestures made with it (see
+ *   button_gesture.h) to the handler passed to button_init.
+ * Debouncing doesn't take a task: an edge disables the GPIO interrupt and starts an esp_timer one-shot, whose
+ *   callback reads the settled level and enables the interrupt again.
+ * The handler runs in the esp_timer task, shared with the other esp_timer callbacks, so it must not block.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "button.h"
+ *
+ * static void handle_button_event(button_event_t event)
+ * {
+ *     if (event == BUTTON_EVENT_SHORT_PRESS)
+ *         lcd_select_next_view();
+ * }
+ *
+ * int main(void)
+ * {
+ *     button_init(handle_button_event);
+ * }
+ * ```
+ */
+
 #pragma once
 
-#include "driver/gpio.h"
+#include "button_gesture.h"
+
 #include "esp_err.h"
 
-esp_err_t button_init(gpio_isr_t isr_handler);
+typedef void (*button_event_handler_t)(button_event_t event);
 
-void button_debounce(void);
+esp_err_t button_init(button_event_handler_t event_handler);
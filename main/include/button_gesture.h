@@ -0,0 +1,81 @@
+/*
+ * Recognizer of the gestures made with a single push button: short press, long press and double press.
+ * It's fed the debounced presses and releases, and the expiry of the timeout it asks for, and returns the
+ *   gesture each of them completes, if any:
+ *   - BUTTON_EVENT_LONG_PRESS: the button was held for long_press_ms, reported while it's still held,
+ *   - BUTTON_EVENT_DOUBLE_PRESS: the button was pressed again within double_press_ms of being released,
+ *   - BUTTON_EVENT_SHORT_PRESS: the button was released, and not pressed again within double_press_ms.
+ * A short press is therefore reported double_press_ms after the release; with double_press_ms 0, double presses
+ *   aren't recognized, and short presses are reported on release.
+ * The module doesn't read any clock, nor start any timer: the caller passes the time, in milliseconds of a clock
+ *   that may wrap around, and calls button_gesture_timeout once button_gesture_timeout_ms elapsed.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "button_gesture.h"
+ *
+ * int main(void)
+ * {
+ *     button_gesture_t gesture;
+ *     button_gesture_init(&gesture, 800, 250);
+ *
+ *     button_gesture_press(&gesture, 0);
+ *     button_gesture_release(&gesture, 100);
+ *     uint32_t timeout_ms = button_gesture_timeout_ms(&gesture, 100); // 250
+ *     button_event_t event = button_gesture_timeout(&gesture, 100 + timeout_ms); // BUTTON_EVENT_SHORT_PRESS
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define BUTTON_GESTURE_NO_TIMEOUT UINT32_MAX // returned by button_gesture_timeout_ms when no timeout is pending
+
+typedef enum
+{
+    BUTTON_EVENT_NONE = 0,
+    BUTTON_EVENT_SHORT_PRESS,
+    BUTTON_EVENT_LONG_PRESS,
+    BUTTON_EVENT_DOUBLE_PRESS,
+} button_event_t;
+
+typedef enum
+{
+    BUTTON_GESTURE_IDLE,     // released, no gesture in progress
+    BUTTON_GESTURE_PRESSED,  // pressed, waiting for the release or for the long press
+    BUTTON_GESTURE_RELEASED, // released after a short press, waiting for the second press
+    BUTTON_GESTURE_HELD,     // pressed, with the gesture already reported, waiting for the release
+} button_gesture_state_t;
+
+typedef struct
+{
+    uint32_t long_press_ms;
+    uint32_t double_press_ms;
+    button_gesture_state_t state;
+    uint32_t since_ms; // when the current state was entered
+} button_gesture_t;
+
+void button_gesture_init(button_gesture_t *gesture, uint32_t long_press_ms, uint32_t double_press_ms);
+
+/*
+ * button_gesture_press and button_gesture_release feed the debounced edges of the button, at now_ms.
+ * A press while already pressed, or a release while already released, is ignored.
+ */
+button_event_t button_gesture_press(button_gesture_t *gesture, uint32_t now_ms);
+
+button_event_t button_gesture_release(button_gesture_t *gesture, uint32_t now_ms);
+
+/*
+ * button_gesture_timeout reports the gesture completed by the timeout expired at now_ms; it returns
+ *   BUTTON_EVENT_NONE if the timeout isn't due yet, e.g. when the timer fired late and an edge got there first.
+ */
+button_event_t button_gesture_timeout(button_gesture_t *gesture, uint32_t now_ms);
+
+/*
+ * button_gesture_timeout_ms returns how long after now_ms button_gesture_timeout is due, 0 if it's overdue, or
+ *   BUTTON_GESTURE_NO_TIMEOUT if no gesture is waiting for one.
+ * It changes with each edge and timeout fed, so it's to be asked again after each of them.
+ */
+uint32_t button_gesture_timeout_ms(const button_gesture_t *gesture, uint32_t now_ms);
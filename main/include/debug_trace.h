@@ -0,0 +1,58 @@
+/*
+ * This module marks the stages of the sensor pipeline on GPIO pins, one pin per stage, so that a logic analyzer
+ *   shows when each stage starts and ends, and how stages of different tasks overlap.
+ * Each pin goes high with DEBUG_TRACE_ENTER and low with DEBUG_TRACE_EXIT. Both macros write the GPIO set/clear
+ *   registers directly with a constant mask: a single store, unlike gpio_set_level which validates the pin and
+ *   goes through the HAL, so the trace barely shifts the timings it measures. They're also safe from ISRs.
+ * Without CONFIG_DEBUG_TRACE, the macros expand to nothing and debug_trace_init doesn't touch any pin.
+ * Pins are assigned in envi_config.h and must be lower than 32, the range of the GPIO_OUT registers.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "debug_trace.h"
+ *
+ * int main(void)
+ * {
+ *     debug_trace_init();
+ *     DEBUG_TRACE_ENTER(LCD_RENDER);
+ *     lcd_render();
+ *     DEBUG_TRACE_EXIT(LCD_RENDER);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "envi_config.h"
+
+#include "esp_err.h"
+
+#if CONFIG_DEBUG_TRACE
+
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+
+_Static_assert(TRACE_I2C_READ_PIN < 32 && TRACE_QUEUE_SEND_PIN < 32 && TRACE_BLE_WRITE_PIN < 32 &&
+                   TRACE_LCD_RENDER_PIN < 32 && TRACE_ISR_PIN < 32,
+               "trace pins must be driven by GPIO_OUT_W1TS_REG and GPIO_OUT_W1TC_REG");
+
+#define DEBUG_TRACE_MASK_I2C_READ BIT(TRACE_I2C_READ_PIN)     // sensor channels read over I2C
+#define DEBUG_TRACE_MASK_QUEUE_SEND BIT(TRACE_QUEUE_SEND_PIN) // reading published on the sample bus
+#define DEBUG_TRACE_MASK_BLE_WRITE BIT(TRACE_BLE_WRITE_PIN)   // characteristics updated and clients notified
+#define DEBUG_TRACE_MASK_LCD_RENDER BIT(TRACE_LCD_RENDER_PIN) // view drawn on the lcd
+#define DEBUG_TRACE_MASK_ISR BIT(TRACE_ISR_PIN)               // button interrupt handler
+
+#define DEBUG_TRACE_ENTER(stage) REG_WRITE(GPIO_OUT_W1TS_REG, DEBUG_TRACE_MASK_##stage)
+#define DEBUG_TRACE_EXIT(stage) REG_WRITE(GPIO_OUT_W1TC_REG, DEBUG_TRACE_MASK_##stage)
+
+#else
+
+#define DEBUG_TRACE_ENTER(stage) ((void)0)
+#define DEBUG_TRACE_EXIT(stage) ((void)0)
+
+#endif // CONFIG_DEBUG_TRACE
+
+/*
+ * debug_trace_init configures the trace pins as outputs, driven low.
+ */
+esp_err_t debug_trace_init(void);
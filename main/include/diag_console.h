@@ -0,0 +1,65 @@
+/*
+ * A diagnostics console over UART, to inspect a running device without rebuilding it with more logs.
+ * Type `help` at the `envi>` prompt for the list of commands: they print heap usage, stack high-water marks,
+ *   queue depths, sample store fill level, BLE connections, render timings, sensor errors and sample timing, and
+ *   change the log level and the settings at runtime.
+ * State owned by the application (tasks, sample bus, sample store, sample timing, settings) is reached through
+ *   diag_console_sources_t; everything else is read from the modules directly.
+ * Requires CONFIG_DIAG_CONSOLE.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "diag_console.h"
+ *
+ * int main(void)
+ * {
+ *     static const diag_console_task_t tasks[] = {{"task_read_sensor", task_read_sensor_handle}};
+ *     diag_console_sources_t sources = {
+ *         .sample_bus = &sample_bus,
+ *         .sample_store = &sample_store,
+ *         .tasks = tasks,
+ *         .tasks_len = 1,
+ *         .get_sample_timing = get_sample_timing,
+ *         .get_settings = get_settings,
+ *         .set_settings = set_settings,
+ *     };
+ *     diag_console_start(&sources);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "sample_bus.h"
+#include "sample_store.h"
+#include "sample_timing.h"
+#include "settings.h"
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    const char *name;
+    TaskHandle_t handle;
+} diag_console_task_t;
+
+typedef struct
+{
+    sample_bus_t *sample_bus;
+    const sample_store_t *sample_store;
+    const diag_console_task_t *tasks; // tasks created by the application
+    size_t tasks_len;
+    void (*get_sample_timing)(sample_timing_t *dst);
+    void (*get_settings)(settings_t *dst);
+    esp_err_t (*set_settings)(const settings_t *settings); // applies and stores them, ESP_ERR_INVALID_ARG if invalid
+} diag_console_sources_t;
+
+/*
+ * diag_console_start registers the commands and starts the console task on the default UART.
+ * It assumes sources, and the arrays it points to, exist for the entire lifetime of the program.
+ */
+esp_err_t diag_console_start(const diag_console_sources_t *sources);
@@ -1,5 +1,5 @@
 /*
- * This header centralizes pins mapping and task priorities across different modules.
+ * This header centralizes pins mapping, task priorities and task placement across different modules.
  *
  */
 
@@ -23,6 +23,24 @@
 #define LCD_RST_PIN GPIO_NUM_16    // LCD Reset
 #define SENSOR_SDA_PIN GPIO_NUM_32 // Sensor SDA
 #define SENSOR_SCL_PIN GPIO_NUM_33 // Sensor SCL
+#define TRACE_I2C_READ_PIN GPIO_NUM_26   // Logic Analyzer, with CONFIG_DEBUG_TRACE
+#define TRACE_QUEUE_SEND_PIN GPIO_NUM_27 // Logic Analyzer, with CONFIG_DEBUG_TRACE
+#define TRACE_BLE_WRITE_PIN GPIO_NUM_19  // Logic Analyzer, with CONFIG_DEBUG_TRACE
+#define TRACE_LCD_RENDER_PIN GPIO_NUM_22 // Logic Analyzer, with CONFIG_DEBUG_TRACE
+#define TRACE_ISR_PIN GPIO_NUM_4         // Logic Analyzer, with CONFIG_DEBUG_TRACE
+#if CONFIG_BATCH_MODE
+#define WAKE_PIN CONFIG_BATCH_MODE_WAKE_GPIO // Button waking the device up from deep sleep, with CONFIG_BATCH_MODE
+#endif
+
+//
+// I2C Bus
+//
+#define SENSOR_I2C_PORT 0 // I2C port shared by all the sensors
+#if CONFIG_SENSOR_I2C_MUX
+#define SENSOR_SHT21_MUX_PORT CONFIG_SENSOR_SHT21_MUX_PORT // multiplexer port of the primary SHT21
+#else
+#define SENSOR_SHT21_MUX_PORT -1 // primary SHT21 wired directly to the bus
+#endif
 
 //
 // Task Priorities
@@ -31,11 +49,34 @@
 #define TASK_PRIORITY_MAX (configMAX_PRIORITIES - 1U) // max priority that can be assigned, for reference
 #define TASK_PRIORITY_READ_SENSOR 2
 #define TASK_PRIORITY_UPDATE_BLE 3
-#define TASK_PRIORITY_UPDATE_LCD_RING_BUFFER 3
-#define TASK_PRIORITY_DEBOUNCE_BUTTON 3
+#define TASK_PRIORITY_UPDATE_SAMPLE_STORE 3
 #define TASK_PRIORITY_RENDER_LCD_VIEW 4
+#define TASK_PRIORITY_LOG_RUNTIME_STATS 1
+#define TASK_PRIORITY_APPLY_SETTINGS 1
+#define TASK_PRIORITY_DIAG_CONSOLE 1
+
+//
+// Task Placement
+//
+#if CONFIG_TASK_PINNING && CONFIG_BT_NIMBLE_ENABLED
+#define TASK_CORE_BT_HOST CONFIG_BT_NIMBLE_PINNED_TO_CORE // NimBLE host, with the BLE callbacks
+#define TASK_CORE_PIPELINE (1 - TASK_CORE_BT_HOST)        // sensor and lcd, away from BLE traffic
+#elif CONFIG_TASK_PINNING
+#define TASK_CORE_BT_HOST CONFIG_BT_BLUEDROID_PINNED_TO_CORE // Bluedroid, with the BLE callbacks
+#define TASK_CORE_PIPELINE (1 - TASK_CORE_BT_HOST)           // sensor and lcd, away from BLE traffic
+#else
+#define TASK_CORE_BT_HOST tskNO_AFFINITY  // single core, or placement left to the scheduler
+#define TASK_CORE_PIPELINE tskNO_AFFINITY // single core, or placement left to the scheduler
+#endif
+#define TASK_CORE_READ_SENSOR TASK_CORE_PIPELINE
+#define TASK_CORE_UPDATE_BLE TASK_CORE_BT_HOST // calls into the BT host
+#define TASK_CORE_UPDATE_SAMPLE_STORE TASK_CORE_PIPELINE
+#define TASK_CORE_RENDER_LCD_VIEW TASK_CORE_PIPELINE
+#define TASK_CORE_LOG_RUNTIME_STATS tskNO_AFFINITY
+#define TASK_CORE_APPLY_SETTINGS TASK_CORE_PIPELINE // resamples the store, away from the BT host
 
 //
 // Task Stack Depths (in words)
 //
 #define TASK_STACK_DEPTH 2048
+#define TASK_STACK_DEPTH_DIAG_CONSOLE 4096 // printf of 64-bit integers, linenoise line buffer
@@ -0,0 +1,105 @@
+/*
+ * Evaluator of the Environmental Sensing Service trigger settings, deciding whether a new value of a characteristic
+ *   should be notified to the clients.
+ * Each characteristic has up to ESS_TRIGGER_MAX trigger settings, written by clients into the ES Trigger Setting
+ *   descriptors (0x290D), combined with the logic written into the ES Configuration descriptor (0x290B).
+ * Conditions follow the Environmental Sensing Service specification, Section 3.1.2.2:
+ *   - ESS_TRIGGER_FIXED_INTERVAL: notify if interval_s elapsed since the last notification,
+ *   - ESS_TRIGGER_MIN_INTERVAL: notify if the value changed, but no sooner than interval_s after the last one,
+ *   - ESS_TRIGGER_ON_CHANGE: notify if the value changed since the last notification,
+ *   - ESS_TRIGGER_LESS_THAN ... ESS_TRIGGER_NOT_EQUAL: notify while the value compares so with operand.
+ * As an extension, ESS_TRIGGER_ON_CHANGE accepts an optional operand: the value must then change by more than
+ *   operand, so that clients can ignore noise.
+ * Values and operands are integers in the unit of the characteristic (e.g. 0.01 °C for Temperature).
+ * Conditions are evaluated when a new value is available, so intervals are rounded up to the sampling period.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "ess_trigger.h"
+ *
+ * int main(void)
+ * {
+ *     ess_trigger_set_t set;
+ *     ess_trigger_set_init(&set);
+ *
+ *     // notify when temperature changes by more than 0.50 °C
+ *     uint8_t descriptor[] = {ESS_TRIGGER_ON_CHANGE, 50, 0};
+ *     ess_trigger_parse(descriptor, sizeof(descriptor), true, &set.triggers[0]);
+ *
+ *     bool notify = ess_trigger_evaluate(&set, 2150, 0);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESS_TRIGGER_MAX 3     // trigger settings per characteristic, as allowed by the specification
+#define ESS_TRIGGER_MAX_LEN 4 // condition followed by a 24-bit interval or by a 16-bit value
+
+typedef enum
+{
+    ESS_TRIGGER_INACTIVE = 0x00,
+    ESS_TRIGGER_FIXED_INTERVAL = 0x01,
+    ESS_TRIGGER_MIN_INTERVAL = 0x02,
+    ESS_TRIGGER_ON_CHANGE = 0x03,
+    ESS_TRIGGER_LESS_THAN = 0x04,
+    ESS_TRIGGER_LESS_OR_EQUAL = 0x05,
+    ESS_TRIGGER_GREATER_THAN = 0x06,
+    ESS_TRIGGER_GREATER_OR_EQUAL = 0x07,
+    ESS_TRIGGER_EQUAL = 0x08,
+    ESS_TRIGGER_NOT_EQUAL = 0x09,
+} ess_trigger_condition_t;
+
+/* Logic combining the active trigger settings, as written into the ES Configuration descriptor */
+typedef enum
+{
+    ESS_TRIGGER_LOGIC_AND = 0x00,
+    ESS_TRIGGER_LOGIC_OR = 0x01,
+} ess_trigger_logic_t;
+
+typedef struct
+{
+    ess_trigger_condition_t condition;
+    uint32_t interval_s; // only used by ESS_TRIGGER_FIXED_INTERVAL and ESS_TRIGGER_MIN_INTERVAL
+    int32_t operand;     // only used by the other conditions
+} ess_trigger_t;
+
+typedef struct
+{
+    ess_trigger_t triggers[ESS_TRIGGER_MAX];
+    ess_trigger_logic_t logic;
+    bool notified; // false until the first notification
+    int32_t last_value;
+    uint32_t last_ms;
+} ess_trigger_set_t;
+
+/*
+ * ess_trigger_set_init sets the default trigger: notify whenever the value changes.
+ */
+void ess_trigger_set_init(ess_trigger_set_t *set);
+
+/*
+ * ess_trigger_parse decodes the value of an ES Trigger Setting descriptor, whose characteristic holds a 16-bit
+ *   integer, signed or not.
+ * It returns ESP_ERR_INVALID_SIZE if the length doesn't match the condition, ESP_ERR_NOT_SUPPORTED if the condition
+ *   is unknown; dst is left untouched.
+ */
+esp_err_t ess_trigger_parse(const uint8_t *data, size_t len, bool is_signed, ess_trigger_t *dst);
+
+/*
+ * ess_trigger_encode writes the value of the ES Trigger Setting descriptor into dst.
+ * It returns the length of the value.
+ */
+size_t ess_trigger_encode(const ess_trigger_t *trigger, uint8_t dst[ESS_TRIGGER_MAX_LEN]);
+
+/*
+ * ess_trigger_evaluate combines the active trigger settings for the new value, sampled at now_ms.
+ * It returns true if the value should be notified, and then records it as the last notified value.
+ * Without active trigger settings, nothing is notified.
+ */
+bool ess_trigger_evaluate(ess_trigger_set_t *set, int32_t value, uint32_t now_ms);
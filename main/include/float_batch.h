@@ -0,0 +1,76 @@
+/*
+ * Kernels working on a whole span of floats at once, e.g. the history of a field queried from the sample store:
+ *   - float_batch_reduce computes minimum, maximum and sum,
+ *   - float_batch_quantize_i16 converts to int16 fixed-point values, as used by the BLE GATT characteristics,
+ *   - float_batch_reduce_i16 computes minimum, maximum and sum of the values so quantized.
+ * The float loops keep four independent lanes, so the FPU can overlap their operations, and the sum is accumulated in
+ *   a fixed order, lane by lane, so that a vectorized implementation can reproduce it bit for bit.
+ * The int16 reduction is exact, whatever the order: on the ESP32-S3 it runs on the PIE vector instructions, eight items
+ *   at a time, and gives the same result as the portable implementation the other targets run.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "float_batch.h"
+ *
+ * int main(void)
+ * {
+ *     float temperatures[3] = {21.5, 22.25, 21.75};
+ *     float_batch_reduction_t reduction;
+ *     float_batch_reduce(temperatures, 3, &reduction);
+ *     float mean = reduction.sum / 3;
+ *
+ *     int16_t centi_temperatures[3];
+ *     float_batch_quantize_i16(temperatures, 3, 100, centi_temperatures);
+ *     float_batch_reduction_i16_t centi_reduction;
+ *     float_batch_reduce_i16(centi_temperatures, 3, &centi_reduction);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLOAT_BATCH_I16_MAX_LEN 65536 // the longest span float_batch_reduce_i16 can sum into an int32_t
+
+typedef struct
+{
+    float min;
+    float max;
+    float sum; // lane l sums items l, l + 4, l + 8, ..., then the lanes are added as (0 + 1) + (2 + 3)
+} float_batch_reduction_t;
+
+typedef struct
+{
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+} float_batch_reduction_i16_t;
+
+/*
+ * float_batch_reduce computes minimum, maximum and sum of the len items of src, which mustn't be NAN.
+ * It returns len; if 0, dst is left untouched.
+ */
+size_t float_batch_reduce(const float src[], size_t len, float_batch_reduction_t *dst);
+
+/*
+ * float_batch_quantize_i16 writes each item of src multiplied by scale into dst, rounded to the nearest integer
+ *   (halfway cases away from zero) and saturated to [INT16_MIN + 1, INT16_MAX].
+ * NAN items become INT16_MIN, i.e. 0x8000, which the GATT specification reserves for "value is not known".
+ */
+void float_batch_quantize_i16(const float src[], size_t len, float scale, int16_t dst[]);
+
+/*
+ * float_batch_reduce_i16 computes minimum, maximum and sum of the len items of src, as written by
+ *   float_batch_quantize_i16, skipping the INT16_MIN ones, i.e. the NAN ones; len mustn't exceed
+ *   FLOAT_BATCH_I16_MAX_LEN.
+ * It returns the number of items reduced; if 0, dst is left untouched.
+ */
+size_t float_batch_reduce_i16(const int16_t src[], size_t len, float_batch_reduction_i16_t *dst);
+
+/*
+ * float_batch_reduce_i16_scalar is the portable implementation of float_batch_reduce_i16, which the targets without
+ *   vector instructions run; it's exposed so that the tests can check the vector one against it.
+ */
+size_t float_batch_reduce_i16_scalar(const int16_t src[], size_t len, float_batch_reduction_i16_t *dst);
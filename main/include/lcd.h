@@ -1,14 +1,34 @@
 #pragma once
 
+#include "sample_store.h"
+
 #include "esp_err.h"
+#include <stddef.h>
 #include <stdint.h>
 
-esp_err_t lcd_init(void);
+typedef struct
+{
+    uint32_t count;    // views rendered since boot
+    uint32_t last_us;  // duration of the latest rendering
+    uint32_t max_us;   // longest rendering since boot
+    uint64_t total_us; // sum of the durations, to compute the mean
+} lcd_render_timing_t;
 
-void lcd_store_temperature(float temperature);
+/*
+ * lcd_init initializes the lcd, whose views show the records in store, of SAMPLE_FIELD_COUNT fields.
+ */
+esp_err_t lcd_init(const sample_store_t *store);
 
-void lcd_store_humidity(float humidity);
+void lcd_select_first_view(void);
 
 void lcd_select_next_view(void);
 
+void lcd_select_previous_view(void);
+
 void lcd_render(void);
+
+/*
+ * lcd_get_render_timing copies into dst how long lcd_render took to draw the views.
+ * It's safe to call from any task.
+ */
+void lcd_get_render_timing(lcd_render_timing_t *dst);
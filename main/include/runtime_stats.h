@@ -0,0 +1,41 @@
+/*
+ * This module reports how much CPU time each task used, and on which core it is allowed to run.
+ * FreeRTOS counts the run time of each task since boot: runtime_stats_log_window logs the share of the time
+ *   elapsed since its previous call instead, so that load peaks (e.g. several BLE clients reading at once) aren't
+ *   averaged away.
+ * Requires CONFIG_TASK_RUNTIME_STATS, which enables the run time counters of FreeRTOS.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "runtime_stats.h"
+ *
+ * int main(void)
+ * {
+ *     while(1)
+ *     {
+ *         vTaskDelay(10000 / portTICK_PERIOD_MS);
+ *         runtime_stats_log_window();
+ *     }
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#define RUNTIME_STATS_MAX_TASKS 24 // tasks tracked between two windows, including the ones of ESP-IDF
+
+/*
+ * runtime_stats_log_window logs, for each task, the percentage of one core used since the previous call,
+ *   the core the task is pinned to, and its stack high-water mark.
+ * The first call covers the time since boot.
+ * It returns ESP_ERR_NO_MEM if there are more than RUNTIME_STATS_MAX_TASKS tasks.
+ */
+esp_err_t runtime_stats_log_window(void);
+
+/*
+ * runtime_stats_print_since_boot prints the run time of each task since boot, as formatted by
+ *   vTaskGetRunTimeStats.
+ */
+void runtime_stats_print_since_boot(void);
@@ -0,0 +1,126 @@
+/*
+ * Readings buffered across deep sleep, for the batch mode: each wake-up takes one reading and goes back to sleep,
+ *   and the whole batch is published once it holds publish_len readings, or when the button is pressed.
+ * The batch is meant to live in RTC memory, so it's compact: temperature and humidity are stored in hundredths, as
+ *   int16 (INT16_MIN if not acquired), and each reading's time as the seconds elapsed since the previous one.
+ * The module decides what each wake-up does, and when the next one is due; it doesn't read any clock, nor touch
+ *   the sensor or the radio: the caller passes the time, in milliseconds of a clock that keeps running during deep
+ *   sleep, and acts on the returned sample_batch_action_t.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "sample_batch.h"
+ *
+ * RTC_DATA_ATTR static sample_batch_t batch;
+ *
+ * int main(void)
+ * {
+ *     if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED)
+ *         sample_batch_init(&batch, 20, now_ms());
+ *     switch (sample_batch_on_wake(&batch, SAMPLE_BATCH_WAKE_TIMER, now_ms()))
+ *     {
+ *     case SAMPLE_BATCH_READ:
+ *         sample_batch_push(&batch, 21.5, 40, now_ms(), 30000);
+ *         break;
+ *     case SAMPLE_BATCH_PUBLISH:
+ *         publish(&batch);
+ *         sample_batch_clear(&batch);
+ *         break;
+ *     case SAMPLE_BATCH_SLEEP:
+ *         break;
+ *     }
+ *     esp_deep_sleep(sample_batch_sleep_ms(&batch, now_ms()) * 1000);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAMPLE_BATCH_MAX_LEN 240 // 6 bytes each, well within the 8 KB of RTC memory
+
+typedef enum
+{
+    SAMPLE_BATCH_WAKE_TIMER,  // the deep sleep timer expired
+    SAMPLE_BATCH_WAKE_BUTTON, // the user pressed the button
+} sample_batch_wake_t;
+
+typedef enum
+{
+    SAMPLE_BATCH_READ,    // take a reading, push it, and go back to sleep
+    SAMPLE_BATCH_PUBLISH, // start BLE and lcd, publish the batch, clear it, and go back to sleep
+    SAMPLE_BATCH_SLEEP,   // woken up early, go back to sleep
+} sample_batch_action_t;
+
+typedef struct
+{
+    uint16_t delta_s;          // seconds since the previous reading, 0 for the first one
+    int16_t centi_temperature; // °C * 100, INT16_MIN if not acquired
+    int16_t centi_humidity;    // % * 100, INT16_MIN if not acquired
+} sample_batch_item_t;
+
+typedef struct
+{
+    size_t publish_len;
+    size_t len;
+    uint64_t first_ms;        // time of the first reading
+    uint64_t last_ms;         // time of the last reading, as rebuilt from the deltas
+    uint64_t next_reading_ms; // when the next reading is due
+    sample_batch_item_t items[SAMPLE_BATCH_MAX_LEN];
+} sample_batch_t;
+
+typedef struct
+{
+    size_t n;         // next reading, from the oldest (n = 0)
+    uint64_t time_ms; // time of the reading before it, as rebuilt from the deltas
+} sample_batch_cursor_t;
+
+/*
+ * sample_batch_init empties the batch, to be published every publish_len readings (at most SAMPLE_BATCH_MAX_LEN),
+ *   and makes the first reading due at now_ms.
+ */
+void sample_batch_init(sample_batch_t *batch, size_t publish_len, uint64_t now_ms);
+
+/*
+ * sample_batch_on_wake returns what the wake-up at now_ms has to do: publish if the button was pressed or the batch
+ *   is complete, read if a reading is due, and sleep otherwise.
+ */
+sample_batch_action_t sample_batch_on_wake(const sample_batch_t *batch, sample_batch_wake_t wake, uint64_t now_ms);
+
+/*
+ * sample_batch_push appends a reading taken at now_ms, NAN for a channel not acquired, and schedules the next one
+ *   period_ms after the one that was due; readings missed meanwhile, e.g. while the batch was being published, are
+ *   skipped rather than caught up.
+ * Readings pushed once the batch holds SAMPLE_BATCH_MAX_LEN are dropped, and false is returned.
+ */
+bool sample_batch_push(sample_batch_t *batch, float temperature, float humidity, uint64_t now_ms, uint32_t period_ms);
+
+/*
+ * sample_batch_sleep_ms returns how long to sleep, from now_ms, until the next wake-up has something to do: 0 if the
+ *   batch is complete, or a reading is already due.
+ */
+uint64_t sample_batch_sleep_ms(const sample_batch_t *batch, uint64_t now_ms);
+
+size_t sample_batch_len(const sample_batch_t *batch);
+
+/*
+ * sample_batch_begin returns a cursor on the oldest reading of the batch, for sample_batch_next.
+ */
+sample_batch_cursor_t sample_batch_begin(const sample_batch_t *batch);
+
+/*
+ * sample_batch_next copies the reading under the cursor, and the time it was taken at, to the second, then moves the
+ *   cursor to the next one; channels not acquired are NAN. Each call adds a single delta to the time of the previous
+ *   reading, so reading the whole batch costs O(len).
+ * It returns the number of readings copied, 0 once past the newest one.
+ */
+size_t sample_batch_next(const sample_batch_t *batch, sample_batch_cursor_t *cursor, uint64_t *time_ms,
+                         float *temperature, float *humidity);
+
+/*
+ * sample_batch_clear empties the batch, once published; the next reading stays due when it was.
+ */
+void sample_batch_clear(sample_batch_t *batch);
@@ -0,0 +1,104 @@
+/*
+ * A bus fanning out samples from one producer to several consumers, each with its own queue.
+ * Every consumer chooses what happens when its queue is full:
+ *   - SAMPLE_BUS_OVERWRITE_OLDEST: the oldest queued sample is dropped to make room for the new one,
+ *   - SAMPLE_BUS_BLOCK: the producer waits up to max_block_ms for room, then the new sample is dropped.
+ * The producer never waits longer than the sum of the blocking consumers' max_block_ms, so a stalled consumer
+ *   can't delay the producer's next cycle as long as that sum is shorter than the producer's period.
+ * Dropped samples are counted per consumer, together with late samples: samples that were delivered while a
+ *   newer one was already queued behind them.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "sample_bus.h"
+ *
+ * static sample_bus_consumer_t consumers_[2];
+ *
+ * int main(void)
+ * {
+ *     sample_bus_t bus = sample_bus_init(sizeof(float), consumers_, 2);
+ *     sample_bus_consumer_t *latest = sample_bus_subscribe(&bus, "latest", 1, SAMPLE_BUS_OVERWRITE_OLDEST, 0);
+ *     sample_bus_consumer_t *history = sample_bus_subscribe(&bus, "history", 8, SAMPLE_BUS_BLOCK, 100);
+ *
+ *     float sample = 5;
+ *     sample_bus_publish(&bus, &sample);
+ *
+ *     sample_bus_receive(history, &sample, portMAX_DELAY);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAMPLE_BUS_MAX_ITEM_SIZE 128 // largest sample that can be published, in bytes
+
+typedef enum
+{
+    SAMPLE_BUS_OVERWRITE_OLDEST = 0,
+    SAMPLE_BUS_BLOCK
+} sample_bus_policy_t;
+
+typedef struct
+{
+    uint32_t delivered; // samples received by the consumer
+    uint32_t dropped;   // samples that never reached the consumer
+    uint32_t late;      // samples received while a newer one was already queued
+} sample_bus_counters_t;
+
+typedef struct
+{
+    const char *name;
+    QueueHandle_t queue;
+    size_t depth;
+    sample_bus_policy_t policy;
+    TickType_t max_block_ticks;
+    sample_bus_counters_t counters;
+} sample_bus_consumer_t;
+
+typedef struct
+{
+    size_t item_size;
+    sample_bus_consumer_t *consumers;
+    size_t consumers_capacity;
+    size_t consumers_len;
+} sample_bus_t;
+
+/*
+ * sample_bus_init creates a new sample bus for items of item_size bytes, with room for up to consumers_capacity
+ *   consumers.
+ * It assumes consumers is provided by the application writer and exists for the entire lifetime of the program.
+ * It returns the new sample_bus.
+ */
+sample_bus_t sample_bus_init(size_t item_size, sample_bus_consumer_t consumers[], size_t consumers_capacity);
+
+/*
+ * sample_bus_subscribe adds a consumer with a queue holding up to depth samples.
+ * max_block_ms is only used with SAMPLE_BUS_BLOCK.
+ * It returns the new consumer, or NULL if the bus is full or the queue can't be allocated.
+ */
+sample_bus_consumer_t *sample_bus_subscribe(sample_bus_t *bus, const char *name, size_t depth,
+                                            sample_bus_policy_t policy, uint32_t max_block_ms);
+
+/*
+ * sample_bus_publish copies item into the queue of every consumer.
+ * It returns the number of consumers the item couldn't be delivered to.
+ */
+size_t sample_bus_publish(sample_bus_t *bus, const void *item);
+
+/*
+ * sample_bus_receive moves the oldest sample queued for the consumer into dst, waiting up to ticks_to_wait.
+ * It returns false if no sample was received.
+ */
+bool sample_bus_receive(sample_bus_consumer_t *consumer, void *dst, TickType_t ticks_to_wait);
+
+/*
+ * sample_bus_get_counters copies the consumer's counters into dst.
+ * It's safe to call from any task.
+ */
+void sample_bus_get_counters(const sample_bus_consumer_t *consumer, sample_bus_counters_t *dst);
@@ -0,0 +1,157 @@
+/*
+ * The sample store holds the history of every sample, as timestamped records of a fixed number of fields.
+ * It's written once per sample, by a single task, and read by every module needing the history (lcd, statistics,
+ *   BLE, diagnostics) through read-only queries, each asking for the fields and the number of records it needs.
+ * Fields that weren't acquired in a sample are NAN, and queries on a field skip them, so channels read less often
+ *   than others share the same records.
+ * Values are stored field by field (struct of arrays), so that the queries, which scan the history of a single field,
+ *   read contiguous memory, and records are written whole, under a single mutex round-trip per append.
+ * No allocations are made on the heap; instead, memory is provided by the application writer.
+ * It's safe to use with multiple consumers; a mutex is held for the whole of each call.
+ * Readers scanning the whole history can also read it in place, without copying it, as the (up to) two contiguous
+ *   spans either side of the point where the store wraps around, each holding the records in chronological order.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "sample_store.h"
+ *
+ * static float values_[240 * 2];
+ * static uint32_t timestamps_ms_[240];
+ *
+ * int main(void)
+ * {
+ *     sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 240, 240);
+ *
+ *     float record[2] = {21.5, 40};
+ *     sample_store_append(&store, 30000, record);
+ *
+ *     float temperatures[10];
+ *     size_t count = sample_store_query(&store, 0, 10, temperatures, NULL);
+ *
+ *     sample_store_span_t spans[2];
+ *     sample_store_lock_spans(&store, spans);
+ *     for (size_t s = 0; s < 2; s++)
+ *     {
+ *         const float *span_temperatures = sample_store_span_values(&store, &spans[s], 0);
+ *         for (size_t i = 0; i < spans[s].len; i++)
+ *             printf("%f\n", span_temperatures[i]);
+ *     }
+ *     sample_store_unlock_spans(&store);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    float *values;           // fields_len columns of max_capacity values, one column per field
+    uint32_t *timestamps_ms; // time of each record, since boot
+    size_t fields_len;
+    size_t max_capacity;
+    size_t capacity;
+    size_t count;
+    size_t head; // index of the newest record
+    SemaphoreHandle_t mutex;
+} sample_store_t;
+
+typedef struct
+{
+    size_t first; // index of the span's oldest record, in the column of every field
+    size_t len;
+} sample_store_span_t;
+
+/*
+ * sample_store_init creates a new sample store of capacity records, each of fields_len values, which can be resampled
+ *   up to max_capacity records.
+ * It assumes values and timestamps_ms are provided by the application writer, hold max_capacity records, and exist for
+ *   the entire lifetime of the program.
+ * It returns the new sample_store.
+ */
+sample_store_t sample_store_init(float values[], uint32_t timestamps_ms[], size_t fields_len, size_t max_capacity,
+                                 size_t capacity);
+
+/*
+ * sample_store_append adds a new record of fields_len values, overwriting the oldest one if necessary.
+ * Fields not acquired must be NAN.
+ */
+void sample_store_append(sample_store_t *store, uint32_t timestamp_ms, const float values[]);
+
+/*
+ * sample_store_get_record copies the record added n appends ago into timestamp_ms and values, i.e. n == 0 is the newest
+ *   record; values must hold fields_len values.
+ * It returns the number of records retrieved, i.e. 0 if no such record exists, 1 otherwise.
+ */
+size_t sample_store_get_record(const sample_store_t *store, size_t n, uint32_t *timestamp_ms, float values[]);
+
+/*
+ * sample_store_get_value gets the value of field in the record added n appends ago, i.e. n == 0 is the newest record;
+ *   the value is NAN if the field wasn't acquired in that record. Unlike sample_store_get_nth, it costs O(1).
+ * It returns the number of values retrieved, i.e. 0 if no such record exists, 1 otherwise.
+ */
+size_t sample_store_get_value(const sample_store_t *store, size_t field, size_t n, float *dst);
+
+/*
+ * sample_store_get_nth gets the nth newest value of field, i.e. n == 0 is its latest value, skipping the records
+ *   without it.
+ * It returns the number of values retrieved, i.e. 0 if no such value exists, 1 otherwise.
+ */
+size_t sample_store_get_nth(const sample_store_t *store, size_t field, size_t n, float *dst);
+
+/*
+ * sample_store_query copies up to max_count of the latest values of field into dst, newest first, skipping the
+ *   records without it; if timestamps_ms isn't NULL, the time of each value is copied into it.
+ * It returns the number of values copied.
+ */
+size_t sample_store_query(const sample_store_t *store, size_t field, size_t max_count, float dst[],
+                          uint32_t timestamps_ms[]);
+
+/*
+ * sample_store_count returns the number of records stored, at most the capacity of the store.
+ */
+size_t sample_store_count(const sample_store_t *store);
+
+/*
+ * sample_store_capacity returns the number of records the store can hold.
+ */
+size_t sample_store_capacity(const sample_store_t *store);
+
+/*
+ * sample_store_resample changes the capacity of the store, keeping the records it holds.
+ * Record n of the resampled store is the record added n * step appends ago, with values and timestamp linearly
+ *   interpolated between the records around it: a step of 2 keeps every other record, e.g. when records are appended
+ *   half as often from now on. Records older than the oldest one, or beyond the new capacity, are dropped.
+ * new_capacity must not exceed the max_capacity given to sample_store_init.
+ */
+void sample_store_resample(sample_store_t *store, size_t new_capacity, float step);
+
+/*
+ * sample_store_lock_spans takes the store's mutex and splits the records stored into spans, without copying them:
+ *   spans[0] holds the oldest records, spans[1] the newer ones stored from the start of the store after it wrapped
+ *   around, if any; both in chronological order.
+ * The spans are valid until sample_store_unlock_spans, which must follow as soon as possible, as appends block
+ *   meanwhile; no other function of the store may be called in between.
+ * It returns the number of records in the two spans.
+ */
+size_t sample_store_lock_spans(const sample_store_t *store, sample_store_span_t spans[2]);
+
+/*
+ * sample_store_unlock_spans releases the mutex taken by sample_store_lock_spans; the spans mustn't be used afterwards.
+ */
+void sample_store_unlock_spans(const sample_store_t *store);
+
+/*
+ * sample_store_span_values returns the span->len values of field in the records of span, NAN where the field wasn't
+ *   acquired.
+ */
+const float *sample_store_span_values(const sample_store_t *store, const sample_store_span_t *span, size_t field);
+
+/*
+ * sample_store_span_timestamps returns the span->len timestamps of the records of span.
+ */
+const uint32_t *sample_store_span_timestamps(const sample_store_t *store, const sample_store_span_t *span);
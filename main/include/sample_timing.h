@@ -0,0 +1,99 @@
+/*
+ * Instrumentation of a periodic acquisition: for every sample, the scheduled and the actual acquisition time are
+ *   recorded, and their difference (the lateness) is accumulated into a histogram, together with the number of
+ *   samples later than the deadline.
+ * Histogram bins grow exponentially: bin 0 counts samples less than SAMPLE_TIMING_BIN0_US late (or early), bin n
+ *   samples less than SAMPLE_TIMING_BIN0_US * 2^n late, and the last bin all the others.
+ * The module also holds the retry policy of a failed acquisition: retries are bounded both in number and in total
+ *   time, and wait exponentially longer between each other, so that a failing bus is neither hammered in a tight
+ *   loop nor allowed to delay the next acquisition.
+ * The module doesn't read any clock and isn't thread-safe: the caller passes the timestamps, and guards the
+ *   instance with a lock if it's read by other tasks.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "sample_timing.h"
+ *
+ * int main(void)
+ * {
+ *     sample_timing_t timing;
+ *     sample_timing_init(&timing, 100000);
+ *     sample_timing_record(&timing, 30000000, 30000250);
+ *
+ *     sample_timing_retry_t retry = {.max_attempts = 3, .base_delay_ms = 100, .budget_ms = 1000};
+ *     uint32_t delay_ms;
+ *     for (uint32_t attempt = 0, elapsed_ms = 0; acquire() != ESP_OK; attempt++, elapsed_ms += delay_ms)
+ *     {
+ *         if (!sample_timing_retry_delay(&retry, attempt, elapsed_ms, &delay_ms))
+ *             break;
+ *         vTaskDelay(delay_ms / portTICK_PERIOD_MS);
+ *     }
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAMPLE_TIMING_BINS 10       // the last bin counts samples at least 25.6 ms late
+#define SAMPLE_TIMING_BIN0_US 100   // upper bound of the first bin
+#define SAMPLE_TIMING_RECENT_LEN 16 // samples whose timestamps are kept
+
+typedef struct
+{
+    int64_t scheduled_us;
+    int64_t actual_us;
+} sample_timing_record_t;
+
+typedef struct
+{
+    uint32_t deadline_us; // samples later than this miss their deadline
+    uint32_t samples;
+    uint32_t missed_deadlines;
+    uint32_t histogram[SAMPLE_TIMING_BINS];
+    int64_t min_lateness_us;
+    int64_t max_lateness_us;
+    int64_t total_lateness_us;
+    sample_timing_record_t recent[SAMPLE_TIMING_RECENT_LEN]; // the last samples, oldest overwritten first
+    uint32_t retries;                                        // acquisitions retried after a failure
+    uint32_t gave_up;                                        // acquisitions still failing after the last retry
+} sample_timing_t;
+
+typedef struct
+{
+    uint32_t max_attempts;  // retries after the first failure
+    uint32_t base_delay_ms; // delay before the first retry, doubled at each one
+    uint32_t budget_ms;     // retries stop once their delays would add up to more than this
+} sample_timing_retry_t;
+
+/*
+ * sample_timing_init resets the statistics.
+ */
+void sample_timing_init(sample_timing_t *timing, uint32_t deadline_us);
+
+/*
+ * sample_timing_record adds a sample, scheduled at scheduled_us and acquired at actual_us, to the statistics.
+ */
+void sample_timing_record(sample_timing_t *timing, int64_t scheduled_us, int64_t actual_us);
+
+/*
+ * sample_timing_get_recent writes into dst the timestamps of the nth most recent sample (0 being the latest).
+ * It returns false if there's no such sample.
+ */
+bool sample_timing_get_recent(const sample_timing_t *timing, size_t nth, sample_timing_record_t *dst);
+
+/*
+ * sample_timing_mean_lateness_us returns the mean lateness of the samples, or 0 if there are none.
+ */
+int64_t sample_timing_mean_lateness_us(const sample_timing_t *timing);
+
+/*
+ * sample_timing_retry_delay writes into delay_ms how long to wait before retry number attempt (starting from 0),
+ *   given that the previous retries already waited elapsed_ms.
+ * It returns false if the acquisition should be given up instead.
+ */
+bool sample_timing_retry_delay(const sample_timing_retry_t *retry, uint32_t attempt, uint32_t elapsed_ms,
+                               uint32_t *delay_ms);
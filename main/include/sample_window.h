@@ -0,0 +1,71 @@
+/*
+ * Statistics window over one field of the sample store, i.e. the window of stats.h kept in step with the history it
+ *   is computed on: the item leaving the window is read back from the store, never copied.
+ * The window tracks how many appends ago its oldest item was stored, so that item is read back in O(1), however many
+ *   records without the field lie in between; records whose field is NAN are skipped, so a window over a field that
+ *   isn't acquired every time holds fewer readings than its capacity, but never one older than the store.
+ * The module doesn't lock the store: the caller serializes the appends and the window updates, e.g. with a mutex.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "sample_window.h"
+ *
+ * static float values_[2 * 240];
+ * static uint32_t timestamps_ms_[240];
+ * static float history[120];
+ * static uint16_t stats_bins_[400];
+ *
+ * int main(void)
+ * {
+ *     sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 240, 240);
+ *
+ *     // 120 temperatures taken every 30 seconds, histogram with 0.25 wide bins in range [0, 100)
+ *     size_t history_len = sample_store_query(&store, 0, 120, history, NULL);
+ *     sample_window_t win;
+ *     sample_window_init(&win, stats_window_init(stats_bins_, 400, 0, 0.25, 120, 30000), &store, 0, history,
+ *                        history_len);
+ *
+ *     float record[2] = {21.5, 40};
+ *     sample_window_evict(&win, &store, record[0]);
+ *     sample_store_append(&store, 30000, record);
+ *     sample_window_push(&win, record[0]);
+ *
+ *     stats_t stats;
+ *     stats_window_get(&win.stats, &stats);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "sample_store.h"
+#include "stats.h"
+
+#include <stddef.h>
+
+typedef struct
+{
+    stats_window_t stats;
+    size_t field;      // field of the sample store the window is computed on
+    size_t oldest_age; // appends ago the oldest item of the window was stored, if it isn't empty
+} sample_window_t;
+
+/*
+ * sample_window_init creates the window over field of store, with stats, an empty statistics window, filled with
+ *   the readings already in the store: history must hold the latest values of field as returned by
+ *   sample_store_query, at least as many as the window's capacity or all of them.
+ */
+void sample_window_init(sample_window_t *win, stats_window_t stats, const sample_store_t *store, size_t field,
+                        const float history[], size_t history_len);
+
+/*
+ * sample_window_evict removes the oldest item of the window, if new_item is going to take its place, or if it's
+ *   going to be overwritten in the store. It must be called right before appending the record holding new_item.
+ */
+void sample_window_evict(sample_window_t *win, const sample_store_t *store, float new_item);
+
+/*
+ * sample_window_push adds new_item, the value of field in the record just appended, to the window; NAN is skipped.
+ *   It must be called right after the append, once sample_window_evict made room.
+ */
+void sample_window_push(sample_window_t *win, float new_item);
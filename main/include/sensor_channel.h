@@ -0,0 +1,162 @@
+/*
+ * Sensor channels: every quantity read from a sensor on the I2C bus is a channel.
+ * A channel is described by a static descriptor (quantity, multiplexer port, acquisition schedule, read function and
+ *   BLE characteristic), and owns the statistics windows computed over its history, which is held by the sample store
+ *   together with the metrics derived from the channels (see sample_field_t).
+ *
+ * sensor_channel_acquire reads all the channels due in the current cycle within a single acquisition of the I2C bus,
+ *   grouped by multiplexer port, so each channel only adds its own transactions: adding channels requires neither new
+ *   tasks nor new queues.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "sensor_channel.h"
+ *
+ * int main(void)
+ * {
+ *     sensor_channel_init(&store, 30000);
+ *     for (uint32_t cycle = 0;; cycle++)
+ *     {
+ *         sensor_sample_t sample;
+ *         sensor_channel_acquire(cycle, &sample);
+ *         float record[SAMPLE_FIELD_COUNT];
+ *         sensor_sample_to_record(&sample, record);
+ *         sensor_channel_store(sample.timestamp_ms, record);
+ *         sensor_channel_write_ble(&sample);
+ *     }
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "sample_store.h"
+#include "stats.h"
+
+#include "esp_err.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SENSOR_CHANNEL_NO_MUX -1 // the sensor is wired directly to the I2C bus
+
+typedef enum
+{
+    SENSOR_QUANTITY_TEMPERATURE = 0, // °C
+    SENSOR_QUANTITY_HUMIDITY,        // %
+    SENSOR_QUANTITY_PRESSURE,        // hPa
+    SENSOR_QUANTITY_COUNT
+} sensor_quantity_t;
+
+typedef enum
+{
+    SENSOR_CHANNEL_TEMPERATURE = 0,
+    SENSOR_CHANNEL_HUMIDITY,
+#if CONFIG_SENSOR_SECOND_SHT21
+    SENSOR_CHANNEL_TEMPERATURE_2,
+    SENSOR_CHANNEL_HUMIDITY_2,
+#endif
+    SENSOR_CHANNEL_COUNT
+} sensor_channel_id_t;
+
+// fields of the sample store records: the sensor channels, then the metrics derived from them
+typedef enum
+{
+    SAMPLE_FIELD_DEW_POINT = SENSOR_CHANNEL_COUNT,
+    SAMPLE_FIELD_ABSOLUTE_HUMIDITY,
+    SAMPLE_FIELD_HEAT_INDEX,
+    SAMPLE_FIELD_COUNT
+} sample_field_t;
+
+typedef enum
+{
+    SENSOR_CHANNEL_STATS_WINDOW_SHORT = 0,
+    SENSOR_CHANNEL_STATS_WINDOW_MEDIUM,
+    SENSOR_CHANNEL_STATS_WINDOW_LONG,
+    SENSOR_CHANNEL_STATS_WINDOW_COUNT
+} sensor_channel_stats_window_t;
+
+typedef struct
+{
+    const char *name;
+    sensor_quantity_t quantity;
+    int8_t mux_port;            // port of the I2C multiplexer the sensor is behind, or SENSOR_CHANNEL_NO_MUX
+    uint32_t period_multiplier; // the channel is acquired every period_multiplier cycles
+    esp_err_t (*read)(float *dst);
+    esp_err_t (*ble_write)(float value); // NULL if the channel isn't exposed over BLE
+} sensor_channel_desc_t;
+
+typedef struct
+{
+    float values[SENSOR_CHANNEL_COUNT];
+    uint32_t acquired;     // bit n is set if values[n] was acquired in this cycle
+    uint32_t cycle;        // cycle the sample was acquired in
+    uint32_t timestamp_ms; // time of the acquisition, since boot
+} sensor_sample_t;
+
+_Static_assert(SENSOR_CHANNEL_COUNT <= 32, "sensor_sample_t.acquired can't hold all the channels");
+
+static inline bool sensor_sample_has(const sensor_sample_t *sample, sensor_channel_id_t id)
+{
+    return (sample->acquired >> id) & 1U;
+}
+
+/*
+ * sensor_sample_to_record copies the channels of the sample into the first fields of a sample store record, NAN for
+ *   those not acquired; the derived metrics are left to the caller.
+ */
+static inline void sensor_sample_to_record(const sensor_sample_t *sample, float record[SAMPLE_FIELD_COUNT])
+{
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        record[id] = sensor_sample_has(sample, id) ? sample->values[id] : NAN;
+    }
+}
+
+/*
+ * sensor_channel_init initializes the I2C bus, the multiplexer and the channels' statistics, for channels read every
+ *   read_period_ms (times their period_multiplier) and whose history is held by store, of SAMPLE_FIELD_COUNT fields.
+ */
+esp_err_t sensor_channel_init(sample_store_t *store, uint32_t read_period_ms);
+
+const sensor_channel_desc_t *sensor_channel_get_desc(sensor_channel_id_t id);
+
+/*
+ * sensor_channel_acquire reads the channels due in the given cycle, clamped to the range of their quantity.
+ * Channels that fail to be read are left out of dst->acquired; the first error is returned.
+ */
+esp_err_t sensor_channel_acquire(uint32_t cycle, sensor_sample_t *dst);
+
+/*
+ * sensor_channel_store appends a record of SAMPLE_FIELD_COUNT fields to the sample store, and adds the channels it
+ *   holds to their statistics windows.
+ * Only the sample store's writer calls it, so that the windows always match the history.
+ */
+void sensor_channel_store(uint32_t timestamp_ms, const float record[]);
+
+/*
+ * sensor_channel_write_ble updates the BLE characteristics of the acquired channels; the first error is returned.
+ */
+esp_err_t sensor_channel_write_ble(const sensor_sample_t *sample);
+
+/*
+ * sensor_channel_get_stats_window_minutes returns the actual length of the statistics window: the short and medium
+ *   ones can be shorter than configured if the history can't hold enough readings, the long one averages readings
+ *   instead, and always covers its length.
+ */
+uint32_t sensor_channel_get_stats_window_minutes(sensor_channel_id_t id, sensor_channel_stats_window_t window);
+
+size_t sensor_channel_get_stats(sensor_channel_id_t id, sensor_channel_stats_window_t window, stats_t *dst);
+
+/*
+ * sensor_channel_get_error_count returns the number of failed readings of the channel since boot.
+ */
+uint32_t sensor_channel_get_error_count(sensor_channel_id_t id);
+
+/*
+ * sensor_channel_reconfigure applies a new period and history length: the records already in the sample store are
+ *   resampled to the new period rather than discarded, and the statistics windows are rebuilt over them.
+ * It returns ESP_ERR_INVALID_ARG if history_len is 0 or longer than CONFIG_HISTORY_MAX_LEN.
+ */
+esp_err_t sensor_channel_reconfigure(uint32_t read_period_ms, size_t history_len);
@@ -0,0 +1,60 @@
+/*
+ * Settings changed at runtime, through the BLE Settings characteristic or the diagnostics console, and persisted in
+ *   NVS so that they survive a reboot; the Kconfig values are only the defaults for a freshly flashed device.
+ * The module also owns the initialization of the NVS partition, which the BT host uses too.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "settings.h"
+ *
+ * int main(void)
+ * {
+ *     settings_init();
+ *     settings_t settings;
+ *     settings_load(&settings);
+ *     settings.read_period_ms = 60000;
+ *     if (settings_validate(&settings))
+ *         settings_save(&settings);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SETTINGS_READ_PERIOD_MIN_MS 1000    // leaves room for the slowest SHT21 measurement and its retries
+#define SETTINGS_READ_PERIOD_MAX_MS 3600000 // one hour
+#define SETTINGS_HISTORY_MIN_LEN 2          // the trend needs at least two readings
+#define SETTINGS_HISTORY_MAX_LEN CONFIG_HISTORY_MAX_LEN
+
+typedef struct
+{
+    uint32_t read_period_ms; // how often the sensor channels are read
+    uint32_t history_len;    // readings held in the history of each channel and derived metric
+} settings_t;
+
+/*
+ * settings_init initializes the NVS partition, erasing it if it's full or was written by a newer NVS version.
+ */
+esp_err_t settings_init(void);
+
+/*
+ * settings_validate returns true if every setting is within its range.
+ */
+bool settings_validate(const settings_t *settings);
+
+/*
+ * settings_load reads the settings stored in NVS into dst.
+ * Settings never stored, or out of range, are replaced by their Kconfig defaults.
+ * On error, dst holds the defaults.
+ */
+esp_err_t settings_load(settings_t *dst);
+
+/*
+ * settings_save stores the settings in NVS.
+ * It returns ESP_ERR_INVALID_ARG, without storing anything, if any setting is out of range.
+ */
+esp_err_t settings_save(const settings_t *settings);
@@ -0,0 +1,108 @@
+/*
+ * Running statistics over a sliding window of the most recent items of a history, e.g. the sample store.
+ * Every update costs O(1), regardless of the window length:
+ *   - mean and standard deviation are kept with Welford's algorithm, extended to remove the item leaving the window,
+ *   - the trend is the least-squares slope over the window, kept through a running index-weighted sum,
+ *   - percentiles are read from a histogram with fixed bin width (resolution is one bin).
+ * With CONFIG_STATS_FIXED_POINT, items are rounded to hundredths and accumulated as integers instead: plain sums,
+ *   of the items and of their squares, are then exact, and need no double arithmetic, for targets without an FPU.
+ *   Only the accumulators are fixed point: items still come in as floats, so each update converts the item entering
+ *   and the one leaving the window with a float multiplication and lroundf, emulated in software on such targets.
+ *   Items are clamped to +-STATS_FIXED_POINT_MAX.
+ * No allocations are made on the heap; memory for the histogram is provided by the application writer.
+ *
+ * The window doesn't keep its items: the history does, and the item leaving the window is passed back to
+ *   stats_window_push, or to stats_window_pop when it leaves the history first.
+ *
+ * Example (without error checking):
+ * ```c
+ * #include "stats.h"
+ * #include <math.h>
+ *
+ * static float history[240];
+ * static uint16_t stats_bins_[400];
+ *
+ * int main(void)
+ * {
+ *     // 120 readings taken every 30 seconds, histogram with 0.25 wide bins in range [0, 100)
+ *     stats_window_t win = stats_window_init(stats_bins_, 400, 0, 0.25, 120, 30000);
+ *
+ *     for (size_t i = 0; i < 240; i++)
+ *         stats_window_push(&win, history[i], i >= 120 ? history[i - 120] : NAN);
+ *
+ *     stats_t stats;
+ *     stats_window_get(&win, &stats);
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "sdkconfig.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_FIXED_POINT_SCALE 100 // items are accumulated in hundredths, with CONFIG_STATS_FIXED_POINT
+#define STATS_FIXED_POINT_MAX ((float)(1 << 23) / STATS_FIXED_POINT_SCALE) // squares of a full window fit int64
+
+typedef struct
+{
+    uint16_t *bins;
+    size_t bins_len;
+    float bins_min;
+    float bin_width;
+    size_t capacity;
+    uint32_t sample_period_ms;
+    size_t count;
+#if CONFIG_STATS_FIXED_POINT
+    int32_t fixed_bins_min; // bins_min and bin_width, in hundredths
+    int32_t fixed_bin_width;
+    int64_t sum;
+    int64_t sum_sq;
+    int64_t index_sum; // sum of each item multiplied by its position in the window (0 is the oldest)
+#else
+    // accumulators are doubles so that rounding errors don't build up while items enter and leave the window
+    double mean;
+    double m2;
+    double sum;
+    double index_sum; // sum of each item multiplied by its position in the window (0 is the oldest)
+#endif
+} stats_window_t;
+
+typedef struct
+{
+    size_t count; // number of items in the window
+    float mean;
+    float stddev; // sample standard deviation, 0 with less than 2 items
+    float p10;
+    float p90;
+    float trend; // rate of change per hour, 0 with less than 2 items
+} stats_t;
+
+/*
+ * stats_window_init creates a new statistics window holding up to window_len items.
+ * It assumes bins is provided by the application writer and exists for the entire lifetime of the program.
+ * Items outside [bins_min, bins_min + bins_len * bin_width) are accounted in the first or last bin.
+ * With CONFIG_STATS_FIXED_POINT, bins_min and bin_width are rounded to hundredths, and bin_width must be at least 0.01.
+ * It returns the new stats_window.
+ */
+stats_window_t stats_window_init(uint16_t bins[], size_t bins_len, float bins_min, float bin_width, size_t window_len,
+                                 uint32_t sample_period_ms);
+
+/*
+ * stats_window_push adds a new item to the window, removing oldest_item if the window is full: it must then be the
+ *   item pushed window_len items ago, and is ignored otherwise.
+ */
+void stats_window_push(stats_window_t *win, float new_item, float oldest_item);
+
+/*
+ * stats_window_pop removes oldest_item, which must be the oldest item in the window, e.g. when it leaves the history
+ *   before the window is full; the window must not be empty.
+ */
+void stats_window_pop(stats_window_t *win, float oldest_item);
+
+/*
+ * stats_window_get computes the statistics for the items currently in the window.
+ * It returns the number of items in the window; if 0, dst is left untouched.
+ */
+size_t stats_window_get(const stats_window_t *win, stats_t *dst);
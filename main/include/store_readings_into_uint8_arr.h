@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+#define STORE_READINGS_LEN 8              // temperature, humidity, sequence number, age
+#define STORE_READINGS_AGE_UNKNOWN 0xFFFF // age of readings never taken, or older than 0xFFFE seconds
+
+/*
+ * store_readings_into_uint8_arr stores temperature and humidity as the Temperature and Humidity characteristics do,
+ *   followed by the sequence number and the age in seconds, as 16-bit unsigned integers.
+ * Values that can't be represented are stored as 'value is not known', and ages too large saturate to
+ *   STORE_READINGS_AGE_UNKNOWN.
+ */
+void store_readings_into_uint8_arr(float temperature, float humidity, uint16_t seq, uint32_t age_s,
+                                   uint8_t arr[STORE_READINGS_LEN]);
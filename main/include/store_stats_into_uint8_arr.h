@@ -0,0 +1,13 @@
+#pragma once
+
+#include "stats.h"
+
+#include <stdint.h>
+
+#define STORE_STATS_LEN 10 // mean, standard deviation, 10th and 90th percentile, trend
+
+/*
+ * store_stats_into_uint8_arr stores the statistics as 16-bit signed integers with resolution of 0.01.
+ * Statistics with count 0 are stored as 0x8000, meaning 'value is not known'.
+ */
+void store_stats_into_uint8_arr(const stats_t *stats, uint8_t arr[STORE_STATS_LEN]);
@@ -5,12 +5,18 @@
 #include "lcd.h"
 
 #include "envi_config.h"
-#include "ringbuf.h"
+#include "sample_store.h"
+#include "sensor_channel.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
 #include "ssd1306.h"
 #include <assert.h>
+#include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 //==================================================================================================
@@ -27,6 +33,8 @@
 #define SCREEN_WIDTH (84 / CHAR_WIDTH)
 #define SCREEN_HEIGHT (48 / CHAR_HEIGHT)
 
+#define TENTHS_LEN 16 // sign, digits of an int, point, tenth, terminator
+
 //==================================================================================================
 // ENUMS - STRUCTS - TYPEDEFS
 //==================================================================================================
@@ -34,8 +42,15 @@
 typedef enum
 {
     LCD_VIEW_CURRENT_READINGS = 0,
+    LCD_VIEW_DERIVED_METRICS,
     LCD_VIEW_TEMPERATURE_ANALYSIS,
     LCD_VIEW_HUMIDITY_ANALYSIS,
+    LCD_VIEW_TEMPERATURE_STATS_SHORT,
+    LCD_VIEW_TEMPERATURE_STATS_MEDIUM,
+    LCD_VIEW_TEMPERATURE_STATS_LONG,
+    LCD_VIEW_HUMIDITY_STATS_SHORT,
+    LCD_VIEW_HUMIDITY_STATS_MEDIUM,
+    LCD_VIEW_HUMIDITY_STATS_LONG,
     LCD_VIEW_COUNT
 } lcd_view_t;
 
@@ -45,12 +60,25 @@ typedef enum
 
 static void initialize_my_font_6x8(void);
 
+static void render_view(lcd_view_t view);
+
 static void render_current_readings(void);
 
+static void render_derived_metrics(void);
+
 static void render_temperature_analysis(void);
 
 static void render_humidity_analysis(void);
 
+static void render_stats(const char *title, sensor_channel_id_t id, sensor_channel_stats_window_t window,
+                         const char *unit);
+
+static const char *format_tenths(float value, bool plus_sign, char dst[TENTHS_LEN]);
+
+static size_t get_sorted_history(size_t field, float dst[CONFIG_HISTORY_MAX_LEN]);
+
+static int compare_floats(const void *a, const void *b);
+
 //==================================================================================================
 // STATIC VARIABLES
 //==================================================================================================
@@ -63,25 +91,27 @@ static void render_humidity_analysis(void);
  */
 static uint8_t my_font_6x8[MY_FONT_6x8_LEN];
 
-/* Ring-buffers for temperature and humidity */
-static ringbuf_t ringbuf_lcd_temperature;
-static ringbuf_t ringbuf_lcd_humidity;
-
-/* Memory reserved for holding ring-buffers' data */
-static float ringbuf_lcd_temperature_data_[CONFIG_LCD_RINGBUF_DATA_LEN];
-static float ringbuf_lcd_humidity_data_[CONFIG_LCD_RINGBUF_DATA_LEN];
+// store holds the readings and derived metrics shown in the views
+static const sample_store_t *store = NULL;
 
 // lcd_view determines which view is rendered on the lcd
 static lcd_view_t lcd_view = LCD_VIEW_CURRENT_READINGS;
 
+// render_timing is written by the rendering task and read by the diagnostics console
+static lcd_render_timing_t render_timing;
+static portMUX_TYPE render_timing_lock = portMUX_INITIALIZER_UNLOCKED;
+
 //==================================================================================================
 // GLOBAL FUNCTIONS
 //==================================================================================================
 
-esp_err_t lcd_init(void)
+esp_err_t lcd_init(const sample_store_t *store_)
 {
-    ringbuf_lcd_temperature = ringbuf_init(ringbuf_lcd_temperature_data_, CONFIG_LCD_RINGBUF_DATA_LEN);
-    ringbuf_lcd_humidity = ringbuf_init(ringbuf_lcd_humidity_data_, CONFIG_LCD_RINGBUF_DATA_LEN);
+    if (store_->fields_len != SAMPLE_FIELD_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    store = store_;
     initialize_my_font_6x8();
     ssd1306_setFixedFont(my_font_6x8);
     pcd8544_84x48_spi_init(LCD_RST_PIN, LCD_CE_PIN, LCD_DC_PIN);
@@ -89,35 +119,44 @@ esp_err_t lcd_init(void)
     return ESP_OK;
 }
 
-void lcd_store_temperature(float temperature)
+void lcd_select_first_view(void)
 {
-    ringbuf_put(&ringbuf_lcd_temperature, temperature);
+    lcd_view = LCD_VIEW_CURRENT_READINGS;
 }
 
-void lcd_store_humidity(float humidity)
+void lcd_select_next_view(void)
 {
-    ringbuf_put(&ringbuf_lcd_humidity, humidity);
+    lcd_view = (lcd_view + 1) % LCD_VIEW_COUNT;
 }
 
-void lcd_select_next_view(void)
+void lcd_select_previous_view(void)
 {
-    lcd_view = (lcd_view + 1) % LCD_VIEW_COUNT;
+    lcd_view = (lcd_view + LCD_VIEW_COUNT - 1) % LCD_VIEW_COUNT;
 }
 
 void lcd_render(void)
 {
     ESP_LOGD(ESP_LOG_TAG, "render view #%d", lcd_view);
-    switch (lcd_view)
+    int64_t start_us = esp_timer_get_time();
+    render_view(lcd_view);
+    uint32_t elapsed_us = esp_timer_get_time() - start_us;
+
+    portENTER_CRITICAL(&render_timing_lock);
+    render_timing.count++;
+    render_timing.last_us = elapsed_us;
+    render_timing.total_us += elapsed_us;
+    if (elapsed_us > render_timing.max_us)
     {
-    case LCD_VIEW_CURRENT_READINGS:
-        return render_current_readings();
-    case LCD_VIEW_TEMPERATURE_ANALYSIS:
-        return render_temperature_analysis();
-    case LCD_VIEW_HUMIDITY_ANALYSIS:
-        return render_humidity_analysis();
-    default:
-        assert(0);
+        render_timing.max_us = elapsed_us;
     }
+    portEXIT_CRITICAL(&render_timing_lock);
+}
+
+void lcd_get_render_timing(lcd_render_timing_t *dst)
+{
+    portENTER_CRITICAL(&render_timing_lock);
+    *dst = render_timing;
+    portEXIT_CRITICAL(&render_timing_lock);
 }
 
 //==================================================================================================
@@ -134,27 +173,83 @@ static void initialize_my_font_6x8(void)
     }
 }
 
+static void render_view(lcd_view_t view)
+{
+    switch (view)
+    {
+    case LCD_VIEW_CURRENT_READINGS:
+        return render_current_readings();
+    case LCD_VIEW_DERIVED_METRICS:
+        return render_derived_metrics();
+    case LCD_VIEW_TEMPERATURE_ANALYSIS:
+        return render_temperature_analysis();
+    case LCD_VIEW_HUMIDITY_ANALYSIS:
+        return render_humidity_analysis();
+    case LCD_VIEW_TEMPERATURE_STATS_SHORT:
+        return render_stats("Temp", SENSOR_CHANNEL_TEMPERATURE, SENSOR_CHANNEL_STATS_WINDOW_SHORT, "'C");
+    case LCD_VIEW_TEMPERATURE_STATS_MEDIUM:
+        return render_stats("Temp", SENSOR_CHANNEL_TEMPERATURE, SENSOR_CHANNEL_STATS_WINDOW_MEDIUM, "'C");
+    case LCD_VIEW_TEMPERATURE_STATS_LONG:
+        return render_stats("Temp", SENSOR_CHANNEL_TEMPERATURE, SENSOR_CHANNEL_STATS_WINDOW_LONG, "'C");
+    case LCD_VIEW_HUMIDITY_STATS_SHORT:
+        return render_stats("Hum", SENSOR_CHANNEL_HUMIDITY, SENSOR_CHANNEL_STATS_WINDOW_SHORT, " %");
+    case LCD_VIEW_HUMIDITY_STATS_MEDIUM:
+        return render_stats("Hum", SENSOR_CHANNEL_HUMIDITY, SENSOR_CHANNEL_STATS_WINDOW_MEDIUM, " %");
+    case LCD_VIEW_HUMIDITY_STATS_LONG:
+        return render_stats("Hum", SENSOR_CHANNEL_HUMIDITY, SENSOR_CHANNEL_STATS_WINDOW_LONG, " %");
+    default:
+        assert(0);
+    }
+}
+
 static void render_current_readings(void)
 {
     ssd1306_clearScreen();
     ssd1306_printFixed(24, 0, "Envi", STYLE_ITALIC);
     ssd1306_printFixed(16, 8, "Sensor", STYLE_ITALIC);
 
-    float temperature;
-    float humidity;
-    uint8_t success = 0x01;
-    success &= ringbuf_get(&ringbuf_lcd_temperature, &temperature);
-    success &= ringbuf_get(&ringbuf_lcd_humidity, &humidity);
-    if (success == 0)
+    uint32_t timestamp_ms;
+    float record[SAMPLE_FIELD_COUNT];
+    if (sample_store_get_record(store, 0, &timestamp_ms, record) == 0)
+    {
+        ssd1306_printFixed(0, 24, "No data yet", STYLE_NORMAL);
+        return;
+    }
+
+    char line_buffer[SCREEN_WIDTH + 1];
+    char tenths[TENTHS_LEN];
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s'C", "Temp:",
+             format_tenths(record[SENSOR_CHANNEL_TEMPERATURE], false, tenths));
+    ssd1306_printFixed(0, 24, line_buffer, STYLE_NORMAL);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s %%", "Hum:",
+             format_tenths(record[SENSOR_CHANNEL_HUMIDITY], false, tenths));
+    ssd1306_printFixed(0, 40, line_buffer, STYLE_NORMAL);
+}
+
+static void render_derived_metrics(void)
+{
+    ssd1306_clearScreen();
+    ssd1306_printFixed(20, 0, "Derived", STYLE_ITALIC);
+    ssd1306_printFixed(20, 8, "Metrics", STYLE_ITALIC);
+
+    uint32_t timestamp_ms;
+    float record[SAMPLE_FIELD_COUNT];
+    if (sample_store_get_record(store, 0, &timestamp_ms, record) == 0)
     {
         ssd1306_printFixed(0, 24, "No data yet", STYLE_NORMAL);
         return;
     }
 
     char line_buffer[SCREEN_WIDTH + 1];
-    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %.1f'C", "Temp:", temperature);
+    char tenths[TENTHS_LEN];
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s'C", "Dew:",
+             format_tenths(record[SAMPLE_FIELD_DEW_POINT], false, tenths));
     ssd1306_printFixed(0, 24, line_buffer, STYLE_NORMAL);
-    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %.1f %%", "Hum:", humidity);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %sg/m3", "AbsH:",
+             format_tenths(record[SAMPLE_FIELD_ABSOLUTE_HUMIDITY], false, tenths));
+    ssd1306_printFixed(0, 32, line_buffer, STYLE_NORMAL);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s'C", "HI:",
+             format_tenths(record[SAMPLE_FIELD_HEAT_INDEX], false, tenths));
     ssd1306_printFixed(0, 40, line_buffer, STYLE_NORMAL);
 }
 
@@ -164,8 +259,8 @@ static void render_temperature_analysis(void)
     ssd1306_printFixed(8, 0, "Temperature", STYLE_ITALIC);
     ssd1306_printFixed(16, 8, "Analysis", STYLE_ITALIC);
 
-    static float sorted_temps[CONFIG_LCD_RINGBUF_DATA_LEN];
-    size_t sorted_temps_len = ringbuf_getallsorted(&ringbuf_lcd_temperature, sorted_temps);
+    static float sorted_temps[CONFIG_HISTORY_MAX_LEN];
+    size_t sorted_temps_len = get_sorted_history(SENSOR_CHANNEL_TEMPERATURE, sorted_temps);
     if (sorted_temps_len == 0)
     {
         ssd1306_printFixed(0, 24, "No data yet", STYLE_NORMAL);
@@ -173,11 +268,14 @@ static void render_temperature_analysis(void)
     }
 
     char line_buffer[SCREEN_WIDTH + 1];
-    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %.1f'C", "Min:", sorted_temps[0]);
+    char tenths[TENTHS_LEN];
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s'C", "Min:", format_tenths(sorted_temps[0], false, tenths));
     ssd1306_printFixed(0, 24, line_buffer, STYLE_NORMAL);
-    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %.1f'C", "Med:", sorted_temps[((sorted_temps_len - 1) / 2)]);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s'C", "Med:",
+             format_tenths(sorted_temps[((sorted_temps_len - 1) / 2)], false, tenths));
     ssd1306_printFixed(0, 32, line_buffer, STYLE_NORMAL);
-    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %.1f'C", "Max:", sorted_temps[(sorted_temps_len - 1)]);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s'C", "Max:",
+             format_tenths(sorted_temps[(sorted_temps_len - 1)], false, tenths));
     ssd1306_printFixed(0, 40, line_buffer, STYLE_NORMAL);
 }
 
@@ -187,8 +285,8 @@ static void render_humidity_analysis(void)
     ssd1306_printFixed(16, 0, "Humidity", STYLE_ITALIC);
     ssd1306_printFixed(16, 8, "Analysis", STYLE_ITALIC);
 
-    static float sorted_humids[CONFIG_LCD_RINGBUF_DATA_LEN];
-    size_t sorted_humids_len = ringbuf_getallsorted(&ringbuf_lcd_humidity, sorted_humids);
+    static float sorted_humids[CONFIG_HISTORY_MAX_LEN];
+    size_t sorted_humids_len = get_sorted_history(SENSOR_CHANNEL_HUMIDITY, sorted_humids);
     if (sorted_humids_len == 0)
     {
         ssd1306_printFixed(0, 24, "No data yet", STYLE_NORMAL);
@@ -196,10 +294,113 @@ static void render_humidity_analysis(void)
     }
 
     char line_buffer[SCREEN_WIDTH + 1];
-    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %.1f %%", "Min:", sorted_humids[0]);
+    char tenths[TENTHS_LEN];
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s %%", "Min:", format_tenths(sorted_humids[0], false, tenths));
+    ssd1306_printFixed(0, 24, line_buffer, STYLE_NORMAL);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s %%", "Med:",
+             format_tenths(sorted_humids[((sorted_humids_len - 1) / 2)], false, tenths));
+    ssd1306_printFixed(0, 32, line_buffer, STYLE_NORMAL);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s %%", "Max:",
+             format_tenths(sorted_humids[(sorted_humids_len - 1)], false, tenths));
+    ssd1306_printFixed(0, 40, line_buffer, STYLE_NORMAL);
+}
+
+static void render_stats(const char *title, sensor_channel_id_t id, sensor_channel_stats_window_t window,
+                         const char *unit)
+{
+    ssd1306_clearScreen();
+    char line_buffer[SCREEN_WIDTH + 1];
+    char tenths[TENTHS_LEN];
+    uint32_t minutes = sensor_channel_get_stats_window_minutes(id, window);
+    if (minutes % 60 == 0)
+    {
+        snprintf(line_buffer, SCREEN_WIDTH + 1, "%s %uh", title, (unsigned)(minutes / 60));
+    }
+    else
+    {
+        snprintf(line_buffer, SCREEN_WIDTH + 1, "%s %umin", title, (unsigned)minutes);
+    }
+    ssd1306_printFixed(0, 0, line_buffer, STYLE_ITALIC);
+
+    stats_t stats;
+    if (sensor_channel_get_stats(id, window, &stats) == 0)
+    {
+        ssd1306_printFixed(0, 24, "No data yet", STYLE_NORMAL);
+        return;
+    }
+
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s%s", "Avg:", format_tenths(stats.mean, false, tenths), unit);
+    ssd1306_printFixed(0, 8, line_buffer, STYLE_NORMAL);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s%s", "Std:", format_tenths(stats.stddev, false, tenths), unit);
+    ssd1306_printFixed(0, 16, line_buffer, STYLE_NORMAL);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s%s", "P10:", format_tenths(stats.p10, false, tenths), unit);
     ssd1306_printFixed(0, 24, line_buffer, STYLE_NORMAL);
-    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %.1f %%", "Med:", sorted_humids[((sorted_humids_len - 1) / 2)]);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s%s", "P90:", format_tenths(stats.p90, false, tenths), unit);
     ssd1306_printFixed(0, 32, line_buffer, STYLE_NORMAL);
-    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %.1f %%", "Max:", sorted_humids[(sorted_humids_len - 1)]);
+    snprintf(line_buffer, SCREEN_WIDTH + 1, "%-5s %s%s/h", "Rate:", format_tenths(stats.trend, true, tenths), unit);
     ssd1306_printFixed(0, 40, line_buffer, STYLE_NORMAL);
 }
+
+/*
+ * format_tenths writes value into dst with one decimal, prefixed with + if positive and plus_sign is set.
+ * With CONFIG_STATS_FIXED_POINT, the value is rounded to an integer number of tenths and formatted as such, instead of
+ *   going through printf's %f, which works on doubles.
+ * It returns dst.
+ */
+static const char *format_tenths(float value, bool plus_sign, char dst[TENTHS_LEN])
+{
+#if CONFIG_STATS_FIXED_POINT
+    if (isnan(value))
+    {
+        snprintf(dst, TENTHS_LEN, "nan");
+        return dst;
+    }
+    int tenths = (int)lroundf(value * 10);
+    const char *sign = tenths < 0 ? "-" : (plus_sign && tenths > 0 ? "+" : "");
+    snprintf(dst, TENTHS_LEN, "%s%d.%d", sign, abs(tenths) / 10, abs(tenths) % 10);
+#else
+    snprintf(dst, TENTHS_LEN, plus_sign ? "%+.1f" : "%.1f", value);
+#endif
+    return dst;
+}
+
+/*
+ * get_sorted_history copies the whole history of field into dst, sorted in ascending order; it's read in place, so
+ *   the store is only locked for the copy, and sorted once unlocked.
+ * It returns the number of values copied.
+ */
+static size_t get_sorted_history(size_t field, float dst[CONFIG_HISTORY_MAX_LEN])
+{
+    size_t len = 0;
+    sample_store_span_t spans[2];
+    sample_store_lock_spans(store, spans);
+    for (size_t s = 0; s < 2; s++)
+    {
+        const float *values = sample_store_span_values(store, &spans[s], field);
+        for (size_t i = 0; i < spans[s].len; i++)
+        {
+            if (!isnan(values[i]))
+            {
+                dst[len++] = values[i];
+            }
+        }
+    }
+    sample_store_unlock_spans(store);
+    qsort(dst, len, sizeof(float), compare_floats);
+    return len;
+}
+
+static int compare_floats(const void *a, const void *b)
+{
+    float arg1 = *(const float *)a;
+    float arg2 = *(const float *)b;
+    if (arg1 < arg2)
+    {
+        return -1;
+    }
+    if (arg1 > arg2)
+    {
+        return 1;
+    }
+    return 0;
+}
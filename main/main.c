@@ -3,19 +3,38 @@
 //==================================================================================================
 
 #include "ble.h"
+#include "boot_profile.h"
 #include "button.h"
 #include "debug_heartbeat.h"
+#include "debug_trace.h"
+#include "derived_metrics.h"
+#include "diag_console.h"
 #include "envi_config.h"
 #include "lcd.h"
+#include "runtime_stats.h"
+#include "sample_batch.h"
+#include "sample_bus.h"
+#include "sample_store.h"
+#include "sample_timing.h"
+#include "sensor_channel.h"
+#include "settings.h"
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
-#include "sht21.h"
 #include <assert.h>
 
+#if CONFIG_BATCH_MODE
+#include "driver/rtc_io.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include <math.h>
+#include <sys/time.h>
+#endif
+
 //==================================================================================================
 // DEFINES - MACROS
 //==================================================================================================
@@ -23,67 +42,238 @@
 #define ESP_LOG_TAG "ENVI_SENSOR_MAIN"
 #include "iferr.h"
 
+#define SAMPLE_BUS_CONSUMERS_LEN 2
+#define TASKS_LEN 6 // tasks created by app_main, listed by the diagnostics console
+
+/* Retries of a failed acquisition never wait longer than a quarter of the period, leaving room for the reading
+ *   itself and for publishing it, so that the next reading is never delayed */
+#define SENSOR_RETRY_BUDGET_MS(period_ms) ((period_ms) / 4)
+
+#if CONFIG_BATCH_MODE
+/* GPIOs able to wake the device up from deep sleep, with the pull-up the button needs: the RTC GPIOs, through ext0,
+ *   or on the ESP32-C3, which has no ext0, the GPIOs powered in deep sleep */
+#if CONFIG_IDF_TARGET_ESP32
+#define RTC_PINS_MASK                                                                                                  \
+    (1ULL << 0 | 1ULL << 2 | 1ULL << 4 | 0xFULL << 12 | 0x7ULL << 25 | 0x3ULL << 32) // 34 to 39 have no pull-up
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define RTC_PINS_MASK 0x3FFFFFULL // 0 to 21
+#elif CONFIG_IDF_TARGET_ESP32C3
+#define RTC_PINS_MASK 0x3FULL // 0 to 5
+#else
+#error "the GPIOs able to wake this target up from deep sleep aren't known"
+#endif
+/* GPIOs envi_config.h already assigns, debug and JTAG ones included, but the button's */
+#define USED_PINS_MASK                                                                                                 \
+    (1ULL << HEARTBEAT_PIN | 1ULL << JTAG_TDO | 1ULL << JTAG_TDI | 1ULL << JTAG_TCK | 1ULL << JTAG_TMS |              \
+     1ULL << LCD_CLK_PIN | 1ULL << LCD_DIN_PIN | 1ULL << LCD_DC_PIN | 1ULL << LCD_CE_PIN | 1ULL << LCD_RST_PIN |      \
+     1ULL << SENSOR_SDA_PIN | 1ULL << SENSOR_SCL_PIN | 1ULL << TRACE_I2C_READ_PIN | 1ULL << TRACE_QUEUE_SEND_PIN |    \
+     1ULL << TRACE_BLE_WRITE_PIN | 1ULL << TRACE_LCD_RENDER_PIN | 1ULL << TRACE_ISR_PIN)
+#define WAKE_PINS_MASK (RTC_PINS_MASK & ~USED_PINS_MASK)
+_Static_assert(WAKE_PINS_MASK >> WAKE_PIN & 1,
+               "CONFIG_BATCH_MODE_WAKE_GPIO can't wake the device up from deep sleep, or is already used");
+#endif
+
+_Static_assert(2 * CONFIG_SAMPLE_BUS_MAX_BLOCK_MS < CONFIG_READ_SENSOR_FREQUENCY_MS,
+               "blocking consumers could delay the next sensor reading");
+_Static_assert(BLE_STATS_WINDOW_COUNT == SENSOR_CHANNEL_STATS_WINDOW_COUNT,
+               "statistics windows mismatch between BLE and sensor channels");
+
 //==================================================================================================
 // ENUMS - STRUCTS - TYPEDEFS
 //==================================================================================================
 
 typedef struct
 {
-    float temperature;
-    float humidity;
+    sensor_sample_t sample;
+    derived_metrics_t derived; // computed from the primary temperature and humidity channels
 } sensor_reading_t;
 
 //==================================================================================================
 // STATIC PROTOTYPES
 //==================================================================================================
 
-static void create_task(TaskFunction_t fn, const char *const name, UBaseType_t priority);
+static void create_task(TaskFunction_t fn, const char *const name, UBaseType_t priority, BaseType_t core);
 
-static void button_isr_handler(void *param);
+static void handle_button_event(button_event_t event);
 
 static void task_read_sensor(void *param);
 
+static void acquire_sample(uint32_t cycle, uint32_t period_ms, sensor_sample_t *dst);
+
+static void record_sample_timing(uint32_t cycle, int64_t scheduled_us, int64_t actual_us);
+
+static void publish_reading(sensor_reading_t *reading);
+
 static void task_update_ble(void *param);
 
-static void task_update_lcd_ring_buffer(void *param);
+static void task_update_sample_store(void *param);
 
 static void task_render_lcd_view(void *param);
 
+#if CONFIG_TASK_RUNTIME_STATS
+static void task_log_runtime_stats(void *param);
+#endif
+
+static void update_ble_stats(void);
+
+static esp_err_t apply_settings(const settings_t *new_settings);
+
+static esp_err_t handle_ble_settings(uint32_t read_period_ms, uint32_t history_len);
+
+static void task_apply_settings(void *param);
+
+#if CONFIG_DIAG_CONSOLE
+static void get_sample_timing(sample_timing_t *dst);
+
+static void get_settings(settings_t *dst);
+#endif
+
+#if CONFIG_BLE_PERIODIC_ADVERTISING
+static void update_ble_history(void);
+#endif
+
+#if CONFIG_BATCH_MODE
+static void handle_batch_wake(void);
+
+static void push_batch_reading(const sensor_sample_t *sample, uint32_t period_ms);
+
+static void load_batch(void);
+
+static void enter_deep_sleep(void);
+
+static uint64_t get_clock_ms(void);
+#endif
+
 //==================================================================================================
 // STATIC VARIABLES
 //==================================================================================================
 
-// pass sensor readings from the sensor to the BLE peripheral
-static QueueHandle_t binqueue_ble = NULL;
+// pass sensor readings from the sensor to the BLE peripheral and to the onboard monitor
+static sample_bus_t sample_bus;
+static sample_bus_consumer_t sample_bus_consumers_[SAMPLE_BUS_CONSUMERS_LEN];
+
+// the BLE peripheral only needs the latest reading, while the sample store needs all of them
+static sample_bus_consumer_t *consumer_ble = NULL;
+static sample_bus_consumer_t *consumer_store = NULL;
 
-// pass sensor readings from the sensor to the onboard monitor
-static QueueHandle_t binqueue_lcd = NULL;
+// history of the readings and derived metrics, written by task_update_sample_store and read by everyone else
+static sample_store_t sample_store;
+static float sample_store_values_[CONFIG_HISTORY_MAX_LEN * SAMPLE_FIELD_COUNT];
+static uint32_t sample_store_timestamps_ms_[CONFIG_HISTORY_MAX_LEN];
 
 // binsemaphore_lcd_render informs a task when the lcd_view has been updated
 static SemaphoreHandle_t binsemaphore_lcd_render = NULL;
 
+// scheduled and actual time of each sensor reading, written by task_read_sensor
+static sample_timing_t sample_timing;
+static portMUX_TYPE sample_timing_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// settings in use, changed at runtime through BLE or the diagnostics console; settings_mutex serializes the changes
+static settings_t settings;
+static SemaphoreHandle_t settings_mutex = NULL;
+
+// settings written over BLE, waiting to be applied by task_apply_settings; only the latest write is kept
+static QueueHandle_t queue_ble_settings = NULL;
+
+// period of task_read_sensor, copied from settings and applied from the next reading
+static volatile uint32_t read_sensor_period_ms = CONFIG_READ_SENSOR_FREQUENCY_MS;
+
+#if CONFIG_DIAG_CONSOLE
+static diag_console_task_t tasks_[TASKS_LEN];
+static size_t tasks_len = 0;
+
+static diag_console_sources_t diag_console_sources = {
+    .sample_bus = &sample_bus,
+    .sample_store = &sample_store,
+    .tasks = tasks_,
+    .get_sample_timing = get_sample_timing,
+    .get_settings = get_settings,
+    .set_settings = apply_settings,
+};
+#endif
+
+#if CONFIG_BATCH_MODE
+// readings taken in deep sleep, and while publishing, kept in RTC memory until they're published
+RTC_DATA_ATTR static sample_batch_t sample_batch;
+static portMUX_TYPE sample_batch_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
 //==================================================================================================
 // GLOBAL FUNCTIONS
 //==================================================================================================
 
 void app_main(void)
 {
+    boot_profile_mark(BOOT_PHASE_APP_MAIN);
     ESP_LOGI(ESP_LOG_TAG, "initialize peripherals and tasks");
-    binqueue_ble = xQueueCreate(1, sizeof(sensor_reading_t));
-    binqueue_lcd = xQueueCreate(1, sizeof(sensor_reading_t));
+    sample_bus = sample_bus_init(sizeof(sensor_reading_t), sample_bus_consumers_, SAMPLE_BUS_CONSUMERS_LEN);
+    consumer_ble = sample_bus_subscribe(&sample_bus, "ble", CONFIG_SAMPLE_BUS_BLE_DEPTH, SAMPLE_BUS_OVERWRITE_OLDEST, 0);
+    consumer_store = sample_bus_subscribe(&sample_bus, "store", CONFIG_SAMPLE_BUS_STORE_DEPTH, SAMPLE_BUS_BLOCK,
+                                          CONFIG_SAMPLE_BUS_MAX_BLOCK_MS);
+    assert(consumer_ble && consumer_store);
     binsemaphore_lcd_render = xSemaphoreCreateBinary();
+    sample_timing_init(&sample_timing, CONFIG_SAMPLE_TIMING_DEADLINE_MS * 1000);
+    settings_mutex = xSemaphoreCreateMutex();
+    assert(settings_mutex);
+    queue_ble_settings = xQueueCreate(1, sizeof(settings_t));
+    assert(queue_ble_settings);
+
+    /*
+     * The BT controller and host take the longest to start, so they come last: the sensor and lcd tasks are created
+     *   first and, having a higher priority than app_main, take and show the first reading while ble_init runs.
+     * Only NVS must be ready before both: it holds the settings, and the BT controller calibration data.
+     * task_update_ble is created once ble_init returned; until then, the latest reading waits in its sample bus queue.
+     */
+    ESP_ERROR_CHECK(settings_init());
+    IFERR_LOG(settings_load(&settings), "failed to load the settings, using the defaults");
+    read_sensor_period_ms = settings.read_period_ms;
+    sample_store = sample_store_init(sample_store_values_, sample_store_timestamps_ms_, SAMPLE_FIELD_COUNT,
+                                     CONFIG_HISTORY_MAX_LEN, settings.history_len);
+    boot_profile_mark(BOOT_PHASE_SETTINGS);
+#if CONFIG_BATCH_MODE
+    // most wake-ups end here, after a single reading; the others go on booting, to publish the batch
+    handle_batch_wake();
+#endif
 
-    ESP_ERROR_CHECK(ble_init());
-    ESP_ERROR_CHECK(button_init(button_isr_handler));
+    ESP_ERROR_CHECK(button_init(handle_button_event));
     ESP_ERROR_CHECK(debug_heartbeat_init(HEARTBEAT_PIN));
-    ESP_ERROR_CHECK(lcd_init());
-    ESP_ERROR_CHECK(sht21_init(0, SENSOR_SDA_PIN, SENSOR_SCL_PIN, sht21_i2c_speed_standard));
+    ESP_ERROR_CHECK(debug_trace_init());
+    boot_profile_mark(BOOT_PHASE_GPIO);
+    ESP_ERROR_CHECK(lcd_init(&sample_store));
+    boot_profile_mark(BOOT_PHASE_LCD);
+    ESP_ERROR_CHECK(sensor_channel_init(&sample_store, settings.read_period_ms));
+#if CONFIG_BATCH_MODE
+    load_batch();
+#endif
+    boot_profile_mark(BOOT_PHASE_SENSOR);
+
+    create_task(task_read_sensor, "task_read_sensor", TASK_PRIORITY_READ_SENSOR, TASK_CORE_READ_SENSOR);
+    create_task(task_update_sample_store, "task_update_sample_store", TASK_PRIORITY_UPDATE_SAMPLE_STORE,
+                TASK_CORE_UPDATE_SAMPLE_STORE);
+    create_task(task_render_lcd_view, "task_render_lcd_view", TASK_PRIORITY_RENDER_LCD_VIEW, TASK_CORE_RENDER_LCD_VIEW);
+    create_task(task_apply_settings, "task_apply_settings", TASK_PRIORITY_APPLY_SETTINGS, TASK_CORE_APPLY_SETTINGS);
+    boot_profile_mark(BOOT_PHASE_TASKS);
+
+    // after the histories, as clients can change the settings as soon as they connect
+    ESP_ERROR_CHECK(ble_write_settings(settings.read_period_ms, settings.history_len));
+    ESP_ERROR_CHECK(ble_init(handle_ble_settings));
+    boot_profile_mark(BOOT_PHASE_BLE);
+    create_task(task_update_ble, "task_update_ble", TASK_PRIORITY_UPDATE_BLE, TASK_CORE_UPDATE_BLE);
+#if CONFIG_TASK_RUNTIME_STATS
+    create_task(task_log_runtime_stats, "task_log_runtime_stats", TASK_PRIORITY_LOG_RUNTIME_STATS,
+                TASK_CORE_LOG_RUNTIME_STATS);
+#endif
 
-    create_task(task_read_sensor, "task_read_sensor", TASK_PRIORITY_READ_SENSOR);
-    create_task(task_update_ble, "task_update_ble", TASK_PRIORITY_UPDATE_BLE);
-    create_task(task_update_lcd_ring_buffer, "task_update_lcd_ring_buffer", TASK_PRIORITY_UPDATE_LCD_RING_BUFFER);
-    create_task(task_render_lcd_view, "task_render_lcd_view", TASK_PRIORITY_RENDER_LCD_VIEW);
+#if CONFIG_DIAG_CONSOLE
+    diag_console_sources.tasks_len = tasks_len;
+    IFERR_LOG(diag_console_start(&diag_console_sources), "failed to start the diagnostics console");
+#endif
 
+#if CONFIG_BATCH_MODE
+    vTaskDelay(CONFIG_BATCH_MODE_PUBLISH_MS / portTICK_PERIOD_MS);
+    IFERR_LOG(ble_stop(), "failed to stop BLE before deep sleep");
+    enter_deep_sleep();
+#endif
     vTaskDelete(NULL);
 }
 
@@ -91,61 +281,134 @@ void app_main(void)
 // STATIC FUNCTIONS
 //==================================================================================================
 
-static void create_task(TaskFunction_t fn, const char *const name, UBaseType_t priority)
+/*
+ * create_task pins the task to core, which can also be tskNO_AFFINITY (see "Task Placement" in envi_config.h).
+ */
+static void create_task(TaskFunction_t fn, const char *const name, UBaseType_t priority, BaseType_t core)
 {
     TaskHandle_t task_handle = NULL;
-    xTaskCreate(fn, name, TASK_STACK_DEPTH, NULL, priority, &task_handle);
+    xTaskCreatePinnedToCore(fn, name, TASK_STACK_DEPTH, NULL, priority, &task_handle, core);
     assert(task_handle);
+#if CONFIG_DIAG_CONSOLE
+    assert(tasks_len < TASKS_LEN);
+    tasks_[tasks_len++] = (diag_console_task_t){.name = name, .handle = task_handle};
+#endif
 }
 
-static void button_isr_handler(void *param)
+/*
+ * handle_button_event browses the lcd views: a short press shows the next one, a double press the previous one, and
+ *   a long press goes back to the current readings.
+ */
+static void handle_button_event(button_event_t event)
 {
-    button_debounce();
-    lcd_select_next_view();
-    xSemaphoreGiveFromISR(binsemaphore_lcd_render, NULL);
+    switch (event)
+    {
+    case BUTTON_EVENT_SHORT_PRESS:
+        lcd_select_next_view();
+        break;
+    case BUTTON_EVENT_DOUBLE_PRESS:
+        lcd_select_previous_view();
+        break;
+    case BUTTON_EVENT_LONG_PRESS:
+        lcd_select_first_view();
+        break;
+    default:
+        return;
+    }
+    xSemaphoreGive(binsemaphore_lcd_render);
 }
 
 static void task_read_sensor(void *param)
 {
-    const TickType_t frequency = CONFIG_READ_SENSOR_FREQUENCY_MS / portTICK_PERIOD_MS;
+    // start right after a tick, so that the tick-based schedule and esp_timer agree
+    vTaskDelay(1);
     TickType_t lastWakeTime = xTaskGetTickCount();
+    int64_t scheduled_us = esp_timer_get_time();
+    uint32_t cycle = 0;
     while (1)
     {
-        ESP_LOGI(ESP_LOG_TAG, "read sensor");
-        esp_err_t err;
-        float temperature_reading;
-        float humidity_reading;
-        if ((err = sht21_get_temperature(&temperature_reading)) != ESP_OK)
-        {
-            IFERR_LOG(err, "could not read temperature");
-            continue;
-        }
-        if ((err = sht21_get_humidity(&humidity_reading)) != ESP_OK)
+        record_sample_timing(cycle, scheduled_us, esp_timer_get_time());
+        IFERR_LOG(debug_heartbeat_toggle(), "failed to toggle heartbeat"); // one edge per reading
+        const uint32_t period_ms = read_sensor_period_ms;
+        const TickType_t frequency = period_ms / portTICK_PERIOD_MS;
+        ESP_LOGI(ESP_LOG_TAG, "read sensor channels, cycle %u", (unsigned)cycle);
+        sensor_reading_t reading;
+        acquire_sample(cycle++, period_ms, &reading.sample);
+#if CONFIG_BATCH_MODE
+        // the sample store doesn't survive deep sleep: the next batch carries the readings taken while publishing
+        push_batch_reading(&reading.sample, period_ms);
+#endif
+        if (sensor_sample_has(&reading.sample, SENSOR_CHANNEL_TEMPERATURE) &&
+            sensor_sample_has(&reading.sample, SENSOR_CHANNEL_HUMIDITY))
         {
-            IFERR_LOG(err, "could not read humidity");
-            continue;
+            publish_reading(&reading);
+            boot_profile_mark(BOOT_PHASE_FIRST_SAMPLE);
         }
-        if (humidity_reading < 0)
-            humidity_reading = 0;
-        if (humidity_reading > 100)
-            humidity_reading = 100;
+        vTaskDelayUntil(&lastWakeTime, frequency);
+        scheduled_us += (int64_t)frequency * portTICK_PERIOD_MS * 1000;
+    }
+}
 
-        sensor_reading_t reading = {.temperature = temperature_reading, .humidity = humidity_reading};
-        if (xQueueSend(binqueue_ble, (void *)&reading, portMAX_DELAY) != pdPASS)
+/*
+ * acquire_sample reads the sensor channels, retrying with exponential backoff within a budget set by period_ms.
+ */
+static void acquire_sample(uint32_t cycle, uint32_t period_ms, sensor_sample_t *dst)
+{
+    const sample_timing_retry_t sensor_retry = {
+        .max_attempts = CONFIG_SENSOR_RETRY_MAX_ATTEMPTS,
+        .base_delay_ms = CONFIG_SENSOR_RETRY_BACKOFF_MS,
+        .budget_ms = SENSOR_RETRY_BUDGET_MS(period_ms),
+    };
+    esp_err_t err = sensor_channel_acquire(cycle, dst);
+    uint32_t elapsed_ms = 0;
+    for (uint32_t attempt = 0; err != ESP_OK; attempt++)
+    {
+        uint32_t delay_ms;
+        bool retry = sample_timing_retry_delay(&sensor_retry, attempt, elapsed_ms, &delay_ms);
+        portENTER_CRITICAL(&sample_timing_lock);
+        if (retry)
         {
-            ESP_LOGW(ESP_LOG_TAG, "last sensor reading not received from BLE peripheral, overwriting with new value");
-            assert(xQueueOverwrite(binqueue_ble, (void *)&reading));
+            sample_timing.retries++;
         }
-        if (xQueueSend(binqueue_lcd, (void *)&reading, portMAX_DELAY) != pdPASS)
+        else
         {
-            ESP_LOGW(ESP_LOG_TAG, "last sensor reading not received from monitor, overwriting with new value");
-            assert(xQueueOverwrite(binqueue_lcd, (void *)&reading));
+            sample_timing.gave_up++;
         }
-        if (xSemaphoreGive(binsemaphore_lcd_render) != pdTRUE)
+        portEXIT_CRITICAL(&sample_timing_lock);
+        if (!retry)
         {
-            ESP_LOGW(ESP_LOG_TAG, "failed to give binsemaphore_lcd_render");
+            IFERR_LOG(err, "could not read all sensor channels, gave up after %u retries", (unsigned)attempt);
+            return;
         }
-        vTaskDelayUntil(&lastWakeTime, frequency);
+        ESP_LOGW(ESP_LOG_TAG, "could not read all sensor channels, retry in %u ms", (unsigned)delay_ms);
+        vTaskDelay(delay_ms / portTICK_PERIOD_MS);
+        elapsed_ms += delay_ms;
+        err = sensor_channel_acquire(cycle, dst);
+    }
+}
+
+static void record_sample_timing(uint32_t cycle, int64_t scheduled_us, int64_t actual_us)
+{
+    portENTER_CRITICAL(&sample_timing_lock);
+    sample_timing_record(&sample_timing, scheduled_us, actual_us);
+    portEXIT_CRITICAL(&sample_timing_lock);
+    if (actual_us - scheduled_us > CONFIG_SAMPLE_TIMING_DEADLINE_MS * 1000)
+    {
+        ESP_LOGW(ESP_LOG_TAG, "cycle %u missed its deadline, %lld us late", (unsigned)cycle,
+                 (long long)(actual_us - scheduled_us));
+    }
+}
+
+static void publish_reading(sensor_reading_t *reading)
+{
+    derived_metrics_compute(reading->sample.values[SENSOR_CHANNEL_TEMPERATURE],
+                            reading->sample.values[SENSOR_CHANNEL_HUMIDITY], &reading->derived);
+    DEBUG_TRACE_ENTER(QUEUE_SEND);
+    size_t failed_count = sample_bus_publish(&sample_bus, reading);
+    DEBUG_TRACE_EXIT(QUEUE_SEND);
+    if (failed_count > 0)
+    {
+        ESP_LOGW(ESP_LOG_TAG, "sensor reading dropped by %u consumers", (unsigned)failed_count);
     }
 }
 
@@ -154,25 +417,49 @@ static void task_update_ble(void *param)
     while (1)
     {
         sensor_reading_t reading;
-        if (xQueueReceive(binqueue_ble, &reading, portMAX_DELAY))
+        if (sample_bus_receive(consumer_ble, &reading, portMAX_DELAY))
         {
-            ESP_LOGI(ESP_LOG_TAG, "update ble charact , temp: %f humid: %f", reading.temperature, reading.humidity);
-            IFERR_LOG(ble_write_temperature(reading.temperature), "failed to write temperature");
-            IFERR_LOG(ble_write_humidity(reading.humidity), "failed to write humidity");
+            ESP_LOGI(ESP_LOG_TAG, "update ble characteristics");
+            DEBUG_TRACE_ENTER(BLE_WRITE);
+            IFERR_LOG(sensor_channel_write_ble(&reading.sample), "failed to write sensor channels");
+            IFERR_LOG(ble_write_readings(reading.sample.values[SENSOR_CHANNEL_TEMPERATURE],
+                                         reading.sample.values[SENSOR_CHANNEL_HUMIDITY], reading.sample.cycle,
+                                         reading.sample.timestamp_ms),
+                      "failed to write readings");
+#if CONFIG_BLE_BROADCAST_MODE
+            IFERR_LOG(ble_broadcast_readings(reading.sample.values[SENSOR_CHANNEL_TEMPERATURE],
+                                             reading.sample.values[SENSOR_CHANNEL_HUMIDITY]),
+                      "failed to broadcast readings");
+#endif
+            IFERR_LOG(ble_write_derived_metrics(&reading.derived), "failed to write derived metrics");
+            DEBUG_TRACE_EXIT(BLE_WRITE);
         }
     }
 }
 
-static void task_update_lcd_ring_buffer(void *param)
+static void task_update_sample_store(void *param)
 {
     while (1)
     {
         sensor_reading_t reading;
-        if (xQueueReceive(binqueue_lcd, &reading, portMAX_DELAY))
+        if (sample_bus_receive(consumer_store, &reading, portMAX_DELAY))
         {
-            ESP_LOGI(ESP_LOG_TAG, "update ring-buffers, temp: %f humid: %f", reading.temperature, reading.humidity);
-            lcd_store_temperature(reading.temperature);
-            lcd_store_humidity(reading.humidity);
+            ESP_LOGI(ESP_LOG_TAG, "update sample store");
+            float record[SAMPLE_FIELD_COUNT];
+            sensor_sample_to_record(&reading.sample, record);
+            record[SAMPLE_FIELD_DEW_POINT] = reading.derived.dew_point;
+            record[SAMPLE_FIELD_ABSOLUTE_HUMIDITY] = reading.derived.absolute_humidity;
+            record[SAMPLE_FIELD_HEAT_INDEX] = reading.derived.heat_index;
+            sensor_channel_store(reading.sample.timestamp_ms, record);
+            // the lcd shows what's in the store, so it's rendered once the reading is stored
+            if (xSemaphoreGive(binsemaphore_lcd_render) != pdTRUE)
+            {
+                ESP_LOGW(ESP_LOG_TAG, "failed to give binsemaphore_lcd_render");
+            }
+            update_ble_stats();
+#if CONFIG_BLE_PERIODIC_ADVERTISING
+            update_ble_history();
+#endif
         }
     }
 }
@@ -185,6 +472,287 @@ static void task_render_lcd_view(void *param)
         {
         }
         ESP_LOGI(ESP_LOG_TAG, "render lcd");
+        DEBUG_TRACE_ENTER(LCD_RENDER);
         lcd_render();
+        DEBUG_TRACE_EXIT(LCD_RENDER);
+    }
+}
+
+#if CONFIG_TASK_RUNTIME_STATS
+static void task_log_runtime_stats(void *param)
+{
+    const TickType_t frequency = CONFIG_TASK_RUNTIME_STATS_PERIOD_MS / portTICK_PERIOD_MS;
+    TickType_t lastWakeTime = xTaskGetTickCount();
+    while (1)
+    {
+        vTaskDelayUntil(&lastWakeTime, frequency);
+        IFERR_LOG(runtime_stats_log_window(), "could not log runtime stats");
+    }
+}
+#endif
+
+static void update_ble_stats(void)
+{
+    for (sensor_channel_stats_window_t window = 0; window < SENSOR_CHANNEL_STATS_WINDOW_COUNT; window++)
+    {
+        stats_t temperature_stats = {0};
+        stats_t humidity_stats = {0};
+        sensor_channel_get_stats(SENSOR_CHANNEL_TEMPERATURE, window, &temperature_stats);
+        sensor_channel_get_stats(SENSOR_CHANNEL_HUMIDITY, window, &humidity_stats);
+        uint32_t minutes = sensor_channel_get_stats_window_minutes(SENSOR_CHANNEL_TEMPERATURE, window);
+        IFERR_LOG(ble_write_stats(window, minutes, &temperature_stats, &humidity_stats), "failed to write statistics");
     }
 }
+
+#if CONFIG_BLE_PERIODIC_ADVERTISING
+static void update_ble_history(void)
+{
+    static float temperatures[CONFIG_BLE_PERIODIC_ADV_HISTORY_LEN];
+    static float humidities[CONFIG_BLE_PERIODIC_ADV_HISTORY_LEN];
+    // walking the records newest first, from the end of the newer span, keeps the nth temperature and humidity of
+    //   the same record, skipping the records missing either
+    size_t count = 0;
+    sample_store_span_t spans[2];
+    sample_store_lock_spans(&sample_store, spans);
+    for (size_t s = 2; s-- > 0 && count < CONFIG_BLE_PERIODIC_ADV_HISTORY_LEN;)
+    {
+        const float *span_temperatures = sample_store_span_values(&sample_store, &spans[s], SENSOR_CHANNEL_TEMPERATURE);
+        const float *span_humidities = sample_store_span_values(&sample_store, &spans[s], SENSOR_CHANNEL_HUMIDITY);
+        for (size_t i = spans[s].len; i-- > 0 && count < CONFIG_BLE_PERIODIC_ADV_HISTORY_LEN;)
+        {
+            if (!isnan(span_temperatures[i]) && !isnan(span_humidities[i]))
+            {
+                temperatures[count] = span_temperatures[i];
+                humidities[count] = span_humidities[i];
+                count++;
+            }
+        }
+    }
+    sample_store_unlock_spans(&sample_store);
+
+    stats_t temperature_stats = {0};
+    stats_t humidity_stats = {0};
+    sensor_channel_get_stats(SENSOR_CHANNEL_TEMPERATURE, SENSOR_CHANNEL_STATS_WINDOW_SHORT, &temperature_stats);
+    sensor_channel_get_stats(SENSOR_CHANNEL_HUMIDITY, SENSOR_CHANNEL_STATS_WINDOW_SHORT, &humidity_stats);
+    ble_adv_payload_history_t history = {
+        .sample_period_s = read_sensor_period_ms / 1000,
+        .window_minutes =
+            sensor_channel_get_stats_window_minutes(SENSOR_CHANNEL_TEMPERATURE, SENSOR_CHANNEL_STATS_WINDOW_SHORT),
+        .temperature_stats = &temperature_stats,
+        .humidity_stats = &humidity_stats,
+        .temperatures = temperatures,
+        .humidities = humidities,
+        .count = count,
+    };
+    IFERR_LOG(ble_broadcast_history(&history), "failed to broadcast history");
+}
+#endif
+
+/*
+ * apply_settings resizes and resamples the sample store, changes the sensor period from the next reading, stores the
+ *   settings in NVS and exposes them over BLE; settings equal to the current ones are left alone.
+ * It's called by task_apply_settings and by the diagnostics console; it returns ESP_ERR_INVALID_ARG if any setting
+ *   is out of range, leaving the current ones in place.
+ */
+static esp_err_t apply_settings(const settings_t *new_settings)
+{
+    if (!settings_validate(new_settings))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(settings_mutex, portMAX_DELAY);
+    if (new_settings->read_period_ms == settings.read_period_ms && new_settings->history_len == settings.history_len)
+    {
+        xSemaphoreGive(settings_mutex);
+        return ESP_OK;
+    }
+    ESP_LOGI(ESP_LOG_TAG, "period changed from %u to %u ms, history from %u to %u readings",
+             (unsigned)settings.read_period_ms, (unsigned)new_settings->read_period_ms, (unsigned)settings.history_len,
+             (unsigned)new_settings->history_len);
+    esp_err_t err = sensor_channel_reconfigure(new_settings->read_period_ms, new_settings->history_len);
+    if (err == ESP_OK)
+    {
+        settings = *new_settings;
+        read_sensor_period_ms = settings.read_period_ms;
+        IFERR_LOG(settings_save(&settings), "the settings will be lost at reboot");
+        IFERR_LOG(ble_write_settings(settings.read_period_ms, settings.history_len), "failed to write settings");
+    }
+    xSemaphoreGive(settings_mutex);
+    return err;
+}
+
+/*
+ * handle_ble_settings runs in the BT host task, which mustn't wait for the store to be resampled and NVS to be
+ *   written: it only checks the settings, so that the client is answered right away, and leaves the rest to
+ *   task_apply_settings.
+ */
+static esp_err_t handle_ble_settings(uint32_t read_period_ms, uint32_t history_len)
+{
+    settings_t new_settings = {.read_period_ms = read_period_ms, .history_len = history_len};
+    if (!settings_validate(&new_settings))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xQueueOverwrite(queue_ble_settings, &new_settings);
+    return ESP_OK;
+}
+
+static void task_apply_settings(void *param)
+{
+    while (1)
+    {
+        settings_t new_settings;
+        while (!xQueueReceive(queue_ble_settings, &new_settings, portMAX_DELAY))
+        {
+        }
+        IFERR_LOG(apply_settings(&new_settings), "failed to apply the settings written over BLE");
+    }
+}
+
+#if CONFIG_DIAG_CONSOLE
+static void get_sample_timing(sample_timing_t *dst)
+{
+    portENTER_CRITICAL(&sample_timing_lock);
+    *dst = sample_timing;
+    portEXIT_CRITICAL(&sample_timing_lock);
+}
+
+static void get_settings(settings_t *dst)
+{
+    xSemaphoreTake(settings_mutex, portMAX_DELAY);
+    *dst = settings;
+    xSemaphoreGive(settings_mutex);
+}
+#endif
+
+#if CONFIG_BATCH_MODE
+/*
+ * handle_batch_wake decides what this boot is for: if it's a wake-up from deep sleep with a reading due, it takes the
+ *   reading, pushes it into the batch and goes back to sleep, without returning.
+ * It returns if the batch is to be published: after a power-on or reset, which also starts a new batch, once the
+ *   batch is complete, or when the button woke the device up.
+ */
+static void handle_batch_wake(void)
+{
+    uint64_t now_ms = get_clock_ms();
+    sample_batch_action_t action;
+    switch (esp_sleep_get_wakeup_cause())
+    {
+    case ESP_SLEEP_WAKEUP_TIMER:
+        action = sample_batch_on_wake(&sample_batch, SAMPLE_BATCH_WAKE_TIMER, now_ms);
+        break;
+    case ESP_SLEEP_WAKEUP_EXT0:
+    case ESP_SLEEP_WAKEUP_GPIO:
+        action = sample_batch_on_wake(&sample_batch, SAMPLE_BATCH_WAKE_BUTTON, now_ms);
+        break;
+    default: // the RTC memory didn't survive, so the device is shown working until the first reading is due
+        sample_batch_init(&sample_batch, CONFIG_BATCH_MODE_PUBLISH_LEN, now_ms);
+        action = SAMPLE_BATCH_PUBLISH;
+        break;
+    }
+    if (action == SAMPLE_BATCH_PUBLISH)
+    {
+        ESP_LOGI(ESP_LOG_TAG, "publish a batch of %u readings", (unsigned)sample_batch_len(&sample_batch));
+        return;
+    }
+
+    if (action == SAMPLE_BATCH_READ)
+    {
+        ESP_ERROR_CHECK(sensor_channel_init(&sample_store, settings.read_period_ms));
+        sensor_sample_t sample;
+        acquire_sample(sample_batch_len(&sample_batch), settings.read_period_ms, &sample);
+        push_batch_reading(&sample, settings.read_period_ms);
+    }
+    enter_deep_sleep();
+}
+
+/*
+ * push_batch_reading appends the temperature and humidity of sample to the batch, scheduling the next reading of
+ *   deep sleep period_ms later.
+ */
+static void push_batch_reading(const sensor_sample_t *sample, uint32_t period_ms)
+{
+    float record[SAMPLE_FIELD_COUNT];
+    sensor_sample_to_record(sample, record);
+    uint64_t now_ms = get_clock_ms();
+    portENTER_CRITICAL(&sample_batch_lock);
+    bool pushed = sample_batch_push(&sample_batch, record[SENSOR_CHANNEL_TEMPERATURE],
+                                    record[SENSOR_CHANNEL_HUMIDITY], now_ms, period_ms);
+    portEXIT_CRITICAL(&sample_batch_lock);
+    if (!pushed)
+    {
+        ESP_LOGW(ESP_LOG_TAG, "batch full, reading dropped");
+    }
+}
+
+/*
+ * load_batch stores the readings of the batch into the sample store, with their derived metrics, then clears it.
+ * They were taken before this boot, so their timestamps wrap around: the age of a reading, computed by subtracting
+ *   its timestamp from the current time, is still right.
+ * It's called before task_read_sensor is created, so the batch isn't locked.
+ */
+static void load_batch(void)
+{
+    uint64_t now_ms = get_clock_ms();
+    uint32_t boot_now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS; // the clock of sensor_channel_acquire
+    uint64_t time_ms;
+    float temperature;
+    float humidity;
+    sample_batch_cursor_t cursor = sample_batch_begin(&sample_batch);
+    while (sample_batch_next(&sample_batch, &cursor, &time_ms, &temperature, &humidity))
+    {
+        float record[SAMPLE_FIELD_COUNT];
+        for (size_t field = 0; field < SAMPLE_FIELD_COUNT; field++)
+        {
+            record[field] = NAN;
+        }
+        record[SENSOR_CHANNEL_TEMPERATURE] = temperature;
+        record[SENSOR_CHANNEL_HUMIDITY] = humidity;
+        if (!isnan(temperature) && !isnan(humidity))
+        {
+            derived_metrics_t derived;
+            derived_metrics_compute(temperature, humidity, &derived);
+            record[SAMPLE_FIELD_DEW_POINT] = derived.dew_point;
+            record[SAMPLE_FIELD_ABSOLUTE_HUMIDITY] = derived.absolute_humidity;
+            record[SAMPLE_FIELD_HEAT_INDEX] = derived.heat_index;
+        }
+        sensor_channel_store(boot_now_ms - (uint32_t)(now_ms - time_ms), record);
+    }
+    sample_batch_clear(&sample_batch);
+}
+
+/*
+ * enter_deep_sleep sleeps until the batch has something to do, or the button on WAKE_PIN is pressed; it never
+ *   returns.
+ * A reading pushed by task_read_sensor in the meantime is kept, and at worst wakes the device up early.
+ */
+static void enter_deep_sleep(void)
+{
+    uint64_t now_ms = get_clock_ms();
+    portENTER_CRITICAL(&sample_batch_lock);
+    uint64_t sleep_ms = sample_batch_sleep_ms(&sample_batch, now_ms);
+    size_t batch_len = sample_batch_len(&sample_batch);
+    portEXIT_CRITICAL(&sample_batch_lock);
+    ESP_LOGI(ESP_LOG_TAG, "deep sleep for %llu ms, %u readings in the batch", (unsigned long long)sleep_ms,
+             (unsigned)batch_len);
+    // with nothing to wait for, the shortest sleep still goes through a whole wake-up
+    ESP_ERROR_CHECK(esp_sleep_enable_timer_wakeup((sleep_ms > 0 ? sleep_ms : 1) * 1000));
+#if SOC_PM_SUPPORT_EXT_WAKEUP
+    ESP_ERROR_CHECK(rtc_gpio_pullup_en(WAKE_PIN));
+    ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(WAKE_PIN, 0));
+#else
+    ESP_ERROR_CHECK(esp_deep_sleep_enable_gpio_wakeup(1ULL << WAKE_PIN, ESP_GPIO_WAKEUP_GPIO_LOW));
+#endif
+    esp_deep_sleep_start();
+}
+
+/*
+ * get_clock_ms returns the time of the RTC clock, which keeps running in deep sleep, in milliseconds.
+ */
+static uint64_t get_clock_ms(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+#endif
@@ -0,0 +1,130 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "runtime_stats.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define ESP_LOG_TAG "ENVI_SENSOR_RUNTIME_STATS"
+
+#define SINCE_BOOT_LINE_LEN 40 // task name, absolute and relative run time, as printed by vTaskGetRunTimeStats
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+/* Run time counter of a task at the end of the previous window */
+typedef struct
+{
+    TaskHandle_t handle;
+    uint32_t run_time;
+} task_run_time_t;
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static uint32_t find_previous_run_time(TaskHandle_t handle);
+
+static const char *format_core(BaseType_t core);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+static TaskStatus_t task_statuses[RUNTIME_STATS_MAX_TASKS];
+
+static task_run_time_t previous_run_times[RUNTIME_STATS_MAX_TASKS];
+static size_t previous_run_times_len = 0;
+static uint32_t previous_total_run_time = 0;
+
+static char since_boot_buf[RUNTIME_STATS_MAX_TASKS * SINCE_BOOT_LINE_LEN];
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+esp_err_t runtime_stats_log_window(void)
+{
+    uint32_t total_run_time = 0;
+    UBaseType_t len = uxTaskGetSystemState(task_statuses, RUNTIME_STATS_MAX_TASKS, &total_run_time);
+    if (len == 0)
+    {
+        ESP_LOGE(ESP_LOG_TAG, "more than %d tasks", RUNTIME_STATS_MAX_TASKS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // counters wrap around, unsigned differences stay correct as long as windows are shorter than that
+    uint32_t window = total_run_time - previous_total_run_time;
+    ESP_LOGI(ESP_LOG_TAG, "%-16s %6s %5s %6s", "task", "cpu %", "core", "stack");
+    for (UBaseType_t i = 0; i < len; i++)
+    {
+        const TaskStatus_t *status = &task_statuses[i];
+        uint32_t run_time = status->ulRunTimeCounter - find_previous_run_time(status->xHandle);
+        ESP_LOGI(ESP_LOG_TAG, "%-16s %6.1f %5s %6u", status->pcTaskName,
+                 window == 0 ? 0.0 : 100.0 * run_time / window, format_core(xTaskGetAffinity(status->xHandle)),
+                 (unsigned)status->usStackHighWaterMark);
+    }
+
+    for (UBaseType_t i = 0; i < len; i++)
+    {
+        previous_run_times[i].handle = task_statuses[i].xHandle;
+        previous_run_times[i].run_time = task_statuses[i].ulRunTimeCounter;
+    }
+    previous_run_times_len = len;
+    previous_total_run_time = total_run_time;
+    return ESP_OK;
+}
+
+void runtime_stats_print_since_boot(void)
+{
+    if (uxTaskGetNumberOfTasks() > RUNTIME_STATS_MAX_TASKS)
+    {
+        ESP_LOGE(ESP_LOG_TAG, "more than %d tasks", RUNTIME_STATS_MAX_TASKS);
+        return;
+    }
+    vTaskGetRunTimeStats(since_boot_buf);
+    printf("%s", since_boot_buf);
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * find_previous_run_time returns the run time counter of the task at the end of the previous window,
+ *   or 0 if the task has been created since.
+ */
+static uint32_t find_previous_run_time(TaskHandle_t handle)
+{
+    for (size_t i = 0; i < previous_run_times_len; i++)
+    {
+        if (previous_run_times[i].handle == handle)
+        {
+            return previous_run_times[i].run_time;
+        }
+    }
+    return 0;
+}
+
+static const char *format_core(BaseType_t core)
+{
+    switch (core)
+    {
+    case 0:
+        return "0";
+    case 1:
+        return "1";
+    default:
+        return "any";
+    }
+}
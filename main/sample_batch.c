@@ -0,0 +1,138 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "sample_batch.h"
+
+#include "float_batch.h"
+
+#include <math.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define CENTI_SCALE 100
+#define DELTA_MAX_S UINT16_MAX // longer gaps, only possible if the clock jumps, are stored as this
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static float from_centi(int16_t centi);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void sample_batch_init(sample_batch_t *batch, size_t publish_len, uint64_t now_ms)
+{
+    batch->publish_len = publish_len < SAMPLE_BATCH_MAX_LEN ? publish_len : SAMPLE_BATCH_MAX_LEN;
+    batch->len = 0;
+    batch->first_ms = 0;
+    batch->last_ms = 0;
+    batch->next_reading_ms = now_ms;
+}
+
+sample_batch_action_t sample_batch_on_wake(const sample_batch_t *batch, sample_batch_wake_t wake, uint64_t now_ms)
+{
+    if (wake == SAMPLE_BATCH_WAKE_BUTTON || batch->len >= batch->publish_len)
+    {
+        return SAMPLE_BATCH_PUBLISH;
+    }
+    if (now_ms >= batch->next_reading_ms)
+    {
+        return SAMPLE_BATCH_READ;
+    }
+    return SAMPLE_BATCH_SLEEP;
+}
+
+bool sample_batch_push(sample_batch_t *batch, float temperature, float humidity, uint64_t now_ms, uint32_t period_ms)
+{
+    batch->next_reading_ms += period_ms;
+    if (batch->next_reading_ms <= now_ms)
+    {
+        batch->next_reading_ms = now_ms + period_ms;
+    }
+    if (batch->len == SAMPLE_BATCH_MAX_LEN)
+    {
+        return false;
+    }
+
+    sample_batch_item_t *item = &batch->items[batch->len];
+    if (batch->len == 0)
+    {
+        batch->first_ms = now_ms;
+        batch->last_ms = now_ms;
+        item->delta_s = 0;
+    }
+    else
+    {
+        // rounded against the rebuilt time of the previous reading, so that rounding errors don't add up
+        uint64_t delta_s = (now_ms - batch->last_ms + 500) / 1000;
+        item->delta_s = delta_s < DELTA_MAX_S ? delta_s : DELTA_MAX_S;
+        batch->last_ms += (uint64_t)item->delta_s * 1000;
+    }
+    float_batch_quantize_i16(&temperature, 1, CENTI_SCALE, &item->centi_temperature);
+    float_batch_quantize_i16(&humidity, 1, CENTI_SCALE, &item->centi_humidity);
+    batch->len++;
+    return true;
+}
+
+uint64_t sample_batch_sleep_ms(const sample_batch_t *batch, uint64_t now_ms)
+{
+    if (batch->len >= batch->publish_len || batch->next_reading_ms <= now_ms)
+    {
+        return 0;
+    }
+    return batch->next_reading_ms - now_ms;
+}
+
+size_t sample_batch_len(const sample_batch_t *batch)
+{
+    return batch->len;
+}
+
+sample_batch_cursor_t sample_batch_begin(const sample_batch_t *batch)
+{
+    return (sample_batch_cursor_t){.n = 0, .time_ms = batch->first_ms};
+}
+
+size_t sample_batch_next(const sample_batch_t *batch, sample_batch_cursor_t *cursor, uint64_t *time_ms,
+                         float *temperature, float *humidity)
+{
+    if (cursor->n >= batch->len)
+    {
+        return 0;
+    }
+    const sample_batch_item_t *item = &batch->items[cursor->n];
+    // the first reading's delta is 0
+    cursor->time_ms += (uint64_t)item->delta_s * 1000;
+    cursor->n++;
+    *time_ms = cursor->time_ms;
+    *temperature = from_centi(item->centi_temperature);
+    *humidity = from_centi(item->centi_humidity);
+    return 1;
+}
+
+void sample_batch_clear(sample_batch_t *batch)
+{
+    batch->len = 0;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static float from_centi(int16_t centi)
+{
+    return centi == INT16_MIN ? NAN : (float)centi / CENTI_SCALE;
+}
@@ -0,0 +1,135 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "sample_bus.h"
+
+#include <assert.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static bool deliver(sample_bus_consumer_t *consumer, const void *item);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+// counters_lock guards the counters of all the consumers, which are updated by both producer and consumers
+static portMUX_TYPE counters_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+sample_bus_t sample_bus_init(size_t item_size, sample_bus_consumer_t consumers[], size_t consumers_capacity)
+{
+    assert(item_size > 0 && item_size <= SAMPLE_BUS_MAX_ITEM_SIZE);
+    sample_bus_t bus = {.item_size = item_size, .consumers = consumers, .consumers_capacity = consumers_capacity};
+    return bus;
+}
+
+sample_bus_consumer_t *sample_bus_subscribe(sample_bus_t *bus, const char *name, size_t depth,
+                                            sample_bus_policy_t policy, uint32_t max_block_ms)
+{
+    assert(depth > 0);
+    if (bus->consumers_len == bus->consumers_capacity)
+    {
+        return NULL;
+    }
+    QueueHandle_t queue = xQueueCreate(depth, bus->item_size);
+    if (queue == NULL)
+    {
+        return NULL;
+    }
+    sample_bus_consumer_t *consumer = &bus->consumers[bus->consumers_len++];
+    sample_bus_consumer_t new_consumer = {.name = name,
+                                          .queue = queue,
+                                          .depth = depth,
+                                          .policy = policy,
+                                          .max_block_ticks = max_block_ms / portTICK_PERIOD_MS};
+    *consumer = new_consumer;
+    return consumer;
+}
+
+size_t sample_bus_publish(sample_bus_t *bus, const void *item)
+{
+    size_t failed_count = 0;
+    for (size_t i = 0; i < bus->consumers_len; i++)
+    {
+        if (!deliver(&bus->consumers[i], item))
+        {
+            failed_count++;
+        }
+    }
+    return failed_count;
+}
+
+bool sample_bus_receive(sample_bus_consumer_t *consumer, void *dst, TickType_t ticks_to_wait)
+{
+    if (xQueueReceive(consumer->queue, dst, ticks_to_wait) != pdTRUE)
+    {
+        return false;
+    }
+    bool late = uxQueueMessagesWaiting(consumer->queue) > 0;
+    portENTER_CRITICAL(&counters_lock);
+    consumer->counters.delivered++;
+    if (late)
+    {
+        consumer->counters.late++;
+    }
+    portEXIT_CRITICAL(&counters_lock);
+    return true;
+}
+
+void sample_bus_get_counters(const sample_bus_consumer_t *consumer, sample_bus_counters_t *dst)
+{
+    portENTER_CRITICAL(&counters_lock);
+    *dst = consumer->counters;
+    portEXIT_CRITICAL(&counters_lock);
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * deliver copies item into the consumer's queue, applying the consumer's policy if the queue is full.
+ * It returns false if item was dropped; with SAMPLE_BUS_OVERWRITE_OLDEST, the oldest sample is dropped instead.
+ */
+static bool deliver(sample_bus_consumer_t *consumer, const void *item)
+{
+    if (consumer->policy == SAMPLE_BUS_BLOCK)
+    {
+        if (xQueueSend(consumer->queue, item, consumer->max_block_ticks) == pdTRUE)
+        {
+            return true;
+        }
+        portENTER_CRITICAL(&counters_lock);
+        consumer->counters.dropped++;
+        portEXIT_CRITICAL(&counters_lock);
+        return false;
+    }
+
+    // the consumer can empty the queue concurrently, so retry until there's room for item
+    while (xQueueSend(consumer->queue, item, 0) != pdTRUE)
+    {
+        uint8_t discarded[SAMPLE_BUS_MAX_ITEM_SIZE];
+        if (xQueueReceive(consumer->queue, discarded, 0) == pdTRUE)
+        {
+            portENTER_CRITICAL(&counters_lock);
+            consumer->counters.dropped++;
+            portEXIT_CRITICAL(&counters_lock);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,310 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "sample_store.h"
+
+#include <assert.h>
+#include <math.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define RESAMPLE_TOLERANCE 1e-3 // in appends, absorbs rounding errors of step without adding a whole record
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static size_t physical_idx(const sample_store_t *store, size_t n);
+
+static float *column(const sample_store_t *store, size_t field);
+
+static void reverse(sample_store_t *store, size_t begin, size_t end);
+
+static void swap_records(sample_store_t *store, size_t a, size_t b);
+
+static void interpolate(sample_store_t *store, size_t len, double pos, size_t dst);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+sample_store_t sample_store_init(float values[], uint32_t timestamps_ms[], size_t fields_len, size_t max_capacity,
+                                 size_t capacity)
+{
+    assert(fields_len > 0 && capacity > 0 && capacity <= max_capacity);
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    assert(mutex);
+    sample_store_t store = {.values = values,
+                            .timestamps_ms = timestamps_ms,
+                            .fields_len = fields_len,
+                            .max_capacity = max_capacity,
+                            .capacity = capacity,
+                            .count = 0,
+                            .head = capacity - 1,
+                            .mutex = mutex};
+    return store;
+}
+
+void sample_store_append(sample_store_t *store, uint32_t timestamp_ms, const float values[])
+{
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    store->head = (store->head + 1) % store->capacity;
+    store->timestamps_ms[store->head] = timestamp_ms;
+    for (size_t field = 0; field < store->fields_len; field++)
+    {
+        column(store, field)[store->head] = values[field];
+    }
+    if (store->count < store->capacity)
+    {
+        store->count++;
+    }
+    xSemaphoreGive(store->mutex);
+}
+
+size_t sample_store_get_record(const sample_store_t *store, size_t n, uint32_t *timestamp_ms, float values[])
+{
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    if (n >= store->count)
+    {
+        xSemaphoreGive(store->mutex);
+        return 0;
+    }
+    size_t idx = physical_idx(store, n);
+    *timestamp_ms = store->timestamps_ms[idx];
+    for (size_t field = 0; field < store->fields_len; field++)
+    {
+        values[field] = column(store, field)[idx];
+    }
+    xSemaphoreGive(store->mutex);
+    return 1;
+}
+
+size_t sample_store_get_value(const sample_store_t *store, size_t field, size_t n, float *dst)
+{
+    assert(field < store->fields_len);
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    if (n >= store->count)
+    {
+        xSemaphoreGive(store->mutex);
+        return 0;
+    }
+    *dst = column(store, field)[physical_idx(store, n)];
+    xSemaphoreGive(store->mutex);
+    return 1;
+}
+
+size_t sample_store_get_nth(const sample_store_t *store, size_t field, size_t n, float *dst)
+{
+    assert(field < store->fields_len);
+    size_t get_count = 0;
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    const float *values = column(store, field);
+    for (size_t i = 0, seen = 0; i < store->count; i++)
+    {
+        float value = values[physical_idx(store, i)];
+        if (isnan(value))
+        {
+            continue;
+        }
+        if (seen++ == n)
+        {
+            *dst = value;
+            get_count = 1;
+            break;
+        }
+    }
+    xSemaphoreGive(store->mutex);
+    return get_count;
+}
+
+size_t sample_store_query(const sample_store_t *store, size_t field, size_t max_count, float dst[],
+                          uint32_t timestamps_ms[])
+{
+    assert(field < store->fields_len);
+    size_t count = 0;
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    const float *values = column(store, field);
+    for (size_t i = 0; i < store->count && count < max_count; i++)
+    {
+        size_t idx = physical_idx(store, i);
+        float value = values[idx];
+        if (isnan(value))
+        {
+            continue;
+        }
+        dst[count] = value;
+        if (timestamps_ms)
+        {
+            timestamps_ms[count] = store->timestamps_ms[idx];
+        }
+        count++;
+    }
+    xSemaphoreGive(store->mutex);
+    return count;
+}
+
+size_t sample_store_count(const sample_store_t *store)
+{
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    size_t count = store->count;
+    xSemaphoreGive(store->mutex);
+    return count;
+}
+
+size_t sample_store_capacity(const sample_store_t *store)
+{
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    size_t capacity = store->capacity;
+    xSemaphoreGive(store->mutex);
+    return capacity;
+}
+
+void sample_store_resample(sample_store_t *store, size_t new_capacity, float step)
+{
+    assert(new_capacity > 0 && new_capacity <= store->max_capacity && step > 0);
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    size_t len = store->count;
+    if (len > 0)
+    {
+        // the records up to head, then the ones after it, are in reverse chronological order once reversed
+        reverse(store, 0, store->head + 1);
+        reverse(store, store->head + 1, len);
+    }
+
+    // new record k is the old one k * step appends ago, the last one no older than the oldest record
+    size_t new_len = 0;
+    while (len > 0 && new_len < new_capacity && (double)new_len * step <= len - 1 + RESAMPLE_TOLERANCE)
+    {
+        new_len++;
+    }
+    // resampling in place: record k only depends on old records not older than k * step, which are still to be
+    //   overwritten if they're further away than k, i.e. when downsampling; upsampling goes the other way round
+    if (step >= 1)
+    {
+        for (size_t k = 0; k < new_len; k++)
+        {
+            interpolate(store, len, (double)k * step, k);
+        }
+    }
+    else
+    {
+        for (size_t k = new_len; k-- > 0;)
+        {
+            interpolate(store, len, (double)k * step, k);
+        }
+    }
+
+    reverse(store, 0, new_len);
+    store->capacity = new_capacity;
+    store->count = new_len;
+    store->head = new_len > 0 ? new_len - 1 : new_capacity - 1;
+    xSemaphoreGive(store->mutex);
+}
+
+size_t sample_store_lock_spans(const sample_store_t *store, sample_store_span_t spans[2])
+{
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    // until the store wraps around, the records are stored from its start
+    size_t first = store->count < store->capacity ? 0 : (store->head + 1) % store->capacity;
+    size_t len = store->capacity - first < store->count ? store->capacity - first : store->count;
+    spans[0] = (sample_store_span_t){.first = first, .len = len};
+    spans[1] = (sample_store_span_t){.first = 0, .len = store->count - len};
+    return store->count;
+}
+
+void sample_store_unlock_spans(const sample_store_t *store)
+{
+    xSemaphoreGive(store->mutex);
+}
+
+const float *sample_store_span_values(const sample_store_t *store, const sample_store_span_t *span, size_t field)
+{
+    assert(field < store->fields_len);
+    return column(store, field) + span->first;
+}
+
+const uint32_t *sample_store_span_timestamps(const sample_store_t *store, const sample_store_span_t *span)
+{
+    return store->timestamps_ms + span->first;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * physical_idx returns where the record added n appends ago is stored.
+ */
+static size_t physical_idx(const sample_store_t *store, size_t n)
+{
+    return (store->head + store->capacity - n) % store->capacity;
+}
+
+/*
+ * column returns the values of field, one for each record: fields are stored one after the other, each in a column of
+ *   max_capacity values, so that resampling to a longer history doesn't move them.
+ */
+static float *column(const sample_store_t *store, size_t field)
+{
+    return &store->values[field * store->max_capacity];
+}
+
+static void reverse(sample_store_t *store, size_t begin, size_t end)
+{
+    while (end > begin + 1)
+    {
+        end--;
+        swap_records(store, begin, end);
+        begin++;
+    }
+}
+
+static void swap_records(sample_store_t *store, size_t a, size_t b)
+{
+    uint32_t tmp_timestamp = store->timestamps_ms[a];
+    store->timestamps_ms[a] = store->timestamps_ms[b];
+    store->timestamps_ms[b] = tmp_timestamp;
+    for (size_t field = 0; field < store->fields_len; field++)
+    {
+        float *values = column(store, field);
+        float tmp = values[a];
+        values[a] = values[b];
+        values[b] = tmp;
+    }
+}
+
+/*
+ * interpolate writes into record dst the record pos appends ago, linearly interpolated between the records around it,
+ *   from the len records stored newest first.
+ * A field missing from either record is missing from the result too, unless pos falls exactly on a record.
+ */
+static void interpolate(sample_store_t *store, size_t len, double pos, size_t dst)
+{
+    size_t i = (size_t)pos;
+    double fraction = pos - i;
+    if (i >= len - 1)
+    {
+        i = len - 1;
+        fraction = 0;
+    }
+    const size_t next = fraction > 0 ? i + 1 : i;
+    const uint32_t newer_ms = store->timestamps_ms[i];
+    const uint32_t older_ms = store->timestamps_ms[next];
+    store->timestamps_ms[dst] = newer_ms - (uint32_t)llround(fraction * (uint32_t)(newer_ms - older_ms));
+    for (size_t field = 0; field < store->fields_len; field++)
+    {
+        float *values = column(store, field);
+        values[dst] = values[i] + fraction * (values[next] - values[i]);
+    }
+}
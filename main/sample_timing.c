@@ -0,0 +1,107 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "sample_timing.h"
+
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static size_t find_bin(int64_t lateness_us);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void sample_timing_init(sample_timing_t *timing, uint32_t deadline_us)
+{
+    memset(timing, 0, sizeof(*timing));
+    timing->deadline_us = deadline_us;
+}
+
+void sample_timing_record(sample_timing_t *timing, int64_t scheduled_us, int64_t actual_us)
+{
+    int64_t lateness_us = actual_us - scheduled_us;
+    if (timing->samples == 0 || lateness_us < timing->min_lateness_us)
+    {
+        timing->min_lateness_us = lateness_us;
+    }
+    if (timing->samples == 0 || lateness_us > timing->max_lateness_us)
+    {
+        timing->max_lateness_us = lateness_us;
+    }
+    if (lateness_us > (int64_t)timing->deadline_us)
+    {
+        timing->missed_deadlines++;
+    }
+    timing->histogram[find_bin(lateness_us)]++;
+    timing->total_lateness_us += lateness_us;
+
+    sample_timing_record_t *record = &timing->recent[timing->samples % SAMPLE_TIMING_RECENT_LEN];
+    record->scheduled_us = scheduled_us;
+    record->actual_us = actual_us;
+    timing->samples++;
+}
+
+bool sample_timing_get_recent(const sample_timing_t *timing, size_t nth, sample_timing_record_t *dst)
+{
+    if (nth >= timing->samples || nth >= SAMPLE_TIMING_RECENT_LEN)
+    {
+        return false;
+    }
+    *dst = timing->recent[(timing->samples - 1 - nth) % SAMPLE_TIMING_RECENT_LEN];
+    return true;
+}
+
+int64_t sample_timing_mean_lateness_us(const sample_timing_t *timing)
+{
+    return timing->samples == 0 ? 0 : timing->total_lateness_us / timing->samples;
+}
+
+bool sample_timing_retry_delay(const sample_timing_retry_t *retry, uint32_t attempt, uint32_t elapsed_ms,
+                               uint32_t *delay_ms)
+{
+    if (attempt >= retry->max_attempts || attempt >= 32)
+    {
+        return false;
+    }
+    uint64_t delay = (uint64_t)retry->base_delay_ms << attempt;
+    if (elapsed_ms + delay > retry->budget_ms)
+    {
+        return false;
+    }
+    *delay_ms = delay;
+    return true;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static size_t find_bin(int64_t lateness_us)
+{
+    int64_t magnitude = lateness_us < 0 ? -lateness_us : lateness_us;
+    int64_t upper_bound = SAMPLE_TIMING_BIN0_US;
+    size_t bin = 0;
+    while (bin < SAMPLE_TIMING_BINS - 1 && magnitude >= upper_bound)
+    {
+        upper_bound *= 2;
+        bin++;
+    }
+    return bin;
+}
@@ -0,0 +1,112 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "sample_window.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static size_t next_reading_age(const sample_store_t *store, size_t field, size_t age);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void sample_window_init(sample_window_t *win, stats_window_t stats, const sample_store_t *store, size_t field,
+                        const float history[], size_t history_len)
+{
+    win->stats = stats;
+    win->field = field;
+    win->oldest_age = 0;
+    size_t filled_len = stats.capacity < history_len ? stats.capacity : history_len;
+    // oldest first; the window never fills up before the last one, so no item is evicted
+    for (size_t n = filled_len; n-- > 0;)
+    {
+        stats_window_push(&win->stats, history[n], NAN);
+    }
+
+    // the oldest item is the field's (filled_len - 1)th newest reading
+    float value;
+    for (size_t age = 0, seen = 0; seen < filled_len && sample_store_get_value(store, field, age, &value); age++)
+    {
+        if (isnan(value))
+        {
+            continue;
+        }
+        win->oldest_age = age;
+        seen++;
+    }
+}
+
+void sample_window_evict(sample_window_t *win, const sample_store_t *store, float new_item)
+{
+    if (win->stats.count == 0)
+    {
+        return;
+    }
+    // the append overwrites the oldest record once the store is full
+    size_t capacity = sample_store_capacity(store);
+    bool overwritten = win->oldest_age == capacity - 1 && sample_store_count(store) == capacity;
+    // the oldest reading leaves the window to make room for the new one, or when it leaves the history
+    if ((win->stats.count == win->stats.capacity && !isnan(new_item)) || overwritten)
+    {
+        float oldest = NAN;
+        sample_store_get_value(store, win->field, win->oldest_age, &oldest);
+        stats_window_pop(&win->stats, oldest);
+        if (win->stats.count > 0)
+        {
+            win->oldest_age = next_reading_age(store, win->field, win->oldest_age);
+        }
+    }
+}
+
+void sample_window_push(sample_window_t *win, float new_item)
+{
+    win->oldest_age++;
+    if (isnan(new_item))
+    {
+        return;
+    }
+    if (win->stats.count == 0)
+    {
+        win->oldest_age = 0;
+    }
+    stats_window_push(&win->stats, new_item, NAN);
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * next_reading_age returns how many appends ago the field's reading following the one stored age appends ago was
+ *   stored; such a reading must exist.
+ * Each record is skipped at most once per window, so the cost is O(1) on average.
+ */
+static size_t next_reading_age(const sample_store_t *store, size_t field, size_t age)
+{
+    float value = NAN;
+    do
+    {
+        age--;
+        sample_store_get_value(store, field, age, &value);
+    } while (isnan(value) && age > 0);
+    return age;
+}
@@ -0,0 +1,488 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "sensor_channel.h"
+
+#include "ble.h"
+#include "debug_trace.h"
+#include "envi_config.h"
+#include "sample_window.h"
+
+#include "driver/i2c.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sht21.h"
+#include <assert.h>
+#include <math.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define ESP_LOG_TAG "ENVI_SENSOR_CHANNEL"
+#include "iferr.h"
+
+#define MUX_TIMEOUT_MS 50
+
+#define STATS_BINS_LEN 500 // histogram bins per statistics window, enough for every quantity
+
+#define LONG_WINDOW_LEN 240 // values of the long window, each the mean of as many readings as needed to cover it
+#define INIT_HISTORY_LEN (CONFIG_HISTORY_MAX_LEN > LONG_WINDOW_LEN ? CONFIG_HISTORY_MAX_LEN : LONG_WINDOW_LEN)
+
+_Static_assert((uint64_t)CONFIG_STATS_WINDOW_SHORT_MINUTES * 60000 / CONFIG_READ_SENSOR_FREQUENCY_MS <=
+                       CONFIG_SAMPLE_STORE_DEFAULT_LEN &&
+                   (uint64_t)CONFIG_STATS_WINDOW_MEDIUM_MINUTES * 60000 / CONFIG_READ_SENSOR_FREQUENCY_MS <=
+                       CONFIG_SAMPLE_STORE_DEFAULT_LEN,
+               "the short and medium statistics windows don't fit into the default history");
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+typedef struct
+{
+    float min; // readings are clamped to [min, max]
+    float max;
+    float bins_min; // histogram used for percentiles, STATS_BINS_LEN bins wide bin_width each
+    float bin_width;
+} quantity_range_t;
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static esp_err_t select_mux_port(int8_t port);
+
+static void sort_acquisition_order(void);
+
+static void append_to_windows(sample_store_t *dst, sensor_channel_stats_window_t first,
+                              sensor_channel_stats_window_t end, uint32_t timestamp_ms, const float record[]);
+
+static void store_long_record(uint32_t timestamp_ms, const float record[]);
+
+static void init_stats_windows(sensor_channel_id_t id);
+
+static uint32_t long_window_stride(void);
+
+static sample_store_t *window_store(sensor_channel_stats_window_t window);
+
+static size_t window_len(sensor_channel_id_t id, sensor_channel_stats_window_t window);
+
+static uint32_t window_period_ms(sensor_channel_id_t id, sensor_channel_stats_window_t window);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+static const quantity_range_t quantity_ranges[SENSOR_QUANTITY_COUNT] = {
+    [SENSOR_QUANTITY_TEMPERATURE] = {.min = -40, .max = 125, .bins_min = -40, .bin_width = 0.25}, // up to 85 °C
+    [SENSOR_QUANTITY_HUMIDITY] = {.min = 0, .max = 100, .bins_min = 0, .bin_width = 0.25},
+    [SENSOR_QUANTITY_PRESSURE] = {.min = 300, .max = 1100, .bins_min = 300, .bin_width = 2},
+};
+
+static const sensor_channel_desc_t channel_descs[SENSOR_CHANNEL_COUNT] = {
+    [SENSOR_CHANNEL_TEMPERATURE] = {.name = "temperature",
+                                    .quantity = SENSOR_QUANTITY_TEMPERATURE,
+                                    .mux_port = SENSOR_SHT21_MUX_PORT,
+                                    .period_multiplier = 1,
+                                    .read = sht21_get_temperature,
+                                    .ble_write = ble_write_temperature},
+    [SENSOR_CHANNEL_HUMIDITY] = {.name = "humidity",
+                                 .quantity = SENSOR_QUANTITY_HUMIDITY,
+                                 .mux_port = SENSOR_SHT21_MUX_PORT,
+                                 .period_multiplier = 1,
+                                 .read = sht21_get_humidity,
+                                 .ble_write = ble_write_humidity},
+#if CONFIG_SENSOR_SECOND_SHT21
+    [SENSOR_CHANNEL_TEMPERATURE_2] = {.name = "temperature_2",
+                                      .quantity = SENSOR_QUANTITY_TEMPERATURE,
+                                      .mux_port = CONFIG_SENSOR_SECOND_SHT21_MUX_PORT,
+                                      .period_multiplier = CONFIG_SENSOR_SECOND_SHT21_PERIOD_MULTIPLIER,
+                                      .read = sht21_get_temperature,
+                                      .ble_write = NULL},
+    [SENSOR_CHANNEL_HUMIDITY_2] = {.name = "humidity_2",
+                                   .quantity = SENSOR_QUANTITY_HUMIDITY,
+                                   .mux_port = CONFIG_SENSOR_SECOND_SHT21_MUX_PORT,
+                                   .period_multiplier = CONFIG_SENSOR_SECOND_SHT21_PERIOD_MULTIPLIER,
+                                   .read = sht21_get_humidity,
+                                   .ble_write = NULL},
+#endif
+};
+
+// channels sorted by multiplexer port, so that each port is selected at most once per cycle
+static sensor_channel_id_t acquisition_order[SENSOR_CHANNEL_COUNT];
+
+// i2c_bus_mutex is held for the whole acquisition cycle
+static SemaphoreHandle_t i2c_bus_mutex = NULL;
+
+// channel_errors counts the failed readings of each channel, only written by sensor_channel_acquire
+static volatile uint32_t channel_errors[SENSOR_CHANNEL_COUNT];
+
+/* History of the channels, resampled and written under stats_mutex too, so that the windows always match it */
+static sample_store_t *store = NULL;
+
+/* Period set by sensor_channel_init or sensor_channel_reconfigure, guarded by stats_mutex */
+static uint32_t channels_read_period_ms = CONFIG_READ_SENSOR_FREQUENCY_MS;
+
+/* Statistics windows over the channels' history, guarded by stats_mutex */
+static sample_window_t channel_stats[SENSOR_CHANNEL_COUNT][SENSOR_CHANNEL_STATS_WINDOW_COUNT];
+static uint16_t channel_stats_bins_[SENSOR_CHANNEL_COUNT][SENSOR_CHANNEL_STATS_WINDOW_COUNT][STATS_BINS_LEN];
+static SemaphoreHandle_t stats_mutex = NULL;
+
+/* History of the long statistics window, guarded by stats_mutex: a record every long_stride records of the sample
+ *   store, each field the mean of the channel's readings in between, or NAN if none, so that the window covers its
+ *   whole length whatever the history length */
+static float long_values_[SENSOR_CHANNEL_COUNT * LONG_WINDOW_LEN];
+static uint32_t long_timestamps_ms_[LONG_WINDOW_LEN];
+static sample_store_t long_store;
+static uint32_t long_stride = 1;
+static uint32_t long_pending = 0; // records of the sample store summed into long_sums since the last long record
+static float long_sums[SENSOR_CHANNEL_COUNT];
+static uint32_t long_counts[SENSOR_CHANNEL_COUNT];
+
+static const uint32_t stats_window_configured_minutes[SENSOR_CHANNEL_STATS_WINDOW_COUNT] = {
+    [SENSOR_CHANNEL_STATS_WINDOW_SHORT] = CONFIG_STATS_WINDOW_SHORT_MINUTES,
+    [SENSOR_CHANNEL_STATS_WINDOW_MEDIUM] = CONFIG_STATS_WINDOW_MEDIUM_MINUTES,
+    [SENSOR_CHANNEL_STATS_WINDOW_LONG] = CONFIG_STATS_WINDOW_LONG_MINUTES,
+};
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+esp_err_t sensor_channel_init(sample_store_t *store_, uint32_t read_period_ms)
+{
+    if (read_period_ms == 0 || store_->fields_len != SAMPLE_FIELD_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    store = store_;
+    channels_read_period_ms = read_period_ms;
+    i2c_bus_mutex = xSemaphoreCreateMutex();
+    stats_mutex = xSemaphoreCreateMutex();
+    assert(i2c_bus_mutex && stats_mutex);
+    long_store = sample_store_init(long_values_, long_timestamps_ms_, SENSOR_CHANNEL_COUNT, LONG_WINDOW_LEN,
+                                   LONG_WINDOW_LEN);
+    long_stride = long_window_stride();
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        init_stats_windows(id);
+    }
+    sort_acquisition_order();
+    IFERR_RETE(sht21_init(SENSOR_I2C_PORT, SENSOR_SDA_PIN, SENSOR_SCL_PIN, sht21_i2c_speed_standard),
+               "failed to initialize the I2C bus");
+    return ESP_OK;
+}
+
+const sensor_channel_desc_t *sensor_channel_get_desc(sensor_channel_id_t id)
+{
+    assert(id < SENSOR_CHANNEL_COUNT);
+    return &channel_descs[id];
+}
+
+esp_err_t sensor_channel_acquire(uint32_t cycle, sensor_sample_t *dst)
+{
+    esp_err_t first_err = ESP_OK;
+    dst->acquired = 0;
+    dst->cycle = cycle;
+    int8_t selected_port = SENSOR_CHANNEL_NO_MUX;
+    esp_err_t select_err = ESP_OK;
+
+    xSemaphoreTake(i2c_bus_mutex, portMAX_DELAY);
+    DEBUG_TRACE_ENTER(I2C_READ);
+    for (size_t i = 0; i < SENSOR_CHANNEL_COUNT; i++)
+    {
+        sensor_channel_id_t id = acquisition_order[i];
+        const sensor_channel_desc_t *desc = &channel_descs[id];
+        if (cycle % desc->period_multiplier != 0)
+        {
+            continue;
+        }
+        if (desc->mux_port != selected_port)
+        {
+            selected_port = desc->mux_port;
+            select_err = select_mux_port(selected_port);
+        }
+        esp_err_t err = select_err;
+        float value;
+        if (err == ESP_OK && (err = desc->read(&value)) == ESP_OK)
+        {
+            const quantity_range_t *range = &quantity_ranges[desc->quantity];
+            if (value < range->min)
+                value = range->min;
+            if (value > range->max)
+                value = range->max;
+            dst->values[id] = value;
+            dst->acquired |= 1U << id;
+        }
+        else
+        {
+            ESP_LOGW(ESP_LOG_TAG, "could not read %s: %s", desc->name, esp_err_to_name(err));
+            channel_errors[id]++;
+            if (first_err == ESP_OK)
+                first_err = err;
+        }
+    }
+    DEBUG_TRACE_EXIT(I2C_READ);
+    xSemaphoreGive(i2c_bus_mutex);
+    dst->timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    return first_err;
+}
+
+void sensor_channel_store(uint32_t timestamp_ms, const float record[])
+{
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    append_to_windows(store, SENSOR_CHANNEL_STATS_WINDOW_SHORT, SENSOR_CHANNEL_STATS_WINDOW_LONG, timestamp_ms,
+                      record);
+    store_long_record(timestamp_ms, record);
+    xSemaphoreGive(stats_mutex);
+}
+
+esp_err_t sensor_channel_write_ble(const sensor_sample_t *sample)
+{
+    esp_err_t first_err = ESP_OK;
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        if (!sensor_sample_has(sample, id) || channel_descs[id].ble_write == NULL)
+        {
+            continue;
+        }
+        esp_err_t err = channel_descs[id].ble_write(sample->values[id]);
+        if (err != ESP_OK && first_err == ESP_OK)
+        {
+            first_err = err;
+        }
+    }
+    return first_err;
+}
+
+uint32_t sensor_channel_get_stats_window_minutes(sensor_channel_id_t id, sensor_channel_stats_window_t window)
+{
+    assert(id < SENSOR_CHANNEL_COUNT && window < SENSOR_CHANNEL_STATS_WINDOW_COUNT);
+    const stats_window_t *win = &channel_stats[id][window].stats;
+    return (uint64_t)win->capacity * win->sample_period_ms / 60000;
+}
+
+size_t sensor_channel_get_stats(sensor_channel_id_t id, sensor_channel_stats_window_t window, stats_t *dst)
+{
+    assert(id < SENSOR_CHANNEL_COUNT && window < SENSOR_CHANNEL_STATS_WINDOW_COUNT);
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    size_t count = stats_window_get(&channel_stats[id][window].stats, dst);
+    xSemaphoreGive(stats_mutex);
+    return count;
+}
+
+uint32_t sensor_channel_get_error_count(sensor_channel_id_t id)
+{
+    return channel_errors[id];
+}
+
+esp_err_t sensor_channel_reconfigure(uint32_t read_period_ms, size_t history_len)
+{
+    if (read_period_ms == 0 || history_len == 0 || history_len > CONFIG_HISTORY_MAX_LEN)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    // every channel is read a multiple of the period, so the ratio between old and new period is the same
+    float step = (float)read_period_ms / channels_read_period_ms;
+    uint64_t long_period_ms = (uint64_t)channels_read_period_ms * long_stride;
+    channels_read_period_ms = read_period_ms;
+    sample_store_resample(store, history_len, step);
+    // the long window keeps covering its length, at the resolution the new period needs; the readings not averaged
+    //   yet were taken at the old period, and are dropped
+    long_stride = long_window_stride();
+    float long_step = (float)((uint64_t)read_period_ms * long_stride) / long_period_ms;
+    sample_store_resample(&long_store, LONG_WINDOW_LEN, long_step);
+    long_pending = 0;
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        long_sums[id] = 0;
+        long_counts[id] = 0;
+        init_stats_windows(id);
+    }
+    xSemaphoreGive(stats_mutex);
+    ESP_LOGI(ESP_LOG_TAG, "history resampled to %u readings every %u ms", (unsigned)history_len,
+             (unsigned)read_period_ms);
+    return ESP_OK;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+/*
+ * select_mux_port routes the I2C bus to the given port of the TCA9548A multiplexer.
+ * It's a no-op when the sensor is wired directly to the bus.
+ */
+static esp_err_t select_mux_port(int8_t port)
+{
+    if (port == SENSOR_CHANNEL_NO_MUX)
+    {
+        return ESP_OK;
+    }
+#if CONFIG_SENSOR_I2C_MUX
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (CONFIG_SENSOR_I2C_MUX_ADDRESS << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, 1U << port, true);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(SENSOR_I2C_PORT, cmd, MUX_TIMEOUT_MS / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/*
+ * sort_acquisition_order sorts the channels by multiplexer port, keeping the channels' order within each port.
+ */
+static void sort_acquisition_order(void)
+{
+    for (size_t i = 0; i < SENSOR_CHANNEL_COUNT; i++)
+    {
+        sensor_channel_id_t id = i;
+        size_t j = i;
+        while (j > 0 && channel_descs[acquisition_order[j - 1]].mux_port > channel_descs[id].mux_port)
+        {
+            acquisition_order[j] = acquisition_order[j - 1];
+            j--;
+        }
+        acquisition_order[j] = id;
+    }
+}
+
+/*
+ * append_to_windows appends record to dst, and updates the statistics windows from first to end (excluded) of every
+ *   channel, which must be computed on dst.
+ */
+static void append_to_windows(sample_store_t *dst, sensor_channel_stats_window_t first,
+                              sensor_channel_stats_window_t end, uint32_t timestamp_ms, const float record[])
+{
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        for (size_t i = first; i < end; i++)
+        {
+            sample_window_evict(&channel_stats[id][i], dst, record[id]);
+        }
+    }
+    sample_store_append(dst, timestamp_ms, record);
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        for (size_t i = first; i < end; i++)
+        {
+            sample_window_push(&channel_stats[id][i], record[id]);
+        }
+    }
+}
+
+/*
+ * store_long_record sums the channels of record, and appends their means to the long window's history once
+ *   long_stride records have been summed.
+ */
+static void store_long_record(uint32_t timestamp_ms, const float record[])
+{
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        if (!isnan(record[id]))
+        {
+            long_sums[id] += record[id];
+            long_counts[id]++;
+        }
+    }
+    if (++long_pending < long_stride)
+    {
+        return;
+    }
+    float long_record[SENSOR_CHANNEL_COUNT];
+    for (sensor_channel_id_t id = 0; id < SENSOR_CHANNEL_COUNT; id++)
+    {
+        long_record[id] = long_counts[id] > 0 ? long_sums[id] / long_counts[id] : NAN;
+        long_sums[id] = 0;
+        long_counts[id] = 0;
+    }
+    long_pending = 0;
+    append_to_windows(&long_store, SENSOR_CHANNEL_STATS_WINDOW_LONG, SENSOR_CHANNEL_STATS_WINDOW_COUNT, timestamp_ms,
+                      long_record);
+}
+
+/*
+ * init_stats_windows creates the statistics windows of the channel for the current period and history length,
+ *   filled with the readings already in their history.
+ */
+static void init_stats_windows(sensor_channel_id_t id)
+{
+    // newest first; only used under stats_mutex
+    static float history[INIT_HISTORY_LEN];
+    const quantity_range_t *range = &quantity_ranges[channel_descs[id].quantity];
+    for (sensor_channel_stats_window_t i = 0; i < SENSOR_CHANNEL_STATS_WINDOW_COUNT; i++)
+    {
+        size_t len = window_len(id, i);
+        size_t history_len = sample_store_query(window_store(i), id, len, history, NULL);
+        stats_window_t win = stats_window_init(channel_stats_bins_[id][i], STATS_BINS_LEN, range->bins_min,
+                                               range->bin_width, len, window_period_ms(id, i));
+        sample_window_init(&channel_stats[id][i], win, window_store(i), id, history, history_len);
+    }
+}
+
+/*
+ * long_window_stride returns how many records of the sample store each value of the long window averages, so that
+ *   LONG_WINDOW_LEN values cover the window at the current period.
+ */
+static uint32_t long_window_stride(void)
+{
+    uint64_t readings = (uint64_t)CONFIG_STATS_WINDOW_LONG_MINUTES * 60000 / channels_read_period_ms;
+    uint64_t stride = (readings + LONG_WINDOW_LEN - 1) / LONG_WINDOW_LEN;
+    return stride > 0 ? stride : 1;
+}
+
+static sample_store_t *window_store(sensor_channel_stats_window_t window)
+{
+    return window == SENSOR_CHANNEL_STATS_WINDOW_LONG ? &long_store : store;
+}
+
+/*
+ * window_len converts the window length from minutes to number of values, limited by the values of the channel its
+ *   history can hold; only the short and medium windows can be limited, by the history length.
+ */
+static size_t window_len(sensor_channel_id_t id, sensor_channel_stats_window_t window)
+{
+    uint32_t minutes = stats_window_configured_minutes[window];
+    uint32_t period_ms = window_period_ms(id, window);
+    size_t len = (uint64_t)minutes * 60000 / period_ms;
+    uint64_t record_period_ms = (uint64_t)channels_read_period_ms * (window_store(window) == store ? 1 : long_stride);
+    size_t max_len = sample_store_capacity(window_store(window)) * record_period_ms / period_ms;
+    if (max_len == 0)
+    {
+        max_len = 1;
+    }
+    if (len == 0)
+    {
+        return 1;
+    }
+    if (len > max_len)
+    {
+        ESP_LOGW(ESP_LOG_TAG, "statistics window of %u minutes limited to %u readings", (unsigned)minutes,
+                 (unsigned)max_len);
+        return max_len;
+    }
+    return len;
+}
+
+/*
+ * window_period_ms returns the time between two values of the window: the channel's period for the short and medium
+ *   windows, at least long_stride records for the long one.
+ */
+static uint32_t window_period_ms(sensor_channel_id_t id, sensor_channel_stats_window_t window)
+{
+    uint32_t multiplier = channel_descs[id].period_multiplier;
+    if (window == SENSOR_CHANNEL_STATS_WINDOW_LONG && long_stride > multiplier)
+    {
+        multiplier = long_stride;
+    }
+    return channels_read_period_ms * multiplier;
+}
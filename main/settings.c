@@ -0,0 +1,129 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "settings.h"
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define ESP_LOG_TAG "ENVI_SENSOR_SETTINGS"
+#include "iferr.h"
+
+#define NVS_NAMESPACE "envi_settings"
+#define NVS_KEY_READ_PERIOD_MS "period_ms"
+#define NVS_KEY_HISTORY_LEN "history_len"
+
+_Static_assert(CONFIG_SAMPLE_STORE_DEFAULT_LEN >= SETTINGS_HISTORY_MIN_LEN &&
+                   CONFIG_SAMPLE_STORE_DEFAULT_LEN <= SETTINGS_HISTORY_MAX_LEN,
+               "the default history doesn't fit into CONFIG_HISTORY_MAX_LEN");
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+static void get_defaults(settings_t *dst);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+esp_err_t settings_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        IFERR_RETE(nvs_flash_erase(), "erase flash failed");
+        ret = nvs_flash_init();
+    }
+    IFERR_RETE(ret, "init flash failed");
+    return ESP_OK;
+}
+
+bool settings_validate(const settings_t *settings)
+{
+    // the period also leaves room for consumers blocking the sample bus, see CONFIG_SAMPLE_BUS_MAX_BLOCK_MS
+    return settings->read_period_ms >= SETTINGS_READ_PERIOD_MIN_MS &&
+           settings->read_period_ms <= SETTINGS_READ_PERIOD_MAX_MS &&
+           settings->read_period_ms > 2 * CONFIG_SAMPLE_BUS_MAX_BLOCK_MS &&
+           settings->history_len >= SETTINGS_HISTORY_MIN_LEN && settings->history_len <= SETTINGS_HISTORY_MAX_LEN;
+}
+
+esp_err_t settings_load(settings_t *dst)
+{
+    get_defaults(dst);
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        ESP_LOGI(ESP_LOG_TAG, "no settings stored, using the defaults");
+        return ESP_OK;
+    }
+    IFERR_RETE(err, "failed to open namespace %s", NVS_NAMESPACE);
+
+    settings_t stored = *dst;
+    err = nvs_get_u32(handle, NVS_KEY_READ_PERIOD_MS, &stored.read_period_ms);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        err = nvs_get_u32(handle, NVS_KEY_HISTORY_LEN, &stored.history_len);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    {
+        IFERR_RETE(err, "failed to read the settings");
+    }
+    if (!settings_validate(&stored))
+    {
+        ESP_LOGW(ESP_LOG_TAG, "stored settings out of range, using the defaults");
+        return ESP_OK;
+    }
+    *dst = stored;
+    ESP_LOGI(ESP_LOG_TAG, "period %u ms, history %u readings", (unsigned)dst->read_period_ms,
+             (unsigned)dst->history_len);
+    return ESP_OK;
+}
+
+esp_err_t settings_save(const settings_t *settings)
+{
+    if (!settings_validate(settings))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_handle_t handle;
+    IFERR_RETE(nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle), "failed to open namespace %s", NVS_NAMESPACE);
+    esp_err_t err = nvs_set_u32(handle, NVS_KEY_READ_PERIOD_MS, settings->read_period_ms);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_u32(handle, NVS_KEY_HISTORY_LEN, settings->history_len);
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    IFERR_RETE(err, "failed to store the settings");
+    return ESP_OK;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static void get_defaults(settings_t *dst)
+{
+    dst->read_period_ms = CONFIG_READ_SENSOR_FREQUENCY_MS;
+    dst->history_len = CONFIG_SAMPLE_STORE_DEFAULT_LEN;
+}
@@ -0,0 +1,252 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "stats.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define MS_PER_HOUR 3600000.0
+
+#define FIXED_MAX (1 << 23) // STATS_FIXED_POINT_MAX, in hundredths
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+#if CONFIG_STATS_FIXED_POINT
+static int32_t to_fixed(float item);
+
+static size_t bin_index(const stats_window_t *win, int32_t item);
+#else
+static size_t bin_index(const stats_window_t *win, float item);
+#endif
+
+static void remove_oldest(stats_window_t *win, float old_item);
+
+static void add_newest(stats_window_t *win, float new_item);
+
+static float percentile(const stats_window_t *win, float q);
+
+static float item_at_rank(const stats_window_t *win, size_t rank);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+stats_window_t stats_window_init(uint16_t bins[], size_t bins_len, float bins_min, float bin_width, size_t window_len,
+                                 uint32_t sample_period_ms)
+{
+    assert(bins_len > 0 && bin_width > 0 && window_len > 0 && window_len <= UINT16_MAX);
+    memset(bins, 0, bins_len * sizeof(bins[0]));
+    stats_window_t win = {.bins = bins,
+                          .bins_len = bins_len,
+                          .bins_min = bins_min,
+                          .bin_width = bin_width,
+                          .capacity = window_len,
+                          .sample_period_ms = sample_period_ms};
+#if CONFIG_STATS_FIXED_POINT
+    win.fixed_bins_min = to_fixed(bins_min);
+    win.fixed_bin_width = to_fixed(bin_width);
+    assert(win.fixed_bin_width > 0);
+#endif
+    return win;
+}
+
+void stats_window_push(stats_window_t *win, float new_item, float oldest_item)
+{
+    if (win->count == win->capacity)
+    {
+        remove_oldest(win, oldest_item);
+    }
+    add_newest(win, new_item);
+}
+
+void stats_window_pop(stats_window_t *win, float oldest_item)
+{
+    assert(win->count > 0);
+    remove_oldest(win, oldest_item);
+}
+
+size_t stats_window_get(const stats_window_t *win, stats_t *dst)
+{
+    size_t n = win->count;
+    if (n == 0)
+    {
+        return 0;
+    }
+    dst->count = n;
+#if CONFIG_STATS_FIXED_POINT
+    // only the result is floating point: it's computed when the statistics are shown, not on every update
+    double mean = (double)win->sum / n;
+    double m2 = (double)win->sum_sq - mean * win->sum;
+    dst->mean = mean / STATS_FIXED_POINT_SCALE;
+    double scale = STATS_FIXED_POINT_SCALE;
+#else
+    dst->mean = win->mean;
+    double m2 = win->m2;
+    double scale = 1;
+#endif
+    dst->stddev = 0;
+    dst->trend = 0;
+    if (n > 1)
+    {
+        dst->stddev = sqrt(fmax(m2, 0) / (n - 1)) / scale;
+        double slope_per_sample =
+            ((double)win->index_sum - (n - 1) / 2.0 * win->sum) / (n * ((double)n * n - 1) / 12.0) / scale;
+        dst->trend = slope_per_sample * (MS_PER_HOUR / win->sample_period_ms);
+    }
+    dst->p10 = percentile(win, 0.1f);
+    dst->p90 = percentile(win, 0.9f);
+    return n;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+#if CONFIG_STATS_FIXED_POINT
+/*
+ * to_fixed is the only floating-point operation left to an update, as items come in as floats: a multiplication and
+ *   lroundf, emulated in software on targets without an FPU.
+ */
+static int32_t to_fixed(float item)
+{
+    float fixed = item * STATS_FIXED_POINT_SCALE;
+    if (!(fixed > -FIXED_MAX))
+    {
+        return -FIXED_MAX;
+    }
+    if (fixed > FIXED_MAX)
+    {
+        return FIXED_MAX;
+    }
+    return lroundf(fixed);
+}
+
+static size_t bin_index(const stats_window_t *win, int32_t item)
+{
+    int32_t offset = item - win->fixed_bins_min;
+    if (offset < 0)
+    {
+        return 0;
+    }
+    size_t idx = offset / win->fixed_bin_width;
+    return idx < win->bins_len ? idx : win->bins_len - 1;
+}
+
+static void remove_oldest(stats_window_t *win, float old_item)
+{
+    int32_t item = to_fixed(old_item);
+    // every remaining item moves one position towards the start of the window
+    win->sum -= item;
+    win->index_sum -= win->sum;
+    win->sum_sq -= (int64_t)item * item;
+    win->bins[bin_index(win, item)]--;
+    win->count--;
+}
+
+static void add_newest(stats_window_t *win, float new_item)
+{
+    int32_t item = to_fixed(new_item);
+    win->index_sum += (int64_t)win->count * item;
+    win->sum += item;
+    win->sum_sq += (int64_t)item * item;
+    win->count++;
+    win->bins[bin_index(win, item)]++;
+}
+#else
+static size_t bin_index(const stats_window_t *win, float item)
+{
+    float idx = floorf((item - win->bins_min) / win->bin_width);
+    if (!(idx > 0))
+    {
+        return 0;
+    }
+    if (idx >= win->bins_len)
+    {
+        return win->bins_len - 1;
+    }
+    return (size_t)idx;
+}
+
+static void remove_oldest(stats_window_t *win, float old_item)
+{
+    size_t n = win->count;
+    // every remaining item moves one position towards the start of the window
+    win->sum -= old_item;
+    win->index_sum -= win->sum;
+    if (n == 1)
+    {
+        win->mean = 0;
+        win->m2 = 0;
+    }
+    else
+    {
+        double old_mean = win->mean;
+        win->mean = (n * old_mean - old_item) / (n - 1);
+        win->m2 -= (old_item - old_mean) * (old_item - win->mean);
+    }
+    win->bins[bin_index(win, old_item)]--;
+    win->count--;
+}
+
+static void add_newest(stats_window_t *win, float new_item)
+{
+    win->index_sum += (double)win->count * new_item;
+    win->sum += new_item;
+    win->count++;
+    double delta = new_item - win->mean;
+    win->mean += delta / win->count;
+    win->m2 += delta * (new_item - win->mean);
+    win->bins[bin_index(win, new_item)]++;
+}
+#endif
+
+/*
+ * The items in each bin are assumed to be evenly spread within the bin, and the percentile is
+ *   linearly interpolated between the two items closest to the requested rank.
+ */
+static float percentile(const stats_window_t *win, float q)
+{
+    float rank = q * (win->count - 1);
+    size_t lower_rank = (size_t)rank;
+    float lower = item_at_rank(win, lower_rank);
+    if (lower_rank + 1 >= win->count)
+    {
+        return lower;
+    }
+    float upper = item_at_rank(win, lower_rank + 1);
+    return lower + (rank - lower_rank) * (upper - lower);
+}
+
+static float item_at_rank(const stats_window_t *win, size_t rank)
+{
+    size_t cumulative = 0;
+    for (size_t i = 0; i < win->bins_len; i++)
+    {
+        uint16_t bin_count = win->bins[i];
+        if (rank < cumulative + bin_count)
+        {
+            float fraction = (rank - cumulative + 0.5f) / bin_count;
+            return win->bins_min + (i + fraction) * win->bin_width;
+        }
+        cumulative += bin_count;
+    }
+    assert(0);
+    return NAN;
+}
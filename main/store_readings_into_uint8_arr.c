@@ -0,0 +1,32 @@
+#include "store_readings_into_uint8_arr.h"
+
+#include "store_float_into_uint8_arr.h"
+
+void store_readings_into_uint8_arr(float temperature, float humidity, uint16_t seq, uint32_t age_s,
+                                   uint8_t arr[STORE_READINGS_LEN])
+{
+    // See: GATT Specification Supplement Datasheet Section 3.204 (Temperature) and 3.114 (Humidity)
+    if (temperature >= -273.15 && temperature <= 327.67)
+    {
+        store_float_into_uint8_arr(&temperature, &arr[0]);
+    }
+    else
+    {
+        arr[0] = 0x00;
+        arr[1] = 0x80;
+    }
+    if (humidity >= 0 && humidity <= 100)
+    {
+        store_float_into_uint8_arr(&humidity, &arr[2]);
+    }
+    else
+    {
+        arr[2] = 0xFF;
+        arr[3] = 0xFF;
+    }
+    arr[4] = seq & 0xFF;
+    arr[5] = seq >> 8;
+    uint16_t age = age_s < STORE_READINGS_AGE_UNKNOWN ? age_s : STORE_READINGS_AGE_UNKNOWN;
+    arr[6] = age & 0xFF;
+    arr[7] = age >> 8;
+}
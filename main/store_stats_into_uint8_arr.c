@@ -0,0 +1,21 @@
+#include "store_stats_into_uint8_arr.h"
+
+#include "store_float_into_uint8_arr.h"
+
+void store_stats_into_uint8_arr(const stats_t *stats, uint8_t arr[STORE_STATS_LEN])
+{
+    if (stats->count == 0)
+    {
+        for (size_t i = 0; i < STORE_STATS_LEN; i += 2)
+        {
+            arr[i] = 0x00;
+            arr[i + 1] = 0x80;
+        }
+        return;
+    }
+    store_float_into_uint8_arr(&stats->mean, &arr[0]);
+    store_float_into_uint8_arr(&stats->stddev, &arr[2]);
+    store_float_into_uint8_arr(&stats->p10, &arr[4]);
+    store_float_into_uint8_arr(&stats->p90, &arr[6]);
+    store_float_into_uint8_arr(&stats->trend, &arr[8]);
+}
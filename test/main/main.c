@@ -1,7 +1,23 @@
-#include "ringbuf.h"
+#include "ble_adv_payload.h"
+#include "ble_conn_policy.h"
+#include "ble_conn_table.h"
+#include "button_gesture.h"
+#include "derived_metrics.h"
+#include "ess_trigger.h"
+#include "float_batch.h"
+#include "sample_batch.h"
+#include "sample_bus.h"
+#include "sample_store.h"
+#include "sample_timing.h"
+#include "sample_window.h"
+#include "stats.h"
 #include "store_float_into_uint8_arr.h"
+#include "store_readings_into_uint8_arr.h"
 #include "unity.h"
+#include <math.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 //==================================================================================================
 // store_float_into_uint8_arr
@@ -17,7 +33,7 @@ TEST_CASE("should store negative values", "[store_float_into_uint8_arr]")
     store_float_into_uint8_arr(&f32_value, uint8_arr);
 
     // Assert
-    int16_t expected = ((float)-18.3 * (float)100.0);
+    int16_t expected = lroundf((float)-18.3 * (float)100.0);
     TEST_ASSERT_EQUAL_HEX8(expected & 0xff, uint8_arr[0]);
     TEST_ASSERT_EQUAL_HEX8(expected >> 8, uint8_arr[1]);
 }
@@ -47,12 +63,12 @@ TEST_CASE("should store positive values", "[store_float_into_uint8_arr]")
     store_float_into_uint8_arr(&f32_value, uint8_arr);
 
     // Assert
-    int16_t expected = ((float)23.78 * (float)100.0);
+    int16_t expected = lroundf((float)23.78 * (float)100.0);
     TEST_ASSERT_EQUAL_HEX8(expected & 0xff, uint8_arr[0]);
     TEST_ASSERT_EQUAL_HEX8(expected >> 8, uint8_arr[1]);
 }
 
-TEST_CASE("should keep only 2 digits after the decimal point", "[store_float_into_uint8_arr]")
+TEST_CASE("should round to 2 digits after the decimal point", "[store_float_into_uint8_arr]")
 {
     // Arrange
     float f32_value = 9.87654321;
@@ -62,96 +78,1532 @@ TEST_CASE("should keep only 2 digits after the decimal point", "[store_float_int
     store_float_into_uint8_arr(&f32_value, uint8_arr);
 
     // Assert
-    int16_t expected = ((float)9.87 * (float)100.0);
+    int16_t expected = 988;
     TEST_ASSERT_EQUAL_HEX8(expected & 0xff, uint8_arr[0]);
     TEST_ASSERT_EQUAL_HEX8(expected >> 8, uint8_arr[1]);
 }
 
 //==================================================================================================
-// ringbuf
+// store_readings_into_uint8_arr
 //==================================================================================================
 
-TEST_CASE("should get no item, if no item hasn't been added into the ring-buffer yet", "[ringbuf]")
+TEST_CASE("should store readings, sequence number and age", "[store_readings_into_uint8_arr]")
 {
     // Arrange
-    float ringbuf_data_[3];
-    ringbuf_t rbuf = ringbuf_init(ringbuf_data_, 3);
+    uint8_t uint8_arr[STORE_READINGS_LEN];
 
     // Act
-    float actual;
-    size_t get_count = ringbuf_get(&rbuf, &actual);
+    store_readings_into_uint8_arr(21.5, 48.25, 0x1234, 90, uint8_arr);
 
     // Assert
-    TEST_ASSERT_EQUAL_UINT(0, get_count);
+    uint8_t expected[STORE_READINGS_LEN] = {0x66, 0x08, 0xD9, 0x12, 0x34, 0x12, 0x5A, 0x00};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, uint8_arr, STORE_READINGS_LEN);
 }
 
-TEST_CASE("should get the last item added to the ring-buffer", "[ringbuf]")
+TEST_CASE("should store unknown readings and saturate the age", "[store_readings_into_uint8_arr]")
 {
     // Arrange
-    float ringbuf_data_[3];
-    ringbuf_t rbuf = ringbuf_init(ringbuf_data_, 3);
-    ringbuf_put(&rbuf, 5.43);
-    ringbuf_put(&rbuf, 23.29);
+    uint8_t uint8_arr[STORE_READINGS_LEN];
 
     // Act
-    float actual;
-    size_t get_count = ringbuf_get(&rbuf, &actual);
+    store_readings_into_uint8_arr(NAN, 100.5, 0, 70000, uint8_arr);
 
     // Assert
-    TEST_ASSERT_EQUAL_UINT(1, get_count);
-    TEST_ASSERT_EQUAL_FLOAT(23.29, actual);
+    uint8_t expected[STORE_READINGS_LEN] = {0x00, 0x80, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, uint8_arr, STORE_READINGS_LEN);
+}
+
+//==================================================================================================
+// float_batch
+//==================================================================================================
+
+static uint32_t float_as_u32(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
 }
 
-TEST_CASE("should get all the items sorted in ascending order", "[ringbuf]")
+TEST_CASE("should reduce a span to its minimum, maximum and sum, lane by lane", "[float_batch]")
+{
+    // Arrange: 7 items, so the last 3 fill the lanes partially
+    const float items[] = {0.1, -3.5, 1e7, 2.25, 0.2, 7.75, -1e7};
+
+    // Act
+    float_batch_reduction_t reduction;
+    size_t len = float_batch_reduce(items, 7, &reduction);
+    size_t empty_len = float_batch_reduce(items, 0, &reduction);
+
+    // Assert: the sum is exactly the one computed lane by lane, which differs from the one computed in order
+    float lanes[4] = {items[0] + items[4], items[1] + items[5], items[2] + items[6], items[3]};
+    TEST_ASSERT_EQUAL_UINT(7, len);
+    TEST_ASSERT_EQUAL_UINT(0, empty_len);
+    TEST_ASSERT_EQUAL_FLOAT(-1e7, reduction.min);
+    TEST_ASSERT_EQUAL_FLOAT(1e7, reduction.max);
+    TEST_ASSERT_EQUAL_HEX32(float_as_u32((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])), float_as_u32(reduction.sum));
+}
+
+TEST_CASE("should quantize rounding halfway cases away from zero, and saturating", "[float_batch]")
 {
     // Arrange
-    float ringbuf_data_[5];
-    ringbuf_t rbuf = ringbuf_init(ringbuf_data_, 5);
-    ringbuf_put(&rbuf, 0.8);
-    ringbuf_put(&rbuf, -18.63);
-    ringbuf_put(&rbuf, 33.1);
+    const float items[] = {21.125, -7.125, 0.004, 400, -400, NAN};
 
     // Act
-    float actuals[5];
-    size_t get_count = ringbuf_getallsorted(&rbuf, actuals);
+    int16_t actuals[6];
+    float_batch_quantize_i16(items, 6, 100, actuals);
 
     // Assert
-    TEST_ASSERT_EQUAL_UINT(3, get_count);
-    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){-18.63, 0.8, 33.1}), actuals, 3);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(((int16_t[]){2113, -713, 0, INT16_MAX, INT16_MIN + 1, INT16_MIN}), actuals, 6);
+}
+
+TEST_CASE("should reduce quantized items skipping the NAN ones", "[float_batch]")
+{
+    // Arrange
+    const float items[] = {21.125, NAN, -400, 400, -7.125};
+    int16_t centi_items[5];
+    float_batch_quantize_i16(items, 5, 100, centi_items);
+    const int16_t unknowns[] = {INT16_MIN, INT16_MIN};
+
+    // Act
+    float_batch_reduction_i16_t reduction;
+    size_t len = float_batch_reduce_i16_scalar(centi_items, 5, &reduction);
+    float_batch_reduction_i16_t untouched = {.min = 1, .max = 2, .sum = 3};
+    size_t unknowns_len = float_batch_reduce_i16_scalar(unknowns, 2, &untouched);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(4, len);
+    TEST_ASSERT_EQUAL_INT16(INT16_MIN + 1, reduction.min);
+    TEST_ASSERT_EQUAL_INT16(INT16_MAX, reduction.max);
+    TEST_ASSERT_EQUAL_INT32(2113 + INT16_MIN + 1 + INT16_MAX - 713, reduction.sum);
+    TEST_ASSERT_EQUAL_UINT(0, unknowns_len);
+    TEST_ASSERT_EQUAL_INT32(3, untouched.sum);
+}
+
+TEST_CASE("should reduce quantized items alike on the vector and the scalar paths", "[float_batch]")
+{
+    // Arrange: NAN and saturated items scattered over aligned blocks, unaligned heads and partial tails
+    float items[67];
+    for (size_t i = 0; i < 67; i++)
+    {
+        items[i] = (float)((int32_t)(i * 7919 % 2003) - 1001) / 3;
+    }
+    items[3] = NAN;
+    items[12] = NAN;
+    items[13] = NAN;
+    items[20] = 1e6;
+    items[41] = -1e6;
+    items[66] = NAN;
+    int16_t centi_items[67] __attribute__((aligned(16)));
+    float_batch_quantize_i16(items, 67, 100, centi_items);
+
+    for (size_t begin = 0; begin < 9; begin++)
+    {
+        for (size_t len = 0; begin + len <= 67; len++)
+        {
+            // Act
+            float_batch_reduction_i16_t expected = {0};
+            float_batch_reduction_i16_t actual = {0};
+            size_t expected_len = float_batch_reduce_i16_scalar(centi_items + begin, len, &expected);
+            size_t actual_len = float_batch_reduce_i16(centi_items + begin, len, &actual);
+
+            // Assert
+            TEST_ASSERT_EQUAL_UINT(expected_len, actual_len);
+            TEST_ASSERT_EQUAL_INT16(expected.min, actual.min);
+            TEST_ASSERT_EQUAL_INT16(expected.max, actual.max);
+            TEST_ASSERT_EQUAL_INT32(expected.sum, actual.sum);
+        }
+    }
+}
+
+//==================================================================================================
+// sample_bus
+//==================================================================================================
+
+TEST_CASE("should deliver every sample to every consumer, in order", "[sample_bus]")
+{
+    // Arrange
+    sample_bus_consumer_t consumers_[2];
+    sample_bus_t bus = sample_bus_init(sizeof(float), consumers_, 2);
+    sample_bus_consumer_t *first = sample_bus_subscribe(&bus, "first", 2, SAMPLE_BUS_OVERWRITE_OLDEST, 0);
+    sample_bus_consumer_t *second = sample_bus_subscribe(&bus, "second", 2, SAMPLE_BUS_BLOCK, 0);
+
+    // Act
+    size_t failed_count = 0;
+    failed_count += sample_bus_publish(&bus, &(float){5.43});
+    failed_count += sample_bus_publish(&bus, &(float){23.29});
+    float actuals[4];
+    bool received = true;
+    received &= sample_bus_receive(first, &actuals[0], 0);
+    received &= sample_bus_receive(first, &actuals[1], 0);
+    received &= sample_bus_receive(second, &actuals[2], 0);
+    received &= sample_bus_receive(second, &actuals[3], 0);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(0, failed_count);
+    TEST_ASSERT_TRUE(received);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){5.43, 23.29, 5.43, 23.29}), actuals, 4);
+    vQueueDelete(first->queue);
+    vQueueDelete(second->queue);
+}
+
+TEST_CASE("should drop the oldest sample, if an overwriting consumer is full", "[sample_bus]")
+{
+    // Arrange
+    sample_bus_consumer_t consumers_[1];
+    sample_bus_t bus = sample_bus_init(sizeof(float), consumers_, 1);
+    sample_bus_consumer_t *consumer = sample_bus_subscribe(&bus, "consumer", 2, SAMPLE_BUS_OVERWRITE_OLDEST, 0);
+
+    // Act
+    size_t failed_count = 0;
+    failed_count += sample_bus_publish(&bus, &(float){5.43});
+    failed_count += sample_bus_publish(&bus, &(float){23.29});
+    failed_count += sample_bus_publish(&bus, &(float){-7.2});
+    float actuals[2];
+    sample_bus_receive(consumer, &actuals[0], 0);
+    sample_bus_receive(consumer, &actuals[1], 0);
+    sample_bus_counters_t counters;
+    sample_bus_get_counters(consumer, &counters);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(0, failed_count);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){23.29, -7.2}), actuals, 2);
+    TEST_ASSERT_EQUAL_UINT32(2, counters.delivered);
+    TEST_ASSERT_EQUAL_UINT32(1, counters.dropped);
+    TEST_ASSERT_EQUAL_UINT32(1, counters.late);
+    vQueueDelete(consumer->queue);
+}
+
+TEST_CASE("should drop the newest sample, if a blocking consumer is still full after waiting", "[sample_bus]")
+{
+    // Arrange
+    sample_bus_consumer_t consumers_[1];
+    sample_bus_t bus = sample_bus_init(sizeof(float), consumers_, 1);
+    sample_bus_consumer_t *consumer = sample_bus_subscribe(&bus, "consumer", 2, SAMPLE_BUS_BLOCK, 0);
+
+    // Act
+    size_t failed_count = 0;
+    failed_count += sample_bus_publish(&bus, &(float){5.43});
+    failed_count += sample_bus_publish(&bus, &(float){23.29});
+    failed_count += sample_bus_publish(&bus, &(float){-7.2});
+    float actuals[2];
+    sample_bus_receive(consumer, &actuals[0], 0);
+    sample_bus_receive(consumer, &actuals[1], 0);
+    float empty;
+    bool received_from_empty = sample_bus_receive(consumer, &empty, 0);
+    sample_bus_counters_t counters;
+    sample_bus_get_counters(consumer, &counters);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(1, failed_count);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){5.43, 23.29}), actuals, 2);
+    TEST_ASSERT_FALSE(received_from_empty);
+    TEST_ASSERT_EQUAL_UINT32(2, counters.delivered);
+    TEST_ASSERT_EQUAL_UINT32(1, counters.dropped);
+    TEST_ASSERT_EQUAL_UINT32(1, counters.late);
+    vQueueDelete(consumer->queue);
+}
+
+TEST_CASE("should refuse new consumers, if the bus is full", "[sample_bus]")
+{
+    // Arrange
+    sample_bus_consumer_t consumers_[1];
+    sample_bus_t bus = sample_bus_init(sizeof(float), consumers_, 1);
+    sample_bus_consumer_t *first = sample_bus_subscribe(&bus, "first", 1, SAMPLE_BUS_BLOCK, 0);
+
+    // Act
+    sample_bus_consumer_t *second = sample_bus_subscribe(&bus, "second", 1, SAMPLE_BUS_BLOCK, 0);
+
+    // Assert
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NULL(second);
+    vQueueDelete(first->queue);
+}
+
+//==================================================================================================
+// sample_store
+//==================================================================================================
+
+TEST_CASE("should query the latest values of a field, skipping the records without it", "[sample_store]")
+{
+    // Arrange
+    float values_[3 * 2];
+    uint32_t timestamps_ms_[3];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 3, 3);
+    sample_store_append(&store, 1000, (float[]){1, 10});
+    sample_store_append(&store, 2000, (float[]){2, NAN});
+    sample_store_append(&store, 3000, (float[]){3, 30});
+    sample_store_append(&store, 4000, (float[]){4, NAN});
+
+    // Act
+    float firsts[4];
+    size_t firsts_count = sample_store_query(&store, 0, 4, firsts, NULL);
+    float seconds[4];
+    uint32_t seconds_timestamps_ms[4];
+    size_t seconds_count = sample_store_query(&store, 1, 4, seconds, seconds_timestamps_ms);
+    float nth;
+    size_t nth_count = sample_store_get_nth(&store, 1, 1, &nth);
+
+    // Assert: the first record was overwritten
+    TEST_ASSERT_EQUAL_UINT(3, sample_store_count(&store));
+    TEST_ASSERT_EQUAL_UINT(3, firsts_count);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){4, 3, 2}), firsts, 3);
+    TEST_ASSERT_EQUAL_UINT(1, seconds_count);
+    TEST_ASSERT_EQUAL_FLOAT(30, seconds[0]);
+    TEST_ASSERT_EQUAL_UINT32(3000, seconds_timestamps_ms[0]);
+    TEST_ASSERT_EQUAL_UINT(0, nth_count);
+}
+
+TEST_CASE("should get the value of a field in a given record, missing or not", "[sample_store]")
+{
+    // Arrange
+    float values_[3 * 2];
+    uint32_t timestamps_ms_[3];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 3, 3);
+    sample_store_append(&store, 1000, (float[]){1, 10});
+    sample_store_append(&store, 2000, (float[]){2, NAN});
+
+    // Act
+    float newest;
+    size_t newest_count = sample_store_get_value(&store, 1, 0, &newest);
+    float oldest;
+    size_t oldest_count = sample_store_get_value(&store, 1, 1, &oldest);
+    float missing;
+    size_t missing_count = sample_store_get_value(&store, 1, 2, &missing);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(1, newest_count);
+    TEST_ASSERT_TRUE(isnan(newest));
+    TEST_ASSERT_EQUAL_UINT(1, oldest_count);
+    TEST_ASSERT_EQUAL_FLOAT(10, oldest);
+    TEST_ASSERT_EQUAL_UINT(0, missing_count);
+}
+
+TEST_CASE("should resample the records together with their timestamps", "[sample_store]")
+{
+    // Arrange
+    float values_[6 * 2];
+    uint32_t timestamps_ms_[6];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 6, 4);
+    for (size_t i = 1; i <= 6; i++)
+    {
+        sample_store_append(&store, i * 1000, (float[]){i, 10 * i});
+    }
+
+    // Act: records twice as often, in a store twice as long
+    sample_store_resample(&store, 6, 0.5);
+
+    // Assert: records 3 to 6 are kept, with a record interpolated between each pair
+    uint32_t timestamp_ms;
+    float record[2];
+    TEST_ASSERT_EQUAL_UINT(6, sample_store_count(&store));
+    TEST_ASSERT_EQUAL_UINT(1, sample_store_get_record(&store, 0, &timestamp_ms, record));
+    TEST_ASSERT_EQUAL_UINT32(6000, timestamp_ms);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){6, 60}), record, 2);
+    TEST_ASSERT_EQUAL_UINT(1, sample_store_get_record(&store, 1, &timestamp_ms, record));
+    TEST_ASSERT_EQUAL_UINT32(5500, timestamp_ms);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){5.5, 55}), record, 2);
+    TEST_ASSERT_EQUAL_UINT(1, sample_store_get_record(&store, 5, &timestamp_ms, record));
+    TEST_ASSERT_EQUAL_UINT32(3500, timestamp_ms);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){3.5, 35}), record, 2);
+}
+
+TEST_CASE("should split the records into two chronological spans, once the store wraps around", "[sample_store]")
+{
+    // Arrange
+    float values_[4 * 2];
+    uint32_t timestamps_ms_[4];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 4, 4);
+    sample_store_append(&store, 1000, (float[]){1, 10});
+    sample_store_append(&store, 2000, (float[]){2, NAN});
+    sample_store_append(&store, 3000, (float[]){3, 30});
+
+    // Act
+    sample_store_span_t spans[2];
+    size_t count = sample_store_lock_spans(&store, spans);
+    sample_store_span_t first_span = spans[0];
+    sample_store_span_t second_span = spans[1];
+    float first_temperatures[3];
+    float first_humidities[3];
+    memcpy(first_temperatures, sample_store_span_values(&store, &first_span, 0), sizeof(first_temperatures));
+    memcpy(first_humidities, sample_store_span_values(&store, &first_span, 1), sizeof(first_humidities));
+    sample_store_unlock_spans(&store);
+    sample_store_append(&store, 4000, (float[]){4, 40});
+    sample_store_append(&store, 5000, (float[]){5, 50});
+    sample_store_append(&store, 6000, (float[]){6, 60});
+    size_t wrapped_count = sample_store_lock_spans(&store, spans);
+    sample_store_unlock_spans(&store);
+
+    // Assert: NAN values are left in place, for the reader to skip
+    TEST_ASSERT_EQUAL_UINT(3, count);
+    TEST_ASSERT_EQUAL_UINT(3, first_span.len);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){1, 2, 3}), first_temperatures, 3);
+    TEST_ASSERT_TRUE(isnan(first_humidities[1]));
+    TEST_ASSERT_EQUAL_UINT(0, second_span.len);
+    TEST_ASSERT_EQUAL_UINT(4, wrapped_count);
+    TEST_ASSERT_EQUAL_UINT(2, spans[0].len);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){30, 40}), sample_store_span_values(&store, &spans[0], 1), 2);
+    TEST_ASSERT_EQUAL_UINT32(3000, sample_store_span_timestamps(&store, &spans[0])[0]);
+    TEST_ASSERT_EQUAL_UINT(2, spans[1].len);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){50, 60}), sample_store_span_values(&store, &spans[1], 1), 2);
+    TEST_ASSERT_EQUAL_UINT32(6000, sample_store_span_timestamps(&store, &spans[1])[1]);
+}
+
+TEST_CASE("should lend the records of a wrapped store as two spans, in chronological order", "[sample_store]")
+{
+    // Arrange: 12 records into 5, so the oldest kept, the 8th, isn't at the start of the store
+    float values_[5 * 2];
+    uint32_t timestamps_ms_[5];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 5, 5);
+    for (size_t i = 1; i <= 12; i++)
+    {
+        sample_store_append(&store, i * 1000, (float[]){i, i % 4 == 0 ? NAN : 10 * i});
+    }
+
+    // Act: copied while locked, as the spans are only valid until then
+    sample_store_span_t spans[2];
+    size_t count = sample_store_lock_spans(&store, spans);
+    float temperatures[5];
+    float humidities[5];
+    uint32_t timestamps_ms[5];
+    size_t len = 0;
+    for (size_t s = 0; s < 2; s++)
+    {
+        memcpy(&temperatures[len], sample_store_span_values(&store, &spans[s], 0), spans[s].len * sizeof(float));
+        memcpy(&humidities[len], sample_store_span_values(&store, &spans[s], 1), spans[s].len * sizeof(float));
+        memcpy(&timestamps_ms[len], sample_store_span_timestamps(&store, &spans[s]), spans[s].len * sizeof(uint32_t));
+        len += spans[s].len;
+    }
+    sample_store_unlock_spans(&store);
+
+    // Assert: the first span ends at the end of the store, the second one starts from its start
+    TEST_ASSERT_EQUAL_UINT(5, count);
+    TEST_ASSERT_EQUAL_UINT(3, spans[0].len);
+    TEST_ASSERT_EQUAL_UINT(2, spans[1].len);
+    TEST_ASSERT_EQUAL_UINT(0, spans[1].first);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){8, 9, 10, 11, 12}), temperatures, 5);
+    TEST_ASSERT_TRUE(isnan(humidities[0]));
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){90, 100, 110}), &humidities[1], 3);
+    TEST_ASSERT_TRUE(isnan(humidities[4]));
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(((uint32_t[]){8000, 9000, 10000, 11000, 12000}), timestamps_ms, 5);
+}
+
+TEST_CASE("should lend the records of a full store, not wrapped yet, as a single span", "[sample_store]")
+{
+    // Arrange
+    float values_[3 * 1];
+    uint32_t timestamps_ms_[3];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 1, 3, 3);
+    for (size_t i = 1; i <= 3; i++)
+    {
+        sample_store_append(&store, i * 1000, (float[]){i});
+    }
+
+    // Act
+    sample_store_span_t spans[2];
+    size_t count = sample_store_lock_spans(&store, spans);
+    float values[3];
+    uint32_t timestamps_ms[3];
+    memcpy(values, sample_store_span_values(&store, &spans[0], 0), sizeof(values));
+    memcpy(timestamps_ms, sample_store_span_timestamps(&store, &spans[0]), sizeof(timestamps_ms));
+    sample_store_unlock_spans(&store);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(3, count);
+    TEST_ASSERT_EQUAL_UINT(3, spans[0].len);
+    TEST_ASSERT_EQUAL_UINT(0, spans[1].len);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){1, 2, 3}), values, 3);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(((uint32_t[]){1000, 2000, 3000}), timestamps_ms, 3);
+}
+
+//==================================================================================================
+// sample_batch
+//==================================================================================================
+
+TEST_CASE("should read when a reading is due, and sleep until the next one otherwise", "[sample_batch]")
+{
+    // Arrange
+    static sample_batch_t batch;
+    sample_batch_init(&batch, 3, 1000);
+
+    // Act
+    sample_batch_action_t first_wake = sample_batch_on_wake(&batch, SAMPLE_BATCH_WAKE_TIMER, 1000);
+    sample_batch_push(&batch, 21.5, 40, 1050, 30000);
+    uint64_t sleep_ms = sample_batch_sleep_ms(&batch, 1100);
+    sample_batch_action_t early_wake = sample_batch_on_wake(&batch, SAMPLE_BATCH_WAKE_TIMER, 30000);
+
+    // Assert: the next reading is due a period after the first was, not after it was taken
+    TEST_ASSERT_EQUAL(SAMPLE_BATCH_READ, first_wake);
+    TEST_ASSERT_EQUAL_UINT32(29900, (uint32_t)sleep_ms);
+    TEST_ASSERT_EQUAL(SAMPLE_BATCH_SLEEP, early_wake);
+    TEST_ASSERT_EQUAL(SAMPLE_BATCH_READ, sample_batch_on_wake(&batch, SAMPLE_BATCH_WAKE_TIMER, 31000));
+}
+
+TEST_CASE("should publish once the batch is complete, or when the button is pressed", "[sample_batch]")
+{
+    // Arrange
+    static sample_batch_t batch;
+    sample_batch_init(&batch, 2, 0);
+    sample_batch_push(&batch, 21.5, 40, 0, 30000);
+
+    // Act
+    sample_batch_action_t button_wake = sample_batch_on_wake(&batch, SAMPLE_BATCH_WAKE_BUTTON, 10000);
+    sample_batch_push(&batch, 21.5, 40, 30000, 30000);
+    uint64_t sleep_ms = sample_batch_sleep_ms(&batch, 30100);
+    sample_batch_action_t complete_wake = sample_batch_on_wake(&batch, SAMPLE_BATCH_WAKE_TIMER, 30200);
+    sample_batch_clear(&batch);
+
+    // Assert: once cleared, the next reading is due when it was before publishing
+    TEST_ASSERT_EQUAL(SAMPLE_BATCH_PUBLISH, button_wake);
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)sleep_ms);
+    TEST_ASSERT_EQUAL(SAMPLE_BATCH_PUBLISH, complete_wake);
+    TEST_ASSERT_EQUAL_UINT(0, sample_batch_len(&batch));
+    TEST_ASSERT_EQUAL_UINT32(29800, (uint32_t)sample_batch_sleep_ms(&batch, 30200));
+}
+
+TEST_CASE("should give back the readings in hundredths, with their time to the second", "[sample_batch]")
+{
+    // Arrange
+    static sample_batch_t batch;
+    sample_batch_init(&batch, 10, 5000);
+
+    // Act: the second reading failed, and the third was taken 400 ms late
+    sample_batch_push(&batch, 21.456, 40.1, 5000, 30000);
+    sample_batch_push(&batch, NAN, NAN, 35000, 30000);
+    sample_batch_push(&batch, -5.5, 99.999, 65400, 30000);
+    uint64_t time_ms;
+    float temperature;
+    float humidity;
+    sample_batch_cursor_t cursor = sample_batch_begin(&batch);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(3, sample_batch_len(&batch));
+    TEST_ASSERT_EQUAL_UINT(1, sample_batch_next(&batch, &cursor, &time_ms, &temperature, &humidity));
+    TEST_ASSERT_EQUAL_UINT32(5000, (uint32_t)time_ms);
+    TEST_ASSERT_EQUAL_FLOAT(21.46, temperature);
+    TEST_ASSERT_EQUAL_FLOAT(40.1, humidity);
+    TEST_ASSERT_EQUAL_UINT(1, sample_batch_next(&batch, &cursor, &time_ms, &temperature, &humidity));
+    TEST_ASSERT_EQUAL_UINT32(35000, (uint32_t)time_ms);
+    TEST_ASSERT_TRUE(isnan(temperature) && isnan(humidity));
+    TEST_ASSERT_EQUAL_UINT(1, sample_batch_next(&batch, &cursor, &time_ms, &temperature, &humidity));
+    TEST_ASSERT_EQUAL_UINT32(65000, (uint32_t)time_ms);
+    TEST_ASSERT_EQUAL_FLOAT(-5.5, temperature);
+    TEST_ASSERT_EQUAL_FLOAT(100, humidity);
+    TEST_ASSERT_EQUAL_UINT(0, sample_batch_next(&batch, &cursor, &time_ms, &temperature, &humidity));
+}
+
+TEST_CASE("should walk a full batch in order, rebuilding the time of every reading", "[sample_batch]")
+{
+    // Arrange: readings taken 30.2 seconds apart
+    static sample_batch_t batch;
+    sample_batch_init(&batch, SAMPLE_BATCH_MAX_LEN, 0);
+    for (size_t i = 0; i < SAMPLE_BATCH_MAX_LEN; i++)
+    {
+        sample_batch_push(&batch, i / 100.0, 50, i * 30200, 30000);
+    }
+
+    // Act
+    size_t count = 0;
+    size_t mismatches = 0;
+    uint64_t time_ms;
+    float temperature;
+    float humidity;
+    sample_batch_cursor_t cursor = sample_batch_begin(&batch);
+    while (sample_batch_next(&batch, &cursor, &time_ms, &temperature, &humidity))
+    {
+        // to the second, without the rounding errors adding up
+        uint64_t expected_ms = (count * 30200 + 500) / 1000 * 1000;
+        if (time_ms != expected_ms || fabsf(temperature - count / 100.0f) > 0.001)
+        {
+            mismatches++;
+        }
+        count++;
+    }
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(SAMPLE_BATCH_MAX_LEN, count);
+    TEST_ASSERT_EQUAL_UINT(0, mismatches);
+}
+
+TEST_CASE("should skip the readings missed while awake, rather than catching up", "[sample_batch]")
+{
+    // Arrange
+    static sample_batch_t batch;
+    sample_batch_init(&batch, 10, 0);
+    sample_batch_push(&batch, 21.5, 40, 0, 30000);
+
+    // Act: published for 100 seconds, then back to sleep and woken right away
+    sample_batch_action_t wake = sample_batch_on_wake(&batch, SAMPLE_BATCH_WAKE_TIMER, 100000);
+    sample_batch_push(&batch, 21.5, 40, 100000, 30000);
+
+    // Assert
+    TEST_ASSERT_EQUAL(SAMPLE_BATCH_READ, wake);
+    TEST_ASSERT_EQUAL_UINT32(30000, (uint32_t)sample_batch_sleep_ms(&batch, 100000));
+}
+
+//==================================================================================================
+// sample_timing
+//==================================================================================================
+
+TEST_CASE("should count lateness into exponential bins and missed deadlines", "[sample_timing]")
+{
+    // Arrange
+    sample_timing_t timing;
+    sample_timing_init(&timing, 50000);
+    const int64_t lateness_us[] = {0, 99, -150, 150, 20000, 50001, 1000000};
+
+    // Act
+    for (size_t i = 0; i < sizeof(lateness_us) / sizeof(lateness_us[0]); i++)
+    {
+        int64_t scheduled_us = 30000000LL * i;
+        sample_timing_record(&timing, scheduled_us, scheduled_us + lateness_us[i]);
+    }
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT32(7, timing.samples);
+    TEST_ASSERT_EQUAL_UINT32(2, timing.missed_deadlines);
+    TEST_ASSERT_EQUAL_UINT32(2, timing.histogram[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, timing.histogram[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, timing.histogram[8]);
+    TEST_ASSERT_EQUAL_UINT32(2, timing.histogram[SAMPLE_TIMING_BINS - 1]);
+    TEST_ASSERT_EQUAL_INT32(-150, (int32_t)timing.min_lateness_us);
+    TEST_ASSERT_EQUAL_INT32(1000000, (int32_t)timing.max_lateness_us);
+    TEST_ASSERT_EQUAL_INT32((20000 + 50001 + 1000000 + 99) / 7, (int32_t)sample_timing_mean_lateness_us(&timing));
+    sample_timing_record_t latest;
+    TEST_ASSERT_TRUE(sample_timing_get_recent(&timing, 0, &latest));
+    TEST_ASSERT_EQUAL_INT32(6 * 30000000, (int32_t)latest.scheduled_us);
+    TEST_ASSERT_EQUAL_INT32(6 * 30000000 + 1000000, (int32_t)latest.actual_us);
+    TEST_ASSERT_FALSE(sample_timing_get_recent(&timing, 7, &latest));
+}
+
+TEST_CASE("should back off exponentially, within attempts and budget", "[sample_timing]")
+{
+    // Arrange
+    const sample_timing_retry_t retry = {.max_attempts = 5, .base_delay_ms = 100, .budget_ms = 1000};
+    uint32_t delays_ms[5] = {0};
+    uint32_t elapsed_ms = 0;
+    uint32_t attempt = 0;
+
+    // Act
+    while (sample_timing_retry_delay(&retry, attempt, elapsed_ms, &delays_ms[attempt]))
+    {
+        elapsed_ms += delays_ms[attempt];
+        attempt++;
+    }
+
+    // Assert: the fourth retry would wait 800 ms, after 700 ms already waited
+    TEST_ASSERT_EQUAL_UINT32(3, attempt);
+    TEST_ASSERT_EQUAL_UINT32(100, delays_ms[0]);
+    TEST_ASSERT_EQUAL_UINT32(200, delays_ms[1]);
+    TEST_ASSERT_EQUAL_UINT32(400, delays_ms[2]);
+    TEST_ASSERT_EQUAL_UINT32(700, elapsed_ms);
+    const sample_timing_retry_t no_retries = {.max_attempts = 0, .base_delay_ms = 100, .budget_ms = 1000};
+    TEST_ASSERT_FALSE(sample_timing_retry_delay(&no_retries, 0, 0, &delays_ms[0]));
+}
+
+//==================================================================================================
+// ble_adv_payload
+//==================================================================================================
+
+TEST_CASE("should encode the readings in BTHome v2 format", "[ble_adv_payload]")
+{
+    // Arrange
+    uint8_t payload[BLE_ADV_PAYLOAD_MAX_LEN];
+
+    // Act
+    size_t len = ble_adv_payload_bthome(-7.2, 48.25, 0x2A, "Envi", payload);
+
+    // Assert
+    uint8_t expected[] = {0x02, 0x01, 0x06,                               // flags
+                          0x0C, 0x16, 0xD2, 0xFC, 0x40,                   // BTHome service data
+                          0x00, 0x2A, 0x02, 0x30, 0xFD, 0x03, 0xD9, 0x12, // packet id, temperature, humidity
+                          0x05, 0x09, 'E',  'n',  'v',  'i'};             // complete local name
+    TEST_ASSERT_EQUAL_UINT(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, payload, sizeof(expected));
+}
+
+TEST_CASE("should shorten the device name to fit into the advertising data", "[ble_adv_payload]")
+{
+    // Arrange
+    uint8_t payload[BLE_ADV_PAYLOAD_MAX_LEN];
+
+    // Act
+    size_t len = ble_adv_payload_bthome(21.5, 48.25, 0, "Envi Sensor in the Living Room", payload);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(BLE_ADV_PAYLOAD_MAX_LEN, len);
+    TEST_ASSERT_EQUAL_UINT8(14, payload[16]);
+    TEST_ASSERT_EQUAL_HEX8(0x08, payload[17]);
+    TEST_ASSERT_EQUAL_MEMORY("Envi Sensor i", &payload[18], 13);
+}
+
+TEST_CASE("should encode nothing, if the readings can't be represented", "[ble_adv_payload]")
+{
+    // Arrange
+    uint8_t payload[BLE_ADV_PAYLOAD_MAX_LEN];
+
+    // Act
+    size_t len = 0;
+    len += ble_adv_payload_bthome(400, 48.25, 0, "Envi", payload);
+    len += ble_adv_payload_bthome(21.5, 101, 0, "Envi", payload);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(0, len);
+}
+
+TEST_CASE("should encode the history with its statistics", "[ble_adv_payload]")
+{
+    // Arrange
+    stats_t temperature_stats = {.count = 2, .mean = 21.5, .stddev = 0.25, .p10 = 21.25, .p90 = 21.75, .trend = -1};
+    stats_t no_stats = {0};
+    ble_adv_payload_history_t history = {.packet_id = 7,
+                                         .sample_period_s = 30,
+                                         .window_minutes = 15,
+                                         .temperature_stats = &temperature_stats,
+                                         .humidity_stats = &no_stats,
+                                         .temperatures = (float[]){21.75, -7.2},
+                                         .humidities = (float[]){48.25, 101}};
+    history.count = 2;
+    uint8_t payload[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN];
+
+    // Act
+    size_t len = ble_adv_payload_history(&history, payload);
+
+    // Assert
+    uint8_t expected_header[] = {60, 0x21, 0x74, 0x47, 0x90, 0x6f, 0xa7, 0x7b, 0x68, 0x8d, 0xd6, 0x49,
+                                 0xa0, 0x36, 0x03, 0x00, 0x1e, 0xf7, 0x02, 0x07, 0x1E, 0x00, 0x0F, 0x00};
+    uint8_t expected_stats[] = {0x66, 0x08, 0x19, 0x00, 0x4D, 0x08, 0x7F, 0x08, 0x9C, 0xFF,
+                                0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80};
+    // the humidity out of range is left out of the range
+    uint8_t expected_ranges[] = {0x30, 0xFD, 0x7F, 0x08, 0xD9, 0x12, 0xD9, 0x12};
+    uint8_t expected_readings[] = {0x02, 0x7F, 0x08, 0xD9, 0x12, 0x30, 0xFD, 0xFF, 0xFF};
+    TEST_ASSERT_EQUAL_UINT(61, len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_header, payload, sizeof(expected_header));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_stats, &payload[24], sizeof(expected_stats));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_ranges, &payload[44], sizeof(expected_ranges));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_readings, &payload[52], sizeof(expected_readings));
+}
+
+TEST_CASE("should encode an unknown range, if no reading of the channel is known", "[ble_adv_payload]")
+{
+    // Arrange
+    stats_t no_stats = {0};
+    ble_adv_payload_history_t history = {.temperature_stats = &no_stats,
+                                         .humidity_stats = &no_stats,
+                                         .temperatures = (float[]){NAN, 400, -300},
+                                         .humidities = (float[]){NAN, 55.5, -1}};
+    history.count = 3;
+    uint8_t payload[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN];
+
+    // Act
+    size_t len = ble_adv_payload_history(&history, payload);
+
+    // Assert
+    uint8_t expected_ranges[] = {0x00, 0x80, 0x00, 0x80, 0xAE, 0x15, 0xAE, 0x15};
+    uint8_t expected_readings[] = {0x03, 0x00, 0x80, 0xFF, 0xFF, 0x00, 0x80, 0xAE, 0x15, 0x00, 0x80, 0xFF, 0xFF};
+    TEST_ASSERT_EQUAL_UINT(53 + 3 * 4, len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_ranges, &payload[44], sizeof(expected_ranges));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_readings, &payload[52], sizeof(expected_readings));
+}
+
+TEST_CASE("should encode no history, if it holds too many readings", "[ble_adv_payload]")
+{
+    // Arrange
+    static float readings[BLE_ADV_PAYLOAD_HISTORY_MAX_COUNT + 1];
+    stats_t no_stats = {0};
+    ble_adv_payload_history_t history = {.temperature_stats = &no_stats,
+                                         .humidity_stats = &no_stats,
+                                         .temperatures = readings,
+                                         .humidities = readings,
+                                         .count = BLE_ADV_PAYLOAD_HISTORY_MAX_COUNT + 1};
+    uint8_t payload[BLE_ADV_PAYLOAD_HISTORY_MAX_LEN];
+
+    // Act
+    size_t len = ble_adv_payload_history(&history, payload);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(0, len);
+}
+
+//==================================================================================================
+// ble_conn_policy
+//==================================================================================================
+
+static const ble_conn_policy_config_t conn_policy_config = {
+    .fast_interval_ms = 30, .relaxed_interval_ms = 1000, .relaxed_latency = 4, .idle_timeout_ms = 5000};
+
+TEST_CASE("should request fast parameters, then relax them once the link is idle", "[ble_conn_policy]")
+{
+    // Arrange
+    ble_conn_policy_t policy;
+    ble_conn_params_t fast_params;
+    ble_conn_params_t relaxed_params;
+
+    // Act
+    ble_conn_policy_init(&policy, &conn_policy_config, 0);
+    ble_conn_policy_get_params(&policy, &fast_params);
+    bool relaxed_early = ble_conn_policy_on_tick(&policy, 4999);
+    bool relaxed = ble_conn_policy_on_tick(&policy, 5000);
+    ble_conn_policy_get_params(&policy, &relaxed_params);
+
+    // Assert
+    TEST_ASSERT_FALSE(relaxed_early);
+    TEST_ASSERT_TRUE(relaxed);
+    TEST_ASSERT_EQUAL_UINT16(24, fast_params.min_int);
+    TEST_ASSERT_EQUAL_UINT16(48, fast_params.max_int);
+    TEST_ASSERT_EQUAL_UINT16(0, fast_params.latency);
+    TEST_ASSERT_EQUAL_UINT16(200, fast_params.timeout);
+    TEST_ASSERT_EQUAL_UINT16(800, relaxed_params.min_int);
+    TEST_ASSERT_EQUAL_UINT16(1600, relaxed_params.max_int);
+    TEST_ASSERT_EQUAL_UINT16(4, relaxed_params.latency);
+    TEST_ASSERT_EQUAL_UINT16(3200, relaxed_params.timeout);
 }
 
-TEST_CASE("should overwrite the oldest item, if the ring-buffer is full", "[ringbuf]")
+TEST_CASE("should request fast parameters again, only if traffic resumes on a relaxed link", "[ble_conn_policy]")
 {
     // Arrange
-    float ringbuf_data_[3];
-    ringbuf_t rbuf = ringbuf_init(ringbuf_data_, 3);
-    ringbuf_put(&rbuf, 5.43);
-    ringbuf_put(&rbuf, 23.29);
-    ringbuf_put(&rbuf, -7.2);
-    ringbuf_put(&rbuf, 0.4);
+    ble_conn_policy_t policy;
+    ble_conn_policy_init(&policy, &conn_policy_config, UINT32_MAX - 1000);
 
     // Act
-    float actual;
-    size_t get_count;
-    get_count = ringbuf_get(&rbuf, &actual);
+    bool sped_up_fast = ble_conn_policy_on_traffic(&policy, UINT32_MAX, 20);
+    bool relaxed = ble_conn_policy_on_tick(&policy, 4999);
+    bool sped_up_relaxed = ble_conn_policy_on_traffic(&policy, 6000, 20);
+    bool relaxed_again = ble_conn_policy_on_tick(&policy, 7000);
 
     // Assert
-    TEST_ASSERT_EQUAL_UINT(1, get_count);
-    TEST_ASSERT_EQUAL_FLOAT(0.4, actual);
+    TEST_ASSERT_FALSE(sped_up_fast);
+    TEST_ASSERT_TRUE(relaxed);
+    TEST_ASSERT_TRUE(sped_up_relaxed);
+    TEST_ASSERT_FALSE(relaxed_again);
+}
+
+TEST_CASE("should reduce the latency to keep the supervision timeout valid", "[ble_conn_policy]")
+{
+    // Arrange
+    ble_conn_policy_config_t config = {
+        .fast_interval_ms = 30, .relaxed_interval_ms = 2000, .relaxed_latency = 30, .idle_timeout_ms = 5000};
+    ble_conn_policy_t policy;
+    ble_conn_policy_init(&policy, &config, 0);
+    ble_conn_policy_on_tick(&policy, 5000);
+    ble_conn_params_t params;
 
     // Act
-    float actuals[3];
-    get_count = ringbuf_getallsorted(&rbuf, actuals);
+    ble_conn_policy_get_params(&policy, &params);
 
     // Assert
+    TEST_ASSERT_EQUAL_UINT16(3200, params.max_int);
+    TEST_ASSERT_EQUAL_UINT16(2, params.latency);
+    TEST_ASSERT_EQUAL_UINT16(3200, params.timeout);
+}
+
+TEST_CASE("should measure throughput and connection events of each phase", "[ble_conn_policy]")
+{
+    // Arrange
+    ble_conn_policy_t policy;
+    ble_conn_policy_init(&policy, &conn_policy_config, 0);
+    ble_conn_policy_on_params_updated(&policy, 0, 24, 0);
+    ble_conn_policy_on_traffic(&policy, 1000, 100);
+    ble_conn_policy_on_traffic(&policy, 3000, 200);
+    ble_conn_policy_on_tick(&policy, 8000);
+    ble_conn_policy_on_params_updated(&policy, 8000, 1600, 4);
+    ble_conn_policy_metrics_t fast;
+    ble_conn_policy_metrics_t relaxed;
+
+    // Act
+    ble_conn_policy_get_metrics(&policy, 28000, BLE_CONN_POLICY_FAST, &fast);
+    ble_conn_policy_get_metrics(&policy, 28000, BLE_CONN_POLICY_RELAXED, &relaxed);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT32(8000, fast.duration_ms);
+    TEST_ASSERT_EQUAL_UINT32(300, fast.bytes);
+    TEST_ASSERT_EQUAL_FLOAT(37.5, fast.throughput_bps);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 266.67, fast.conn_events);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 1.125, fast.bytes_per_event);
+    TEST_ASSERT_EQUAL_UINT32(1, fast.entered_count);
+    TEST_ASSERT_EQUAL_UINT32(20000, relaxed.duration_ms);
+    TEST_ASSERT_EQUAL_UINT32(0, relaxed.bytes);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 2, relaxed.conn_events);
+    TEST_ASSERT_EQUAL_UINT32(1, relaxed.entered_count);
+}
+
+//==================================================================================================
+// ble_conn_table
+//==================================================================================================
+
+#define SIMULATED_CLIENTS_LEN 4
+
+TEST_CASE("should refuse connections beyond capacity, until one disconnects", "[ble_conn_table]")
+{
+    // Arrange
+    ble_conn_t conns_[2];
+    ble_conn_table_t table = ble_conn_table_init(conns_, 2);
+    uint8_t bda[3][6] = {{1}, {2}, {3}};
+
+    // Act
+    ble_conn_t *first = ble_conn_table_add(&table, 0, bda[0]);
+    ble_conn_t *second = ble_conn_table_add(&table, 1, bda[1]);
+    ble_conn_t *refused = ble_conn_table_add(&table, 2, bda[2]);
+    bool removed = ble_conn_table_remove(&table, 0);
+    ble_conn_t *third = ble_conn_table_add(&table, 2, bda[2]);
+
+    // Assert
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NOT_NULL(second);
+    TEST_ASSERT_NULL(refused);
+    TEST_ASSERT_TRUE(removed);
+    TEST_ASSERT_NOT_NULL(third);
+    TEST_ASSERT_EQUAL_UINT16(BLE_CONN_TABLE_DEFAULT_MTU, third->mtu);
+    TEST_ASSERT_EQUAL_UINT32(0, third->subscriptions);
+    TEST_ASSERT_EQUAL_UINT(2, ble_conn_table_count(&table));
+    TEST_ASSERT_NULL(ble_conn_table_find(&table, 0));
+    TEST_ASSERT_EQUAL_PTR(second, ble_conn_table_find_by_bda(&table, bda[1]));
+}
+
+TEST_CASE("should notify subscribed connections only, within their MTU", "[ble_conn_table]")
+{
+    // Arrange
+    ble_conn_t conns_[SIMULATED_CLIENTS_LEN];
+    ble_conn_table_t table = ble_conn_table_init(conns_, SIMULATED_CLIENTS_LEN);
+    uint8_t bda[6] = {0};
+    ble_conn_t *small_mtu = ble_conn_table_add(&table, 10, bda);
+    ble_conn_t *large_mtu = ble_conn_table_add(&table, 11, bda);
+    ble_conn_t *not_subscribed = ble_conn_table_add(&table, 12, bda);
+    ble_conn_t *congested = ble_conn_table_add(&table, 13, bda);
+    small_mtu->subscriptions = 1 << 1;
+    large_mtu->subscriptions = 1 << 1;
+    large_mtu->mtu = 247;
+    not_subscribed->subscriptions = 1 << 0;
+    congested->subscriptions = 1 << 1;
+    congested->congested = true;
+    ble_conn_target_t targets[SIMULATED_CLIENTS_LEN];
+
+    // Act
+    size_t targets_len = ble_conn_table_select_targets(&table, 1, 66, targets);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(2, targets_len);
+    TEST_ASSERT_EQUAL_UINT16(10, targets[0].conn_id);
+    TEST_ASSERT_EQUAL_UINT16(20, targets[0].len);
+    TEST_ASSERT_EQUAL_UINT16(11, targets[1].conn_id);
+    TEST_ASSERT_EQUAL_UINT16(66, targets[1].len);
+    TEST_ASSERT_EQUAL_UINT32(1, congested->notify_counters.skipped);
+}
+
+TEST_CASE("should serve every simulated client first equally often", "[ble_conn_table]")
+{
+    // Arrange
+    ble_conn_t conns_[SIMULATED_CLIENTS_LEN];
+    ble_conn_table_t table = ble_conn_table_init(conns_, SIMULATED_CLIENTS_LEN);
+    uint8_t bda[6] = {0};
+    for (uint16_t conn_id = 0; conn_id < SIMULATED_CLIENTS_LEN; conn_id++)
+    {
+        ble_conn_table_add(&table, conn_id, bda)->subscriptions = 1 << 0;
+    }
+    uint32_t served_first[SIMULATED_CLIENTS_LEN] = {0};
+    const size_t fan_outs = 100 * SIMULATED_CLIENTS_LEN;
+
+    // Act
+    for (size_t i = 0; i < fan_outs; i++)
+    {
+        ble_conn_target_t targets[SIMULATED_CLIENTS_LEN];
+        size_t targets_len = ble_conn_table_select_targets(&table, 0, 2, targets);
+        served_first[targets[0].conn_id]++;
+        for (size_t t = 0; t < targets_len; t++)
+        {
+            ble_conn_table_on_notify_result(&table, targets[t].conn_id, true);
+        }
+    }
+
+    // Assert
+    for (uint16_t conn_id = 0; conn_id < SIMULATED_CLIENTS_LEN; conn_id++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(100, served_first[conn_id]);
+        TEST_ASSERT_EQUAL_UINT32(fan_outs, ble_conn_table_find(&table, conn_id)->notify_counters.sent);
+    }
+}
+
+//==================================================================================================
+// ess_trigger
+//==================================================================================================
+
+TEST_CASE("should parse and encode trigger settings, rejecting invalid ones", "[ess_trigger]")
+{
+    // Arrange
+    const uint8_t fixed_interval[] = {ESS_TRIGGER_FIXED_INTERVAL, 0x10, 0x0E, 0x00};
+    const uint8_t less_than[] = {ESS_TRIGGER_LESS_THAN, 0x0C, 0xFE};
+    const uint8_t wrong_len[] = {ESS_TRIGGER_GREATER_THAN, 0x0C};
+    const uint8_t unknown[] = {0x0A, 0x00, 0x00};
+    ess_trigger_t trigger;
+    uint8_t encoded[ESS_TRIGGER_MAX_LEN];
+
+    // Act & Assert: 3600 seconds
+    TEST_ASSERT_EQUAL(ESP_OK, ess_trigger_parse(fixed_interval, sizeof(fixed_interval), true, &trigger));
+    TEST_ASSERT_EQUAL(ESS_TRIGGER_FIXED_INTERVAL, trigger.condition);
+    TEST_ASSERT_EQUAL_UINT32(3600, trigger.interval_s);
+    TEST_ASSERT_EQUAL_UINT(sizeof(fixed_interval), ess_trigger_encode(&trigger, encoded));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(fixed_interval, encoded, sizeof(fixed_interval));
+
+    // Act & Assert: -5.00 °C
+    TEST_ASSERT_EQUAL(ESP_OK, ess_trigger_parse(less_than, sizeof(less_than), true, &trigger));
+    TEST_ASSERT_EQUAL_INT32(-500, trigger.operand);
+    TEST_ASSERT_EQUAL_UINT(sizeof(less_than), ess_trigger_encode(&trigger, encoded));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(less_than, encoded, sizeof(less_than));
+
+    // Act & Assert: the same bytes are 654.52 %RH, if unsigned
+    TEST_ASSERT_EQUAL(ESP_OK, ess_trigger_parse(less_than, sizeof(less_than), false, &trigger));
+    TEST_ASSERT_EQUAL_INT32(65036, trigger.operand);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, ess_trigger_parse(wrong_len, sizeof(wrong_len), true, &trigger));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, ess_trigger_parse(unknown, sizeof(unknown), true, &trigger));
+    TEST_ASSERT_EQUAL_INT32(65036, trigger.operand);
+}
+
+TEST_CASE("should notify only when the value changes by more than the operand", "[ess_trigger]")
+{
+    // Arrange
+    ess_trigger_set_t set;
+    ess_trigger_set_init(&set);
+    const uint8_t on_change[] = {ESS_TRIGGER_ON_CHANGE, 50, 0};
+    TEST_ASSERT_EQUAL(ESP_OK, ess_trigger_parse(on_change, sizeof(on_change), true, &set.triggers[0]));
+
+    // Act & Assert: the first value is always notified, then changes are compared with the last notified one
+    TEST_ASSERT_TRUE(ess_trigger_evaluate(&set, 2150, 0));
+    TEST_ASSERT_FALSE(ess_trigger_evaluate(&set, 2180, 30000));
+    TEST_ASSERT_FALSE(ess_trigger_evaluate(&set, 2200, 60000));
+    TEST_ASSERT_TRUE(ess_trigger_evaluate(&set, 2201, 90000));
+    TEST_ASSERT_FALSE(ess_trigger_evaluate(&set, 2201, 120000));
+    TEST_ASSERT_TRUE(ess_trigger_evaluate(&set, 2150, 150000));
+}
+
+TEST_CASE("should combine trigger settings with the configured logic", "[ess_trigger]")
+{
+    // Arrange: on change, but at most every 5 minutes
+    ess_trigger_set_t set;
+    ess_trigger_set_init(&set);
+    set.triggers[1] = (ess_trigger_t){.condition = ESS_TRIGGER_MIN_INTERVAL, .interval_s = 300};
+
+    // Act & Assert
+    TEST_ASSERT_TRUE(ess_trigger_evaluate(&set, 2150, 0));
+    TEST_ASSERT_FALSE(ess_trigger_evaluate(&set, 2160, 30000));
+    TEST_ASSERT_FALSE(ess_trigger_evaluate(&set, 2150, 300000));
+    TEST_ASSERT_TRUE(ess_trigger_evaluate(&set, 2170, 330000));
+
+    // Arrange: every hour, or while above 30.00 °C
+    set.triggers[0] = (ess_trigger_t){.condition = ESS_TRIGGER_FIXED_INTERVAL, .interval_s = 3600};
+    set.triggers[1] = (ess_trigger_t){.condition = ESS_TRIGGER_GREATER_THAN, .operand = 3000};
+    set.logic = ESS_TRIGGER_LOGIC_OR;
+
+    // Act & Assert
+    TEST_ASSERT_FALSE(ess_trigger_evaluate(&set, 2170, 360000));
+    TEST_ASSERT_TRUE(ess_trigger_evaluate(&set, 3001, 390000));
+    TEST_ASSERT_TRUE(ess_trigger_evaluate(&set, 3001, 420000));
+    TEST_ASSERT_FALSE(ess_trigger_evaluate(&set, 2170, 450000));
+    TEST_ASSERT_TRUE(ess_trigger_evaluate(&set, 2170, 420000 + 3600000));
+
+    // Arrange: no active trigger settings
+    set.triggers[0].condition = ESS_TRIGGER_INACTIVE;
+    set.triggers[1].condition = ESS_TRIGGER_INACTIVE;
+
+    // Act & Assert
+    TEST_ASSERT_FALSE(ess_trigger_evaluate(&set, 3500, 10000000));
+}
+
+//==================================================================================================
+// button_gesture
+//==================================================================================================
+
+TEST_CASE("should report a short press once no second press came in time", "[button_gesture]")
+{
+    // Arrange
+    button_gesture_t gesture;
+    button_gesture_init(&gesture, 800, 250);
+
+    // Act
+    button_event_t press = button_gesture_press(&gesture, 1000);
+    button_event_t release = button_gesture_release(&gesture, 1100);
+    uint32_t timeout_ms = button_gesture_timeout_ms(&gesture, 1100);
+    button_event_t early_timeout = button_gesture_timeout(&gesture, 1300);
+    button_event_t timeout = button_gesture_timeout(&gesture, 1350);
+
+    // Assert
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_NONE, press);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_NONE, release);
+    TEST_ASSERT_EQUAL_UINT32(250, timeout_ms);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_NONE, early_timeout);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_SHORT_PRESS, timeout);
+    TEST_ASSERT_EQUAL_UINT32(BUTTON_GESTURE_NO_TIMEOUT, button_gesture_timeout_ms(&gesture, 1350));
+}
+
+TEST_CASE("should report a long press while the button is still held", "[button_gesture]")
+{
+    // Arrange
+    button_gesture_t gesture;
+    button_gesture_init(&gesture, 800, 250);
+    button_gesture_press(&gesture, 0);
+
+    // Act
+    uint32_t timeout_ms = button_gesture_timeout_ms(&gesture, 300);
+    button_event_t timeout = button_gesture_timeout(&gesture, 800);
+    button_event_t release = button_gesture_release(&gesture, 2000);
+
+    // Assert: releasing a long press doesn't report anything else
+    TEST_ASSERT_EQUAL_UINT32(500, timeout_ms);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_LONG_PRESS, timeout);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_NONE, release);
+    TEST_ASSERT_EQUAL_UINT32(BUTTON_GESTURE_NO_TIMEOUT, button_gesture_timeout_ms(&gesture, 2000));
+}
+
+TEST_CASE("should report a double press on the second press, or short presses without double presses",
+          "[button_gesture]")
+{
+    // Arrange
+    button_gesture_t gesture;
+    button_gesture_init(&gesture, 800, 250);
+    button_gesture_t no_double;
+    button_gesture_init(&no_double, 800, 0);
+
+    // Act
+    button_gesture_press(&gesture, 0);
+    button_gesture_release(&gesture, 100);
+    button_event_t second_press = button_gesture_press(&gesture, 300);
+    button_event_t second_release = button_gesture_release(&gesture, 1500);
+    button_gesture_press(&no_double, 0);
+    button_event_t release = button_gesture_release(&no_double, 100);
+
+    // Assert: a second press held long isn't a long press too
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_DOUBLE_PRESS, second_press);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_NONE, second_release);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_SHORT_PRESS, release);
+    TEST_ASSERT_EQUAL_UINT32(BUTTON_GESTURE_NO_TIMEOUT, button_gesture_timeout_ms(&no_double, 100));
+}
+
+TEST_CASE("should tell gestures apart when the timeouts come late, across a clock wrap-around", "[button_gesture]")
+{
+    // Arrange
+    button_gesture_t gesture;
+    button_gesture_init(&gesture, 800, 250);
+    const uint32_t start_ms = UINT32_MAX - 100;
+
+    // Act: the timeouts never fire, so the edges come first
+    button_gesture_press(&gesture, start_ms);
+    button_gesture_release(&gesture, start_ms + 100);
+    button_event_t late_press = button_gesture_press(&gesture, start_ms + 400);
+    button_event_t late_release = button_gesture_release(&gesture, start_ms + 1300);
+
+    // Assert: the first press was a short one, and the second a long one
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_SHORT_PRESS, late_press);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_LONG_PRESS, late_release);
+}
+
+//==================================================================================================
+// stats
+//==================================================================================================
+
+TEST_CASE("should get no statistics, if no item has been added", "[stats]")
+{
+    // Arrange
+    uint16_t bins[100];
+    stats_window_t win = stats_window_init(bins, 100, 0, 1, 3, 1000);
+
+    // Act
+    stats_t actual;
+    size_t get_count = stats_window_get(&win, &actual);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(0, get_count);
+}
+
+TEST_CASE("should compute mean and standard deviation over the window only", "[stats]")
+{
+    // Arrange
+    uint16_t bins[100];
+    stats_window_t win = stats_window_init(bins, 100, 0, 1, 3, 1000);
+    float items[] = {50, 2, 4, 4, 7};
+    for (size_t i = 0; i < sizeof(items) / sizeof(items[0]); i++)
+    {
+        stats_window_push(&win, items[i], i >= 3 ? items[i - 3] : NAN);
+    }
+
+    // Act
+    stats_t actual;
+    size_t get_count = stats_window_get(&win, &actual);
+
+    // Assert: window holds {4, 4, 7}
     TEST_ASSERT_EQUAL_UINT(3, get_count);
-    TEST_ASSERT_EQUAL_FLOAT_ARRAY(((float[]){-7.2, 0.4, 23.29}), actuals, 3);
+    TEST_ASSERT_EQUAL_UINT(3, actual.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 5.0, actual.mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, sqrtf(3.0), actual.stddev);
+}
+
+TEST_CASE("should pop the oldest item, as if it had never been added", "[stats]")
+{
+    // Arrange
+    uint16_t bins[100];
+    stats_window_t win = stats_window_init(bins, 100, 0, 1, 3, 1000);
+    stats_window_push(&win, 50, NAN);
+    stats_window_push(&win, 4, NAN);
+    stats_window_push(&win, 7, NAN);
+
+    // Act
+    stats_window_pop(&win, 50);
+    stats_window_push(&win, 4, NAN);
+
+    // Assert: window holds {4, 7, 4}
+    stats_t actual;
+    TEST_ASSERT_EQUAL_UINT(3, stats_window_get(&win, &actual));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 5.0, actual.mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, sqrtf(3.0), actual.stddev);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 0, actual.trend);
+}
+
+TEST_CASE("should compute percentiles within one bin width", "[stats]")
+{
+    // Arrange
+    uint16_t bins[400];
+    stats_window_t win = stats_window_init(bins, 400, -50, 0.25, 100, 1000);
+    for (size_t i = 0; i < 150; i++)
+    {
+        // 0.0 ... 9.9, so the item leaving the window is the one entering it
+        float item = (float)(i % 100) / 10;
+        stats_window_push(&win, item, item);
+    }
+
+    // Act
+    stats_t actual;
+    stats_window_get(&win, &actual);
+
+    // Assert
+    TEST_ASSERT_FLOAT_WITHIN(0.25, 0.99, actual.p10);
+    TEST_ASSERT_FLOAT_WITHIN(0.25, 8.91, actual.p90);
+}
+
+TEST_CASE("should clamp items outside the histogram range into the first and last bin", "[stats]")
+{
+    // Arrange
+    uint16_t bins[10];
+    stats_window_t win = stats_window_init(bins, 10, 0, 1, 3, 1000);
+    float items[] = {-100, 5, 100};
+    for (size_t i = 0; i < sizeof(items) / sizeof(items[0]); i++)
+    {
+        stats_window_push(&win, items[i], NAN);
+    }
+
+    // Act
+    stats_t actual;
+    stats_window_get(&win, &actual);
+
+    // Assert
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 0.5 + 0.2 * 5, actual.p10);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 5.5 + 0.8 * 4, actual.p90);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 5.0 / 3, actual.mean);
+}
+
+TEST_CASE("should compute the trend per hour, also after the window wraps", "[stats]")
+{
+    // Arrange
+    uint16_t bins[100];
+    // one reading every 30 seconds, i.e. 120 readings per hour
+    stats_window_t win = stats_window_init(bins, 100, 0, 1, 8, 30000);
+    for (size_t i = 0; i < 25; i++)
+    {
+        stats_window_push(&win, 20 + 0.01 * i, i >= 8 ? 20 + 0.01 * (i - 8) : NAN);
+    }
+
+    // Act
+    stats_t actual;
+    stats_window_get(&win, &actual);
+
+    // Assert
+    TEST_ASSERT_EQUAL_UINT(8, actual.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1.2, actual.trend);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, 20.205, actual.mean);
+}
+
+TEST_CASE("should keep the mean over a window slid many times", "[stats]")
+{
+    // Arrange: a one hour window of readings taken every 30 seconds
+    enum
+    {
+        WINDOW_LEN = 120,
+        ITEMS = 2000
+    };
+    static uint16_t bins[500];
+    static float items[ITEMS];
+    stats_window_t win = stats_window_init(bins, 500, -40, 0.25, WINDOW_LEN, 30000);
+    for (size_t i = 0; i < ITEMS; i++)
+    {
+        items[i] = 20 + (float)(i * 37 % 101) / 100;
+    }
+
+    // Act
+    for (size_t i = 0; i < ITEMS; i++)
+    {
+        stats_window_push(&win, items[i], i >= WINDOW_LEN ? items[i - WINDOW_LEN] : NAN);
+    }
+    stats_t actual;
+    stats_window_get(&win, &actual);
+
+    // Assert
+    double expected_sum = 0;
+    for (size_t i = ITEMS - WINDOW_LEN; i < ITEMS; i++)
+    {
+        expected_sum += items[i];
+    }
+    TEST_ASSERT_EQUAL_UINT(WINDOW_LEN, actual.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001, expected_sum / WINDOW_LEN, actual.mean);
+}
+
+//==================================================================================================
+// sample_window
+//==================================================================================================
+
+/*
+ * assert_window_matches_store checks that the window holds the latest readings of its field in the store, as many as
+ *   its capacity or all of them, by comparing its statistics with those of a window filled from scratch.
+ */
+static void assert_window_matches_store(const sample_window_t *win, const sample_store_t *store)
+{
+    float history[16];
+    TEST_ASSERT_TRUE(win->stats.capacity <= 16);
+    size_t history_len = sample_store_query(store, win->field, win->stats.capacity, history, NULL);
+    uint16_t bins[100];
+    stats_window_t expected_win = stats_window_init(bins, 100, 0, 1, win->stats.capacity, 1000);
+    for (size_t n = history_len; n-- > 0;)
+    {
+        stats_window_push(&expected_win, history[n], NAN);
+    }
+    stats_t expected;
+    stats_t actual;
+    size_t expected_count = stats_window_get(&expected_win, &expected);
+    TEST_ASSERT_EQUAL_UINT(expected_count, stats_window_get(&win->stats, &actual));
+    if (expected_count > 0)
+    {
+        TEST_ASSERT_FLOAT_WITHIN(0.0001, expected.mean, actual.mean);
+        TEST_ASSERT_FLOAT_WITHIN(0.0001, expected.stddev, actual.stddev);
+        TEST_ASSERT_FLOAT_WITHIN(0.001, expected.trend, actual.trend);
+        TEST_ASSERT_EQUAL_FLOAT(expected.p10, actual.p10);
+        TEST_ASSERT_EQUAL_FLOAT(expected.p90, actual.p90);
+    }
+}
+
+/*
+ * append_and_assert appends a record holding each of the values in its second field, updating the window around each
+ *   append as the firmware does, and checks the window against the store after every one.
+ */
+static void append_and_assert(sample_window_t *win, sample_store_t *store, const float values[], size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        float record[2] = {-1, values[i]};
+        sample_window_evict(win, store, values[i]);
+        sample_store_append(store, (i + 1) * 1000, record);
+        sample_window_push(win, values[i]);
+        assert_window_matches_store(win, store);
+    }
+}
+
+TEST_CASE("should fill the window with the readings already in the store", "[sample_window]")
+{
+    // Arrange: the store wrapped, and lost the reading 1
+    float values_[5 * 2];
+    uint32_t timestamps_ms_[5];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 5, 5);
+    float readings[] = {1, 2, NAN, 4, 5, NAN};
+    for (size_t i = 0; i < sizeof(readings) / sizeof(readings[0]); i++)
+    {
+        sample_store_append(&store, (i + 1) * 1000, (float[]){-1, readings[i]});
+    }
+    float history[3];
+    size_t history_len = sample_store_query(&store, 1, 3, history, NULL);
+    uint16_t bins[100];
+
+    // Act
+    sample_window_t win;
+    sample_window_init(&win, stats_window_init(bins, 100, 0, 1, 3, 1000), &store, 1, history, history_len);
+
+    // Assert: the window holds {2, 4, 5}, the oldest stored 4 appends ago, and keeps in step with the next appends
+    TEST_ASSERT_EQUAL_UINT(3, win.stats.count);
+    TEST_ASSERT_EQUAL_UINT(4, win.oldest_age);
+    assert_window_matches_store(&win, &store);
+    append_and_assert(&win, &store, (float[]){7, NAN, 8, 9}, 4);
+}
+
+TEST_CASE("should slide the window over a full store, not wrapped yet", "[sample_window]")
+{
+    // Arrange
+    float values_[6 * 2];
+    uint32_t timestamps_ms_[6];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 6, 6);
+    uint16_t bins[100];
+    sample_window_t win;
+    sample_window_init(&win, stats_window_init(bins, 100, 0, 1, 4, 1000), &store, 1, NULL, 0);
+
+    // Act and Assert: the last append fills the store
+    append_and_assert(&win, &store, (float[]){3, 14, 15, 92, 65, 35}, 6);
+    TEST_ASSERT_EQUAL_UINT(6, sample_store_count(&store));
+    TEST_ASSERT_EQUAL_UINT(4, win.stats.count);
+}
+
+TEST_CASE("should keep the window in step with a store that wrapped many times", "[sample_window]")
+{
+    // Arrange
+    float values_[5 * 2];
+    uint32_t timestamps_ms_[5];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 5, 5);
+    uint16_t bins[100];
+    sample_window_t win;
+    sample_window_init(&win, stats_window_init(bins, 100, 0, 1, 3, 1000), &store, 1, NULL, 0);
+    float readings[23];
+    for (size_t i = 0; i < sizeof(readings) / sizeof(readings[0]); i++)
+    {
+        readings[i] = (float)(i * 37 % 101) / 10;
+    }
+
+    // Act and Assert
+    append_and_assert(&win, &store, readings, sizeof(readings) / sizeof(readings[0]));
+    TEST_ASSERT_EQUAL_UINT(3, win.stats.count);
+}
+
+TEST_CASE("should skip the records without a reading, and drop the readings the store overwrites", "[sample_window]")
+{
+    // Arrange: gaps of one and of several records, as when a channel fails or is read every few cycles
+    float values_[6 * 2];
+    uint32_t timestamps_ms_[6];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 6, 6);
+    uint16_t bins[100];
+    sample_window_t win;
+    sample_window_init(&win, stats_window_init(bins, 100, 0, 1, 3, 1000), &store, 1, NULL, 0);
+    float readings[] = {1,   NAN, 3,   4,   NAN, NAN, NAN, NAN, 9,  NAN, NAN,
+                        NAN, NAN, NAN, NAN, NAN, 17,  18,  NAN, 20, 21,  22};
+
+    // Act and Assert: the window empties while only NANs are appended
+    append_and_assert(&win, &store, readings, 16);
+    TEST_ASSERT_EQUAL_UINT(0, win.stats.count);
+    append_and_assert(&win, &store, readings + 16, sizeof(readings) / sizeof(readings[0]) - 16);
+    TEST_ASSERT_EQUAL_UINT(3, win.stats.count);
+}
+
+TEST_CASE("should hold the whole history, if the window is longer than the store", "[sample_window]")
+{
+    // Arrange
+    float values_[4 * 2];
+    uint32_t timestamps_ms_[4];
+    sample_store_t store = sample_store_init(values_, timestamps_ms_, 2, 4, 4);
+    uint16_t bins[100];
+    sample_window_t win;
+    sample_window_init(&win, stats_window_init(bins, 100, 0, 1, 10, 1000), &store, 1, NULL, 0);
+    float readings[] = {5, 6, NAN, 8, 9, NAN, NAN, 12, 13, 14, 15, NAN, 17};
+
+    // Act and Assert: the window never fills up, and loses its oldest reading as the store overwrites it
+    append_and_assert(&win, &store, readings, sizeof(readings) / sizeof(readings[0]));
+    TEST_ASSERT_EQUAL_UINT(3, win.stats.count);
+}
+
+//==================================================================================================
+// derived_metrics
+//==================================================================================================
+
+static float magnus_dew_point(float temperature, float humidity)
+{
+    float gamma = logf(humidity / 100) + 17.62f * temperature / (243.12f + temperature);
+    return 243.12f * gamma / (17.62f - gamma);
+}
+
+TEST_CASE("should compute the dew point within 0.02 degrees of the Magnus formula", "[derived_metrics]")
+{
+    for (float temperature = 0; temperature <= 60; temperature += 0.7)
+    {
+        for (float humidity = 10; humidity <= 100; humidity += 2.5)
+        {
+            // Act
+            float actual = derived_metrics_dew_point(temperature, humidity);
+
+            // Assert
+            TEST_ASSERT_FLOAT_WITHIN(0.02, magnus_dew_point(temperature, humidity), actual);
+        }
+    }
+}
+
+TEST_CASE("should compute a dew point equal to the temperature, if air is saturated", "[derived_metrics]")
+{
+    // Act
+    float actual = derived_metrics_dew_point(21.3, 100);
+
+    // Assert
+    TEST_ASSERT_FLOAT_WITHIN(0.02, 21.3, actual);
+}
+
+TEST_CASE("should clamp the dew point to the lookup table range", "[derived_metrics]")
+{
+    // Act
+    float actual = derived_metrics_dew_point(20, 0);
+
+    // Assert
+    TEST_ASSERT_EQUAL_FLOAT(-45, actual);
+}
+
+TEST_CASE("should compute the absolute humidity within 0.2% of the Magnus formula", "[derived_metrics]")
+{
+    for (float temperature = -20; temperature <= 60; temperature += 0.7)
+    {
+        // Arrange
+        float humidity = 60;
+        float vapor_pressure = humidity / 100 * 6.112f * expf(17.62f * temperature / (243.12f + temperature));
+        float expected = 216.7f * vapor_pressure / (273.15f + temperature);
+
+        // Act
+        float actual = derived_metrics_absolute_humidity(temperature, humidity);
+
+        // Assert
+        TEST_ASSERT_FLOAT_WITHIN(expected * 0.002, expected, actual);
+    }
+}
+
+TEST_CASE("should compute the heat index with the Rothfusz regression in hot weather", "[derived_metrics]")
+{
+    // Act: 90 °F at 70%
+    float actual = derived_metrics_heat_index(32.2222, 70);
+
+    // Assert: 106 °F according to the NOAA table
+    TEST_ASSERT_FLOAT_WITHIN(0.6, 41.1, actual);
+}
+
+TEST_CASE("should compute the heat index with the Rothfusz regression once its average with the temperature is 80 °F",
+          "[derived_metrics]")
+{
+    // Act: 82 °F at 1%, the simple formula gives 79.9 °F, averaging 81 °F with the temperature
+    float actual = derived_metrics_heat_index(27.7778, 1);
+
+    // Assert: 78.2 °F with the Rothfusz regression, adjusted for low humidity
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 25.66, actual);
+}
+
+TEST_CASE("should compute the heat index with the simple formula in mild weather", "[derived_metrics]")
+{
+    // Act: 68 °F at 50%
+    float actual = derived_metrics_heat_index(20, 50);
+
+    // Assert: 0.5 * (68 + 61 + 50 * 0.094) °F
+    TEST_ASSERT_FLOAT_WITHIN(0.01, (66.85 - 32) * 5 / 9, actual);
 }
 
 void app_main(void)
 {
     UNITY_BEGIN();
     unity_run_tests_by_tag("[store_float_into_uint8_arr]", false);
-    unity_run_tests_by_tag("[ringbuf]", false);
+    unity_run_tests_by_tag("[store_readings_into_uint8_arr]", false);
+    unity_run_tests_by_tag("[float_batch]", false);
+    unity_run_tests_by_tag("[sample_batch]", false);
+    unity_run_tests_by_tag("[sample_bus]", false);
+    unity_run_tests_by_tag("[sample_store]", false);
+    unity_run_tests_by_tag("[sample_timing]", false);
+    unity_run_tests_by_tag("[sample_window]", false);
+    unity_run_tests_by_tag("[stats]", false);
+    unity_run_tests_by_tag("[derived_metrics]", false);
+    unity_run_tests_by_tag("[ble_adv_payload]", false);
+    unity_run_tests_by_tag("[ble_conn_policy]", false);
+    unity_run_tests_by_tag("[ble_conn_table]", false);
+    unity_run_tests_by_tag("[ess_trigger]", false);
+    unity_run_tests_by_tag("[button_gesture]", false);
     UNITY_END();
 }
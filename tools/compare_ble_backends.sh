@@ -0,0 +1,68 @@
+#!/usr/bin/env bash
+#
+# Builds the Envi Sensor with each BLE backend, Bluedroid and NimBLE, and prints their static memory usage side by
+#   side. Given a serial port, it also flashes each build and reads the time and heap the BT host took to come up,
+#   as logged by ble_init ("host ready in ... ms, using ... bytes of heap").
+#
+# Usage, from the root of the repository and with the ESP-IDF environment exported:
+#   tools/compare_ble_backends.sh [port]
+#
+
+set -euo pipefail
+
+PORT="${1:-}"
+BACKENDS=(bluedroid nimble)
+declare -A DEFAULTS=(
+    [bluedroid]="sdkconfig.defaults"
+    [nimble]="sdkconfig.defaults;sdkconfig.defaults.nimble"
+)
+BOOT_LOG_SECONDS=10
+
+# size_field prints the number of bytes on the line of `idf.py size` starting with $2
+size_field() {
+    grep -m1 "^$2" "$1" | sed -E 's/^[^:]*: *([0-9]+) bytes.*/\1/'
+}
+
+# read_boot_log resets the board and prints the line logged once the BT host is ready
+read_boot_log() {
+    python - "$PORT" "$BOOT_LOG_SECONDS" <<'PYTHON'
+import sys, time, serial
+port = serial.Serial(sys.argv[1], 115200, timeout=0.5)
+port.dtr = False
+port.rts = True  # hold EN low to reset the board
+time.sleep(0.1)
+port.rts = False
+deadline = time.time() + float(sys.argv[2])
+while time.time() < deadline:
+    line = port.readline().decode(errors="replace")
+    if "host ready" in line:
+        print(line.split(": ", 1)[-1].strip())
+        break
+else:
+    print("not logged")
+PYTHON
+}
+
+for backend in "${BACKENDS[@]}"; do
+    build_dir="build_${backend}"
+    echo "building ${backend} into ${build_dir}" >&2
+    idf.py -B "${build_dir}" -D SDKCONFIG="${build_dir}/sdkconfig" -D SDKCONFIG_DEFAULTS="${DEFAULTS[$backend]}" \
+        build >/dev/null
+    idf.py -B "${build_dir}" -D SDKCONFIG="${build_dir}/sdkconfig" size >"${build_dir}/size.txt"
+    if [[ -n "${PORT}" ]]; then
+        idf.py -B "${build_dir}" -D SDKCONFIG="${build_dir}/sdkconfig" -p "${PORT}" flash >/dev/null
+        read_boot_log >"${build_dir}/boot.txt"
+    fi
+done
+
+printf "| %-18s | %12s | %12s |\n" "" "Bluedroid" "NimBLE"
+printf "| %-18s | %12s | %12s |\n" "------------------" "-----------:" "-----------:"
+for field in "Used static DRAM" "Used static IRAM" "Used Flash size" "Total image size"; do
+    printf "| %-18s | %12s | %12s |\n" "${field}" "$(size_field build_bluedroid/size.txt "${field}")" \
+        "$(size_field build_nimble/size.txt "${field}")"
+done
+if [[ -n "${PORT}" ]]; then
+    for backend in "${BACKENDS[@]}"; do
+        echo "${backend}: $(cat "build_${backend}/boot.txt")"
+    done
+fi
@@ -0,0 +1,119 @@
+#!/usr/bin/env bash
+#
+# Builds the benchmark app in bench/ for each target, with the target's profile (sdkconfig.defaults.<target>), boots
+#   it under Espressif's QEMU, and prints the instructions each benchmark took on every target side by side.
+# The sensor and the display are stubbed, so no peripheral is emulated.
+#
+# QEMU runs with -icount, so the cycle counter advances by the same amount for every instruction: results count
+#   instructions, and are repeatable from one run to the next, but don't model caches, flash wait states or FPU
+#   latencies. Flash bench/ onto a board for actual timings; it prints the same lines over the serial port.
+#
+# Only esp32 runs by default: the QEMU release pinned by .devcontainer/Dockerfile has no other machine. esp32c3 and
+#   esp32s3 can be passed explicitly, with a later release of Espressif's QEMU emulating them in PATH.
+#
+# Usage, from the root of the repository, with the ESP-IDF environment exported and Espressif's qemu-system-xtensa
+#   (and qemu-system-riscv32, for esp32c3) in PATH:
+#   tools/run_qemu_benchmarks.sh [target...]
+#
+
+set -euo pipefail
+
+TARGETS=(esp32)
+if (($# > 0)); then
+    TARGETS=("$@")
+fi
+# the QEMU machine of each target is named after it
+declare -A QEMU=(
+    [esp32]=qemu-system-xtensa
+    [esp32c3]=qemu-system-riscv32
+    [esp32s3]=qemu-system-xtensa
+)
+ICOUNT_SHIFT=3
+RUN_SECONDS=120
+FLASH_SIZE_MB=4
+COLUMN_LABEL="instructions (icount)"
+
+# check_qemu exits unless the QEMU in PATH emulates target $1
+check_qemu() {
+    if [[ -z "${QEMU[$1]:-}" ]] || ! "${QEMU[$1]}" -machine help 2>/dev/null | grep -q "^$1 "; then
+        echo "no QEMU machine for $1 in PATH: install a release of Espressif's QEMU emulating it" >&2
+        exit 1
+    fi
+}
+
+# merge_flash_image writes the binaries built into $2 for target $1 at their offsets, into the flash image $3,
+#   padded to the size of the flash as QEMU expects
+merge_flash_image() {
+    if esptool.py --chip "$1" merge_bin --help 2>/dev/null | grep -q -- "--fill-flash-size"; then
+        (cd "$2" && esptool.py --chip "$1" merge_bin --fill-flash-size "${FLASH_SIZE_MB}MB" -o "$3" @flash_args \
+            >/dev/null)
+        return
+    fi
+    # the esptool of ESP-IDF 4.3 may lack merge_bin, or its --fill-flash-size: fill the erased flash by hand
+    head -c $((FLASH_SIZE_MB * 1024 * 1024)) /dev/zero | tr '\0' '\377' >"$3"
+    local offset file
+    while read -r offset file; do
+        dd if="$2/${file}" of="$3" bs=4096 seek="$((offset))" oflag=seek_bytes conv=notrunc status=none
+    done < <(grep "^0x" "$2/flash_args")
+}
+
+# run_qemu boots the flash image $2 of target $1, and copies the serial output into $3 until the benchmarks are done
+run_qemu() {
+    "${QEMU[$1]}" -machine "$1" -nographic -monitor none -icount "${ICOUNT_SHIFT}" \
+        -global "driver=timer.$1.timg,property=wdt_disable,value=true" \
+        -drive "file=$2,if=mtd,format=raw" -serial "file:$3" &
+    local pid=$!
+    local deadline=$((SECONDS + RUN_SECONDS))
+    until grep -q "^bench: done" "$3" 2>/dev/null || ((SECONDS >= deadline)); do
+        sleep 1
+    done
+    kill "${pid}" 2>/dev/null || true
+    wait "${pid}" 2>/dev/null || true
+}
+
+# result prints the instructions logged for benchmark $2 by target $1, or - if it wasn't logged
+result() {
+    local value
+    value=$(grep -m1 "^bench: $2 " "build_bench_$1/bench.txt" | awk '{ print $3 }' || true)
+    echo "${value:--}"
+}
+
+for target in "${TARGETS[@]}"; do
+    check_qemu "${target}"
+done
+for target in "${TARGETS[@]}"; do
+    build_dir="${PWD}/build_bench_${target}"
+    echo "building ${target} into ${build_dir}" >&2
+    idf.py -C bench -B "${build_dir}" -D SDKCONFIG="${build_dir}/sdkconfig" -D IDF_TARGET="${target}" \
+        -D SDKCONFIG_DEFAULTS="${PWD}/sdkconfig.defaults.${target};${PWD}/bench/sdkconfig.defaults" build >/dev/null
+    merge_flash_image "${target}" "${build_dir}" "${build_dir}/flash_image.bin"
+    echo "running ${target} under QEMU" >&2
+    rm -f "${build_dir}/bench.txt"
+    run_qemu "${target}" "${build_dir}/flash_image.bin" "${build_dir}/bench.txt"
+done
+
+# the benchmarks, in the order the first target ran them
+first_log="build_bench_${TARGETS[0]}/bench.txt"
+mapfile -t NAMES < <(grep "^bench: [a-z0-9_]* [0-9]* " "${first_log}" | awk '{ print $2 }')
+
+printf "| %-26s | %-14s |" "Benchmark" "Per"
+for target in "${TARGETS[@]}"; do
+    printf " %29s |" "${target} ${COLUMN_LABEL}"
+done
+printf "\n| %-26s | %-14s |" "--------------------------" "--------------"
+for _ in "${TARGETS[@]}"; do
+    printf " %29s |" "----------------------------:"
+done
+printf "\n"
+for name in "${NAMES[@]}"; do
+    # the app logs e.g. cycles/item: under -icount, the cycles are instructions
+    unit=$(grep -m1 "^bench: ${name} " "${first_log}" | awk '{ print $4 }' | sed 's|^cycles/||')
+    printf "| %-26s | %-14s |" "${name}" "${unit}"
+    for target in "${TARGETS[@]}"; do
+        printf " %29s |" "$(result "${target}" "${name}")"
+    done
+    printf "\n"
+done
+for target in "${TARGETS[@]}"; do
+    grep -m1 "^bench: target" "build_bench_${target}/bench.txt" | sed 's/^bench: //' || echo "${target}: not logged"
+done